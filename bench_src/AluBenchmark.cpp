@@ -0,0 +1,217 @@
+#include "Benchmark.h"
+
+#include "CPU.h"
+#include "RegisterFile.h"
+#include "instruction/ThreadedInterpreter.h"
+#include "memory/FlagRegister.h"
+#include "memory/Memory.h"
+#include "util/FlagHelpers.h"
+
+#include <random>
+#include <vector>
+
+namespace GameBoy::Benchmarks {
+
+using namespace std;
+
+namespace {
+
+    constexpr uint64_t NUM_OPERATIONS = 16'000'000;
+    constexpr size_t NUM_OPERANDS = 4096;
+
+    struct Operands {
+        uint8_t a;
+        uint8_t b;
+    };
+
+    auto random_operands() -> vector<Operands>
+    {
+        mt19937 random(8);
+        vector<Operands> operands(NUM_OPERANDS);
+        for (auto& operand : operands)
+            operand = { uint8_t(random()), uint8_t(random()) };
+        return operands;
+    }
+
+    // Each variant folds every result and F into a checksum, so none of the work can be dropped
+    template <typename Operation>
+    auto run_operation(const vector<Operands>& operands, uint32_t& checksum, Operation&& operation) -> double
+    {
+        return Benchmark::time_seconds([&] {
+            uint32_t sum = 0;
+            for (uint64_t i = 0; i < NUM_OPERATIONS; ++i) {
+                const auto& operand = operands[i % NUM_OPERANDS];
+                const auto res = operation(operand.a, operand.b);
+                sum += res.value ^ (res.flags << 8);
+            }
+            checksum = sum;
+        });
+    }
+
+    auto add_with_helpers(uint8_t a, uint8_t b) -> FlagHelpers::AluResult
+    {
+        const uint8_t res = a + b;
+        const uint8_t f = (res == 0 ? Flags::ZERO : 0)
+            | (FlagHelpers::Add::should_half_carry(a, b) ? Flags::HALF_CARRY : 0)
+            | (FlagHelpers::Add::should_carry(a, b) ? Flags::CARRY : 0);
+        return { res, f };
+    }
+
+    // DAA as the table has it, worked out each time. flags is F, of which N, H and C count.
+    auto decimal_adjust_computed(uint8_t a, uint8_t flags) -> FlagHelpers::AluResult
+    {
+        const bool subtract = flags & Flags::SUBTRACT;
+        bool carry = flags & Flags::CARRY;
+        uint8_t correction = 0;
+        if ((flags & Flags::HALF_CARRY) || (!subtract && (a & 0x0F) > 0x09))
+            correction |= 0x06;
+        if (carry || (!subtract && a > 0x99)) {
+            correction |= 0x60;
+            carry = true;
+        }
+        const uint8_t res = subtract ? a - correction : a + correction;
+        return { res, uint8_t((res == 0 ? Flags::ZERO : 0) | (subtract ? Flags::SUBTRACT : 0) | (carry ? Flags::CARRY : 0)) };
+    }
+
+    // The CB rotates and shifts, by their operation field, worked out each time
+    auto rotate_computed(uint8_t operation, uint8_t value, bool carryIn) -> FlagHelpers::AluResult
+    {
+        uint8_t res = 0;
+        bool carry = false;
+        switch (operation) {
+        case 0: // RLC
+            res = uint8_t(value << 1) | (value >> 7);
+            carry = value & 0x80;
+            break;
+        case 1: // RRC
+            res = (value >> 1) | uint8_t(value << 7);
+            carry = value & 0x01;
+            break;
+        case 2: // RL
+            res = uint8_t(value << 1) | carryIn;
+            carry = value & 0x80;
+            break;
+        case 3: // RR
+            res = (value >> 1) | uint8_t(carryIn << 7);
+            carry = value & 0x01;
+            break;
+        case 4: // SLA
+            res = uint8_t(value << 1);
+            carry = value & 0x80;
+            break;
+        case 5: // SRA
+            res = (value >> 1) | (value & 0x80);
+            carry = value & 0x01;
+            break;
+        case 6: // SWAP
+            res = uint8_t(value << 4) | (value >> 4);
+            break;
+        default: // SRL
+            res = value >> 1;
+            carry = value & 0x01;
+            break;
+        }
+        return { res, uint8_t((res == 0 ? Flags::ZERO : 0) | (carry ? Flags::CARRY : 0)) };
+    }
+
+    // A loop of arithmetic: ADD, ADC, SUB, SBC, CP, INC, DEC, DAA, the A rotates and a few CB
+    // rotates and shifts
+    const vector<uint8_t> PROGRAM = {
+        0x80, // ADD A,B
+        0x27, // DAA
+        0x89, // ADC A,C
+        0x0C, // INC C
+        0x92, // SUB D
+        0x15, // DEC D
+        0x9B, // SBC A,E
+        0x27, // DAA
+        0x17, // RLA
+        0xCB, 0x10, // RL B
+        0xBC, // CP H
+        0x1F, // RRA
+        0xCB, 0x33, // SWAP E
+        0xCB, 0x39, // SRL C
+        0xC6, 0x35, // ADD A,$35
+        0x18, uint8_t(-20), // JR start
+    };
+    constexpr uint64_t LOOP_LENGTH = 16;
+
+    auto run_alu_program() -> double
+    {
+        Memory memory;
+        CPU cpu(memory);
+        auto address = uint16_t(0xC000);
+        for (auto byte : PROGRAM)
+            memory.write8(address++, byte);
+        memory.registers().pc = 0xC000;
+
+        // One pass through the loop, to learn how many cycles it takes
+        uint32_t cyclesPerPass = 0;
+        for (uint64_t i = 0; i < LOOP_LENGTH; ++i)
+            cyclesPerPass += cpu.step();
+        const auto passes = NUM_OPERATIONS / LOOP_LENGTH;
+
+        return Benchmark::time_seconds([&] {
+            ThreadedInterpreter::run(cpu, uint32_t(passes * cyclesPerPass));
+        });
+    }
+
+}
+
+auto alu() -> void
+{
+    const auto operands = random_operands();
+    uint32_t helperChecksum = 0;
+    uint32_t deferredChecksum = 0;
+
+    const auto helperSeconds = run_operation(operands, helperChecksum, add_with_helpers);
+    // The emulator doesn't keep an ADD table, since its handlers defer the flags instead; this
+    // one is built here only to compare against
+    vector<FlagHelpers::AluResult> addTable(0x10000);
+    for (uint32_t index = 0; index < addTable.size(); ++index)
+        addTable[index] = add_with_helpers(uint8_t(index >> 8), uint8_t(index));
+    uint32_t tableChecksum = 0;
+    const auto tableSeconds = run_operation(operands, tableChecksum, [&](uint8_t a, uint8_t b) {
+        return addTable[a << 8 | b];
+    });
+    uint8_t f = 0;
+    FlagRegister flags(f);
+    const auto deferredSeconds = run_operation(operands, deferredChecksum, [&](uint8_t a, uint8_t b) {
+        const uint16_t sum = a + b;
+        flags.defer_add(a, b, sum);
+        return FlagHelpers::AluResult { uint8_t(sum), flags.value() };
+    });
+    if (helperChecksum != tableChecksum || helperChecksum != deferredChecksum)
+        printf("alu: checksums differ (%08x, %08x, %08x)\n", helperChecksum, tableChecksum, deferredChecksum);
+
+    // The operations still table-driven, against working them out. b gives DAA its flags, and
+    // the rotates their operation and carry in.
+    uint32_t checksums[4] = {};
+    const auto daaTableSeconds = run_operation(operands, checksums[0], [](uint8_t a, uint8_t b) {
+        return FlagHelpers::Alu::decimal_adjust(a, b & 0x70);
+    });
+    const auto daaComputedSeconds = run_operation(operands, checksums[1], [](uint8_t a, uint8_t b) {
+        return decimal_adjust_computed(a, b & 0x70);
+    });
+    const auto rotateTableSeconds = run_operation(operands, checksums[2], [](uint8_t a, uint8_t b) {
+        return FlagHelpers::Alu::rotate(b & 0x07, a, b & 0x80);
+    });
+    const auto rotateComputedSeconds = run_operation(operands, checksums[3], [](uint8_t a, uint8_t b) {
+        return rotate_computed(b & 0x07, a, b & 0x80);
+    });
+    if (checksums[0] != checksums[1] || checksums[2] != checksums[3])
+        printf("alu: table and computed checksums differ\n");
+
+    const auto programSeconds = run_alu_program();
+
+    Benchmark::report("alu/add-helpers", NUM_OPERATIONS / helperSeconds / 1e6, "Mops/s");
+    Benchmark::report("alu/add-table", NUM_OPERATIONS / tableSeconds / 1e6, "Mops/s");
+    Benchmark::report("alu/add-deferred", NUM_OPERATIONS / deferredSeconds / 1e6, "Mops/s");
+    Benchmark::report("alu/daa-table", NUM_OPERATIONS / daaTableSeconds / 1e6, "Mops/s");
+    Benchmark::report("alu/daa-computed", NUM_OPERATIONS / daaComputedSeconds / 1e6, "Mops/s");
+    Benchmark::report("alu/rotate-table", NUM_OPERATIONS / rotateTableSeconds / 1e6, "Mops/s");
+    Benchmark::report("alu/rotate-computed", NUM_OPERATIONS / rotateComputedSeconds / 1e6, "Mops/s");
+    Benchmark::report("alu/threaded-program", NUM_OPERATIONS / programSeconds / 1e6, "MIPS");
+}
+
+}
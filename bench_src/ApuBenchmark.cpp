@@ -0,0 +1,114 @@
+#include "Benchmark.h"
+
+#include "CPU.h"
+#include "audio/Apu.h"
+#include "audio/BlepBuffer.h"
+#include "audio/Resampler.h"
+#include "memory/Memory.h"
+
+#include <memory>
+#include <vector>
+
+namespace GameBoy::Benchmarks {
+
+using namespace std;
+
+namespace {
+
+    constexpr uint64_t FRAME_CYCLES = 70224;
+    constexpr uint64_t NUM_SECONDS = 60;
+    constexpr uint32_t SAMPLE_RATE = 48000;
+    constexpr uint32_t BLEP_RATE = Apu::CYCLES_PER_SECOND / BlepBuffer::CYCLES_PER_SAMPLE;
+
+    // All four channels playing for a minute of emulated time, with a halted CPU so that
+    // little else costs anything, and the samples read once a frame. Returns the wall-clock
+    // seconds taken.
+    auto run_apu(bool withApu, uint64_t& frames) -> double
+    {
+        Memory memory;
+        CPU cpu(memory);
+        memory.write8(0xC000, 0x76); // HALT
+        memory.registers().pc = 0xC000;
+        unique_ptr<Apu> apu;
+        if (withApu) {
+            apu = make_unique<Apu>(cpu);
+            apu->set_sample_rate(SAMPLE_RATE);
+            for (uint16_t address = 0xFF30; address < 0xFF40; ++address)
+                memory.write8(address, uint8_t(address * 37));
+            for (const auto& write : vector<pair<uint16_t, uint8_t>> {
+                     { 0xFF24, 0x77 }, { 0xFF25, 0xFF }, // Everything, everywhere
+                     { 0xFF10, 0x00 }, { 0xFF11, 0x80 }, { 0xFF12, 0xF0 }, { 0xFF13, 0x00 }, { 0xFF14, 0x87 },
+                     { 0xFF16, 0x40 }, { 0xFF17, 0xF0 }, { 0xFF18, 0x00 }, { 0xFF19, 0x86 },
+                     { 0xFF1A, 0x80 }, { 0xFF1C, 0x20 }, { 0xFF1D, 0x00 }, { 0xFF1E, 0x85 },
+                     // The quickest noise there is
+                     { 0xFF21, 0xF0 }, { 0xFF22, 0x00 }, { 0xFF23, 0x80 },
+                 })
+                memory.write8(write.first, write.second);
+        }
+
+        vector<int16_t> samples(2 * SAMPLE_RATE);
+        frames = 0;
+        return Benchmark::time_seconds([&] {
+            for (uint64_t cycles = 0; cycles < NUM_SECONDS * Apu::CYCLES_PER_SECOND; cycles += FRAME_CYCLES) {
+                cpu.run_for(FRAME_CYCLES);
+                if (apu)
+                    frames += apu->read_samples(samples.data(), SAMPLE_RATE);
+            }
+        });
+    }
+
+    // A minute of busy input resampled a frame's worth at a time. Returns millions of output
+    // frames per second.
+    auto run_resample(Isa isa, const vector<float>& left, const vector<float>& right, uint64_t& checksum) -> double
+    {
+        const size_t chunk = BLEP_RATE / 60;
+        Resampler resampler(BLEP_RATE, SAMPLE_RATE, isa);
+        vector<int16_t> output;
+        uint64_t frames = 0;
+        const auto seconds = Benchmark::time_seconds([&] {
+            for (uint64_t second = 0; second < NUM_SECONDS; ++second) {
+                for (size_t start = 0; start + chunk <= left.size(); start += chunk) {
+                    output.clear();
+                    resampler.process(left.data() + start, right.data() + start, chunk, output);
+                    frames += output.size() / 2;
+                    checksum += output.empty() ? 0 : uint16_t(output.back());
+                }
+            }
+        });
+        return frames / seconds / 1e6;
+    }
+
+}
+
+auto apu() -> void
+{
+    uint64_t frames;
+    const auto baseline = run_apu(false, frames);
+    const auto seconds = run_apu(true, frames);
+    if (frames < NUM_SECONDS * SAMPLE_RATE - SAMPLE_RATE)
+        printf("apu: only %llu samples\n", static_cast<unsigned long long>(frames));
+
+    // What the APU adds to each emulated second
+    Benchmark::report("apu/cost", (seconds - baseline) / NUM_SECONDS * 1e6, "us/emulated s");
+    Benchmark::report("apu/speed", NUM_SECONDS / seconds, "x realtime");
+
+    // A second of square waves on both sides, as the BlepBuffer would give them
+    vector<float> left(BLEP_RATE);
+    vector<float> right(BLEP_RATE);
+    BlepBuffer steps;
+    steps.reset(0);
+    for (uint64_t cycle = 0, i = 0; cycle < Apu::CYCLES_PER_SECOND - 1024; cycle += 997, ++i)
+        steps.add_step(cycle, (i & 1) ? -7680 : 7680, (i % 3) ? 3840 : -7680);
+    steps.read(left.size(), left.data(), right.data());
+
+    uint64_t checksum = 0;
+    Benchmark::report("apu/resample-scalar", run_resample(Isa::Scalar, left, right, checksum), "Mframes/s");
+    if (isa_supported(Isa::Sse2))
+        Benchmark::report("apu/resample-sse2", run_resample(Isa::Sse2, left, right, checksum), "Mframes/s");
+    if (isa_supported(Isa::Avx2))
+        Benchmark::report("apu/resample-avx2", run_resample(Isa::Avx2, left, right, checksum), "Mframes/s");
+    if (!checksum)
+        printf("apu: no output\n");
+}
+
+}
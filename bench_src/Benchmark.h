@@ -0,0 +1,36 @@
+#pragma once
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+
+namespace GameBoy::Benchmark {
+
+// Runs body once and returns the wall-clock time it took in seconds
+template <typename Body>
+auto time_seconds(Body&& body) -> double
+{
+    const auto start = std::chrono::steady_clock::now();
+    body();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+inline auto report(const char* name, double value, const char* unit) -> void
+{
+    printf("%-40s %12.2f %s\n", name, value, unit);
+}
+
+}
+
+// Every benchmark suite, run in order by main
+namespace GameBoy::Benchmarks {
+
+auto dispatch() -> void;
+auto alu() -> void;
+auto idle() -> void;
+auto ppu() -> void;
+auto apu() -> void;
+auto save_state() -> void;
+
+}
@@ -0,0 +1,139 @@
+#include "Benchmark.h"
+
+#include "CPU.h"
+#include "instruction/ThreadedInterpreter.h"
+#include "jit/Jit.h"
+#include "memory/Memory.h"
+
+#include <memory>
+#include <vector>
+
+namespace GameBoy::Benchmarks {
+
+using namespace std;
+
+namespace {
+
+    constexpr uint16_t PROGRAM_START = 0xC000;
+    constexpr uint64_t NUM_INSTRUCTIONS = 2'000'000;
+
+    // Straight-line block of loads. HL ends up pointing at $D0D0, well clear of the program.
+    const vector<uint8_t> PROGRAM = {
+        0x06, 0xD0, // LD B,$D0
+        0x48, // LD C,B
+        0x51, // LD D,C
+        0x5A, // LD E,D
+        0x63, // LD H,E
+        0x6C, // LD L,H
+        0x7D, // LD A,L
+        0x77, // LD (HL),A
+        0x46, // LD B,(HL)
+        0x3E, 0x12, // LD A,$12
+        0x4F, // LD C,A
+        0x7E, // LD A,(HL)
+    };
+    constexpr uint64_t BLOCK_LENGTH = 12;
+
+    auto load_program(Memory& memory) -> void
+    {
+        auto address = PROGRAM_START;
+        for (auto byte : PROGRAM)
+            memory.write8(address++, byte);
+    }
+
+    auto run_opcode_table() -> double
+    {
+        Memory memory;
+        CPU cpu(memory);
+        load_program(memory);
+
+        return Benchmark::time_seconds([&] {
+            for (uint64_t executed = 0; executed < NUM_INSTRUCTIONS; executed += BLOCK_LENGTH) {
+                memory.registers().pc = PROGRAM_START;
+                for (uint64_t i = 0; i < BLOCK_LENGTH; ++i)
+                    cpu.step();
+            }
+        });
+    }
+
+    // The load block above, looped with a JR so whole blocks can be reused
+    auto load_looped_program(Memory& memory) -> void
+    {
+        load_program(memory);
+        memory.write8(PROGRAM_START + PROGRAM.size(), 0x18); // JR start
+        memory.write8(PROGRAM_START + PROGRAM.size() + 1, uint8_t(-int(PROGRAM.size() + 2)));
+        memory.registers().pc = PROGRAM_START;
+    }
+
+    auto run_block_cache() -> double
+    {
+        Memory memory;
+        CPU cpu(memory);
+        load_looped_program(memory);
+
+        const auto seconds = Benchmark::time_seconds([&] {
+            for (uint64_t executed = 0; executed < NUM_INSTRUCTIONS; executed += BLOCK_LENGTH + 1)
+                cpu.run_block();
+        });
+
+        const auto& stats = cpu.block_cache().stats();
+        printf("block cache: %llu hits, %llu misses\n",
+            static_cast<unsigned long long>(stats.hits),
+            static_cast<unsigned long long>(stats.misses));
+        return seconds;
+    }
+
+    auto run_threaded(uint32_t (*run)(CPU&, uint32_t)) -> double
+    {
+        Memory memory;
+        CPU cpu(memory);
+        load_looped_program(memory);
+
+        // One pass through the loop, to learn how many cycles it takes
+        const auto cyclesPerPass = cpu.run_block();
+        memory.registers().pc = PROGRAM_START;
+        const auto passes = NUM_INSTRUCTIONS / (BLOCK_LENGTH + 1);
+
+        return Benchmark::time_seconds([&] {
+            run(cpu, uint32_t(passes * cyclesPerPass));
+        });
+    }
+
+    auto run_jit() -> double
+    {
+        Memory memory;
+        CPU cpu(memory);
+        cpu.set_execution_mode(ExecutionMode::Jit);
+        load_looped_program(memory);
+
+        // Every pass through the loop takes the same number of cycles, so running for a
+        // cycle count runs a known number of instructions
+        uint32_t cyclesPerPass = 0;
+        for (auto i = 0; i < 2; ++i)
+            cyclesPerPass = cpu.run_block();
+        const auto passes = NUM_INSTRUCTIONS / (BLOCK_LENGTH + 1);
+
+        return Benchmark::time_seconds([&] {
+            cpu.run_for(uint32_t(passes * cyclesPerPass));
+        });
+    }
+
+}
+
+auto dispatch() -> void
+{
+    const auto tableSeconds = run_opcode_table();
+    const auto blockSeconds = run_block_cache();
+    const auto threadedSeconds = run_threaded(ThreadedInterpreter::run);
+    const auto switchSeconds = run_threaded(ThreadedInterpreter::run_portable);
+    const auto jitSeconds = run_jit();
+
+    Benchmark::report("dispatch/opcode-table", NUM_INSTRUCTIONS / tableSeconds / 1e6, "MIPS");
+    Benchmark::report("dispatch/block-cache", NUM_INSTRUCTIONS / blockSeconds / 1e6, "MIPS");
+    Benchmark::report(ThreadedInterpreter::uses_computed_goto() ? "dispatch/threaded" : "dispatch/threaded-switch",
+        NUM_INSTRUCTIONS / threadedSeconds / 1e6, "MIPS");
+    Benchmark::report("dispatch/switch", NUM_INSTRUCTIONS / switchSeconds / 1e6, "MIPS");
+    Benchmark::report("dispatch/jit", NUM_INSTRUCTIONS / jitSeconds / 1e6, "MIPS");
+}
+
+}
@@ -0,0 +1,82 @@
+#include "Benchmark.h"
+
+#include "CPU.h"
+#include "io/InterruptController.h"
+#include "memory/Memory.h"
+
+#include <vector>
+
+namespace GameBoy::Benchmarks {
+
+using namespace std;
+
+namespace {
+
+    constexpr uint64_t FRAME_CYCLES = 70224;
+    constexpr uint64_t NUM_FRAMES = 2000;
+
+    // A game with nothing to do: HALT until VBlank, return from the handler, HALT again
+    const vector<uint8_t> PROGRAM = {
+        0x76, // HALT
+        0x18, uint8_t(-3), // JR start
+    };
+
+    // The same with interrupts off, polling IF for VBlank instead
+    const vector<uint8_t> POLLING_PROGRAM = {
+        0xF3, // DI
+        0xF0, 0x0F, // loop: LDH A,(IF)
+        0xE6, 0x01, // AND $01
+        0x28, 0xFA, // JR Z,loop
+        0xAF, // XOR A
+        0xE0, 0x0F, // LDH (IF),A
+        0x18, 0xF5, // JR loop
+    };
+
+    // Runs a program with VBlank raised once a frame. Returns the frames run per second.
+    template <typename Run>
+    auto run_idle(const vector<uint8_t>& program, bool skipIdleLoops, Run&& run) -> double
+    {
+        Memory memory;
+        CPU cpu(memory);
+        cpu.set_idle_loop_skipping(skipIdleLoops);
+        auto address = uint16_t(0xC000);
+        for (auto byte : program)
+            memory.write8(address++, byte);
+        memory.write8(0x0040, 0xD9); // RETI
+        memory.registers().pc = 0xC000;
+        memory.registers().sp = 0xDFFE;
+        memory.write8(0xFFFF, 0x01);
+        cpu.set_interrupts_enabled(true);
+
+        auto& scheduler = cpu.scheduler();
+        scheduler.set_handler(Event::Ppu, [&] {
+            cpu.interrupts().request(Interrupt::VBlank);
+            scheduler.schedule_in(Event::Ppu, FRAME_CYCLES);
+        });
+        scheduler.schedule(Event::Ppu, FRAME_CYCLES);
+
+        const auto seconds = Benchmark::time_seconds([&] { run(cpu, NUM_FRAMES * FRAME_CYCLES); });
+        return NUM_FRAMES / seconds;
+    }
+
+}
+
+auto idle() -> void
+{
+    // One step at a time, as if every idle cycle had to be ticked through
+    const auto stepped = run_idle(PROGRAM, false, [](CPU& cpu, uint64_t cycles) {
+        while (cpu.scheduler().now() < cycles)
+            cpu.step();
+    });
+    const auto run = [](CPU& cpu, uint64_t cycles) { cpu.run_until(cycles); };
+    const auto fastForwarded = run_idle(PROGRAM, false, run);
+    const auto polled = run_idle(POLLING_PROGRAM, false, run);
+    const auto pollSkipped = run_idle(POLLING_PROGRAM, true, run);
+
+    Benchmark::report("idle/halt-stepped", stepped, "frames/s");
+    Benchmark::report("idle/halt-fast-forward", fastForwarded, "frames/s");
+    Benchmark::report("idle/poll", polled, "frames/s");
+    Benchmark::report("idle/poll-skipped", pollSkipped, "frames/s");
+}
+
+}
@@ -0,0 +1,100 @@
+#include "Benchmark.h"
+
+#include "CPU.h"
+#include "memory/Memory.h"
+#include "video/Ppu.h"
+#include "video/TileDecoder.h"
+
+#include <random>
+#include <vector>
+
+namespace GameBoy::Benchmarks {
+
+using namespace std;
+
+namespace {
+
+    constexpr size_t NUM_TILES = 384;
+    constexpr uint64_t DECODE_PASSES = 20'000;
+    constexpr uint64_t FRAME_CYCLES = 70224;
+    constexpr uint64_t NUM_FRAMES = 600;
+
+    // Every tile in VRAM, decoded over and over. Returns millions of pixels per second.
+    auto run_decode(TileDecoder::Isa isa, const vector<uint8_t>& tiles, uint32_t& checksum) -> double
+    {
+        vector<uint8_t> pixels(NUM_TILES * 64);
+        const auto seconds = Benchmark::time_seconds([&] {
+            for (uint64_t pass = 0; pass < DECODE_PASSES; ++pass) {
+                TileDecoder::decode_rows(isa, tiles.data(), NUM_TILES * 8, pixels.data());
+                checksum += pixels[pass % pixels.size()];
+            }
+        });
+        return DECODE_PASSES * pixels.size() / seconds / 1e6;
+    }
+
+    // Random tiles, maps and sprites with everything switched on, the CPU idling in a loop.
+    // Returns frames per second, and the tile cache's counters when drawing inline.
+    auto run_frames(bool tileCache, bool threaded, TileCache::Stats& stats) -> double
+    {
+        Memory memory;
+        CPU cpu(memory);
+        Ppu ppu(cpu);
+        vector<uint8_t> framebuffer(SCREEN_WIDTH * SCREEN_HEIGHT);
+        ppu.set_framebuffer(framebuffer.data());
+        ppu.set_tile_cache_enabled(tileCache);
+        ppu.set_threaded_rendering(threaded);
+
+        mt19937 random(16);
+        for (uint32_t address = 0x8000; address < 0xA000; ++address)
+            memory.write8(address, uint8_t(random()));
+        for (uint32_t address = 0xFE00; address < 0xFEA0; ++address)
+            memory.write8(address, uint8_t(random()));
+        memory.write8(0xC000, 0x18); // JR self
+        memory.write8(0xC001, 0xFE);
+        memory.registers().pc = 0xC000;
+        memory.write8(0xFF47, 0xE4);
+        memory.write8(0xFF4A, 40);
+        memory.write8(0xFF4B, 50);
+        memory.write8(0xFF40, 0xF3);
+
+        const auto seconds = Benchmark::time_seconds([&] {
+            cpu.run_for(NUM_FRAMES * FRAME_CYCLES);
+            ppu.sync_framebuffer();
+        });
+        stats = ppu.tile_cache_stats();
+        return NUM_FRAMES / seconds;
+    }
+
+}
+
+auto ppu() -> void
+{
+    mt19937 random(8);
+    vector<uint8_t> tiles(NUM_TILES * 16);
+    for (auto& byte : tiles)
+        byte = uint8_t(random());
+
+    uint32_t checksum = 0;
+    const auto scalar = run_decode(TileDecoder::Isa::Scalar, tiles, checksum);
+    Benchmark::report("ppu/decode-scalar", scalar, "Mpixels/s");
+    if (TileDecoder::supported(TileDecoder::Isa::Sse2))
+        Benchmark::report("ppu/decode-sse2", run_decode(TileDecoder::Isa::Sse2, tiles, checksum), "Mpixels/s");
+    if (TileDecoder::supported(TileDecoder::Isa::Avx2))
+        Benchmark::report("ppu/decode-avx2", run_decode(TileDecoder::Isa::Avx2, tiles, checksum), "Mpixels/s");
+    if (!checksum)
+        printf("ppu: empty checksum\n");
+
+    TileCache::Stats stats;
+    Benchmark::report("ppu/frames-uncached", run_frames(false, false, stats), "frames/s");
+    Benchmark::report("ppu/frames", run_frames(true, false, stats), "frames/s");
+    // Uncached, every tile row drawn is decoded; cached, only the 8 rows of each miss
+    const auto rows = stats.hits + stats.misses;
+    Benchmark::report("ppu/rows-decoded-uncached", double(rows) / NUM_FRAMES, "rows/frame");
+    Benchmark::report("ppu/rows-decoded", 8.0 * stats.misses / NUM_FRAMES, "rows/frame");
+    Benchmark::report("ppu/tile-cache-hits", 100.0 * stats.hits / rows, "%");
+
+    TileCache::Stats threadedStats;
+    Benchmark::report("ppu/frames-threaded", run_frames(true, true, threadedStats), "frames/s");
+}
+
+}
@@ -0,0 +1,71 @@
+#include "Benchmark.h"
+
+#include "CPU.h"
+#include "audio/Apu.h"
+#include "cartridge/Cartridge.h"
+#include "cartridge/RomImage.h"
+#include "io/Timer.h"
+#include "memory/Memory.h"
+#include "state/SaveState.h"
+#include "video/OamDma.h"
+#include "video/Ppu.h"
+
+#include <memory>
+#include <vector>
+
+namespace GameBoy::Benchmarks {
+
+using namespace std;
+
+namespace {
+
+    constexpr int NUM_SNAPSHOTS = 10000;
+    constexpr uint64_t FRAME_CYCLES = 70224;
+
+}
+
+auto save_state() -> void
+{
+    // MBC5 with 32 KiB of RAM, the most a snapshot has to carry
+    vector<uint8_t> rom(0x8000);
+    rom[0x147] = 0x1B;
+    rom[0x149] = 0x03;
+    Memory memory;
+    auto cartridge = Cartridge::insert(memory, RomImage::from_bytes(move(rom)));
+    CPU cpu(memory);
+    Timer timer(cpu);
+    Ppu ppu(cpu);
+    OamDma dma(cpu);
+    Apu apu(cpu);
+    vector<uint8_t> framebuffer(SCREEN_WIDTH * SCREEN_HEIGHT);
+    ppu.set_framebuffer(framebuffer.data());
+    apu.set_sample_rate(48000);
+    const Machine machine { cpu, cartridge.get(), &timer, &ppu, &dma, &apu };
+
+    // A loop in WRAM with the LCD on and code cached, as mid-game
+    memory.write8(0xC000, 0x3C); // INC A
+    memory.write8(0xC001, 0x18); // JR -3
+    memory.write8(0xC002, 0xFD);
+    memory.write8(0xFF40, 0x91);
+    memory.registers().pc = 0xC000;
+    cpu.run_cycles(FRAME_CYCLES);
+
+    vector<uint8_t> snapshot;
+    const auto saveSeconds = Benchmark::time_seconds([&] {
+        for (int i = 0; i < NUM_SNAPSHOTS; ++i)
+            GameBoy::save_state(machine, snapshot);
+    });
+    bool loaded = true;
+    const auto loadSeconds = Benchmark::time_seconds([&] {
+        for (int i = 0; i < NUM_SNAPSHOTS; ++i)
+            loaded = load_state(machine, snapshot.data(), snapshot.size()) && loaded;
+    });
+    if (!loaded)
+        printf("savestate: a load failed\n");
+
+    Benchmark::report("savestate/size", snapshot.size() / 1024.0, "KiB");
+    Benchmark::report("savestate/save", saveSeconds / NUM_SNAPSHOTS * 1e6, "us");
+    Benchmark::report("savestate/load", loadSeconds / NUM_SNAPSHOTS * 1e6, "us");
+}
+
+}
@@ -0,0 +1,14 @@
+#include "Benchmark.h"
+
+using namespace GameBoy;
+
+int main()
+{
+    Benchmarks::dispatch();
+    Benchmarks::alu();
+    Benchmarks::idle();
+    Benchmarks::ppu();
+    Benchmarks::apu();
+    Benchmarks::save_state();
+    return 0;
+}
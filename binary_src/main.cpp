@@ -1,8 +1,269 @@
+#include "CPU.h"
+#include "audio/Apu.h"
+#include "audio/WavWriter.h"
+#include "cartridge/Cartridge.h"
+#include "frontend/RateControl.h"
+#include "frontend/SampleRing.h"
+#include "frontend/TripleBuffer.h"
+#include "io/Timer.h"
 #include "memory/Memory.h"
+#include "state/SaveState.h"
+#include "video/OamDma.h"
+#include "video/Ppu.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
 
 using namespace GameBoy;
+using namespace std::chrono_literals;
+
+// How long a frame takes on hardware
+constexpr std::chrono::duration<double> FRAME_TIME { double(CPU::CYCLES_PER_FRAME) / Apu::CYCLES_PER_SECOND };
+constexpr uint32_t SAMPLE_RATE = 48000;
+// In real time, the host takes 10 ms of sound at a time, and rate control keeps about four
+// frames' worth waiting for it
+constexpr size_t AUDIO_RING_FRAMES = 16384;
+constexpr size_t AUDIO_PERIOD_FRAMES = 480;
+constexpr auto AUDIO_PERIOD = 10ms;
+constexpr size_t AUDIO_TARGET_FRAMES = 3200;
+
+namespace {
+
+// Stands in for a frontend's sound card and display, on a thread of its own: takes frames
+// from a TripleBuffer and sound from a SampleRing, recording the sound if asked to. In real
+// time it plays a period of sound every 10 ms whether or not it has arrived; otherwise it
+// takes everything as soon as it's there.
+class Host {
+public:
+    Host(SampleRing& audio, TripleBuffer& frames, WavWriter* wav, bool realtime)
+        : m_audio(audio)
+        , m_frames(frames)
+        , m_wav(wav)
+        , m_realtime(realtime)
+        , m_thread([this] { run(); })
+    {
+    }
+
+    // Plays out whatever is left, then stops
+    auto stop() -> void
+    {
+        m_stopping.store(true, std::memory_order_release);
+        m_thread.join();
+    }
+
+    auto frames_presented() const -> uint64_t { return m_presented; }
+    auto underruns() const -> uint64_t { return m_underruns; }
+
+private:
+    auto run() -> void
+    {
+        // In real time, only from once there's a cushion, so as not to start with dropouts
+        while (m_realtime && m_audio.queued_frames() < AUDIO_TARGET_FRAMES
+            && !m_stopping.load(std::memory_order_acquire))
+            std::this_thread::sleep_for(1ms);
+
+        auto next = std::chrono::steady_clock::now();
+        const std::vector<int16_t> silence(2 * AUDIO_PERIOD_FRAMES);
+        for (;;) {
+            const bool stopping = m_stopping.load(std::memory_order_acquire);
+            if (m_frames.acquire())
+                ++m_presented;
+            if (m_realtime) {
+                next += AUDIO_PERIOD;
+                std::this_thread::sleep_until(next);
+                const auto played = play(AUDIO_PERIOD_FRAMES);
+                if (played < AUDIO_PERIOD_FRAMES && !stopping) {
+                    ++m_underruns;
+                    if (m_wav)
+                        m_wav->write(silence.data(), AUDIO_PERIOD_FRAMES - played);
+                }
+            } else if (!play(SIZE_MAX)) {
+                std::this_thread::sleep_for(1ms);
+            }
+            if (stopping && !m_audio.queued_frames())
+                return;
+        }
+    }
+
+    // Takes up to frames straight from the ring, returning how many there were
+    auto play(size_t frames) -> size_t
+    {
+        size_t played = 0;
+        while (played < frames) {
+            const auto region = m_audio.read_region();
+            const auto count = std::min(region.frames, frames - played);
+            if (!count)
+                break;
+            if (m_wav)
+                m_wav->write(region.samples, count);
+            m_audio.commit_read(count);
+            played += count;
+        }
+        return played;
+    }
+
+    SampleRing& m_audio;
+    TripleBuffer& m_frames;
+    WavWriter* m_wav;
+    bool m_realtime;
+    std::atomic<bool> m_stopping { false };
+    uint64_t m_presented = 0;
+    uint64_t m_underruns = 0;
+    std::thread m_thread;
+};
+
+}
 
 int main(int argc, char* argv[])
 {
+    const auto* program = argv[0];
+    bool skipIdleLoops = false;
+    bool renderThread = false;
+    bool realtime = false;
+    const char* wavPath = nullptr;
+    const char* loadPath = nullptr;
+    const char* savePath = nullptr;
+    for (; argc > 1 && !strncmp(argv[1], "--", 2); --argc, ++argv) {
+        if (!strcmp(argv[1], "--skip-idle")) {
+            skipIdleLoops = true;
+        } else if (!strcmp(argv[1], "--render-thread")) {
+            renderThread = true;
+        } else if (!strcmp(argv[1], "--realtime")) {
+            realtime = true;
+        } else if (!strcmp(argv[1], "--wav") && argc > 2) {
+            wavPath = argv[2];
+            --argc;
+            ++argv;
+        } else if (!strcmp(argv[1], "--load-state") && argc > 2) {
+            loadPath = argv[2];
+            --argc;
+            ++argv;
+        } else if (!strcmp(argv[1], "--save-state") && argc > 2) {
+            savePath = argv[2];
+            --argc;
+            ++argv;
+        } else {
+            fprintf(stderr, "%s: unknown option %s\n", program, argv[1]);
+            return 1;
+        }
+    }
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s [--skip-idle] [--render-thread] [--realtime] [--wav out.wav] [--load-state in.state] [--save-state out.state] rom.gb [frames]\n", program);
+        return 1;
+    }
+
+    auto rom = RomImage::map_file(argv[1]);
+    if (!rom) {
+        fprintf(stderr, "%s: can't open %s\n", program, argv[1]);
+        return 1;
+    }
+
+    Memory memory;
+    auto cartridge = Cartridge::insert(memory, move(rom));
+    if (!cartridge) {
+        fprintf(stderr, "%s: %s isn't a supported cartridge\n", program, argv[1]);
+        return 1;
+    }
+    const auto& header = cartridge->header();
+    printf("%s: type %02X, %u ROM banks, %u bytes of RAM\n",
+        header.title.c_str(), header.type, header.romBanks, header.ramSize);
+
+    CPU cpu(memory);
+    cpu.set_idle_loop_skipping(skipIdleLoops);
+    Timer timer(cpu);
+    Ppu ppu(cpu);
+    OamDma dma(cpu);
+    Apu apu(cpu);
+    std::unique_ptr<WavWriter> wav;
+    if (wavPath) {
+        wav = WavWriter::create(wavPath, SAMPLE_RATE);
+        if (!wav) {
+            fprintf(stderr, "%s: can't create %s\n", program, wavPath);
+            return 1;
+        }
+    }
+    if (wav || realtime)
+        apu.set_sample_rate(SAMPLE_RATE);
+
+    // Each frame goes to the host as VBlank starts, once drawn
+    TripleBuffer frames(SCREEN_WIDTH * SCREEN_HEIGHT);
+    ppu.set_framebuffer(frames.back());
+    ppu.set_threaded_rendering(renderThread);
+    ppu.set_frame_watcher([&] {
+        ppu.sync_framebuffer();
+        ppu.set_framebuffer(frames.publish());
+    });
+    SampleRing audio(AUDIO_RING_FRAMES);
+    RateControl rateControl(SAMPLE_RATE, AUDIO_TARGET_FRAMES);
+    Host host(audio, frames, wav.get(), realtime);
+    // Moves the APU's samples straight into the ring, waiting for room if the host is behind
+    const auto queue_audio = [&] {
+        for (;;) {
+            const auto region = audio.write_region();
+            const auto count = apu.read_samples(region.samples, region.frames);
+            audio.commit_write(count);
+            if (count < region.frames)
+                return;
+            if (!region.frames)
+                std::this_thread::sleep_for(1ms);
+        }
+    };
+
+    // Where the boot ROM leaves things
+    auto& regs = memory.registers();
+    regs.af = 0x01B0;
+    regs.bc = 0x0013;
+    regs.de = 0x00D8;
+    regs.hl = 0x014D;
+    regs.sp = 0xFFFE;
+    regs.pc = 0x0100;
+    memory.write8(0xFF47, 0xFC); // BGP
+    memory.write8(0xFF40, 0x91); // LCDC
+    memory.write8(0xFF24, 0x77); // NR50
+    memory.write8(0xFF25, 0xF3); // NR51
+    const Machine machine { cpu, cartridge.get(), &timer, &ppu, &dma, &apu };
+    if (loadPath && !load_state_file(machine, loadPath)) {
+        fprintf(stderr, "%s: can't load %s as a snapshot of this cartridge\n", program, loadPath);
+        host.stop();
+        return 1;
+    }
+
+    const auto numFrames = argc > 2 ? strtoul(argv[2], nullptr, 10) : 60;
+    unsigned long frame = 0;
+    const auto start = std::chrono::steady_clock::now();
+    // HALT and STOP wait for an interrupt; only an illegal opcode stops the CPU for good
+    for (; frame < numFrames && cpu.state() != CPU::State::Locked; ++frame) {
+        // Ends on VBlank, so each frame is handed over as soon as it's drawn
+        cpu.run_frame();
+        if (realtime) {
+            std::this_thread::sleep_until(start + (frame + 1) * FRAME_TIME);
+            queue_audio();
+            apu.adjust_sample_rate(rateControl.update(audio.queued_frames()));
+        } else {
+            queue_audio();
+        }
+    }
+    ppu.sync_framebuffer();
+    host.stop();
+    if (savePath) {
+        std::vector<uint8_t> snapshot;
+        save_state(machine, snapshot);
+        if (!write_state_file(savePath, snapshot))
+            fprintf(stderr, "%s: can't write %s\n", program, savePath);
+    }
+    const auto& stats = cpu.stats();
+    printf("stopped at PC=%04X after %lu frames (%llu drawn); skipped %llu halted and %llu idle loop cycles\n",
+        regs.pc, frame, static_cast<unsigned long long>(ppu.frame_count()),
+        static_cast<unsigned long long>(stats.haltCyclesSkipped),
+        static_cast<unsigned long long>(stats.idleLoopCyclesSkipped));
+    printf("presented %llu frames; %llu audio underruns\n", static_cast<unsigned long long>(host.frames_presented()),
+        static_cast<unsigned long long>(host.underruns()));
     return 0;
 }
@@ -1,21 +1,339 @@
-
 #include "CPU.h"
 
+#include "instruction/IdleLoopDetector.h"
 #include "instruction/Instruction.h"
+#include "instruction/OpcodeTable.h"
+#include "instruction/ThreadedInterpreter.h"
+#include "jit/Jit.h"
 #include "memory/Memory.h"
+#include "state/StateStream.h"
+
+#include <algorithm>
 
 using namespace std;
 
 namespace GameBoy {
 
+// Cycles spent per step while the CPU isn't executing
+constexpr uint8_t IDLE_CYCLES = 4;
+// Two wait states, pushing PC and the jump to the handler
+constexpr uint8_t INTERRUPT_DISPATCH_CYCLES = 20;
+// How long execution runs between looks for an idle loop, while they are being skipped
+constexpr uint32_t IDLE_LOOP_CHECK_CYCLES = 1024;
+
 CPU::CPU(Memory& memory)
     : memory(memory)
+    , m_registers(memory.registers())
+    , m_flags(m_registers.f)
+    , m_interrupts(*this)
+    , m_blockCache(memory)
+{
+    // A device moving an event closer, as a TIMA or TAC write can, has to cut the slice short
+    m_scheduler.set_deadline_watcher([this] { end_slice(); });
+}
+
+CPU::~CPU() = default;
+
+auto CPU::step() -> uint8_t
+{
+    auto cycles = handle_interrupts();
+    if (!cycles)
+        cycles = m_state == State::Running ? execute_one() : IDLE_CYCLES;
+    tick(cycles);
+    return cycles;
+}
+
+auto CPU::run_block() -> uint32_t
+{
+    auto cycles = handle_interrupts();
+    if (cycles)
+        ;
+    else if (m_state != State::Running)
+        cycles = IDLE_CYCLES;
+    else if (m_enableInterruptsAfterNext || memory.bus_locked())
+        cycles = execute_one();
+    else if (m_jit)
+        cycles = m_jit->execute(0);
+    else
+        cycles = interpret_block(m_blockCache.lookup(registers().pc));
+    tick(cycles);
+    return cycles;
+}
+
+auto CPU::run_for(uint32_t cycles) -> uint32_t
+{
+    return uint32_t(run_until(m_scheduler.now() + cycles));
+}
+
+auto CPU::run_until(uint64_t cycle) -> uint64_t
+{
+    const auto start = m_scheduler.now();
+    while (m_scheduler.now() < cycle)
+        run_slice(cycle);
+    return m_scheduler.now() - start;
+}
+
+auto CPU::run_cycles(uint64_t cycles) -> RunResult
+{
+    return run_batch(cycles);
+}
+
+auto CPU::run_frame() -> RunResult
+{
+    m_stopInterrupts = uint8_t(Interrupt::VBlank);
+    const auto result = run_batch(CYCLES_PER_FRAME);
+    m_stopInterrupts = 0;
+    return result;
+}
+
+auto CPU::run_until_pc(uint16_t address, uint64_t maxCycles) -> RunResult
+{
+    m_breakpoint = address;
+    const auto result = run_batch(maxCycles);
+    m_breakpoint.reset();
+    return result;
+}
+
+auto CPU::run_until_event(uint32_t mask, uint64_t maxCycles) -> RunResult
+{
+    m_stopEvents = mask;
+    const auto result = run_batch(maxCycles);
+    m_stopEvents = 0;
+    return result;
+}
+
+auto CPU::run_batch(uint64_t maxCycles) -> RunResult
+{
+    const auto start = m_scheduler.now();
+    const auto end = maxCycles > Scheduler::NEVER - start ? Scheduler::NEVER : start + maxCycles;
+    const auto result = [&](StopReason reason) { return RunResult { reason, m_scheduler.now() - start }; };
+
+    // Only what happens from here on counts
+    m_scheduler.take_fired();
+    m_interrupts.take_requested();
+    while (true) {
+        if (m_state == State::Locked)
+            return result(StopReason::Locked);
+        if (m_breakpoint && registers().pc == *m_breakpoint && m_state == State::Running)
+            return result(StopReason::ReachedPc);
+        if (m_scheduler.now() >= end)
+            return result(StopReason::CyclesElapsed);
+
+        run_slice(end);
+        // Events only fire, and the PPU only requests VBlank, as the clock moves
+        if (m_scheduler.take_fired() & m_stopEvents)
+            return result(StopReason::Event);
+        if (m_interrupts.take_requested() & m_stopInterrupts)
+            return result(StopReason::FrameEnded);
+    }
+}
+
+auto CPU::run_slice(uint64_t cycle) -> void
+{
+    auto executed = handle_interrupts();
+    if (executed) {
+        tick(executed);
+        return;
+    }
+
+    // Nothing can happen before the next deadline, so run straight up to it
+    const auto now = m_scheduler.now();
+    const auto stop = min(cycle, m_scheduler.next_deadline());
+    auto budget = uint32_t(min<uint64_t>(stop > now ? stop - now : 0, UINT32_MAX));
+    if (m_state != State::Running) {
+        // Only an event can wake the CPU, so skip every idle cycle up to the next one
+        executed = budget ? budget : IDLE_CYCLES;
+        m_stats.haltCyclesSkipped += executed;
+        ++m_stats.haltFastForwards;
+    } else if (m_enableInterruptsAfterNext || memory.bus_locked()) {
+        // Blocks decoded now would be cached as whatever the locked bus reads
+        executed = execute_one();
+    } else if (m_breakpoint) {
+        // Neither the engines nor idle loop skipping would stop at it
+        executed = run_to_breakpoint();
+    } else if (m_skipIdleLoops && !m_idleLoopMissed && skip_idle_loop(stop)) {
+        // Ticked as it went
+        return;
+    } else {
+        // Come back to look again before long
+        if (m_skipIdleLoops)
+            budget = min(budget, IDLE_LOOP_CHECK_CYCLES);
+        m_idleLoopMissed = false;
+        executed = m_jit ? m_jit->execute(budget) : interpret(budget);
+    }
+    tick(executed);
+}
+
+auto CPU::run_to_breakpoint() -> uint32_t
+{
+    auto& regs = registers();
+    const auto& block = m_blockCache.lookup(regs.pc);
+    const auto target = *m_breakpoint;
+    // Wrapping round the end of the address space like the block may
+    const auto offset = uint16_t(target - block.start);
+    if (!offset || offset >= uint16_t(block.end - block.start))
+        return interpret_block(block);
+
+    // Blocks run straight through, so PC gets there unless the block halts or rewrites itself
+    uint32_t cycles = 0;
+    for (size_t i = 0; i < block.instructions.size() && regs.pc != target && m_state == State::Running; ++i)
+        cycles += execute_one();
+    return cycles;
+}
+
+auto CPU::save_state(StateWriter& writer) const -> void
+{
+    writer.write(m_registers);
+    writer.write(m_state);
+    writer.write(m_interruptsEnabled);
+    writer.write(m_enableInterruptsAfterNext);
+}
+
+auto CPU::load_state(StateReader& reader) -> void
+{
+    reader.read(m_registers);
+    m_flags.set(m_registers.f);
+    reader.read(m_state);
+    reader.read(m_interruptsEnabled);
+    reader.read(m_enableInterruptsAfterNext);
+    m_idleLoopMissed = false;
+}
+
+auto CPU::interpret([[maybe_unused]] uint32_t cycles) -> uint32_t
+{
+#ifdef GAMEBOY_THREADED_INTERPRETER
+    return ThreadedInterpreter::run(*this, cycles);
+#else
+    return interpret_block(m_blockCache.lookup(registers().pc));
+#endif
+}
+
+auto CPU::interpret_block(const DecodedBlock& block) -> uint32_t
 {
+    auto& regs = registers();
+    uint64_t cycles = 0;
+    enter_slice(&cycles, nullptr);
+    for (const auto& instr : block.instructions) {
+        regs.pc += instr.length;
+        cycles += instr.handler(*this, instr);
+        // The block just overwrote itself; the rest of it is stale
+        if (!block.valid)
+            break;
+    }
+    m_flags.materialise();
+    leave_slice();
+    return uint32_t(cycles);
 }
 
-auto CPU::tick() -> void
+auto CPU::execute_one() -> uint32_t
 {
-    // FIXME: implement CPU ticking logic
+    const bool enabling = m_enableInterruptsAfterNext;
+
+    auto& regs = registers();
+    const auto instr = OpcodeTable::decode(memory, regs.pc);
+    regs.pc += instr.length;
+    const auto cycles = instr.handler(*this, instr);
+    m_flags.materialise();
+
+    // Unless the instruction was a DI
+    if (enabling && m_enableInterruptsAfterNext) {
+        m_interruptsEnabled = true;
+        m_enableInterruptsAfterNext = false;
+    }
+    return cycles;
+}
+
+auto CPU::skip_idle_loop(uint64_t stop) -> uint64_t
+{
+    auto& regs = registers();
+    const auto loop = IdleLoopDetector::find(memory, regs.pc);
+    if (!loop)
+        return 0;
+
+    // The pass after a register changes reads the new value, so give it a second go
+    const auto entry = m_scheduler.now();
+    bool skippedAny = false;
+    for (auto attempt = 0; attempt < 2 && !skippedAny && m_state == State::Running; ++attempt) {
+        // Every pass reads the same values for as long as none of them changes
+        const auto start = m_scheduler.now();
+        auto until = stop;
+        for (uint8_t i = 0; i < loop->numReads; ++i)
+            until = min(until, memory.next_change(loop->reads[i], start));
+        if (until <= start)
+            break;
+
+        // One pass for real, which must leave every register as it found it
+        const auto before = regs;
+        for (uint8_t i = 0; i < loop->instructions && m_state == State::Running; ++i)
+            step();
+        if (regs.af != before.af || regs.bc != before.bc || regs.de != before.de || regs.hl != before.hl
+            || regs.sp != before.sp || regs.pc != before.pc)
+            continue;
+
+        // The passes skipped have to read before until too
+        const auto pass = m_scheduler.now() - start;
+        const auto passes = (until - start) / pass;
+        if (passes < 2)
+            break;
+        const auto skipped = (passes - 1) * pass;
+        m_scheduler.advance(skipped);
+        m_stats.idleLoopCyclesSkipped += skipped;
+        ++m_stats.idleLoopFastForwards;
+        skippedAny = true;
+    }
+
+    // Let the engine run for a while before stepping through this loop again
+    m_idleLoopMissed = !skippedAny;
+    return m_scheduler.now() - entry;
+}
+
+auto CPU::handle_interrupts() -> uint32_t
+{
+    if (!m_interrupts.pending())
+        return 0;
+
+    // Anything pending wakes the CPU, whether or not it can be serviced
+    if (m_state == State::Halted || m_state == State::Stopped)
+        m_state = State::Running;
+    if (!m_interruptsEnabled || m_state != State::Running)
+        return 0;
+
+    m_interruptsEnabled = false;
+    auto& regs = registers();
+    regs.sp -= 2;
+    memory.write16(regs.sp, regs.pc);
+    regs.pc = m_interrupts.acknowledge();
+    return INTERRUPT_DISPATCH_CYCLES;
+}
+
+auto CPU::execution_mode() const -> ExecutionMode
+{
+    return m_jit ? ExecutionMode::Jit : ExecutionMode::Interpreter;
+}
+
+auto CPU::jit() -> Jit*
+{
+    return m_jit.get();
+}
+
+auto CPU::set_execution_mode(ExecutionMode mode) -> void
+{
+    if (mode == ExecutionMode::Interpreter) {
+        m_jit.reset();
+        return;
+    }
+
+    if (!m_jit) {
+        m_jit = make_unique<Jit>(*this);
+        // No way to run generated code here, so stay interpreted
+        if (!m_jit->available())
+            m_jit.reset();
+    }
+}
+
+auto CPU::tick(uint32_t cycles) -> void
+{
+    m_scheduler.advance(cycles);
 }
 
 auto CPU::get_program_counter() -> unique_ptr<WordAddressable>
@@ -28,9 +346,44 @@ auto CPU::get_stack_pointer() -> unique_ptr<WordAddressable>
     return memory.get_word_register(WordRegister::SP);
 }
 
-auto CPU::get_flags() -> FlagRegister
+auto CPU::get_flags() -> FlagRegister&
+{
+    return m_flags;
+}
+
+auto CPU::state() const -> State
+{
+    return m_state;
+}
+
+auto CPU::set_state(State state) -> void
+{
+    m_state = state;
+}
+
+auto CPU::interrupts_enabled() const -> bool
+{
+    return m_interruptsEnabled;
+}
+
+auto CPU::set_interrupts_enabled(bool enabled) -> void
+{
+    m_interruptsEnabled = enabled;
+    m_enableInterruptsAfterNext = false;
+}
+
+auto CPU::enable_interrupts_after_next() -> void
+{
+    if (m_interruptsEnabled)
+        return;
+    m_enableInterruptsAfterNext = true;
+    // Stop here, so the next instruction runs on its own and IME can be set after it
+    end_slice();
+}
+
+auto CPU::block_cache() -> BlockCache&
 {
-    return FlagRegister(move(memory.get_register(Register::F)));
+    return m_blockCache;
 }
 
 }
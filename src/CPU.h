@@ -1,25 +1,220 @@
 #pragma once
 
+#include "RegisterFile.h"
+#include "Scheduler.h"
+#include "io/InterruptController.h"
+#include "instruction/BlockCache.h"
 #include "memory/FlagRegister.h"
 
 #include <memory>
+#include <optional>
 
 namespace GameBoy {
 
+class Jit;
 class Memory;
+class StateReader;
+class StateWriter;
 class WordAddressable;
 
+enum class ExecutionMode {
+    Interpreter,
+    // Translates hot blocks to host code; falls back to the interpreter where unsupported
+    Jit
+};
+
 // Executes instructions
 class CPU {
 public:
+    enum class State {
+        Running,
+        Halted,
+        Stopped,
+        // Hit an illegal opcode; the hardware freezes until reset
+        Locked
+    };
+
+    struct Stats {
+        // Cycles run_until jumped over while the CPU wasn't executing, and how many jumps
+        uint64_t haltCyclesSkipped = 0;
+        uint64_t haltFastForwards = 0;
+        // The same for polling loops, while idle loop skipping is on
+        uint64_t idleLoopCyclesSkipped = 0;
+        uint64_t idleLoopFastForwards = 0;
+    };
+
+    // Why one of the batched runs below returned
+    enum class StopReason : uint8_t {
+        // Ran for as long as it was allowed to
+        CyclesElapsed,
+        // The VBlank interrupt was requested
+        FrameEnded,
+        // PC reached the address asked for
+        ReachedPc,
+        // An event in the mask fired
+        Event,
+        // Hit an illegal opcode; running on would do nothing
+        Locked
+    };
+
+    struct RunResult {
+        StopReason reason;
+        uint64_t cycles;
+    };
+
+    // How long the LCD takes to draw a frame, which bounds run_frame while it is off
+    static constexpr uint64_t CYCLES_PER_FRAME = 70224;
+    // How long run_until_pc and run_until_event go on for unless told otherwise: a second
+    static constexpr uint64_t DEFAULT_RUN_LIMIT = 4194304;
+
     CPU(Memory&);
+    ~CPU();
 
-    auto tick() -> void;
+    // Dispatches a pending interrupt if IME allows, otherwise fetches, decodes and executes the
+    // instruction at PC. Returns the number of cycles taken.
+    auto step() -> uint8_t;
+    // As step, but executes the cached basic block starting at PC
+    auto run_block() -> uint32_t;
+    // Executes until at least the given number of cycles have passed. Returns the number of
+    // cycles actually taken. Builds with GAMEBOY_THREADED_INTERPRETER interpret through the
+    // threaded core rather than the block cache.
+    auto run_for(uint32_t cycles) -> uint32_t;
+    // Executes until the scheduler's clock reaches cycle, stopping at every event deadline on
+    // the way to let it fire. Interrupts are checked whenever execution stops. While halted
+    // or stopped nothing can wake the CPU before the next deadline, so the clock jumps
+    // straight there, and so does a loop polling a register once idle loop skipping is on.
+    // Returns the number of cycles taken.
+    auto run_until(uint64_t cycle) -> uint64_t;
+    // Batched runs for frontends and debuggers. Each goes through run_until's loop, so the
+    // engines run whole slices between deadlines and the stop condition is only looked at
+    // when the clock moves. All stop early once the CPU locks up.
+    auto run_cycles(uint64_t cycles) -> RunResult;
+    // Until VBlank is requested, or a frame's worth of cycles if the LCD is off
+    auto run_frame() -> RunResult;
+    // Until PC is address at an instruction boundary, which it may already be. Executes block
+    // by block through the interpreter, and only the block holding address one at a time.
+    auto run_until_pc(uint16_t address, uint64_t maxCycles = DEFAULT_RUN_LIMIT) -> RunResult;
+    // Until any event whose event_bit() is in mask fires
+    auto run_until_event(uint32_t mask, uint64_t maxCycles = DEFAULT_RUN_LIMIT) -> RunResult;
+    // Runs an already decoded block from its start, which must be PC
+    auto interpret_block(const DecodedBlock&) -> uint32_t;
+
+    // Whether run_until looks for loops that do nothing but wait for an I/O register to
+    // change, and skips whole passes of them. Off by default.
+    auto idle_loop_skipping() const -> bool { return m_skipIdleLoops; }
+    auto set_idle_loop_skipping(bool enabled) -> void { m_skipIdleLoops = enabled; }
+
+    auto execution_mode() const -> ExecutionMode;
+    auto set_execution_mode(ExecutionMode) -> void;
+    // The translator, while in JIT mode
+    auto jit() -> Jit*;
+
+    // Moves the scheduler's clock forward by cycles the CPU has already executed
+    auto tick(uint32_t cycles) -> void;
+    // The scheduler's clock plus whatever has executed since it last moved: the cycle the
+    // current instruction started on, or during one of its bus accesses the cycle that access
+    // lands on. Devices derive their state from this.
+    auto cycle() const -> uint64_t;
+    // Handlers put each bus access this many cycles into the instruction, the M-cycle the
+    // hardware makes it on, and back to 0 afterwards
+    auto set_access_offset(uint8_t cycles) -> void { m_accessOffset = cycles; }
+    // Execution engines point these at their running cycle count, and the count they stop
+    // at, for as long as they run. The limit may be null for engines that can't stop early.
+    auto enter_slice(const uint64_t* cycles, uint64_t* limit) -> void;
+    auto leave_slice() -> void;
+    // Has the running engine stop after the current instruction, so interrupts get looked at
+    auto end_slice() -> void;
+    auto registers() -> RegisterFile& { return m_registers; }
     auto get_program_counter() -> std::unique_ptr<WordAddressable>;
     auto get_stack_pointer() -> std::unique_ptr<WordAddressable>;
-    auto get_flags() -> FlagRegister;
+    auto get_flags() -> FlagRegister&;
+    // Handlers go through this rather than F, which is only up to date outside of execution
+    auto flags() -> FlagRegister& { return m_flags; }
+
+    auto state() const -> State;
+    auto set_state(State) -> void;
+
+    // IME. Disabling also cancels an EI that hasn't taken effect yet.
+    auto interrupts_enabled() const -> bool;
+    auto set_interrupts_enabled(bool) -> void;
+    // EI: sets IME once the instruction after this one has executed
+    auto enable_interrupts_after_next() -> void;
+    auto interrupts() -> InterruptController& { return m_interrupts; }
+
+    auto stats() const -> const Stats& { return m_stats; }
+
+    // Registers, IME and whether it is running, for snapshots; the scheduler, interrupts and
+    // memory save their own. Only valid between runs, while F is up to date.
+    auto save_state(StateWriter&) const -> void;
+    auto load_state(StateReader&) -> void;
+
+    auto block_cache() -> BlockCache&;
+    auto scheduler() -> Scheduler& { return m_scheduler; }
 
     Memory& memory;
+
+private:
+    // The interpreter this build was configured with
+    auto interpret(uint32_t cycles) -> uint32_t;
+    // One pass of run_until's loop: dispatches an interrupt or executes up to the next
+    // deadline, at most stop, then moves the clock forward
+    auto run_slice(uint64_t stop) -> void;
+    // Runs whichever of the conditions below is set until it holds or maxCycles pass
+    auto run_batch(uint64_t maxCycles) -> RunResult;
+    // Executes the block at PC, or only up to the breakpoint if it lies inside
+    auto run_to_breakpoint() -> uint32_t;
+    // Executes the instruction at PC, then applies a delayed EI that was waiting for it
+    auto execute_one() -> uint32_t;
+    // Wakes the CPU for, and dispatches, any pending interrupt. Returns the cycles taken.
+    auto handle_interrupts() -> uint32_t;
+    // If PC is in an idle loop, runs a pass of it, or two if the first saw a register change,
+    // then skips as many more as will go by before stop or any register it reads changes.
+    // Returns the cycles taken, or 0 if PC isn't in an idle loop.
+    auto skip_idle_loop(uint64_t stop) -> uint64_t;
+
+    RegisterFile& m_registers;
+    FlagRegister m_flags;
+    Scheduler m_scheduler;
+    InterruptController m_interrupts;
+    const uint64_t* m_elapsed = nullptr;
+    uint64_t* m_limit = nullptr;
+    uint8_t m_accessOffset = 0;
+    BlockCache m_blockCache;
+    std::unique_ptr<Jit> m_jit;
+    State m_state = State::Running;
+    bool m_interruptsEnabled = false;
+    bool m_enableInterruptsAfterNext = false;
+    bool m_skipIdleLoops = false;
+    // The last look at an idle loop didn't get to skip any of it
+    bool m_idleLoopMissed = false;
+    // What the running batch stops for
+    std::optional<uint16_t> m_breakpoint;
+    uint32_t m_stopEvents = 0;
+    uint8_t m_stopInterrupts = 0;
+    Stats m_stats;
 };
 
+inline auto CPU::cycle() const -> uint64_t
+{
+    return m_scheduler.now() + (m_elapsed ? *m_elapsed : 0) + m_accessOffset;
+}
+
+inline auto CPU::enter_slice(const uint64_t* cycles, uint64_t* limit) -> void
+{
+    m_elapsed = cycles;
+    m_limit = limit;
+}
+
+inline auto CPU::leave_slice() -> void
+{
+    m_elapsed = nullptr;
+    m_limit = nullptr;
+}
+
+inline auto CPU::end_slice() -> void
+{
+    if (m_limit)
+        *m_limit = 0;
+}
+
 }
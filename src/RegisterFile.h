@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Registers.h"
+
+#include <cstdlib>
+#include <stdint.h>
+
+namespace GameBoy {
+
+// Lays out the two halves of a register pair so that the 16-bit view in the
+// enclosing union has the first named register as its high byte (B in BC).
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define GAMEBOY_REGISTER_PAIR(high, low) \
+    uint8_t high;                        \
+    uint8_t low;
+#else
+#define GAMEBOY_REGISTER_PAIR(high, low) \
+    uint8_t low;                         \
+    uint8_t high;
+#endif
+
+// Bit masks of the flags held in F
+namespace Flags {
+    constexpr uint8_t ZERO = 0x80;
+    constexpr uint8_t SUBTRACT = 0x40;
+    constexpr uint8_t HALF_CARRY = 0x20;
+    constexpr uint8_t CARRY = 0x10;
+}
+
+// Flat SM83 register file. Every pair can be read and written either as a
+// 16-bit word or as its two 8-bit halves, without allocating a reference.
+struct RegisterFile {
+    union {
+        struct {
+            GAMEBOY_REGISTER_PAIR(a, f)
+        };
+        uint16_t af;
+    };
+    union {
+        struct {
+            GAMEBOY_REGISTER_PAIR(b, c)
+        };
+        uint16_t bc;
+    };
+    union {
+        struct {
+            GAMEBOY_REGISTER_PAIR(d, e)
+        };
+        uint16_t de;
+    };
+    union {
+        struct {
+            GAMEBOY_REGISTER_PAIR(h, l)
+        };
+        uint16_t hl;
+    };
+    union {
+        struct {
+            GAMEBOY_REGISTER_PAIR(sp_high, sp_low)
+        };
+        uint16_t sp;
+    };
+    union {
+        struct {
+            GAMEBOY_REGISTER_PAIR(pc_high, pc_low)
+        };
+        uint16_t pc;
+    };
+
+    auto operator[](Register registerName) -> uint8_t&
+    {
+        switch (registerName) {
+        case Register::A:
+            return a;
+        case Register::B:
+            return b;
+        case Register::C:
+            return c;
+        case Register::D:
+            return d;
+        case Register::E:
+            return e;
+        case Register::F:
+            return f;
+        case Register::H:
+            return h;
+        case Register::L:
+            return l;
+        }
+        abort();
+    }
+
+    auto operator[](WordRegister registerName) -> uint16_t&
+    {
+        switch (registerName) {
+        case WordRegister::AF:
+            return af;
+        case WordRegister::BC:
+            return bc;
+        case WordRegister::DE:
+            return de;
+        case WordRegister::HL:
+            return hl;
+        case WordRegister::SP:
+            return sp;
+        case WordRegister::PC:
+            return pc;
+        }
+        abort();
+    }
+};
+
+#undef GAMEBOY_REGISTER_PAIR
+
+static_assert(sizeof(RegisterFile) == 12, "RegisterFile must stay packed");
+
+}
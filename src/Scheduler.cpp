@@ -0,0 +1,161 @@
+#include "Scheduler.h"
+
+#include "state/StateStream.h"
+
+#include <cassert>
+
+namespace GameBoy {
+
+using namespace std;
+
+Scheduler::Scheduler()
+{
+    m_slots.fill(NOT_SCHEDULED);
+    m_deadlines.fill(NEVER);
+}
+
+auto Scheduler::set_handler(Event event, Handler handler) -> void
+{
+    m_handlers[size_t(event)] = move(handler);
+}
+
+auto Scheduler::set_deadline_watcher(function<void()> watcher) -> void
+{
+    m_deadlineWatcher = move(watcher);
+}
+
+auto Scheduler::schedule(Event event, uint64_t deadline) -> void
+{
+    const auto earliest = next_deadline();
+    const auto index = uint8_t(event);
+    const auto previous = m_deadlines[index];
+    m_deadlines[index] = deadline;
+
+    if (m_slots[index] == NOT_SCHEDULED) {
+        place(m_size++, index);
+        sift_up(m_slots[index]);
+    } else if (deadline < previous) {
+        sift_up(m_slots[index]);
+    } else {
+        sift_down(m_slots[index]);
+    }
+
+    if (deadline < earliest && m_deadlineWatcher)
+        m_deadlineWatcher();
+}
+
+auto Scheduler::schedule_in(Event event, uint64_t cycles) -> void
+{
+    schedule(event, m_now + cycles);
+}
+
+auto Scheduler::cancel(Event event) -> void
+{
+    if (is_scheduled(event))
+        remove(uint8_t(event));
+}
+
+auto Scheduler::is_scheduled(Event event) const -> bool
+{
+    return m_slots[size_t(event)] != NOT_SCHEDULED;
+}
+
+auto Scheduler::deadline(Event event) const -> uint64_t
+{
+    return is_scheduled(event) ? m_deadlines[size_t(event)] : NEVER;
+}
+
+auto Scheduler::save_state(StateWriter& writer) const -> void
+{
+    writer.write(m_now);
+    writer.write(m_deadlines);
+}
+
+auto Scheduler::load_state(StateReader& reader) -> void
+{
+    reader.read(m_now);
+    array<uint64_t, NUM_EVENTS> deadlines;
+    reader.read(deadlines);
+    m_size = 0;
+    m_slots.fill(NOT_SCHEDULED);
+    m_deadlines.fill(NEVER);
+    m_fired = 0;
+    for (size_t event = 0; event < NUM_EVENTS; ++event) {
+        if (deadlines[event] != NEVER)
+            schedule(Event(event), deadlines[event]);
+    }
+}
+
+auto Scheduler::fire_until(uint64_t target) -> void
+{
+    while (m_size && m_deadlines[m_heap[0]] <= target) {
+        const auto event = m_heap[0];
+        m_now = m_deadlines[event];
+        remove(event);
+        m_fired |= 1u << event;
+        if (m_handlers[event])
+            m_handlers[event]();
+    }
+}
+
+auto Scheduler::earlier(uint8_t a, uint8_t b) const -> bool
+{
+    // Events due on the same cycle fire in the order they're declared
+    if (m_deadlines[a] != m_deadlines[b])
+        return m_deadlines[a] < m_deadlines[b];
+    return a < b;
+}
+
+auto Scheduler::place(uint8_t slot, uint8_t event) -> void
+{
+    m_heap[slot] = event;
+    m_slots[event] = slot;
+}
+
+auto Scheduler::sift_up(uint8_t slot) -> void
+{
+    const auto event = m_heap[slot];
+    while (slot > 0) {
+        const uint8_t parent = (slot - 1) / 2;
+        if (!earlier(event, m_heap[parent]))
+            break;
+        place(slot, m_heap[parent]);
+        slot = parent;
+    }
+    place(slot, event);
+}
+
+auto Scheduler::sift_down(uint8_t slot) -> void
+{
+    const auto event = m_heap[slot];
+    while (true) {
+        uint8_t child = 2 * slot + 1;
+        if (child >= m_size)
+            break;
+        if (child + 1 < m_size && earlier(m_heap[child + 1], m_heap[child]))
+            ++child;
+        if (!earlier(m_heap[child], event))
+            break;
+        place(slot, m_heap[child]);
+        slot = child;
+    }
+    place(slot, event);
+}
+
+auto Scheduler::remove(uint8_t event) -> void
+{
+    const auto slot = m_slots[event];
+    assert(slot != NOT_SCHEDULED);
+    m_slots[event] = NOT_SCHEDULED;
+    m_deadlines[event] = NEVER;
+
+    const auto last = m_heap[--m_size];
+    if (last == event)
+        return;
+    // The last event takes the hole, then moves whichever way its deadline says
+    place(slot, last);
+    sift_up(slot);
+    sift_down(m_slots[last]);
+}
+
+}
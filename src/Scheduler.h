@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <stdint.h>
+
+namespace GameBoy {
+
+class StateReader;
+class StateWriter;
+
+// Everything that happens at a known future cycle rather than on every cycle
+enum class Event : uint8_t {
+    // TIMA overflowing
+    Timer,
+    // The LCD changing mode, or LY moving on to the next line
+    Ppu,
+    // OAM DMA finishing
+    Dma,
+    // A serial transfer finishing
+    Serial,
+    // The APU's frame sequencer stepping
+    Apu,
+    Count
+};
+
+// The event's bit in a mask of events
+constexpr auto event_bit(Event event) -> uint32_t
+{
+    return 1u << uint8_t(event);
+}
+
+// Keeps the global cycle count and the deadline of every pending event, in a min-heap indexed
+// by event so that rescheduling one doesn't need a search. The CPU runs back-to-back up to
+// the nearest deadline, then the clock is advanced and whatever is due fires.
+class Scheduler {
+public:
+    // Runs with now() at the cycle the event was due, however late the clock got there, so
+    // rescheduling relative to now() keeps exact time
+    using Handler = std::function<void()>;
+
+    static constexpr uint64_t NEVER = UINT64_MAX;
+
+    Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    auto operator=(const Scheduler&) -> Scheduler& = delete;
+
+    auto now() const -> uint64_t;
+
+    auto set_handler(Event, Handler) -> void;
+    // Called whenever schedule() brings the earliest deadline forward, so that whatever is
+    // running up to the old one can stop in time
+    auto set_deadline_watcher(std::function<void()>) -> void;
+
+    // Replaces any earlier deadline for the event
+    auto schedule(Event, uint64_t deadline) -> void;
+    auto schedule_in(Event, uint64_t cycles) -> void;
+    auto cancel(Event) -> void;
+
+    auto is_scheduled(Event) const -> bool;
+    // NEVER if the event isn't scheduled
+    auto deadline(Event) const -> uint64_t;
+    // The earliest deadline of any event, or NEVER
+    auto next_deadline() const -> uint64_t;
+
+    // Moves the clock forward, firing every event that falls due on the way in deadline order
+    auto advance(uint64_t cycles) -> void;
+    // The event_bit() of every event that has fired since the last call
+    auto take_fired() -> uint32_t;
+
+    // The clock and every deadline; handlers stay as they are
+    auto save_state(StateWriter&) const -> void;
+    auto load_state(StateReader&) -> void;
+
+private:
+    auto fire_until(uint64_t target) -> void;
+
+    static constexpr size_t NUM_EVENTS = size_t(Event::Count);
+    static constexpr uint8_t NOT_SCHEDULED = 0xFF;
+
+    auto earlier(uint8_t a, uint8_t b) const -> bool;
+    auto place(uint8_t slot, uint8_t event) -> void;
+    auto sift_up(uint8_t slot) -> void;
+    auto sift_down(uint8_t slot) -> void;
+    auto remove(uint8_t event) -> void;
+
+    uint64_t m_now = 0;
+    // Heap of events, by deadline
+    std::array<uint8_t, NUM_EVENTS> m_heap {};
+    uint8_t m_size = 0;
+    // Each event's slot in the heap, or NOT_SCHEDULED
+    std::array<uint8_t, NUM_EVENTS> m_slots {};
+    std::array<uint64_t, NUM_EVENTS> m_deadlines {};
+    std::array<Handler, NUM_EVENTS> m_handlers;
+    std::function<void()> m_deadlineWatcher;
+    uint32_t m_fired = 0;
+};
+
+inline auto Scheduler::now() const -> uint64_t
+{
+    return m_now;
+}
+
+inline auto Scheduler::next_deadline() const -> uint64_t
+{
+    return m_size ? m_deadlines[m_heap[0]] : NEVER;
+}
+
+inline auto Scheduler::advance(uint64_t cycles) -> void
+{
+    const auto target = m_now + cycles;
+    if (next_deadline() <= target)
+        fire_until(target);
+    m_now = target;
+}
+
+inline auto Scheduler::take_fired() -> uint32_t
+{
+    const auto fired = m_fired;
+    m_fired = 0;
+    return fired;
+}
+
+}
@@ -0,0 +1,372 @@
+#include "audio/Apu.h"
+
+#include "CPU.h"
+#include "memory/Memory.h"
+#include "state/StateStream.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace GameBoy {
+
+using namespace std;
+
+constexpr uint16_t FIRST_REGISTER = 0xFF10;
+constexpr uint16_t NR10 = 0xFF10;
+constexpr uint16_t NR11 = 0xFF11;
+constexpr uint16_t NR12 = 0xFF12;
+constexpr uint16_t NR14 = 0xFF14;
+constexpr uint16_t NR20 = 0xFF15;
+constexpr uint16_t NR21 = 0xFF16;
+constexpr uint16_t NR22 = 0xFF17;
+constexpr uint16_t NR24 = 0xFF19;
+constexpr uint16_t NR30 = 0xFF1A;
+constexpr uint16_t NR31 = 0xFF1B;
+constexpr uint16_t NR34 = 0xFF1E;
+constexpr uint16_t NR40 = 0xFF1F;
+constexpr uint16_t NR41 = 0xFF20;
+constexpr uint16_t NR42 = 0xFF21;
+constexpr uint16_t NR44 = 0xFF23;
+constexpr uint16_t NR50 = 0xFF24;
+constexpr uint16_t NR51 = 0xFF25;
+constexpr uint16_t NR52 = 0xFF26;
+constexpr uint16_t WAVE_RAM = 0xFF30;
+constexpr uint16_t LAST_REGISTER = 0xFF3F;
+
+constexpr uint8_t TRIGGER = 0x80;
+constexpr uint8_t POWER = 0x80;
+
+// Bits that read back as 1 whatever was written, for NR10 to NR52 and the unused FF27-FF2F
+constexpr array<uint8_t, WAVE_RAM - FIRST_REGISTER> READ_MASKS = {
+    0x80, 0x3F, 0x00, 0xFF, 0xBF, // NR10-NR14
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF, // NR20-NR24
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF, // NR30-NR34
+    0xFF, 0xFF, 0x00, 0x00, 0xBF, // NR40-NR44
+    0x00, 0x00, 0x70, // NR50-NR52
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+// 512 Hz
+constexpr uint64_t FRAME_SEQUENCER_CYCLES = 8192;
+
+// Four channels at 15, at the loudest master volume of 8, comes to 480
+constexpr int SAMPLE_SCALE = 64;
+
+// While taking samples, channels are stepped through this much at a time at most, and the
+// steps resampled once there are this many BlepBuffer samples' worth, about every 8192 cycles
+constexpr uint64_t MAX_CATCH_UP_CYCLES = 65536;
+constexpr size_t FLUSH_SAMPLES = 256;
+
+Apu::Apu(CPU& cpu)
+    : m_cpu(cpu)
+    , m_square1(&m_registers[NR10 - FIRST_REGISTER], true)
+    , m_square2(&m_registers[NR20 - FIRST_REGISTER], false)
+    , m_wave(&m_registers[NR30 - FIRST_REGISTER], &m_registers[WAVE_RAM - FIRST_REGISTER])
+    , m_noise(&m_registers[NR40 - FIRST_REGISTER])
+    , m_cycle(cpu.cycle())
+{
+    for (auto address = FIRST_REGISTER; address <= LAST_REGISTER; ++address)
+        m_cpu.memory.map_io(address, this);
+    m_cpu.scheduler().set_handler(Event::Apu, [this] { step_frame_sequencer(); });
+    m_cpu.scheduler().schedule(Event::Apu, m_cycle + FRAME_SEQUENCER_CYCLES);
+}
+
+Apu::~Apu()
+{
+    for (auto address = FIRST_REGISTER; address <= LAST_REGISTER; ++address)
+        m_cpu.memory.map_io(address, nullptr);
+    m_cpu.scheduler().cancel(Event::Apu);
+    m_cpu.scheduler().set_handler(Event::Apu, nullptr);
+}
+
+auto Apu::set_sample_rate(uint32_t rate) -> void
+{
+    catch_up(m_cpu.cycle());
+    m_sampleRate = rate;
+    m_samples.clear();
+    m_samplesRead = 0;
+    m_mixed = {};
+    if (!rate) {
+        m_resampler.reset();
+        return;
+    }
+    m_steps.reset(m_cycle);
+    m_resampler = make_unique<Resampler>(CYCLES_PER_SECOND / BlepBuffer::CYCLES_PER_SAMPLE, rate);
+    // From silence to whatever is playing
+    remix();
+}
+
+auto Apu::adjust_sample_rate(uint32_t rate) -> void
+{
+    if (!m_resampler)
+        return;
+    // Everything up to now at the old rate
+    catch_up(m_cpu.cycle());
+    flush_samples();
+    m_resampler->set_output_rate(rate);
+}
+
+auto Apu::read_samples(int16_t* samples, size_t frames) -> size_t
+{
+    catch_up(m_cpu.cycle());
+    if (m_resampler)
+        flush_samples();
+    frames = min(frames, (m_samples.size() - m_samplesRead) / 2);
+    copy_n(m_samples.begin() + m_samplesRead, 2 * frames, samples);
+    m_samplesRead += 2 * frames;
+    compact_samples();
+    return frames;
+}
+
+auto Apu::read8(uint16_t address) -> uint8_t
+{
+    if (address >= WAVE_RAM)
+        return m_registers[address - FIRST_REGISTER];
+    if (address == NR52) {
+        return READ_MASKS[NR52 - FIRST_REGISTER] | (m_powered ? POWER : 0)
+            | (m_square1.enabled() ? 0x01 : 0) | (m_square2.enabled() ? 0x02 : 0)
+            | (m_wave.enabled() ? 0x04 : 0) | (m_noise.enabled() ? 0x08 : 0);
+    }
+    return m_registers[address - FIRST_REGISTER] | READ_MASKS[address - FIRST_REGISTER];
+}
+
+auto Apu::write8(uint16_t address, uint8_t value) -> void
+{
+    // Everything up to now sounds as the registers were
+    catch_up(m_cpu.cycle());
+
+    if (address >= WAVE_RAM) {
+        m_registers[address - FIRST_REGISTER] = value;
+        remix();
+        return;
+    }
+    if (address == NR52) {
+        if (bool(value & POWER) != m_powered)
+            power(value & POWER);
+        remix();
+        return;
+    }
+    // Powered off, only NR52 and wave RAM can be written
+    if (!m_powered)
+        return;
+
+    m_registers[address - FIRST_REGISTER] = value;
+    switch (address) {
+    case NR11:
+        m_square1.length_written();
+        break;
+    case NR12:
+        m_square1.envelope_written();
+        break;
+    case NR14:
+        if (value & TRIGGER)
+            m_square1.trigger();
+        break;
+    case NR21:
+        m_square2.length_written();
+        break;
+    case NR22:
+        m_square2.envelope_written();
+        break;
+    case NR24:
+        if (value & TRIGGER)
+            m_square2.trigger();
+        break;
+    case NR30:
+        m_wave.dac_written();
+        break;
+    case NR31:
+        m_wave.length_written();
+        break;
+    case NR34:
+        if (value & TRIGGER)
+            m_wave.trigger();
+        break;
+    case NR41:
+        m_noise.length_written();
+        break;
+    case NR42:
+        m_noise.envelope_written();
+        break;
+    case NR44:
+        if (value & TRIGGER)
+            m_noise.trigger();
+        break;
+    default:
+        // Read as needed
+        break;
+    }
+    remix();
+}
+
+auto Apu::next_change(uint16_t address, uint64_t) -> uint64_t
+{
+    return address == NR52 ? m_cpu.scheduler().deadline(Event::Apu) : Scheduler::NEVER;
+}
+
+auto Apu::save_state(StateWriter& writer) const -> void
+{
+    writer.write(m_registers);
+    writer.write(m_powered);
+    m_square1.save_state(writer);
+    m_square2.save_state(writer);
+    m_wave.save_state(writer);
+    m_noise.save_state(writer);
+    writer.write(m_cycle);
+    writer.write(m_sequencerStep);
+}
+
+auto Apu::load_state(StateReader& reader) -> void
+{
+    const auto cycle = m_cycle;
+    reader.read(m_registers);
+    reader.read(m_powered);
+    m_square1.load_state(reader);
+    m_square2.load_state(reader);
+    m_wave.load_state(reader);
+    m_noise.load_state(reader);
+    reader.read(m_cycle);
+    reader.read(m_sequencerStep);
+    if (m_resampler)
+        m_steps.rebase(cycle, m_cycle);
+    remix();
+}
+
+auto Apu::catch_up(uint64_t cycle) -> void
+{
+    // A frame sequencer step that fired late, after a write already caught up past it
+    if (cycle <= m_cycle)
+        return;
+    if (!m_resampler) {
+        advance_channels(cycle - m_cycle);
+        m_cycle = cycle;
+        return;
+    }
+    // Bit by bit, so that the steps waiting to be resampled never pile up
+    while (m_cycle < cycle) {
+        const auto cycles = min(cycle - m_cycle, MAX_CATCH_UP_CYCLES);
+        run_channel(m_square1, 0, cycles);
+        run_channel(m_square2, 1, cycles);
+        run_channel(m_wave, 2, cycles);
+        run_channel(m_noise, 3, cycles);
+        m_cycle += cycles;
+        if (m_steps.available(m_cycle) >= FLUSH_SAMPLES)
+            flush_samples();
+    }
+}
+
+auto Apu::advance_channels(uint64_t cycles) -> void
+{
+    m_square1.advance(cycles);
+    m_square2.advance(cycles);
+    m_wave.advance(cycles);
+    m_noise.advance(cycles);
+}
+
+template <typename Channel>
+auto Apu::run_channel(Channel& channel, int index, uint64_t cycles) -> void
+{
+    auto cycle = m_cycle;
+    auto level = channel.output();
+    for (auto next = channel.next_step(); next <= cycles; next = channel.next_step()) {
+        channel.advance(next);
+        cycles -= next;
+        cycle += next;
+        // Most steps leave the level as it was
+        if (channel.output() != level) {
+            level = channel.output();
+            mix(index, level, cycle);
+        }
+    }
+    channel.advance(cycles);
+}
+
+auto Apu::mix(int index, uint8_t level, uint64_t cycle) -> void
+{
+    const auto panning = m_registers[NR51 - FIRST_REGISTER];
+    const auto volume = m_registers[NR50 - FIRST_REGISTER];
+    const int left = (panning & (0x10 << index)) ? level * (((volume >> 4) & 0x07) + 1) * SAMPLE_SCALE : 0;
+    const int right = (panning & (0x01 << index)) ? level * ((volume & 0x07) + 1) * SAMPLE_SCALE : 0;
+    auto& mixed = m_mixed[index];
+    if (left == mixed.left && right == mixed.right)
+        return;
+    m_steps.add_step(cycle, left - mixed.left, right - mixed.right);
+    mixed = { left, right };
+}
+
+auto Apu::remix() -> void
+{
+    if (!m_resampler)
+        return;
+    mix(0, m_square1.output(), m_cycle);
+    mix(1, m_square2.output(), m_cycle);
+    mix(2, m_wave.output(), m_cycle);
+    mix(3, m_noise.output(), m_cycle);
+}
+
+auto Apu::flush_samples() -> void
+{
+    const auto count = m_steps.available(m_cycle);
+    m_left.resize(count);
+    m_right.resize(count);
+    m_steps.read(count, m_left.data(), m_right.data());
+    m_resampler->process(m_left.data(), m_right.data(), count, m_samples);
+
+    // Nobody is reading; keep only the newest second
+    if ((m_samples.size() - m_samplesRead) / 2 > m_sampleRate) {
+        m_samplesRead = m_samples.size() - 2 * m_sampleRate;
+        compact_samples();
+    }
+}
+
+auto Apu::compact_samples() -> void
+{
+    // Moving what is left costs no more than reading what went, so reads stay linear
+    if (m_samplesRead < m_samples.size() - m_samplesRead)
+        return;
+    m_samples.erase(m_samples.begin(), m_samples.begin() + m_samplesRead);
+    m_samplesRead = 0;
+}
+
+auto Apu::step_frame_sequencer() -> void
+{
+    catch_up(m_cpu.cycle());
+
+    // Length on every other step, the sweep on every fourth, and the envelopes on the last
+    if (!(m_sequencerStep & 1)) {
+        m_square1.clock_length();
+        m_square2.clock_length();
+        m_wave.clock_length();
+        m_noise.clock_length();
+    }
+    if (m_sequencerStep == 2 || m_sequencerStep == 6)
+        m_square1.clock_sweep();
+    if (m_sequencerStep == 7) {
+        m_square1.clock_envelope();
+        m_square2.clock_envelope();
+        m_noise.clock_envelope();
+    }
+    remix();
+    m_sequencerStep = (m_sequencerStep + 1) & 7;
+    m_cpu.scheduler().schedule_in(Event::Apu, FRAME_SEQUENCER_CYCLES);
+}
+
+auto Apu::power(bool on) -> void
+{
+    m_powered = on;
+    if (on) {
+        m_sequencerStep = 0;
+        m_cpu.scheduler().schedule(Event::Apu, m_cycle + FRAME_SEQUENCER_CYCLES);
+        return;
+    }
+
+    // Every register but wave RAM is cleared, and stays clear until powered on again
+    fill(m_registers.begin(), m_registers.begin() + (NR52 - FIRST_REGISTER), 0);
+    m_square1.power_off();
+    m_square2.power_off();
+    m_wave.power_off();
+    m_noise.power_off();
+    m_cpu.scheduler().cancel(Event::Apu);
+}
+
+}
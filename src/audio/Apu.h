@@ -0,0 +1,113 @@
+#pragma once
+
+#include "audio/BlepBuffer.h"
+#include "audio/Channels.h"
+#include "audio/Resampler.h"
+#include "memory/IoHandler.h"
+
+#include <array>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace GameBoy {
+
+class CPU;
+class StateReader;
+class StateWriter;
+
+// NR10-NR52 and wave RAM (FF10-FF3F). Nothing runs per cycle: the APU catches up to the CPU
+// when a register is written, when the frame sequencer's Apu event fires every 8192 cycles,
+// and when samples are read. Catching up advances each channel by the cycles gone by. While
+// samples are being taken it does so a timer step at a time, and each change in a channel's
+// level, panned and scaled by NR50 and NR51, goes into a BlepBuffer at the cycle it happened;
+// a Resampler takes that to the sample rate a batch at a time. Length, envelope and sweep
+// only move on the frame sequencer steps that clock them.
+class Apu : public IoHandler {
+public:
+    static constexpr uint32_t CYCLES_PER_SECOND = 4194304;
+
+    // Maps the registers into the CPU's memory until destroyed. The APU starts powered on,
+    // with every channel off and no samples being taken.
+    Apu(CPU&);
+    ~Apu() override;
+
+    Apu(const Apu&) = delete;
+    auto operator=(const Apu&) -> Apu& = delete;
+
+    // Stereo samples per second; 0 stops taking them. Up to a second's worth are kept
+    // waiting to be read, after which the oldest are dropped.
+    auto set_sample_rate(uint32_t rate) -> void;
+    auto sample_rate() const -> uint32_t { return m_sampleRate; }
+    // Makes samples at rate from now on without starting over, keeping what is waiting. For
+    // keeping a consumer's queue steady, a fraction of a percent either way.
+    auto adjust_sample_rate(uint32_t rate) -> void;
+    // Catches up to the CPU, then moves up to frames samples into samples, left then right,
+    // returning how many frames it moved
+    auto read_samples(int16_t* samples, size_t frames) -> size_t;
+
+    auto read8(uint16_t address) -> uint8_t override;
+    auto write8(uint16_t address, uint8_t value) -> void override;
+    // Only NR52's channel bits change by themselves, on the frame sequencer
+    auto next_change(uint16_t address, uint64_t cycle) -> uint64_t override;
+
+    // Registers, channels and the frame sequencer. Samples aren't part of it: loading carries
+    // on from the level last output, stepping to the one loaded.
+    auto save_state(StateWriter&) const -> void;
+    auto load_state(StateReader&) -> void;
+
+private:
+    static constexpr size_t NUM_REGISTERS = 0x30;
+
+    auto catch_up(uint64_t cycle) -> void;
+    auto advance_channels(uint64_t cycles) -> void;
+    // Runs a channel on from m_cycle by cycles a step at a time, mixing in each new level
+    template <typename Channel>
+    auto run_channel(Channel&, int index, uint64_t cycles) -> void;
+    // Steps the mix at cycle to channel index at level, under the volume and panning now set
+    auto mix(int index, uint8_t level, uint64_t cycle) -> void;
+    // Mixes in every channel's level now, after anything that may have changed one
+    auto remix() -> void;
+    // Resamples what the BlepBuffer has finished with
+    auto flush_samples() -> void;
+    // Drops samples already read, once they are most of the buffer
+    auto compact_samples() -> void;
+    // Handles the Apu event
+    auto step_frame_sequencer() -> void;
+    auto power(bool on) -> void;
+
+    CPU& m_cpu;
+    // FF10-FF3F as written, wave RAM included
+    std::array<uint8_t, NUM_REGISTERS> m_registers {};
+    bool m_powered = true;
+
+    SquareChannel m_square1;
+    SquareChannel m_square2;
+    WaveChannel m_wave;
+    NoiseChannel m_noise;
+
+    // The cycle everything has been run up to
+    uint64_t m_cycle;
+    uint8_t m_sequencerStep = 0;
+
+    // Each channel's part of the mix, as last stepped to
+    struct Mixed {
+        int left = 0;
+        int right = 0;
+    };
+    std::array<Mixed, 4> m_mixed {};
+
+    uint32_t m_sampleRate = 0;
+    BlepBuffer m_steps;
+    // Null while no samples are being taken
+    std::unique_ptr<Resampler> m_resampler;
+    std::vector<float> m_left;
+    std::vector<float> m_right;
+    // Interleaved frames; those before m_samplesRead have been read and go once they are most
+    // of the buffer
+    std::vector<int16_t> m_samples;
+    size_t m_samplesRead = 0;
+};
+
+}
@@ -0,0 +1,120 @@
+#include "audio/BlepBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace GameBoy {
+
+using namespace std;
+
+// Each step's kernel is the difference of a windowed sinc sampled at one of 32 offsets, one
+// a cycle, in units that add up to exactly 1 << KERNEL_BITS
+constexpr int KERNEL_BITS = 12;
+constexpr size_t NUM_PHASES = BlepBuffer::CYCLES_PER_SAMPLE;
+// As a fraction of the sample rate: through 46 kHz, and nothing left by the 65.5 kHz Nyquist
+constexpr double KERNEL_CUTOFF = 0.35;
+
+namespace {
+
+    using Kernel = array<int32_t, BlepBuffer::KERNEL_SIZE>;
+
+    auto build_kernels() -> array<Kernel, NUM_PHASES>
+    {
+        constexpr double PI = 3.14159265358979323846;
+        constexpr double WIDTH = BlepBuffer::KERNEL_SIZE;
+        array<Kernel, NUM_PHASES> kernels;
+        for (size_t phase = 0; phase < NUM_PHASES; ++phase) {
+            // A step phase / NUM_PHASES of a sample in has its impulse centred half the
+            // kernel later, under a Blackman window
+            double impulse[BlepBuffer::KERNEL_SIZE];
+            double total = 0;
+            for (size_t tap = 0; tap < BlepBuffer::KERNEL_SIZE; ++tap) {
+                const double position = tap - double(phase) / NUM_PHASES;
+                const double x = position - WIDTH / 2;
+                const double sinc = x == 0 ? 1 : sin(2 * PI * KERNEL_CUTOFF * x) / (2 * PI * KERNEL_CUTOFF * x);
+                const double window = position <= 0 ? 0
+                                                    : 0.42 - 0.5 * cos(2 * PI * position / WIDTH)
+                        + 0.08 * cos(4 * PI * position / WIDTH);
+                impulse[tap] = sinc * window;
+                total += impulse[tap];
+            }
+            // Rounded so that the taps add up exactly, the remainder left on the middle one
+            int32_t sum = 0;
+            for (size_t tap = 0; tap < BlepBuffer::KERNEL_SIZE; ++tap) {
+                kernels[phase][tap] = int32_t(lround(impulse[tap] / total * (1 << KERNEL_BITS)));
+                sum += kernels[phase][tap];
+            }
+            kernels[phase][BlepBuffer::KERNEL_SIZE / 2] += (1 << KERNEL_BITS) - sum;
+        }
+        return kernels;
+    }
+
+    const auto KERNELS = build_kernels();
+
+}
+
+auto BlepBuffer::reset(uint64_t cycle) -> void
+{
+    m_start = cycle;
+    m_left.clear();
+    m_right.clear();
+    m_read = 0;
+    m_leftLevel = 0;
+    m_rightLevel = 0;
+}
+
+auto BlepBuffer::add_step(uint64_t cycle, int left, int right) -> void
+{
+    const auto offset = cycle - m_start;
+    const size_t sample = m_read + offset / CYCLES_PER_SAMPLE;
+    const auto& kernel = KERNELS[offset % CYCLES_PER_SAMPLE];
+    if (m_left.size() < sample + KERNEL_SIZE) {
+        m_left.resize(sample + KERNEL_SIZE);
+        m_right.resize(sample + KERNEL_SIZE);
+    }
+    auto* __restrict leftDeltas = m_left.data() + sample;
+    auto* __restrict rightDeltas = m_right.data() + sample;
+    for (size_t tap = 0; tap < KERNEL_SIZE; ++tap) {
+        leftDeltas[tap] += left * kernel[tap];
+        rightDeltas[tap] += right * kernel[tap];
+    }
+}
+
+auto BlepBuffer::available(uint64_t cycle) const -> size_t
+{
+    return (cycle - m_start) / CYCLES_PER_SAMPLE;
+}
+
+auto BlepBuffer::rebase(uint64_t from, uint64_t to) -> void
+{
+    // Wraps round if need be; only differences from m_start are ever taken
+    m_start = m_start - from + to;
+}
+
+auto BlepBuffer::read(size_t count, float* left, float* right) -> void
+{
+    constexpr float SCALE = 1.0f / (1 << KERNEL_BITS);
+    const auto stored = min(count, m_left.size() - m_read);
+    const auto* leftDeltas = m_left.data() + m_read;
+    const auto* rightDeltas = m_right.data() + m_read;
+    for (size_t i = 0; i < stored; ++i) {
+        m_leftLevel += leftDeltas[i];
+        m_rightLevel += rightDeltas[i];
+        left[i] = m_leftLevel * SCALE;
+        right[i] = m_rightLevel * SCALE;
+    }
+    // Nothing stepped after that
+    fill(left + stored, left + count, m_leftLevel * SCALE);
+    fill(right + stored, right + count, m_rightLevel * SCALE);
+    m_start += count * CYCLES_PER_SAMPLE;
+
+    // Moving what is left costs no more than reading what went
+    m_read += stored;
+    if (m_read >= m_left.size() - m_read) {
+        m_left.erase(m_left.begin(), m_left.begin() + m_read);
+        m_right.erase(m_right.begin(), m_right.begin() + m_read);
+        m_read = 0;
+    }
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace GameBoy {
+
+// Stereo output built from steps in level, each placed at the exact cycle it happened as a
+// band-limited step (a BLEP) at one sample every 32 cycles, 131072 Hz. Only the changes are
+// stored, as the differences of each step's kernel, and read() adds them up, so a channel
+// that holds its level costs nothing and one that steps at any pitch never aliases. Levels
+// are kept in fixed point and add up exactly however long it runs.
+class BlepBuffer {
+public:
+    static constexpr uint32_t CYCLES_PER_SAMPLE = 32;
+    // Samples taken by each step
+    static constexpr size_t KERNEL_SIZE = 16;
+
+    // Starts over, silent, with sample 0 at cycle
+    auto reset(uint64_t cycle) -> void;
+    // A step in level at cycle, which must be no earlier than the last cycle passed to
+    // available()
+    auto add_step(uint64_t cycle, int left, int right) -> void;
+    // How many samples no step from cycle on can change any more
+    auto available(uint64_t cycle) const -> size_t;
+    // Moves count of those out as levels, one plane a side
+    auto read(size_t count, float* left, float* right) -> void;
+    // Calls cycle from to from now on, keeping the steps stored and the level, so the output
+    // carries on unbroken when the clock is set back or forward
+    auto rebase(uint64_t from, uint64_t to) -> void;
+
+private:
+    // The cycle of sample 0, the first unread one; each sample holds the kernel differences
+    // landing on it
+    uint64_t m_start = 0;
+    std::vector<int32_t> m_left;
+    std::vector<int32_t> m_right;
+    // Where sample 0 is in m_left and m_right. What was read before it goes once it is most
+    // of the buffer.
+    size_t m_read = 0;
+    // The levels the samples read so far add up to
+    int64_t m_leftLevel = 0;
+    int64_t m_rightLevel = 0;
+};
+
+}
@@ -0,0 +1,456 @@
+#include "audio/Channels.h"
+
+#include "state/StateStream.h"
+
+namespace GameBoy {
+
+using namespace std;
+
+// Register offsets from NRx0
+constexpr int NRX0 = 0;
+constexpr int NRX1 = 1;
+constexpr int NRX2 = 2;
+constexpr int NRX3 = 3;
+constexpr int NRX4 = 4;
+
+// NRx4
+constexpr uint8_t LENGTH_ENABLE = 0x40;
+// NRx2
+constexpr uint8_t ENVELOPE_INCREASE = 0x08;
+constexpr uint8_t DAC_BITS = 0xF8;
+// NR10
+constexpr uint8_t SWEEP_NEGATE = 0x08;
+// NR30
+constexpr uint8_t WAVE_DAC_ENABLE = 0x80;
+// NR43
+constexpr uint8_t NARROW_NOISE = 0x08;
+
+constexpr uint8_t MAX_VOLUME = 15;
+constexpr uint16_t MAX_FREQUENCY = 2047;
+constexpr uint8_t DUTY_STEPS = 8;
+constexpr uint8_t WAVE_SAMPLES = 32;
+// A period of 0 counts as 8 for the sweep
+constexpr uint8_t SWEEP_ZERO_PERIOD = 8;
+// Noise shifts of 14 and 15 never clock the LFSR
+constexpr uint8_t NOISE_STOPPED_SHIFT = 14;
+
+// Each duty as the 8 steps of its cycle, first step in the top bit
+constexpr array<uint8_t, 4> DUTY_PATTERNS = { 0x01, 0x81, 0x87, 0x7E };
+
+namespace {
+
+    // Runs a timer that counts down from period through cycles, returning how many times it
+    // reached zero
+    auto run_timer(uint32_t& timer, uint32_t period, uint64_t cycles) -> uint64_t
+    {
+        if (cycles < timer) {
+            timer -= uint32_t(cycles);
+            return 0;
+        }
+        cycles -= timer;
+        // Stepping through one step at a time, as the APU does while taking samples, shouldn't
+        // cost a division each
+        if (cycles < period) {
+            timer = uint32_t(period - cycles);
+            return 1;
+        }
+        timer = uint32_t(period - cycles % period);
+        return 1 + cycles / period;
+    }
+
+}
+
+LengthCounter::LengthCounter(uint16_t maximum)
+    : m_maximum(maximum)
+{
+}
+
+auto LengthCounter::load(uint16_t length) -> void
+{
+    m_counter = m_maximum - length;
+}
+
+auto LengthCounter::trigger() -> void
+{
+    if (!m_counter)
+        m_counter = m_maximum;
+}
+
+auto LengthCounter::clock(bool enabled) -> bool
+{
+    if (!enabled || !m_counter)
+        return false;
+    return --m_counter == 0;
+}
+
+auto LengthCounter::save_state(StateWriter& writer) const -> void
+{
+    writer.write(m_counter);
+}
+
+auto LengthCounter::load_state(StateReader& reader) -> void
+{
+    reader.read(m_counter);
+}
+
+auto Envelope::trigger(uint8_t nrx2) -> void
+{
+    m_volume = nrx2 >> 4;
+    m_timer = nrx2 & 0x07;
+}
+
+auto Envelope::clock(uint8_t nrx2) -> void
+{
+    const uint8_t period = nrx2 & 0x07;
+    if (!period)
+        return;
+    if (m_timer > 1) {
+        --m_timer;
+        return;
+    }
+    m_timer = period;
+    if ((nrx2 & ENVELOPE_INCREASE) && m_volume < MAX_VOLUME)
+        ++m_volume;
+    else if (!(nrx2 & ENVELOPE_INCREASE) && m_volume > 0)
+        --m_volume;
+}
+
+auto Envelope::save_state(StateWriter& writer) const -> void
+{
+    writer.write(m_volume);
+    writer.write(m_timer);
+}
+
+auto Envelope::load_state(StateReader& reader) -> void
+{
+    reader.read(m_volume);
+    reader.read(m_timer);
+}
+
+SquareChannel::SquareChannel(uint8_t* registers, bool hasSweep)
+    : m_registers(registers)
+    , m_hasSweep(hasSweep)
+{
+}
+
+auto SquareChannel::advance(uint64_t cycles) -> void
+{
+    if (!m_enabled)
+        return;
+    const auto steps = run_timer(m_timer, period(), cycles);
+    m_position = uint8_t((m_position + steps) % DUTY_STEPS);
+}
+
+auto SquareChannel::next_step() const -> uint64_t
+{
+    return m_enabled ? m_timer : NO_STEP;
+}
+
+auto SquareChannel::output() const -> uint8_t
+{
+    if (!m_enabled)
+        return 0;
+    const auto pattern = DUTY_PATTERNS[m_registers[NRX1] >> 6];
+    return (pattern >> (7 - m_position)) & 1 ? m_envelope.volume() : 0;
+}
+
+auto SquareChannel::dac_enabled() const -> bool
+{
+    return m_registers[NRX2] & DAC_BITS;
+}
+
+auto SquareChannel::length_written() -> void
+{
+    m_length.load(m_registers[NRX1] & 0x3F);
+}
+
+auto SquareChannel::envelope_written() -> void
+{
+    if (!dac_enabled())
+        m_enabled = false;
+}
+
+auto SquareChannel::trigger() -> void
+{
+    m_enabled = dac_enabled();
+    m_length.trigger();
+    m_envelope.trigger(m_registers[NRX2]);
+    m_timer = period();
+
+    if (m_hasSweep) {
+        const uint8_t sweepPeriod = (m_registers[NRX0] >> 4) & 0x07;
+        const uint8_t shift = m_registers[NRX0] & 0x07;
+        m_sweepFrequency = frequency();
+        m_sweepTimer = sweepPeriod ? sweepPeriod : SWEEP_ZERO_PERIOD;
+        m_sweepEnabled = sweepPeriod || shift;
+        // Only to see whether it would overflow straight away
+        if (shift)
+            sweep_target();
+    }
+}
+
+auto SquareChannel::power_off() -> void
+{
+    m_enabled = false;
+    m_position = 0;
+}
+
+auto SquareChannel::clock_length() -> void
+{
+    if (m_length.clock(m_registers[NRX4] & LENGTH_ENABLE))
+        m_enabled = false;
+}
+
+auto SquareChannel::clock_envelope() -> void
+{
+    m_envelope.clock(m_registers[NRX2]);
+}
+
+auto SquareChannel::clock_sweep() -> void
+{
+    if (m_sweepTimer > 1) {
+        --m_sweepTimer;
+        return;
+    }
+    const uint8_t sweepPeriod = (m_registers[NRX0] >> 4) & 0x07;
+    m_sweepTimer = sweepPeriod ? sweepPeriod : SWEEP_ZERO_PERIOD;
+    if (!m_sweepEnabled || !sweepPeriod)
+        return;
+
+    const auto target = sweep_target();
+    if (m_enabled && (m_registers[NRX0] & 0x07)) {
+        m_sweepFrequency = target;
+        m_registers[NRX3] = uint8_t(target);
+        m_registers[NRX4] = (m_registers[NRX4] & ~0x07) | uint8_t(target >> 8);
+        // And again with the new frequency, though only to check for overflow
+        sweep_target();
+    }
+}
+
+auto SquareChannel::save_state(StateWriter& writer) const -> void
+{
+    writer.write(m_enabled);
+    m_length.save_state(writer);
+    m_envelope.save_state(writer);
+    writer.write(m_position);
+    writer.write(m_timer);
+    writer.write(m_sweepEnabled);
+    writer.write(m_sweepFrequency);
+    writer.write(m_sweepTimer);
+}
+
+auto SquareChannel::load_state(StateReader& reader) -> void
+{
+    reader.read(m_enabled);
+    m_length.load_state(reader);
+    m_envelope.load_state(reader);
+    reader.read(m_position);
+    reader.read(m_timer);
+    reader.read(m_sweepEnabled);
+    reader.read(m_sweepFrequency);
+    reader.read(m_sweepTimer);
+}
+
+auto SquareChannel::frequency() const -> uint16_t
+{
+    return m_registers[NRX3] | uint16_t((m_registers[NRX4] & 0x07) << 8);
+}
+
+auto SquareChannel::period() const -> uint32_t
+{
+    return (2048 - frequency()) * 4;
+}
+
+auto SquareChannel::sweep_target() -> uint16_t
+{
+    const auto delta = m_sweepFrequency >> (m_registers[NRX0] & 0x07);
+    const int target = (m_registers[NRX0] & SWEEP_NEGATE) ? m_sweepFrequency - delta : m_sweepFrequency + delta;
+    if (target > MAX_FREQUENCY)
+        m_enabled = false;
+    return uint16_t(target);
+}
+
+WaveChannel::WaveChannel(const uint8_t* registers, const uint8_t* waveRam)
+    : m_registers(registers)
+    , m_waveRam(waveRam)
+{
+}
+
+auto WaveChannel::advance(uint64_t cycles) -> void
+{
+    if (!m_enabled)
+        return;
+    const auto steps = run_timer(m_timer, period(), cycles);
+    m_position = uint8_t((m_position + steps) % WAVE_SAMPLES);
+}
+
+auto WaveChannel::next_step() const -> uint64_t
+{
+    return m_enabled ? m_timer : NO_STEP;
+}
+
+auto WaveChannel::output() const -> uint8_t
+{
+    if (!m_enabled)
+        return 0;
+    const auto byte = m_waveRam[m_position / 2];
+    const uint8_t sample = (m_position & 1) ? byte & 0x0F : byte >> 4;
+    // Volume codes 0 to 3 are mute, full, half and a quarter
+    const uint8_t volume = (m_registers[NRX2] >> 5) & 0x03;
+    return volume ? sample >> (volume - 1) : 0;
+}
+
+auto WaveChannel::dac_enabled() const -> bool
+{
+    return m_registers[NRX0] & WAVE_DAC_ENABLE;
+}
+
+auto WaveChannel::length_written() -> void
+{
+    m_length.load(m_registers[NRX1]);
+}
+
+auto WaveChannel::dac_written() -> void
+{
+    if (!dac_enabled())
+        m_enabled = false;
+}
+
+auto WaveChannel::trigger() -> void
+{
+    m_enabled = dac_enabled();
+    m_length.trigger();
+    m_position = 0;
+    m_timer = period();
+}
+
+auto WaveChannel::power_off() -> void
+{
+    m_enabled = false;
+}
+
+auto WaveChannel::clock_length() -> void
+{
+    if (m_length.clock(m_registers[NRX4] & LENGTH_ENABLE))
+        m_enabled = false;
+}
+
+auto WaveChannel::save_state(StateWriter& writer) const -> void
+{
+    writer.write(m_enabled);
+    m_length.save_state(writer);
+    writer.write(m_position);
+    writer.write(m_timer);
+}
+
+auto WaveChannel::load_state(StateReader& reader) -> void
+{
+    reader.read(m_enabled);
+    m_length.load_state(reader);
+    reader.read(m_position);
+    reader.read(m_timer);
+}
+
+auto WaveChannel::period() const -> uint32_t
+{
+    const uint16_t frequency = m_registers[NRX3] | uint16_t((m_registers[NRX4] & 0x07) << 8);
+    return (2048 - frequency) * 2;
+}
+
+NoiseChannel::NoiseChannel(const uint8_t* registers)
+    : m_registers(registers)
+{
+}
+
+auto NoiseChannel::advance(uint64_t cycles) -> void
+{
+    if (!m_enabled || (m_registers[NRX3] >> 4) >= NOISE_STOPPED_SHIFT)
+        return;
+    for (auto steps = run_timer(m_timer, period(), cycles); steps; --steps)
+        shift();
+}
+
+auto NoiseChannel::next_step() const -> uint64_t
+{
+    return m_enabled && (m_registers[NRX3] >> 4) < NOISE_STOPPED_SHIFT ? m_timer : NO_STEP;
+}
+
+auto NoiseChannel::output() const -> uint8_t
+{
+    return m_enabled && !(m_lfsr & 1) ? m_envelope.volume() : 0;
+}
+
+auto NoiseChannel::dac_enabled() const -> bool
+{
+    return m_registers[NRX2] & DAC_BITS;
+}
+
+auto NoiseChannel::length_written() -> void
+{
+    m_length.load(m_registers[NRX1] & 0x3F);
+}
+
+auto NoiseChannel::envelope_written() -> void
+{
+    if (!dac_enabled())
+        m_enabled = false;
+}
+
+auto NoiseChannel::trigger() -> void
+{
+    m_enabled = dac_enabled();
+    m_length.trigger();
+    m_envelope.trigger(m_registers[NRX2]);
+    m_lfsr = 0x7FFF;
+    m_timer = period();
+}
+
+auto NoiseChannel::power_off() -> void
+{
+    m_enabled = false;
+}
+
+auto NoiseChannel::clock_length() -> void
+{
+    if (m_length.clock(m_registers[NRX4] & LENGTH_ENABLE))
+        m_enabled = false;
+}
+
+auto NoiseChannel::clock_envelope() -> void
+{
+    m_envelope.clock(m_registers[NRX2]);
+}
+
+auto NoiseChannel::save_state(StateWriter& writer) const -> void
+{
+    writer.write(m_enabled);
+    m_length.save_state(writer);
+    m_envelope.save_state(writer);
+    writer.write(m_lfsr);
+    writer.write(m_timer);
+}
+
+auto NoiseChannel::load_state(StateReader& reader) -> void
+{
+    reader.read(m_enabled);
+    m_length.load_state(reader);
+    m_envelope.load_state(reader);
+    reader.read(m_lfsr);
+    reader.read(m_timer);
+}
+
+auto NoiseChannel::period() const -> uint32_t
+{
+    const uint8_t divisor = m_registers[NRX3] & 0x07;
+    return (divisor ? divisor * 16 : 8) << (m_registers[NRX3] >> 4);
+}
+
+auto NoiseChannel::shift() -> void
+{
+    const uint16_t bit = (m_lfsr ^ (m_lfsr >> 1)) & 1;
+    m_lfsr = (m_lfsr >> 1) | (bit << 14);
+    if (m_registers[NRX3] & NARROW_NOISE)
+        m_lfsr = (m_lfsr & ~0x40) | (bit << 6);
+}
+
+}
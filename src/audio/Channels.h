@@ -0,0 +1,174 @@
+#pragma once
+
+#include <array>
+#include <stdint.h>
+
+namespace GameBoy {
+
+class StateReader;
+class StateWriter;
+
+// The four DMG sound channels. None of them counts cycles: advance() is told how many have
+// gone by since it was last called, and works out from the period how many steps the
+// frequency timer took in that time, while next_step() says how far off the timer's next step
+// is, for anything that needs each change of level as it happens. Length, envelope and sweep
+// only move when the frame sequencer clocks them. Each channel reads its own five registers,
+// NRx0-NRx4, straight from the APU's copy, so writes only need passing on when they do
+// something at once.
+
+// What next_step() returns for a channel whose timer isn't running
+constexpr uint64_t NO_STEP = UINT64_MAX;
+
+// Silences a channel once it has counted down, if enabled in NRx4
+class LengthCounter {
+public:
+    LengthCounter(uint16_t maximum);
+
+    // From the length written to NRx1
+    auto load(uint16_t length) -> void;
+    // A zero counter is set to the maximum on a trigger
+    auto trigger() -> void;
+    // Returns true when it has just run out
+    auto clock(bool enabled) -> bool;
+
+    auto save_state(StateWriter&) const -> void;
+    auto load_state(StateReader&) -> void;
+
+private:
+    uint16_t m_maximum;
+    uint16_t m_counter = 0;
+};
+
+// The volume of the square and noise channels, moved a step every NRx2 period
+class Envelope {
+public:
+    auto trigger(uint8_t nrx2) -> void;
+    auto clock(uint8_t nrx2) -> void;
+    auto volume() const -> uint8_t { return m_volume; }
+
+    auto save_state(StateWriter&) const -> void;
+    auto load_state(StateReader&) -> void;
+
+private:
+    uint8_t m_volume = 0;
+    uint8_t m_timer = 0;
+};
+
+class SquareChannel {
+public:
+    // registers is NRx0-NRx4. Only channel 1 has NR10, for the sweep, which writes the
+    // frequency it moves to back to NR13 and NR14.
+    SquareChannel(uint8_t* registers, bool hasSweep);
+
+    auto advance(uint64_t cycles) -> void;
+    auto next_step() const -> uint64_t;
+    // 0 to 15, as the DAC sees it
+    auto output() const -> uint8_t;
+    auto enabled() const -> bool { return m_enabled; }
+    auto dac_enabled() const -> bool;
+
+    // Registers written through to the APU's copy
+    auto length_written() -> void;
+    auto envelope_written() -> void;
+    auto trigger() -> void;
+    auto power_off() -> void;
+
+    auto clock_length() -> void;
+    auto clock_envelope() -> void;
+    auto clock_sweep() -> void;
+
+    // Everything but the registers, which are the APU's
+    auto save_state(StateWriter&) const -> void;
+    auto load_state(StateReader&) -> void;
+
+private:
+    auto frequency() const -> uint16_t;
+    auto period() const -> uint32_t;
+    // The next sweep frequency, disabling the channel if it overflows
+    auto sweep_target() -> uint16_t;
+
+    uint8_t* m_registers;
+    bool m_hasSweep;
+    bool m_enabled = false;
+    LengthCounter m_length { 64 };
+    Envelope m_envelope;
+
+    // Where in the 8-step duty cycle it is, and cycles left until the next step
+    uint8_t m_position = 0;
+    uint32_t m_timer = 0;
+
+    bool m_sweepEnabled = false;
+    uint16_t m_sweepFrequency = 0;
+    uint8_t m_sweepTimer = 0;
+};
+
+class WaveChannel {
+public:
+    // registers is NR30-NR34, waveRam FF30-FF3F
+    WaveChannel(const uint8_t* registers, const uint8_t* waveRam);
+
+    auto advance(uint64_t cycles) -> void;
+    auto next_step() const -> uint64_t;
+    auto output() const -> uint8_t;
+    auto enabled() const -> bool { return m_enabled; }
+    auto dac_enabled() const -> bool;
+
+    auto length_written() -> void;
+    auto dac_written() -> void;
+    auto trigger() -> void;
+    auto power_off() -> void;
+
+    auto clock_length() -> void;
+
+    auto save_state(StateWriter&) const -> void;
+    auto load_state(StateReader&) -> void;
+
+private:
+    auto period() const -> uint32_t;
+
+    const uint8_t* m_registers;
+    const uint8_t* m_waveRam;
+    bool m_enabled = false;
+    LengthCounter m_length { 256 };
+
+    // Which of the 32 samples is playing
+    uint8_t m_position = 0;
+    uint32_t m_timer = 0;
+};
+
+class NoiseChannel {
+public:
+    // registers is the unused FF1F, then NR41-NR44
+    NoiseChannel(const uint8_t* registers);
+
+    auto advance(uint64_t cycles) -> void;
+    auto next_step() const -> uint64_t;
+    auto output() const -> uint8_t;
+    auto enabled() const -> bool { return m_enabled; }
+    auto dac_enabled() const -> bool;
+
+    auto length_written() -> void;
+    auto envelope_written() -> void;
+    auto trigger() -> void;
+    auto power_off() -> void;
+
+    auto clock_length() -> void;
+    auto clock_envelope() -> void;
+
+    auto save_state(StateWriter&) const -> void;
+    auto load_state(StateReader&) -> void;
+
+private:
+    auto period() const -> uint32_t;
+    auto shift() -> void;
+
+    const uint8_t* m_registers;
+    bool m_enabled = false;
+    LengthCounter m_length { 64 };
+    Envelope m_envelope;
+
+    uint16_t m_lfsr = 0x7FFF;
+    uint32_t m_timer = 0;
+};
+
+}
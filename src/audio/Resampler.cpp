@@ -0,0 +1,187 @@
+#include "audio/Resampler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define GAMEBOY_AUDIO_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace GameBoy {
+
+using namespace std;
+
+// As a fraction of the lower of the two rates
+constexpr double CUTOFF = 0.45;
+
+namespace {
+
+    // Every kernel works out frame i from the NUM_TAPS input samples from starts[i] with the
+    // taps of phases[i], and rounds it to the nearest, saturating
+
+    auto resample_scalar(const float* left, const float* right, const float* taps, const uint32_t* starts,
+        const uint16_t* phases, size_t frames, int16_t* output) -> void
+    {
+        for (size_t frame = 0; frame < frames; ++frame) {
+            const auto* l = left + starts[frame];
+            const auto* r = right + starts[frame];
+            const auto* t = taps + phases[frame] * Resampler::NUM_TAPS;
+            float sumLeft = 0;
+            float sumRight = 0;
+            for (size_t tap = 0; tap < Resampler::NUM_TAPS; ++tap) {
+                sumLeft += l[tap] * t[tap];
+                sumRight += r[tap] * t[tap];
+            }
+            output[2 * frame] = int16_t(clamp(lrintf(sumLeft), -32768L, 32767L));
+            output[2 * frame + 1] = int16_t(clamp(lrintf(sumRight), -32768L, 32767L));
+        }
+    }
+
+#ifdef GAMEBOY_AUDIO_SIMD
+
+    // The left and right sums in the bottom two lanes, packed into one frame
+    __attribute__((target("sse2"))) inline auto store_frame(__m128 sums, int16_t* output) -> void
+    {
+        const auto rounded = _mm_cvtps_epi32(sums);
+        const int32_t frame = _mm_cvtsi128_si32(_mm_packs_epi32(rounded, rounded));
+        memcpy(output, &frame, sizeof(frame));
+    }
+
+    __attribute__((target("sse2"))) auto resample_sse2(const float* left, const float* right, const float* taps,
+        const uint32_t* starts, const uint16_t* phases, size_t frames, int16_t* output) -> void
+    {
+        for (size_t frame = 0; frame < frames; ++frame) {
+            const auto* l = left + starts[frame];
+            const auto* r = right + starts[frame];
+            const auto* t = taps + phases[frame] * Resampler::NUM_TAPS;
+            auto sumLeft = _mm_setzero_ps();
+            auto sumRight = _mm_setzero_ps();
+            for (size_t tap = 0; tap < Resampler::NUM_TAPS; tap += 4) {
+                const auto weights = _mm_loadu_ps(t + tap);
+                sumLeft = _mm_add_ps(sumLeft, _mm_mul_ps(_mm_loadu_ps(l + tap), weights));
+                sumRight = _mm_add_ps(sumRight, _mm_mul_ps(_mm_loadu_ps(r + tap), weights));
+            }
+            // l0 r0 l1 r1 plus l2 r2 l3 r3, then the two halves of that
+            const auto pairs = _mm_add_ps(_mm_unpacklo_ps(sumLeft, sumRight), _mm_unpackhi_ps(sumLeft, sumRight));
+            store_frame(_mm_add_ps(pairs, _mm_movehl_ps(pairs, pairs)), output + 2 * frame);
+        }
+    }
+
+    __attribute__((target("avx2"))) auto resample_avx2(const float* left, const float* right, const float* taps,
+        const uint32_t* starts, const uint16_t* phases, size_t frames, int16_t* output) -> void
+    {
+        for (size_t frame = 0; frame < frames; ++frame) {
+            const auto* l = left + starts[frame];
+            const auto* r = right + starts[frame];
+            const auto* t = taps + phases[frame] * Resampler::NUM_TAPS;
+            auto sumLeft = _mm256_setzero_ps();
+            auto sumRight = _mm256_setzero_ps();
+            for (size_t tap = 0; tap < Resampler::NUM_TAPS; tap += 8) {
+                const auto weights = _mm256_loadu_ps(t + tap);
+                sumLeft = _mm256_add_ps(sumLeft, _mm256_mul_ps(_mm256_loadu_ps(l + tap), weights));
+                sumRight = _mm256_add_ps(sumRight, _mm256_mul_ps(_mm256_loadu_ps(r + tap), weights));
+            }
+            // Pairs of each side within each lane, the lanes together, then the last pairs
+            const auto pairs = _mm256_hadd_ps(sumLeft, sumRight);
+            const auto quads = _mm_add_ps(_mm256_castps256_ps128(pairs), _mm256_extractf128_ps(pairs, 1));
+            store_frame(_mm_hadd_ps(quads, quads), output + 2 * frame);
+        }
+    }
+
+#endif
+
+}
+
+Resampler::Resampler(uint32_t inputRate, uint32_t outputRate)
+    : Resampler(inputRate, outputRate, best_isa())
+{
+}
+
+Resampler::Resampler(uint32_t inputRate, uint32_t outputRate, Isa isa)
+    : m_inputRate(inputRate)
+    , m_outputRate(outputRate)
+    , m_taps(NUM_PHASES * NUM_TAPS)
+    , m_left(NUM_TAPS - 1)
+    , m_right(NUM_TAPS - 1)
+{
+    assert(isa_supported(isa));
+    switch (isa) {
+#ifdef GAMEBOY_AUDIO_SIMD
+    case Isa::Sse2:
+        m_kernel = resample_sse2;
+        break;
+    case Isa::Avx2:
+        m_kernel = resample_avx2;
+        break;
+#endif
+    default:
+        m_kernel = resample_scalar;
+        break;
+    }
+
+    // A windowed sinc a phase's fraction of a sample later for each phase, so that the frame
+    // at an input position comes out NUM_TAPS / 2 samples behind it
+    constexpr double PI = 3.14159265358979323846;
+    const double cutoff = CUTOFF * min(1.0, double(outputRate) / inputRate);
+    for (size_t phase = 0; phase < NUM_PHASES; ++phase) {
+        auto* taps = &m_taps[phase * NUM_TAPS];
+        double impulse[NUM_TAPS];
+        double total = 0;
+        for (size_t tap = 0; tap < NUM_TAPS; ++tap) {
+            const double x = tap + 1 - double(NUM_TAPS) / 2 - double(phase) / NUM_PHASES;
+            const double sinc = x == 0 ? 1 : sin(2 * PI * cutoff * x) / (2 * PI * cutoff * x);
+            const double position = (x + NUM_TAPS / 2) / NUM_TAPS;
+            const double window = 0.42 - 0.5 * cos(2 * PI * position) + 0.08 * cos(4 * PI * position);
+            impulse[tap] = sinc * window;
+            total += impulse[tap];
+        }
+        for (size_t tap = 0; tap < NUM_TAPS; ++tap)
+            taps[tap] = float(impulse[tap] / total);
+    }
+}
+
+auto Resampler::process(const float* left, const float* right, size_t count, vector<int16_t>& output) -> void
+{
+    m_left.insert(m_left.end(), left, left + count);
+    m_right.insert(m_right.end(), right, right + count);
+
+    // Every frame whose taps reach no further than the input so far
+    const auto step = m_inputRate / m_outputRate;
+    const auto remainder = m_inputRate % m_outputRate;
+    m_starts.clear();
+    m_phases.clear();
+    while (m_position + NUM_TAPS <= m_left.size()) {
+        m_starts.push_back(uint32_t(m_position));
+        m_phases.push_back(uint16_t(uint64_t(m_fraction) * NUM_PHASES / m_outputRate));
+        m_position += step;
+        m_fraction += remainder;
+        if (m_fraction >= m_outputRate) {
+            m_fraction -= m_outputRate;
+            ++m_position;
+        }
+    }
+
+    const auto frames = m_starts.size();
+    output.resize(output.size() + 2 * frames);
+    m_kernel(m_left.data(), m_right.data(), m_taps.data(), m_starts.data(), m_phases.data(), frames,
+        output.data() + output.size() - 2 * frames);
+
+    // Drop what no frame from the next on needs, once that is most of the input kept
+    const auto used = min<uint64_t>(m_position, m_left.size());
+    if (used >= m_left.size() - used) {
+        m_left.erase(m_left.begin(), m_left.begin() + used);
+        m_right.erase(m_right.begin(), m_right.begin() + used);
+        m_position -= used;
+    }
+}
+
+auto Resampler::set_output_rate(uint32_t outputRate) -> void
+{
+    m_fraction = uint32_t(uint64_t(m_fraction) * outputRate / m_outputRate);
+    m_outputRate = outputRate;
+}
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "util/Isa.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace GameBoy {
+
+// Takes planar stereo levels from one rate to another through a polyphase FIR, and mixes
+// each output frame down to 16-bit left and right, saturating. Output frames are worked out
+// a batch at a time, one per input position, on x86 with the taps of both sides multiplied
+// 4 or 8 at a time with SSE2 or AVX2. Nothing depends on how the input is split up.
+class Resampler {
+public:
+    // Taps a side per output frame, at the input rate
+    static constexpr size_t NUM_TAPS = 64;
+    // Steps between input samples that each output frame is rounded to
+    static constexpr size_t NUM_PHASES = 256;
+
+    // Through the best Isa there is
+    Resampler(uint32_t inputRate, uint32_t outputRate);
+    // The Isa must be supported
+    Resampler(uint32_t inputRate, uint32_t outputRate, Isa);
+
+    // Appends count input samples, then every output frame they complete to output, left
+    // then right
+    auto process(const float* left, const float* right, size_t count, std::vector<int16_t>& output) -> void;
+    // Spaces output frames for outputRate from the next one on, carrying on from where it was.
+    // The filter stays as built, so this is for small corrections.
+    auto set_output_rate(uint32_t outputRate) -> void;
+
+private:
+    using Kernel = auto (*)(const float* left, const float* right, const float* taps, const uint32_t* starts,
+        const uint16_t* phases, size_t frames, int16_t* output) -> void;
+
+    uint32_t m_inputRate;
+    uint32_t m_outputRate;
+    Kernel m_kernel;
+    // NUM_PHASES sets of NUM_TAPS, each adding up to 1
+    std::vector<float> m_taps;
+
+    // Input from a little before m_position on, starting NUM_TAPS - 1 zeros before the first
+    // sample
+    std::vector<float> m_left;
+    std::vector<float> m_right;
+    // The next output frame's position in m_left: m_position plus m_fraction / m_outputRate
+    uint64_t m_position = 0;
+    uint32_t m_fraction = 0;
+    // Scratch for a batch's positions
+    std::vector<uint32_t> m_starts;
+    std::vector<uint16_t> m_phases;
+};
+
+}
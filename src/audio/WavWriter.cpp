@@ -0,0 +1,91 @@
+#include "audio/WavWriter.h"
+
+#include <vector>
+
+namespace GameBoy {
+
+using namespace std;
+
+constexpr uint16_t CHANNELS = 2;
+constexpr uint16_t BYTES_PER_SAMPLE = 2;
+constexpr uint16_t BYTES_PER_FRAME = CHANNELS * BYTES_PER_SAMPLE;
+constexpr uint32_t HEADER_BYTES = 44;
+constexpr uint16_t PCM_FORMAT = 1;
+
+namespace {
+
+    // WAV is little-endian whatever the host is
+    auto put16(vector<uint8_t>& bytes, uint16_t value) -> void
+    {
+        bytes.push_back(uint8_t(value));
+        bytes.push_back(uint8_t(value >> 8));
+    }
+
+    auto put32(vector<uint8_t>& bytes, uint32_t value) -> void
+    {
+        put16(bytes, uint16_t(value));
+        put16(bytes, uint16_t(value >> 16));
+    }
+
+    auto put_tag(vector<uint8_t>& bytes, const char* tag) -> void
+    {
+        bytes.insert(bytes.end(), tag, tag + 4);
+    }
+
+}
+
+auto WavWriter::create(const string& path, uint32_t sampleRate) -> unique_ptr<WavWriter>
+{
+    auto* file = fopen(path.c_str(), "wb");
+    if (!file)
+        return nullptr;
+    unique_ptr<WavWriter> writer(new WavWriter(file, sampleRate));
+    // A placeholder until the sizes are known
+    writer->write_header();
+    return writer;
+}
+
+WavWriter::WavWriter(FILE* file, uint32_t sampleRate)
+    : m_file(file)
+    , m_sampleRate(sampleRate)
+{
+}
+
+WavWriter::~WavWriter()
+{
+    fseek(m_file, 0, SEEK_SET);
+    write_header();
+    fclose(m_file);
+}
+
+auto WavWriter::write(const int16_t* samples, size_t frames) -> void
+{
+    vector<uint8_t> bytes;
+    bytes.reserve(frames * BYTES_PER_FRAME);
+    for (size_t i = 0; i < frames * CHANNELS; ++i)
+        put16(bytes, uint16_t(samples[i]));
+    fwrite(bytes.data(), 1, bytes.size(), m_file);
+    m_frames += frames;
+}
+
+auto WavWriter::write_header() -> void
+{
+    const auto dataBytes = uint32_t(m_frames * BYTES_PER_FRAME);
+    vector<uint8_t> header;
+    put_tag(header, "RIFF");
+    put32(header, HEADER_BYTES - 8 + dataBytes);
+    put_tag(header, "WAVE");
+    put_tag(header, "fmt ");
+    put32(header, 16);
+    put16(header, PCM_FORMAT);
+    put16(header, CHANNELS);
+    put32(header, m_sampleRate);
+    put32(header, m_sampleRate * BYTES_PER_FRAME);
+    put16(header, BYTES_PER_FRAME);
+    put16(header, BYTES_PER_SAMPLE * 8);
+    put_tag(header, "data");
+    put32(header, dataBytes);
+    fwrite(header.data(), 1, header.size(), m_file);
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+namespace GameBoy {
+
+// A 16-bit stereo PCM WAV file, written as samples arrive. The sizes in the header are filled
+// in when the writer is destroyed.
+class WavWriter {
+public:
+    // Null when the file can't be created
+    static auto create(const std::string& path, uint32_t sampleRate) -> std::unique_ptr<WavWriter>;
+
+    ~WavWriter();
+
+    WavWriter(const WavWriter&) = delete;
+    auto operator=(const WavWriter&) -> WavWriter& = delete;
+
+    // frames pairs of samples, left then right
+    auto write(const int16_t* samples, size_t frames) -> void;
+    auto frames_written() const -> uint64_t { return m_frames; }
+
+private:
+    WavWriter(FILE*, uint32_t sampleRate);
+
+    auto write_header() -> void;
+
+    FILE* m_file;
+    uint32_t m_sampleRate;
+    uint64_t m_frames = 0;
+};
+
+}
@@ -0,0 +1,293 @@
+#include "cartridge/Cartridge.h"
+
+#include "memory/Memory.h"
+#include "state/StateStream.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace GameBoy {
+
+using namespace std;
+
+constexpr size_t ROM_BANK_SIZE = 0x4000;
+constexpr size_t RAM_BANK_SIZE = 0x2000;
+constexpr size_t HEADER_END = 0x150;
+// Title to global checksum, which together tell one ROM from another
+constexpr size_t IDENTITY_SIZE = HEADER_END - 0x134;
+
+constexpr uint16_t TITLE_START = 0x134;
+constexpr uint16_t TITLE_LENGTH = 16;
+constexpr uint16_t TYPE = 0x147;
+constexpr uint16_t RAM_SIZE = 0x149;
+
+constexpr uint8_t FIXED_ROM_PAGE = 0x00;
+constexpr uint8_t SWITCHABLE_ROM_PAGE = 0x40;
+constexpr uint8_t ROM_BANK_PAGES = 0x40;
+constexpr uint8_t RAM_PAGE = 0xA0;
+constexpr uint8_t RAM_BANK_PAGES = 0x20;
+
+constexpr uint8_t FIRST_CLOCK_REGISTER = 0x08;
+constexpr uint8_t LAST_CLOCK_REGISTER = 0x0C;
+
+namespace {
+
+    auto controller_for(uint8_t type, bool& hasClock) -> optional<BankController>
+    {
+        hasClock = type == 0x0F || type == 0x10;
+        switch (type) {
+        case 0x00:
+        case 0x08:
+        case 0x09:
+            return BankController::None;
+        case 0x01:
+        case 0x02:
+        case 0x03:
+            return BankController::Mbc1;
+        case 0x0F:
+        case 0x10:
+        case 0x11:
+        case 0x12:
+        case 0x13:
+            return BankController::Mbc3;
+        case 0x19:
+        case 0x1A:
+        case 0x1B:
+        case 0x1C:
+        case 0x1D:
+        case 0x1E:
+            return BankController::Mbc5;
+        default:
+            return nullopt;
+        }
+    }
+
+    auto ram_size_for(uint8_t code) -> optional<uint32_t>
+    {
+        switch (code) {
+        case 0x00:
+            return 0;
+        case 0x01:
+            return 0x800;
+        case 0x02:
+            return 0x2000;
+        case 0x03:
+            return 0x8000;
+        case 0x04:
+            return 0x20000;
+        case 0x05:
+            return 0x10000;
+        default:
+            return nullopt;
+        }
+    }
+
+}
+
+auto Cartridge::parse_header(const RomImage& rom) -> optional<CartridgeHeader>
+{
+    const auto size = rom.size();
+    if (size < 2 * ROM_BANK_SIZE || size % ROM_BANK_SIZE || size < HEADER_END)
+        return nullopt;
+
+    const auto* bytes = rom.data();
+    CartridgeHeader header;
+    header.type = bytes[TYPE];
+    const auto controller = controller_for(header.type, header.hasClock);
+    const auto ramSize = ram_size_for(bytes[RAM_SIZE]);
+    if (!controller || !ramSize)
+        return nullopt;
+
+    header.controller = *controller;
+    header.ramSize = *ramSize;
+    header.romBanks = uint16_t(min<size_t>(size / ROM_BANK_SIZE, 0x200));
+
+    const auto* title = reinterpret_cast<const char*>(bytes + TITLE_START);
+    header.title.assign(title, find(title, title + TITLE_LENGTH, '\0'));
+    return header;
+}
+
+auto Cartridge::insert(Memory& memory, unique_ptr<RomImage> rom) -> unique_ptr<Cartridge>
+{
+    const auto header = parse_header(*rom);
+    if (!header)
+        return nullptr;
+
+    auto cartridge = unique_ptr<Cartridge>(new Cartridge(memory, move(rom), *header));
+    cartridge->update_mapping();
+    return cartridge;
+}
+
+Cartridge::Cartridge(Memory& memory, unique_ptr<RomImage> rom, CartridgeHeader header)
+    : m_memory(memory)
+    , m_rom(move(rom))
+    , m_header(move(header))
+    , m_ram(m_header.ramSize)
+    // Without a controller, RAM can't be disabled
+    , m_ramEnabled(m_header.controller == BankController::None)
+{
+}
+
+Cartridge::~Cartridge()
+{
+    m_memory.unmap(FIXED_ROM_PAGE, 2 * ROM_BANK_PAGES);
+    m_memory.unmap(RAM_PAGE, RAM_BANK_PAGES);
+    m_memory.set_rom_banks(0, 1);
+}
+
+auto Cartridge::header() const -> const CartridgeHeader&
+{
+    return m_header;
+}
+
+auto Cartridge::rom_bank() const -> uint16_t
+{
+    return m_switchableBank;
+}
+
+auto Cartridge::ram() -> vector<uint8_t>&
+{
+    return m_ram;
+}
+
+auto Cartridge::read8(uint16_t) -> uint8_t
+{
+    // ROM is always mapped directly, so this is external RAM with nothing behind it
+    if (m_ramEnabled && m_header.hasClock && m_secondaryRegister >= FIRST_CLOCK_REGISTER)
+        return m_latchedClock[m_secondaryRegister - FIRST_CLOCK_REGISTER];
+    return 0xFF;
+}
+
+auto Cartridge::write8(uint16_t address, uint8_t value) -> void
+{
+    if (address >= 0x8000) {
+        if (m_ramEnabled && m_header.hasClock && m_secondaryRegister >= FIRST_CLOCK_REGISTER)
+            m_clock[m_secondaryRegister - FIRST_CLOCK_REGISTER] = value;
+        return;
+    }
+
+    switch (m_header.controller) {
+    case BankController::None:
+        return;
+    case BankController::Mbc1:
+        if (address < 0x2000)
+            m_ramEnabled = (value & 0x0F) == 0x0A;
+        else if (address < 0x4000)
+            m_romBankRegister = max(value & 0x1F, 1);
+        else if (address < 0x6000)
+            m_secondaryRegister = value & 0x03;
+        else
+            m_advancedMode = value & 0x01;
+        break;
+    case BankController::Mbc3:
+        if (address < 0x2000) {
+            m_ramEnabled = (value & 0x0F) == 0x0A;
+        } else if (address < 0x4000) {
+            m_romBankRegister = max(value & 0x7F, 1);
+        } else if (address < 0x6000) {
+            if (value <= 0x03 || (m_header.hasClock && value >= FIRST_CLOCK_REGISTER && value <= LAST_CLOCK_REGISTER))
+                m_secondaryRegister = value;
+        } else {
+            // Writing 00 then 01 copies the clock into the registers the CPU can read
+            if (m_lastLatchWrite == 0x00 && value == 0x01)
+                m_latchedClock = m_clock;
+            m_lastLatchWrite = value;
+        }
+        break;
+    case BankController::Mbc5:
+        if (address < 0x2000)
+            m_ramEnabled = (value & 0x0F) == 0x0A;
+        else if (address < 0x3000)
+            m_romBankRegister = (m_romBankRegister & 0x100) | value;
+        else if (address < 0x4000)
+            m_romBankRegister = (m_romBankRegister & 0xFF) | ((value & 0x01) << 8);
+        else if (address < 0x6000)
+            m_secondaryRegister = value & 0x0F;
+        break;
+    }
+    update_mapping();
+}
+
+auto Cartridge::save_state(StateWriter& writer) const -> void
+{
+    writer.write_bytes(m_rom->data() + TITLE_START, IDENTITY_SIZE);
+    writer.write_bytes(m_ram.data(), m_ram.size());
+    writer.write(m_ramEnabled);
+    writer.write(m_romBankRegister);
+    writer.write(m_secondaryRegister);
+    writer.write(m_advancedMode);
+    writer.write(m_clock);
+    writer.write(m_latchedClock);
+    writer.write(m_lastLatchWrite);
+}
+
+auto Cartridge::state_matches(StateReader& reader) const -> bool
+{
+    const auto* identity = reader.view(IDENTITY_SIZE);
+    return identity && !memcmp(identity, m_rom->data() + TITLE_START, IDENTITY_SIZE);
+}
+
+auto Cartridge::load_state(StateReader& reader) -> void
+{
+    reader.view(IDENTITY_SIZE);
+    if (const auto* ram = reader.view(m_ram.size()))
+        copy(ram, ram + m_ram.size(), m_ram.begin());
+    reader.read(m_ramEnabled);
+    reader.read(m_romBankRegister);
+    reader.read(m_secondaryRegister);
+    reader.read(m_advancedMode);
+    reader.read(m_clock);
+    reader.read(m_latchedClock);
+    reader.read(m_lastLatchWrite);
+    update_mapping();
+    // Code may have been running from RAM
+    m_memory.report_changed(RAM_PAGE << 8, RAM_BANK_PAGES << 8);
+}
+
+auto Cartridge::update_mapping() -> void
+{
+    uint16_t fixedBank = 0;
+    uint16_t switchableBank = 1;
+    uint8_t ramBank = 0;
+    bool ramMapped = m_ramEnabled && !m_ram.empty();
+    switch (m_header.controller) {
+    case BankController::None:
+        break;
+    case BankController::Mbc1:
+        switchableBank = m_secondaryRegister << 5 | m_romBankRegister;
+        if (m_advancedMode) {
+            fixedBank = m_secondaryRegister << 5;
+            ramBank = m_secondaryRegister;
+        }
+        break;
+    case BankController::Mbc3:
+        switchableBank = m_romBankRegister;
+        ramMapped = ramMapped && m_secondaryRegister < FIRST_CLOCK_REGISTER;
+        ramBank = m_secondaryRegister;
+        break;
+    case BankController::Mbc5:
+        switchableBank = m_romBankRegister;
+        ramBank = m_secondaryRegister;
+        break;
+    }
+
+    // Banks past the end of the image wrap around, as the unconnected address lines would
+    m_fixedBank = fixedBank % m_header.romBanks;
+    m_switchableBank = switchableBank % m_header.romBanks;
+    const auto* rom = m_rom->data();
+    m_memory.map_rom(FIXED_ROM_PAGE, ROM_BANK_PAGES, rom + m_fixedBank * ROM_BANK_SIZE, this);
+    m_memory.map_rom(SWITCHABLE_ROM_PAGE, ROM_BANK_PAGES, rom + m_switchableBank * ROM_BANK_SIZE, this);
+    m_memory.set_rom_banks(m_fixedBank, m_switchableBank);
+
+    if (ramMapped) {
+        // A RAM smaller than a bank repeats across the window, its address lines left unused
+        const auto mirrorSize = min(m_ram.size(), RAM_BANK_SIZE);
+        auto* bank = &m_ram[ramBank * RAM_BANK_SIZE % m_ram.size()];
+        for (size_t offset = 0; offset < RAM_BANK_SIZE; offset += mirrorSize)
+            m_memory.map_ram(uint8_t(RAM_PAGE + (offset >> 8)), uint8_t(mirrorSize >> 8), bank);
+    } else {
+        m_memory.map_handler(RAM_PAGE, RAM_BANK_PAGES, this);
+    }
+}
+
+}
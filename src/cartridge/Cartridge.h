@@ -0,0 +1,101 @@
+#pragma once
+
+#include "cartridge/RomImage.h"
+#include "memory/IoHandler.h"
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace GameBoy {
+
+class Memory;
+class StateReader;
+class StateWriter;
+
+enum class BankController {
+    None,
+    Mbc1,
+    Mbc3,
+    Mbc5,
+};
+
+// What the header at 0100-014F says about a cartridge
+struct CartridgeHeader {
+    std::string title;
+    uint8_t type;
+    BankController controller;
+    bool hasClock;
+    // 16 KiB ROM banks actually present in the image
+    uint16_t romBanks;
+    // Bytes of external RAM
+    uint32_t ramSize;
+};
+
+// A cartridge plugged into memory. ROM is never copied: the 0000-3FFF and 4000-7FFF windows
+// point straight into the image, and a bank switch only points them elsewhere. External RAM
+// is mapped the same way while it is enabled. Everything else goes through the bank
+// controller's registers.
+class Cartridge : public IoHandler {
+public:
+    // Empty if the image is too short, isn't a whole number of banks or needs a bank
+    // controller that isn't supported
+    static auto parse_header(const RomImage&) -> std::optional<CartridgeHeader>;
+    // Maps the cartridge into memory, or returns null if its header can't be used. Memory
+    // goes back to plain RAM when the cartridge is destroyed.
+    static auto insert(Memory&, std::unique_ptr<RomImage>) -> std::unique_ptr<Cartridge>;
+
+    ~Cartridge() override;
+
+    Cartridge(const Cartridge&) = delete;
+    auto operator=(const Cartridge&) -> Cartridge& = delete;
+
+    auto header() const -> const CartridgeHeader&;
+    auto rom_bank() const -> uint16_t;
+    // Battery-backed saves read and write this
+    auto ram() -> std::vector<uint8_t>&;
+
+    // Controller registers, and external RAM while it is disabled or showing the clock
+    auto read8(uint16_t address) -> uint8_t override;
+    auto write8(uint16_t address, uint8_t value) -> void override;
+
+    // The controller's registers and external RAM, after the header they belong with
+    auto save_state(StateWriter&) const -> void;
+    // Whether a reader at the start of a chunk from save_state() has this cartridge's header
+    auto state_matches(StateReader&) const -> bool;
+    auto load_state(StateReader&) -> void;
+
+private:
+    Cartridge(Memory&, std::unique_ptr<RomImage>, CartridgeHeader);
+
+    // Points the ROM and RAM windows at the banks the registers select
+    auto update_mapping() -> void;
+
+    Memory& m_memory;
+    std::unique_ptr<RomImage> m_rom;
+    CartridgeHeader m_header;
+    std::vector<uint8_t> m_ram;
+
+    bool m_ramEnabled = false;
+    // ROM bank register, as written, but never 0 on MBC1 and MBC3
+    uint16_t m_romBankRegister = 1;
+    // MBC1: the upper ROM bank bits, or RAM bank in advanced mode. MBC3 and MBC5: RAM bank or,
+    // from 08 on, MBC3's clock register.
+    uint8_t m_secondaryRegister = 0;
+    // MBC1 only: banks the fixed window and RAM with the secondary register too
+    bool m_advancedMode = false;
+
+    uint16_t m_fixedBank = 0;
+    uint16_t m_switchableBank = 1;
+
+    // MBC3's clock registers: seconds, minutes, hours, day low, day high/flags. They hold
+    // whatever was written; the clock doesn't advance on its own.
+    std::array<uint8_t, 5> m_clock {};
+    std::array<uint8_t, 5> m_latchedClock {};
+    uint8_t m_lastLatchWrite = 0xFF;
+};
+
+}
@@ -0,0 +1,74 @@
+#include "cartridge/RomImage.h"
+
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GAMEBOY_HAS_MMAP 1
+#endif
+
+namespace GameBoy {
+
+using namespace std;
+
+auto RomImage::map_file(const string& path) -> unique_ptr<RomImage>
+{
+#ifdef GAMEBOY_HAS_MMAP
+    const auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat info;
+    void* mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+        mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps the file alive on its own
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return nullptr;
+
+    auto image = unique_ptr<RomImage>(new RomImage);
+    image->m_data = static_cast<const uint8_t*>(mapping);
+    image->m_size = info.st_size;
+    image->m_mapped = true;
+    return image;
+#else
+    ifstream file(path, ios::binary);
+    if (!file)
+        return nullptr;
+    return from_bytes(vector<uint8_t>(istreambuf_iterator<char>(file), istreambuf_iterator<char>()));
+#endif
+}
+
+auto RomImage::from_bytes(vector<uint8_t> bytes) -> unique_ptr<RomImage>
+{
+    auto image = unique_ptr<RomImage>(new RomImage);
+    image->m_bytes = move(bytes);
+    image->m_data = image->m_bytes.data();
+    image->m_size = image->m_bytes.size();
+    return image;
+}
+
+RomImage::~RomImage()
+{
+#ifdef GAMEBOY_HAS_MMAP
+    if (m_mapped)
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+}
+
+auto RomImage::data() const -> const uint8_t*
+{
+    return m_data;
+}
+
+auto RomImage::size() const -> size_t
+{
+    return m_size;
+}
+
+}
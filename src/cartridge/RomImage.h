@@ -0,0 +1,38 @@
+#pragma once
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace GameBoy {
+
+// The read-only bytes of a cartridge ROM. Files are mapped rather than read, so opening one
+// costs the same whatever its size, and every image of the same file shares its page cache.
+class RomImage {
+public:
+    // Null when the file can't be opened or mapped
+    static auto map_file(const std::string& path) -> std::unique_ptr<RomImage>;
+    // Keeps a copy of bytes, for images that don't come from a file
+    static auto from_bytes(std::vector<uint8_t> bytes) -> std::unique_ptr<RomImage>;
+
+    ~RomImage();
+
+    RomImage(const RomImage&) = delete;
+    auto operator=(const RomImage&) -> RomImage& = delete;
+
+    auto data() const -> const uint8_t*;
+    auto size() const -> size_t;
+
+private:
+    RomImage() = default;
+
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    // Set when m_data is a mapping of ours rather than m_bytes
+    bool m_mapped = false;
+    std::vector<uint8_t> m_bytes;
+};
+
+}
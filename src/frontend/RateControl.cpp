@@ -0,0 +1,31 @@
+#include "frontend/RateControl.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace GameBoy {
+
+using namespace std;
+
+// How much of each new reading goes into the smoothed depth
+constexpr double SMOOTHING = 0.125;
+
+RateControl::RateControl(uint32_t rate, size_t targetFrames, double maxDeviation)
+    : m_nominalRate(rate)
+    , m_target(double(targetFrames))
+    , m_maxDeviation(maxDeviation)
+    , m_queued(double(targetFrames))
+    , m_rate(rate)
+{
+}
+
+auto RateControl::update(size_t queuedFrames) -> uint32_t
+{
+    m_queued += SMOOTHING * (double(queuedFrames) - m_queued);
+    // -1 with the queue twice as deep as wanted or more, 1 with it empty
+    const auto error = clamp((m_target - m_queued) / m_target, -1.0, 1.0);
+    m_rate = uint32_t(lround(m_nominalRate * (1 + m_maxDeviation * error)));
+    return m_rate;
+}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace GameBoy {
+
+// Dynamic rate control for audio that a host plays out of a queue. The emulator and the host's
+// sound card keep slightly different time, so samples made at exactly the nominal rate would
+// slowly fill the queue, adding latency, or drain it into dropouts. Each update looks at how
+// full the queue is and asks for samples a little faster when it is short of the target and a
+// little slower when over, by at most maxDeviation, too little to hear as a change in pitch.
+class RateControl {
+public:
+    RateControl(uint32_t rate, size_t targetFrames, double maxDeviation = 0.005);
+
+    // From how many frames are queued now, the rate to make samples at until the next update
+    auto update(size_t queuedFrames) -> uint32_t;
+    auto rate() const -> uint32_t { return m_rate; }
+
+private:
+    uint32_t m_nominalRate;
+    double m_target;
+    double m_maxDeviation;
+    // The queue's depth smoothed over the last few updates, as the consumer takes frames in
+    // chunks
+    double m_queued;
+    uint32_t m_rate;
+};
+
+}
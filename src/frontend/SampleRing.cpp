@@ -0,0 +1,89 @@
+#include "frontend/SampleRing.h"
+
+#include <algorithm>
+
+namespace GameBoy {
+
+using namespace std;
+
+namespace {
+
+    auto power_of_two_at_least(size_t value) -> size_t
+    {
+        size_t power = 1;
+        while (power < value)
+            power *= 2;
+        return power;
+    }
+
+}
+
+SampleRing::SampleRing(size_t capacity)
+    : m_samples(2 * power_of_two_at_least(capacity))
+    , m_mask(m_samples.size() / 2 - 1)
+{
+}
+
+auto SampleRing::queued_frames() const -> size_t
+{
+    return m_written.load(memory_order_acquire) - m_read.load(memory_order_acquire);
+}
+
+auto SampleRing::write_region() -> Region
+{
+    const auto written = m_written.load(memory_order_relaxed);
+    const auto free = capacity() - (written - m_read.load(memory_order_acquire));
+    const auto start = written & m_mask;
+    return { &m_samples[2 * start], min(free, capacity() - start) };
+}
+
+auto SampleRing::commit_write(size_t frames) -> void
+{
+    m_written.store(m_written.load(memory_order_relaxed) + frames, memory_order_release);
+}
+
+auto SampleRing::write(const int16_t* samples, size_t frames) -> size_t
+{
+    size_t done = 0;
+    // At most twice, either side of the wrap
+    while (done < frames) {
+        const auto region = write_region();
+        const auto count = min(region.frames, frames - done);
+        if (!count)
+            break;
+        copy_n(samples + 2 * done, 2 * count, region.samples);
+        commit_write(count);
+        done += count;
+    }
+    return done;
+}
+
+auto SampleRing::read_region() -> Region
+{
+    const auto read = m_read.load(memory_order_relaxed);
+    const auto queued = m_written.load(memory_order_acquire) - read;
+    const auto start = read & m_mask;
+    return { &m_samples[2 * start], min(queued, capacity() - start) };
+}
+
+auto SampleRing::commit_read(size_t frames) -> void
+{
+    m_read.store(m_read.load(memory_order_relaxed) + frames, memory_order_release);
+}
+
+auto SampleRing::read(int16_t* samples, size_t frames) -> size_t
+{
+    size_t done = 0;
+    while (done < frames) {
+        const auto region = read_region();
+        const auto count = min(region.frames, frames - done);
+        if (!count)
+            break;
+        copy_n(region.samples, 2 * count, samples + 2 * done);
+        commit_read(count);
+        done += count;
+    }
+    return done;
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace GameBoy {
+
+// Stereo 16-bit frames passed from one producer thread to one consumer thread without locks.
+// Each side only moves its own index, publishing with a release store and reading the other's
+// with an acquire load. Either side can work in place on a region of the ring rather than
+// copying in or out: take a region, fill or use up some of it, then commit that much.
+class SampleRing {
+public:
+    // Contiguous frames, left then right, from where one side has got to
+    struct Region {
+        int16_t* samples;
+        size_t frames;
+    };
+
+    // Room for at least capacity frames, rounded up to a power of two
+    explicit SampleRing(size_t capacity);
+
+    SampleRing(const SampleRing&) = delete;
+    auto operator=(const SampleRing&) -> SampleRing& = delete;
+
+    auto capacity() const -> size_t { return m_mask + 1; }
+    // Either side can ask, though the answer may be out of date by the time it's used
+    auto queued_frames() const -> size_t;
+
+    // Producer: free space up to the end of the ring, then how much of it was filled
+    auto write_region() -> Region;
+    auto commit_write(size_t frames) -> void;
+    // Copies in as many of frames as fit, returning how many did
+    auto write(const int16_t* samples, size_t frames) -> size_t;
+
+    // Consumer: queued frames up to the end of the ring, then how many were used
+    auto read_region() -> Region;
+    auto commit_read(size_t frames) -> void;
+    // Copies out up to frames, returning how many there were
+    auto read(int16_t* samples, size_t frames) -> size_t;
+
+private:
+    std::vector<int16_t> m_samples;
+    size_t m_mask;
+    // Frames ever written and read; each only stored by its own side, and apart so that the
+    // two sides don't share a cache line
+    alignas(64) std::atomic<size_t> m_written { 0 };
+    alignas(64) std::atomic<size_t> m_read { 0 };
+};
+
+}
@@ -0,0 +1,28 @@
+#include "frontend/TripleBuffer.h"
+
+namespace GameBoy {
+
+using namespace std;
+
+TripleBuffer::TripleBuffer(size_t bytes)
+    : m_bytes(bytes)
+    , m_frames(3 * bytes)
+{
+}
+
+auto TripleBuffer::publish() -> uint8_t*
+{
+    // Release the frame drawn, acquire whatever the consumer last let go of
+    m_back = m_middle.exchange(m_back | FRESH, memory_order_acq_rel) & INDEX;
+    return back();
+}
+
+auto TripleBuffer::acquire() -> bool
+{
+    if (!(m_middle.load(memory_order_relaxed) & FRESH))
+        return false;
+    m_front = m_middle.exchange(m_front, memory_order_acq_rel) & INDEX;
+    return true;
+}
+
+}
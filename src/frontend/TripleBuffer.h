@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace GameBoy {
+
+// Three frames shared between a producer that draws them and a consumer that shows them,
+// without locks or copies. The producer always has a back buffer to draw into and the
+// consumer a front one to show; the third holds the newest finished frame, and each side
+// swaps its own buffer with it in a single atomic exchange. Neither ever waits, and the
+// consumer always gets the newest frame, skipping any it was too slow for.
+class TripleBuffer {
+public:
+    explicit TripleBuffer(size_t bytes);
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    auto operator=(const TripleBuffer&) -> TripleBuffer& = delete;
+
+    // Producer: where to draw the next frame
+    auto back() -> uint8_t* { return &m_frames[m_back * m_bytes]; }
+    // Hands the back buffer over as the newest frame, returning the next one to draw into
+    auto publish() -> uint8_t*;
+
+    // Consumer: moves on to the newest frame if there is a newer one, returning whether it did
+    auto acquire() -> bool;
+    // The frame being shown: all zeros until the first one arrives
+    auto front() const -> const uint8_t* { return &m_frames[m_front * m_bytes]; }
+
+private:
+    // Set alongside the middle buffer's index when it holds a frame the consumer hasn't seen
+    static constexpr uint8_t FRESH = 0x04;
+    static constexpr uint8_t INDEX = 0x03;
+
+    size_t m_bytes;
+    std::vector<uint8_t> m_frames;
+    uint8_t m_back = 0;
+    std::atomic<uint8_t> m_middle { 1 };
+    uint8_t m_front = 2;
+};
+
+}
@@ -1,5 +1,6 @@
 #include "instruction/AddByteInstruction.h"
 #include "CPU.h"
+#include "RegisterFile.h"
 #include "memory/FlagRegister.h"
 #include "util/FlagHelpers.h"
 
@@ -17,15 +18,14 @@ auto AddByteInstruction::perform_operation(CPU& cpu) -> void
 {
     using namespace FlagHelpers::Add;
 
-    auto fromValue = m_fromRef->read8();
-    auto toValue = m_toRef->read8();
-    auto flagRegister = cpu.get_flags();
-    auto res = fromValue + toValue;
+    const auto fromValue = m_fromRef->read8();
+    const auto toValue = m_toRef->read8();
+    const uint8_t res = fromValue + toValue;
 
-    flagRegister.set_zero(res == 0);
-    flagRegister.set_substract(false);
-    flagRegister.set_half_carry(should_half_carry(fromValue, toValue));
-    flagRegister.set_carry(should_carry(fromValue, toValue));
+    // Set outright: nothing on this path materialises deferred flags before F is read
+    cpu.get_flags().set((res == 0 ? Flags::ZERO : 0)
+        | (should_half_carry(fromValue, toValue) ? Flags::HALF_CARRY : 0)
+        | (should_carry(fromValue, toValue) ? Flags::CARRY : 0));
 
     m_toRef->write8(res);
 }
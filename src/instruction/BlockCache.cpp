@@ -0,0 +1,140 @@
+#include "instruction/BlockCache.h"
+
+#include "memory/Memory.h"
+
+#include <algorithm>
+
+namespace GameBoy {
+
+using namespace std;
+
+// Caps the amount of work a single block can do between interrupt checks
+constexpr size_t MAX_BLOCK_INSTRUCTIONS = 64;
+
+constexpr uint16_t SWITCHABLE_ROM_START = 0x4000;
+constexpr uint16_t SWITCHABLE_ROM_END = 0x8000;
+
+BlockCache::BlockCache(Memory& memory)
+    : m_memory(memory)
+    , m_blocksByPage(0x100)
+{
+    m_memory.set_write_watcher([this](uint16_t address) {
+        invalidate(address);
+    });
+}
+
+BlockCache::~BlockCache()
+{
+    // Leaves no watched pages behind, so the watcher won't be called again
+    clear();
+}
+
+auto BlockCache::lookup(uint16_t address) -> const DecodedBlock&
+{
+    m_retired.clear();
+
+    const auto key = key_for(address);
+    const auto found = m_blocks.find(key);
+    if (found != m_blocks.end()) {
+        ++m_stats.hits;
+        return *found->second;
+    }
+
+    ++m_stats.misses;
+    auto block = decode_block(address);
+    const auto firstPage = block->start >> 8;
+    const auto lastPage = uint16_t(block->end - 1) >> 8;
+    for (auto page = firstPage;; page = (page + 1) & 0xFF) {
+        m_blocksByPage[page].push_back(key);
+        m_memory.watch_page(page);
+        if (page == lastPage)
+            break;
+    }
+    return *(m_blocks[key] = move(block));
+}
+
+auto BlockCache::invalidate(uint16_t address) -> void
+{
+    // Copy, since retiring a block edits the page lists
+    const auto keys = m_blocksByPage[address >> 8];
+    for (const auto key : keys) {
+        const auto& block = *m_blocks.at(key);
+        const bool covered = block.start < block.end
+            ? address >= block.start && address < block.end
+            : address >= block.start || address < block.end;
+        if (covered) {
+            ++m_stats.invalidations;
+            retire(key);
+        }
+    }
+}
+
+auto BlockCache::clear() -> void
+{
+    while (!m_blocks.empty())
+        retire(m_blocks.begin()->first);
+}
+
+auto BlockCache::set_invalidation_listener(std::function<void(uint32_t)> listener) -> void
+{
+    m_invalidationListener = move(listener);
+}
+
+auto BlockCache::stats() const -> const Stats&
+{
+    return m_stats;
+}
+
+auto BlockCache::key_for(uint16_t address) const -> uint32_t
+{
+    // Only ROM needs the bank to tell blocks apart. The fixed window only changes banks in
+    // MBC1's advanced mode.
+    uint32_t bank = 0;
+    if (address < SWITCHABLE_ROM_START)
+        bank = m_memory.fixed_rom_bank();
+    else if (address < SWITCHABLE_ROM_END)
+        bank = m_memory.switchable_rom_bank();
+    return bank << 16 | address;
+}
+
+auto BlockCache::decode_block(uint16_t address) -> unique_ptr<DecodedBlock>
+{
+    auto block = make_unique<DecodedBlock>();
+    block->start = address;
+    block->bank = uint16_t(key_for(address) >> 16);
+
+    while (block->instructions.size() < MAX_BLOCK_INSTRUCTIONS) {
+        const auto instr = OpcodeTable::decode(m_memory, address);
+        block->instructions.push_back(instr);
+        address += instr.length;
+        if (instr.endsBlock)
+            break;
+    }
+    block->end = address;
+    return block;
+}
+
+auto BlockCache::retire(uint32_t key) -> void
+{
+    auto found = m_blocks.find(key);
+    auto block = move(found->second);
+    m_blocks.erase(found);
+
+    const auto firstPage = block->start >> 8;
+    const auto lastPage = uint16_t(block->end - 1) >> 8;
+    for (auto page = firstPage;; page = (page + 1) & 0xFF) {
+        auto& keys = m_blocksByPage[page];
+        keys.erase(find(keys.begin(), keys.end(), key));
+        m_memory.unwatch_page(page);
+        if (page == lastPage)
+            break;
+    }
+
+    block->valid = false;
+    m_retired.push_back(move(block));
+
+    if (m_invalidationListener)
+        m_invalidationListener(key);
+}
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "instruction/OpcodeTable.h"
+
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+namespace GameBoy {
+
+class Memory;
+
+// A straight run of instructions, decoded once, ending at the first instruction that may
+// transfer control elsewhere
+struct DecodedBlock {
+    uint16_t start;
+    // One past the last byte of the last instruction
+    uint16_t end;
+    uint16_t bank;
+    // Cleared when a write lands inside the block; whoever is executing it must stop
+    bool valid = true;
+    std::vector<DecodedInstruction> instructions;
+};
+
+// Caches decoded blocks by start address and ROM bank. Memory reports writes to the pages
+// a block covers so that self-modifying code and code copied into RAM is redecoded.
+class BlockCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t invalidations = 0;
+    };
+
+    BlockCache(Memory&);
+    ~BlockCache();
+
+    BlockCache(const BlockCache&) = delete;
+    auto operator=(const BlockCache&) -> BlockCache& = delete;
+
+    // Returns the block starting at address, decoding it on a miss. The reference stays valid
+    // until the next call to lookup(), even if the block is invalidated in the meantime.
+    auto lookup(uint16_t address) -> const DecodedBlock&;
+
+    auto invalidate(uint16_t address) -> void;
+    auto clear() -> void;
+
+    // Told the key of every block that gets dropped, so derived code can be dropped with it
+    auto set_invalidation_listener(std::function<void(uint32_t key)>) -> void;
+
+    // Start address and, inside the switchable ROM window, the bank it maps
+    auto key_for(uint16_t address) const -> uint32_t;
+
+    auto stats() const -> const Stats&;
+
+private:
+    auto decode_block(uint16_t address) -> std::unique_ptr<DecodedBlock>;
+    auto retire(uint32_t key) -> void;
+
+    Memory& m_memory;
+    std::unordered_map<uint32_t, std::unique_ptr<DecodedBlock>> m_blocks;
+    // Keys of the blocks covering each 256-byte page
+    std::vector<std::vector<uint32_t>> m_blocksByPage;
+    // Invalidated blocks kept alive until the next lookup, since one may still be executing
+    std::vector<std::unique_ptr<DecodedBlock>> m_retired;
+    std::function<void(uint32_t)> m_invalidationListener;
+    Stats m_stats;
+};
+
+}
@@ -0,0 +1,111 @@
+#include "instruction/IdleLoopDetector.h"
+
+#include "memory/Memory.h"
+
+namespace GameBoy::IdleLoopDetector {
+
+using namespace std;
+
+namespace {
+
+    constexpr uint8_t CB_PREFIX = 0xCB;
+    // The (HL) operand in the low three bits of LD r,r', the ALU ops and BIT
+    constexpr uint8_t HL_OPERAND = 0x06;
+
+    struct Step {
+        // 0 if the instruction can't be part of an idle loop
+        uint8_t length = 0;
+        // Where control goes next if the instruction branches
+        optional<uint16_t> target {};
+        bool conditional = false;
+        optional<uint16_t> read {};
+    };
+
+    auto relative_target(uint16_t address, uint8_t offset) -> uint16_t
+    {
+        return uint16_t(address + 2 + int8_t(offset));
+    }
+
+    auto decode(Memory& memory, uint16_t address) -> Step
+    {
+        const auto opcode = memory.read8(address);
+        const auto operand = memory.read8(address + 1);
+        auto& regs = memory.registers();
+
+        switch (opcode) {
+        case 0x00: // NOP
+            return { 1 };
+        case 0xF0: // LDH A,(n)
+            return { 2, nullopt, false, uint16_t(0xFF00 | operand) };
+        case 0xF2: // LDH A,(C)
+            return { 1, nullopt, false, uint16_t(0xFF00 | regs.c) };
+        case 0xFA: // LD A,(nn)
+            return { 3, nullopt, false, uint16_t(operand | memory.read8(address + 2) << 8) };
+        case 0xE6: // AND n
+        case 0xEE: // XOR n
+        case 0xF6: // OR n
+        case 0xFE: // CP n
+            return { 2 };
+        case 0x18: // JR e
+            return { 2, relative_target(address, operand) };
+        case 0x20: // JR cc,e
+        case 0x28:
+        case 0x30:
+        case 0x38:
+            return { 2, relative_target(address, operand), true };
+        case 0xC3: // JP nn
+            return { 3, uint16_t(operand | memory.read8(address + 2) << 8) };
+        case 0xC2: // JP cc,nn
+        case 0xCA:
+        case 0xD2:
+        case 0xDA:
+            return { 3, uint16_t(operand | memory.read8(address + 2) << 8), true };
+        case CB_PREFIX:
+            // BIT b,r
+            if (operand < 0x40 || operand >= 0x80)
+                return {};
+            if ((operand & 0x07) == HL_OPERAND)
+                return { 2, nullopt, false, regs.hl };
+            return { 2 };
+        default:
+            break;
+        }
+
+        // LD r,r' other than into (HL) and HALT, and AND, XOR, OR and CP r. ADD, ADC, SUB
+        // and SBC are left out, since a pass through them rarely leaves A as it was.
+        const bool load = opcode >= 0x40 && opcode < 0x80 && (opcode & 0xF8) != 0x70;
+        const bool logic = opcode >= 0xA0 && opcode < 0xC0;
+        if (!load && !logic)
+            return {};
+        if ((opcode & 0x07) == HL_OPERAND)
+            return { 1, nullopt, false, regs.hl };
+        return { 1 };
+    }
+
+}
+
+auto find(Memory& memory, uint16_t address) -> optional<IdleLoop>
+{
+    IdleLoop loop;
+    auto current = address;
+    while (loop.instructions < IdleLoop::MAX_INSTRUCTIONS) {
+        const auto step = decode(memory, current);
+        if (!step.length)
+            return nullopt;
+        ++loop.instructions;
+        if (step.read)
+            loop.reads[loop.numReads++] = *step.read;
+
+        // A branch forward is taken as the way out of the loop, and one backward as the way round
+        const uint16_t next = current + step.length;
+        if (step.target && (!step.conditional || *step.target <= current))
+            current = *step.target;
+        else
+            current = next;
+        if (current == address)
+            return loop;
+    }
+    return nullopt;
+}
+
+}
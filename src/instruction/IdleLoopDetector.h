@@ -0,0 +1,33 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <stdint.h>
+
+namespace GameBoy {
+
+class Memory;
+
+// A short loop that only reads memory and tests what it read, like a wait for LY to reach a
+// line or for a bit of IF to be set
+struct IdleLoop {
+    static constexpr uint8_t MAX_INSTRUCTIONS = 8;
+
+    // Instructions in one pass, starting from where the loop was found
+    uint8_t instructions = 0;
+    // Every address a pass reads
+    std::array<uint16_t, MAX_INSTRUCTIONS> reads {};
+    uint8_t numReads = 0;
+};
+
+namespace IdleLoopDetector {
+
+    // Follows the opcodes from address, taking backward branches and not forward ones, and
+    // returns the loop if they come back to address having done nothing but read memory
+    // into registers, compare and branch. Whether a pass really leaves everything as it was
+    // is for the caller to check by running one.
+    auto find(Memory&, uint16_t address) -> std::optional<IdleLoop>;
+
+}
+
+}
@@ -42,10 +42,7 @@ auto Instruction::move_program_counter(CPU& cpu) -> void
 
 auto Instruction::tick_clock(CPU& cpu) -> void
 {
-    auto cyclesTicked = 0;
-    while (cyclesTicked++ <= m_cycles) {
-        cpu.tick();
-    }
+    cpu.tick(m_cycles);
 }
 
 }
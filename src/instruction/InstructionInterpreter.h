@@ -1,14 +0,0 @@
-#pragma once
-
-#include <memory>
-
-namespace GameBoy {
-class Instruction;
-class Memory;
-}
-
-namespace GameBoy::InstructionInterpreter {
-
-auto interpret_next_intstruction(Memory&) -> std::unique_ptr<Instruction>;
-
-}
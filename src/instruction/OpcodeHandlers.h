@@ -0,0 +1,804 @@
+#pragma once
+
+#include "CPU.h"
+#include "RegisterFile.h"
+#include "instruction/OpcodeTable.h"
+#include "memory/FlagRegister.h"
+#include "memory/Memory.h"
+#include "util/FlagHelpers.h"
+
+#include <array>
+#include <utility>
+
+// Handlers and tables behind OpcodeTable. Only for cores that want to dispatch on a constant
+// opcode and have the handler inlined; everything else should go through OpcodeTable.
+namespace GameBoy::OpcodeHandlers {
+
+// Operand encodings shared by most of the instruction set:
+//   r8:  B, C, D, E, H, L, (HL), A
+//   r16: BC, DE, HL, SP (AF in place of SP for PUSH/POP)
+//   cc:  NZ, Z, NC, C
+// Handlers for the regular groups are templates over these fields, so every opcode gets its
+// own instance with nothing left to decode at run time.
+constexpr uint8_t INDIRECT_HL = 6;
+
+template <uint8_t Index>
+inline auto r8(RegisterFile& regs) -> uint8_t&
+{
+    static_assert(Index < 8 && Index != INDIRECT_HL, "(HL) is memory, not a register");
+    if constexpr (Index == 0)
+        return regs.b;
+    else if constexpr (Index == 1)
+        return regs.c;
+    else if constexpr (Index == 2)
+        return regs.d;
+    else if constexpr (Index == 3)
+        return regs.e;
+    else if constexpr (Index == 4)
+        return regs.h;
+    else if constexpr (Index == 5)
+        return regs.l;
+    else
+        return regs.a;
+}
+
+// Bus accesses, Offset cycles into the instruction: devices such as the timer see the M-cycle
+// the hardware makes the access on, not the one the instruction started on
+template <uint8_t Offset>
+inline auto bus_read8(CPU& cpu, uint16_t address) -> uint8_t
+{
+    cpu.set_access_offset(Offset);
+    const auto value = cpu.memory.read8(address);
+    cpu.set_access_offset(0);
+    return value;
+}
+
+template <uint8_t Offset>
+inline auto bus_write8(CPU& cpu, uint16_t address, uint8_t value) -> void
+{
+    cpu.set_access_offset(Offset);
+    cpu.memory.write8(address, value);
+    cpu.set_access_offset(0);
+}
+
+// Both bytes of a 16-bit access are stamped with the first one's cycle; nothing that cares
+// where the second lands is ever reached a word at a time
+template <uint8_t Offset>
+inline auto bus_read16(CPU& cpu, uint16_t address) -> uint16_t
+{
+    cpu.set_access_offset(Offset);
+    const auto value = cpu.memory.read16(address);
+    cpu.set_access_offset(0);
+    return value;
+}
+
+template <uint8_t Offset>
+inline auto bus_write16(CPU& cpu, uint16_t address, uint16_t value) -> void
+{
+    cpu.set_access_offset(Offset);
+    cpu.memory.write16(address, value);
+    cpu.set_access_offset(0);
+}
+
+// Offset only matters for (HL): where in the instruction the access to it lands
+template <uint8_t Index, uint8_t Offset>
+inline auto read_r8(CPU& cpu) -> uint8_t
+{
+    if constexpr (Index == INDIRECT_HL)
+        return bus_read8<Offset>(cpu, cpu.registers().hl);
+    else
+        return r8<Index>(cpu.registers());
+}
+
+template <uint8_t Index, uint8_t Offset>
+inline auto write_r8(CPU& cpu, uint8_t value) -> void
+{
+    if constexpr (Index == INDIRECT_HL)
+        bus_write8<Offset>(cpu, cpu.registers().hl, value);
+    else
+        r8<Index>(cpu.registers()) = value;
+}
+
+template <uint8_t Index>
+inline auto r16(RegisterFile& regs) -> uint16_t&
+{
+    static_assert(Index < 4, "r16 is a two-bit field");
+    if constexpr (Index == 0)
+        return regs.bc;
+    else if constexpr (Index == 1)
+        return regs.de;
+    else if constexpr (Index == 2)
+        return regs.hl;
+    else
+        return regs.sp;
+}
+
+template <uint8_t Index>
+inline auto r16_stack(RegisterFile& regs) -> uint16_t&
+{
+    if constexpr (Index == 3)
+        return regs.af;
+    else
+        return r16<Index>(regs);
+}
+
+template <uint8_t Index>
+inline auto condition(const FlagRegister& flags) -> bool
+{
+    static_assert(Index < 4, "cc is a two-bit field");
+    if constexpr (Index == 0)
+        return !flags.zero();
+    else if constexpr (Index == 1)
+        return flags.zero();
+    else if constexpr (Index == 2)
+        return !flags.carry();
+    else
+        return flags.carry();
+}
+
+// For instructions whose flags aren't worth deferring
+inline auto set_flags(FlagRegister& flags, bool zero, bool subtract, bool halfCarry, bool carry) -> void
+{
+    flags.set((zero ? Flags::ZERO : 0)
+        | (subtract ? Flags::SUBTRACT : 0)
+        | (halfCarry ? Flags::HALF_CARRY : 0)
+        | (carry ? Flags::CARRY : 0));
+}
+
+template <uint8_t Offset>
+inline auto push(CPU& cpu, uint16_t value) -> void
+{
+    auto& regs = cpu.registers();
+    regs.sp -= 2;
+    bus_write16<Offset>(cpu, regs.sp, value);
+}
+
+template <uint8_t Offset>
+inline auto pop(CPU& cpu) -> uint16_t
+{
+    auto& regs = cpu.registers();
+    const auto value = bus_read16<Offset>(cpu, regs.sp);
+    regs.sp += 2;
+    return value;
+}
+
+// Operation field (bits 3-5) of the ALU A,r / ALU A,n groups. These defer their flags: most are
+// overwritten before anything reads them.
+template <uint8_t Operation>
+inline auto alu(CPU& cpu, uint8_t value) -> void
+{
+    auto& regs = cpu.registers();
+    auto& flags = cpu.flags();
+    const auto a = regs.a;
+    if constexpr (Operation == 0 || Operation == 1) { // ADD, ADC
+        uint16_t sum = a + value;
+        if constexpr (Operation == 1)
+            sum += flags.carry();
+        regs.a = uint8_t(sum);
+        flags.defer_add(a, value, sum);
+    } else if constexpr (Operation == 2 || Operation == 3 || Operation == 7) { // SUB, SBC, CP
+        uint16_t difference = a - value;
+        if constexpr (Operation == 3)
+            difference -= flags.carry();
+        if constexpr (Operation != 7)
+            regs.a = uint8_t(difference);
+        flags.defer_subtract(a, value, difference);
+    } else if constexpr (Operation == 4) { // AND
+        regs.a = a & value;
+        flags.defer_logic(regs.a, true);
+    } else if constexpr (Operation == 5) { // XOR
+        regs.a = a ^ value;
+        flags.defer_logic(regs.a, false);
+    } else { // OR
+        regs.a = a | value;
+        flags.defer_logic(regs.a, false);
+    }
+}
+
+// Operation field (bits 3-5) of the CB-prefixed rotate/shift group
+template <uint8_t Operation>
+inline auto rotate(FlagRegister& flags, uint8_t value) -> uint8_t
+{
+    const auto res = FlagHelpers::Alu::rotate(Operation, value, flags.carry());
+    flags.set(res.flags);
+    return res.value;
+}
+
+inline auto add_sp_offset(CPU& cpu, uint8_t offset) -> uint16_t
+{
+    const auto sp = cpu.registers().sp;
+    set_flags(cpu.flags(), false, false, (sp & 0x0F) + (offset & 0x0F) > 0x0F, (sp & 0xFF) + offset > 0xFF);
+    return sp + int8_t(offset);
+}
+
+//
+// Handlers
+//
+
+inline auto nop(CPU&, const DecodedInstruction& instr) -> uint8_t
+{
+    return instr.cycles;
+}
+
+inline auto illegal(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    cpu.set_state(CPU::State::Locked);
+    return instr.cycles;
+}
+
+template <uint8_t Dst, uint8_t Src>
+inline auto ld_r_r(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    if constexpr (Dst != Src)
+        write_r8<Dst, 4>(cpu, read_r8<Src, 4>(cpu));
+    return instr.cycles;
+}
+
+template <uint8_t Dst>
+inline auto ld_r_n(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    write_r8<Dst, 8>(cpu, uint8_t(instr.operand));
+    return instr.cycles;
+}
+
+template <uint8_t Dst>
+inline auto ld_rr_nn(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    r16<Dst>(cpu.registers()) = instr.operand;
+    return instr.cycles;
+}
+
+// Address used by LD (BC),A / LD (DE),A / LD (HL+),A / LD (HL-),A and their loads into A
+template <uint8_t Index>
+inline auto indirect_address(RegisterFile& regs) -> uint16_t
+{
+    if constexpr (Index == 0)
+        return regs.bc;
+    else if constexpr (Index == 1)
+        return regs.de;
+    else if constexpr (Index == 2)
+        return regs.hl++;
+    else
+        return regs.hl--;
+}
+
+template <uint8_t Index>
+inline auto ld_indirect_a(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& regs = cpu.registers();
+    bus_write8<4>(cpu, indirect_address<Index>(regs), regs.a);
+    return instr.cycles;
+}
+
+template <uint8_t Index>
+inline auto ld_a_indirect(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& regs = cpu.registers();
+    regs.a = bus_read8<4>(cpu, indirect_address<Index>(regs));
+    return instr.cycles;
+}
+
+inline auto ld_nn_sp(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    bus_write16<12>(cpu, instr.operand, cpu.registers().sp);
+    return instr.cycles;
+}
+
+inline auto ld_nn_a(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    bus_write8<12>(cpu, instr.operand, cpu.registers().a);
+    return instr.cycles;
+}
+
+inline auto ld_a_nn(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    cpu.registers().a = bus_read8<12>(cpu, instr.operand);
+    return instr.cycles;
+}
+
+inline auto ldh_n_a(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    bus_write8<8>(cpu, 0xFF00 + instr.operand, cpu.registers().a);
+    return instr.cycles;
+}
+
+inline auto ldh_a_n(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    cpu.registers().a = bus_read8<8>(cpu, 0xFF00 + instr.operand);
+    return instr.cycles;
+}
+
+inline auto ldh_c_a(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& regs = cpu.registers();
+    bus_write8<4>(cpu, 0xFF00 + regs.c, regs.a);
+    return instr.cycles;
+}
+
+inline auto ldh_a_c(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& regs = cpu.registers();
+    regs.a = bus_read8<4>(cpu, 0xFF00 + regs.c);
+    return instr.cycles;
+}
+
+inline auto ld_sp_hl(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& regs = cpu.registers();
+    regs.sp = regs.hl;
+    return instr.cycles;
+}
+
+inline auto ld_hl_sp_e(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& regs = cpu.registers();
+    regs.hl = add_sp_offset(cpu, uint8_t(instr.operand));
+    return instr.cycles;
+}
+
+inline auto add_sp_e(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& regs = cpu.registers();
+    regs.sp = add_sp_offset(cpu, uint8_t(instr.operand));
+    return instr.cycles;
+}
+
+template <uint8_t Src>
+inline auto push_rr(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    if constexpr (Src == 3)
+        cpu.flags().materialise();
+    push<8>(cpu, r16_stack<Src>(cpu.registers()));
+    return instr.cycles;
+}
+
+template <uint8_t Dst>
+inline auto pop_rr(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& regs = cpu.registers();
+    r16_stack<Dst>(regs) = pop<4>(cpu);
+    // The lower nibble of F doesn't exist in hardware
+    if constexpr (Dst == 3)
+        cpu.flags().set(regs.f & 0xF0);
+    return instr.cycles;
+}
+
+template <uint8_t Index>
+inline auto inc_r(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    const auto value = read_r8<Index, 4>(cpu);
+    const uint8_t res = value + 1;
+    write_r8<Index, 8>(cpu, res);
+    cpu.flags().defer_increment(value, res);
+    return instr.cycles;
+}
+
+template <uint8_t Index>
+inline auto dec_r(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    const auto value = read_r8<Index, 4>(cpu);
+    const uint8_t res = value - 1;
+    write_r8<Index, 8>(cpu, res);
+    cpu.flags().defer_decrement(value, res);
+    return instr.cycles;
+}
+
+template <uint8_t Index>
+inline auto inc_rr(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    ++r16<Index>(cpu.registers());
+    return instr.cycles;
+}
+
+template <uint8_t Index>
+inline auto dec_rr(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    --r16<Index>(cpu.registers());
+    return instr.cycles;
+}
+
+template <uint8_t Src>
+inline auto add_hl_rr(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& regs = cpu.registers();
+    const auto hl = regs.hl;
+    const auto value = r16<Src>(regs);
+    const auto sum = uint32_t(hl) + value;
+    regs.hl = uint16_t(sum);
+    auto& flags = cpu.flags();
+    set_flags(flags, flags.zero(), false, (hl & 0x0FFF) + (value & 0x0FFF) > 0x0FFF, sum > 0xFFFF);
+    return instr.cycles;
+}
+
+template <uint8_t Operation, uint8_t Src>
+inline auto alu_r(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    alu<Operation>(cpu, read_r8<Src, 4>(cpu));
+    return instr.cycles;
+}
+
+template <uint8_t Operation>
+inline auto alu_n(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    alu<Operation>(cpu, uint8_t(instr.operand));
+    return instr.cycles;
+}
+
+// RLCA, RRCA, RLA, RRA: the CB rotates on A, but Z is always cleared
+template <uint8_t Operation>
+inline auto rotate_a(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& regs = cpu.registers();
+    auto& flags = cpu.flags();
+    regs.a = rotate<Operation>(flags, regs.a);
+    flags.set(flags.value() & ~Flags::ZERO);
+    return instr.cycles;
+}
+
+inline auto daa(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& regs = cpu.registers();
+    auto& flags = cpu.flags();
+    const auto res = FlagHelpers::Alu::decimal_adjust(regs.a, flags.value());
+    regs.a = res.value;
+    flags.set(res.flags);
+    return instr.cycles;
+}
+
+inline auto cpl(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& regs = cpu.registers();
+    auto& flags = cpu.flags();
+    regs.a = ~regs.a;
+    flags.set(flags.value() | Flags::SUBTRACT | Flags::HALF_CARRY);
+    return instr.cycles;
+}
+
+inline auto scf(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& flags = cpu.flags();
+    set_flags(flags, flags.zero(), false, false, true);
+    return instr.cycles;
+}
+
+inline auto ccf(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& flags = cpu.flags();
+    set_flags(flags, flags.zero(), false, false, !flags.carry());
+    return instr.cycles;
+}
+
+inline auto jp(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    cpu.registers().pc = instr.operand;
+    return instr.cycles;
+}
+
+inline auto jp_hl(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& regs = cpu.registers();
+    regs.pc = regs.hl;
+    return instr.cycles;
+}
+
+template <uint8_t Condition>
+inline auto jp_cc(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& regs = cpu.registers();
+    if (!condition<Condition>(cpu.flags()))
+        return instr.cycles;
+    regs.pc = instr.operand;
+    return instr.cycles + 4;
+}
+
+inline auto jr(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    cpu.registers().pc += int8_t(instr.operand);
+    return instr.cycles;
+}
+
+template <uint8_t Condition>
+inline auto jr_cc(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& regs = cpu.registers();
+    if (!condition<Condition>(cpu.flags()))
+        return instr.cycles;
+    regs.pc += int8_t(instr.operand);
+    return instr.cycles + 4;
+}
+
+inline auto call(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    push<16>(cpu, cpu.registers().pc);
+    cpu.registers().pc = instr.operand;
+    return instr.cycles;
+}
+
+template <uint8_t Condition>
+inline auto call_cc(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    if (!condition<Condition>(cpu.flags()))
+        return instr.cycles;
+    push<16>(cpu, cpu.registers().pc);
+    cpu.registers().pc = instr.operand;
+    return instr.cycles + 12;
+}
+
+inline auto ret(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    cpu.registers().pc = pop<4>(cpu);
+    return instr.cycles;
+}
+
+template <uint8_t Condition>
+inline auto ret_cc(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    if (!condition<Condition>(cpu.flags()))
+        return instr.cycles;
+    cpu.registers().pc = pop<8>(cpu);
+    return instr.cycles + 12;
+}
+
+inline auto reti(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    cpu.registers().pc = pop<4>(cpu);
+    cpu.set_interrupts_enabled(true);
+    return instr.cycles;
+}
+
+template <uint8_t Vector>
+inline auto rst(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    push<8>(cpu, cpu.registers().pc);
+    cpu.registers().pc = Vector;
+    return instr.cycles;
+}
+
+inline auto halt(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    // Something already pending would wake it straight away
+    if (!cpu.interrupts().pending())
+        cpu.set_state(CPU::State::Halted);
+    return instr.cycles;
+}
+
+inline auto stop(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    cpu.set_state(CPU::State::Stopped);
+    return instr.cycles;
+}
+
+inline auto di(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    cpu.set_interrupts_enabled(false);
+    return instr.cycles;
+}
+
+inline auto ei(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    cpu.enable_interrupts_after_next();
+    return instr.cycles;
+}
+
+//
+// CB-prefixed handlers
+//
+
+template <uint8_t Operation, uint8_t Index>
+inline auto cb_rotate(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    write_r8<Index, 12>(cpu, rotate<Operation>(cpu.flags(), read_r8<Index, 8>(cpu)));
+    return instr.cycles;
+}
+
+template <uint8_t Bit, uint8_t Index>
+inline auto cb_bit(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    auto& flags = cpu.flags();
+    const bool bitSet = read_r8<Index, 8>(cpu) & (1 << Bit);
+    set_flags(flags, !bitSet, false, true, flags.carry());
+    return instr.cycles;
+}
+
+template <uint8_t Bit, uint8_t Index>
+inline auto cb_res(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    write_r8<Index, 12>(cpu, read_r8<Index, 8>(cpu) & ~(1 << Bit));
+    return instr.cycles;
+}
+
+template <uint8_t Bit, uint8_t Index>
+inline auto cb_set(CPU& cpu, const DecodedInstruction& instr) -> uint8_t
+{
+    write_r8<Index, 12>(cpu, read_r8<Index, 8>(cpu) | (1 << Bit));
+    return instr.cycles;
+}
+
+//
+// Tables
+//
+
+// The instance of the group handler for an opcode of one of the regular groups, nullptr for
+// anything else. Fields: x = bits 6-7, y = bits 3-5, z = bits 0-2, p = bits 4-5.
+template <uint8_t Opcode>
+constexpr auto group_handler() -> OpcodeHandler
+{
+    constexpr uint8_t x = Opcode >> 6;
+    constexpr uint8_t y = (Opcode >> 3) & 7;
+    constexpr uint8_t z = Opcode & 7;
+    constexpr uint8_t p = y >> 1;
+    constexpr bool q = y & 1;
+
+    if constexpr (Opcode == 0x76) // HALT sits where LD (HL),(HL) would be
+        return nullptr;
+    else if constexpr (x == 1)
+        return ld_r_r<y, z>;
+    else if constexpr (x == 2)
+        return alu_r<y, z>;
+    else if constexpr (x == 0 && z == 1)
+        return q ? add_hl_rr<p> : ld_rr_nn<p>;
+    else if constexpr (x == 0 && z == 2)
+        return q ? ld_a_indirect<p> : ld_indirect_a<p>;
+    else if constexpr (x == 0 && z == 3)
+        return q ? dec_rr<p> : inc_rr<p>;
+    else if constexpr (x == 0 && z == 4)
+        return inc_r<y>;
+    else if constexpr (x == 0 && z == 5)
+        return dec_r<y>;
+    else if constexpr (x == 0 && z == 6)
+        return ld_r_n<y>;
+    else if constexpr (x == 0 && z == 7 && y < 4)
+        return rotate_a<y>;
+    else if constexpr (x == 0 && z == 0 && y >= 4)
+        return jr_cc<y - 4>;
+    else if constexpr (x == 3 && z == 0 && y < 4)
+        return ret_cc<y>;
+    else if constexpr (x == 3 && z == 1 && !q)
+        return pop_rr<p>;
+    else if constexpr (x == 3 && z == 2 && y < 4)
+        return jp_cc<y>;
+    else if constexpr (x == 3 && z == 4 && y < 4)
+        return call_cc<y>;
+    else if constexpr (x == 3 && z == 5 && !q)
+        return push_rr<p>;
+    else if constexpr (x == 3 && z == 6)
+        return alu_n<y>;
+    else if constexpr (x == 3 && z == 7)
+        return rst<y * 8>;
+    else
+        return nullptr;
+}
+
+template <uint8_t Opcode>
+constexpr auto prefixed_group_handler() -> OpcodeHandler
+{
+    constexpr uint8_t x = Opcode >> 6;
+    constexpr uint8_t y = (Opcode >> 3) & 7;
+    constexpr uint8_t z = Opcode & 7;
+
+    if constexpr (x == 0)
+        return cb_rotate<y, z>;
+    else if constexpr (x == 1)
+        return cb_bit<y, z>;
+    else if constexpr (x == 2)
+        return cb_res<y, z>;
+    else
+        return cb_set<y, z>;
+}
+
+template <size_t... Opcode>
+constexpr auto group_handlers(std::index_sequence<Opcode...>) -> std::array<OpcodeHandler, 256>
+{
+    return { group_handler<Opcode>()... };
+}
+
+template <size_t... Opcode>
+constexpr auto prefixed_group_handlers(std::index_sequence<Opcode...>) -> std::array<OpcodeHandler, 256>
+{
+    return { prefixed_group_handler<Opcode>()... };
+}
+
+constexpr auto build_table() -> std::array<OpcodeInfo, 256>
+{
+    constexpr auto groups = group_handlers(std::make_index_sequence<256>());
+
+    std::array<OpcodeInfo, 256> table {};
+    for (auto& entry : table)
+        entry = { illegal, 1, 4, true };
+
+    const auto group = [&](uint8_t opcode, uint8_t length, uint8_t cycles, bool endsBlock = false) {
+        table[opcode] = { groups[opcode], length, cycles, endsBlock };
+    };
+
+    table[0x00] = { nop, 1, 4 };
+    table[0x08] = { ld_nn_sp, 3, 20 };
+    table[0x10] = { stop, 2, 4, true };
+    table[0x18] = { jr, 2, 12, true };
+    table[0x27] = { daa, 1, 4 };
+    table[0x2F] = { cpl, 1, 4 };
+    table[0x37] = { scf, 1, 4 };
+    table[0x3F] = { ccf, 1, 4 };
+
+    for (uint8_t rr = 0; rr < 4; ++rr) {
+        const uint8_t row = rr << 4;
+        group(row | 0x01, 3, 12); // LD rr,nn
+        group(row | 0x02, 1, 8); // LD (rr),A
+        group(row | 0x03, 1, 8); // INC rr
+        group(row | 0x09, 1, 8); // ADD HL,rr
+        group(row | 0x0A, 1, 8); // LD A,(rr)
+        group(row | 0x0B, 1, 8); // DEC rr
+        group(0xC1 | row, 1, 12); // POP rr
+        group(0xC5 | row, 1, 16); // PUSH rr
+    }
+
+    for (uint8_t r = 0; r < 8; ++r) {
+        const bool indirect = r == INDIRECT_HL;
+        const uint8_t column = r << 3;
+        group(column | 0x04, 1, indirect ? 12 : 4); // INC r
+        group(column | 0x05, 1, indirect ? 12 : 4); // DEC r
+        group(column | 0x06, 2, indirect ? 12 : 8); // LD r,n
+        group(0xC6 | column, 2, 8); // ALU A,n
+        group(0xC7 | column, 1, 16, true); // RST
+    }
+
+    for (uint8_t op = 0; op < 4; ++op)
+        group(0x07 | op << 3, 1, 4); // RLCA, RRCA, RLA, RRA
+
+    for (uint8_t cc = 0; cc < 4; ++cc) {
+        const uint8_t column = cc << 3;
+        group(0x20 | column, 2, 8, true); // JR cc,e
+        group(0xC0 | column, 1, 8, true); // RET cc
+        group(0xC2 | column, 3, 12, true); // JP cc,nn
+        group(0xC4 | column, 3, 12, true); // CALL cc,nn
+    }
+
+    for (uint8_t dst = 0; dst < 8; ++dst) {
+        for (uint8_t src = 0; src < 8; ++src) {
+            const bool indirect = dst == INDIRECT_HL || src == INDIRECT_HL;
+            group(0x40 | dst << 3 | src, 1, indirect ? 8 : 4); // LD r,r'
+            group(0x80 | dst << 3 | src, 1, src == INDIRECT_HL ? 8 : 4); // ALU A,r
+        }
+    }
+    table[0x76] = { halt, 1, 4, true };
+
+    table[0xC3] = { jp, 3, 16, true };
+    table[0xC9] = { ret, 1, 16, true };
+    table[0xCD] = { call, 3, 24, true };
+    table[0xD9] = { reti, 1, 16, true };
+    table[0xE0] = { ldh_n_a, 2, 12 };
+    table[0xE2] = { ldh_c_a, 1, 8 };
+    table[0xE8] = { add_sp_e, 2, 16 };
+    table[0xE9] = { jp_hl, 1, 4, true };
+    table[0xEA] = { ld_nn_a, 3, 16 };
+    table[0xF0] = { ldh_a_n, 2, 12 };
+    table[0xF2] = { ldh_a_c, 1, 8 };
+    table[0xF3] = { di, 1, 4 };
+    table[0xF8] = { ld_hl_sp_e, 2, 12 };
+    table[0xF9] = { ld_sp_hl, 1, 8 };
+    table[0xFA] = { ld_a_nn, 3, 16 };
+    table[0xFB] = { ei, 1, 4, true };
+
+    // Decoding follows the prefix straight into the CB table, so this entry only records the length
+    table[0xCB] = { illegal, 2, 4, true };
+
+    return table;
+}
+
+constexpr auto build_prefixed_table() -> std::array<OpcodeInfo, 256>
+{
+    constexpr auto groups = prefixed_group_handlers(std::make_index_sequence<256>());
+
+    std::array<OpcodeInfo, 256> table {};
+    for (uint16_t opcode = 0; opcode < 0x100; ++opcode) {
+        const bool indirect = (opcode & 7) == INDIRECT_HL;
+        // BIT only reads (HL); the rest read it and write it back
+        const bool readOnly = (opcode >> 6) == 1;
+        table[opcode] = { groups[opcode], 2, uint8_t(!indirect ? 8 : readOnly ? 12 : 16) };
+    }
+    return table;
+}
+
+inline constexpr auto TABLE = build_table();
+inline constexpr auto PREFIXED_TABLE = build_prefixed_table();
+
+}
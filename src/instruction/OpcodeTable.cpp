@@ -0,0 +1,39 @@
+#include "instruction/OpcodeTable.h"
+
+#include "instruction/OpcodeHandlers.h"
+#include "memory/Memory.h"
+
+namespace GameBoy::OpcodeTable {
+
+using OpcodeHandlers::PREFIXED_TABLE;
+using OpcodeHandlers::TABLE;
+
+auto lookup(uint8_t opcode) -> const OpcodeInfo&
+{
+    return TABLE[opcode];
+}
+
+auto lookup_prefixed(uint8_t opcode) -> const OpcodeInfo&
+{
+    return PREFIXED_TABLE[opcode];
+}
+
+auto decode(Memory& memory, uint16_t address) -> DecodedInstruction
+{
+    const auto opcode = memory.read8(address);
+    if (opcode == 0xCB) {
+        const auto prefixedOpcode = memory.read8(address + 1);
+        const auto& info = PREFIXED_TABLE[prefixedOpcode];
+        return { info.handler, 0, prefixedOpcode, info.length, info.cycles, info.endsBlock, true };
+    }
+
+    const auto& info = TABLE[opcode];
+    uint16_t operand = 0;
+    if (info.length == 2)
+        operand = memory.read8(address + 1);
+    else if (info.length == 3)
+        operand = memory.read16(address + 1);
+    return { info.handler, operand, opcode, info.length, info.cycles, info.endsBlock, false };
+}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace GameBoy {
+
+class CPU;
+class Memory;
+struct DecodedInstruction;
+
+// Executes a decoded instruction. PC has already been moved past the instruction
+// when the handler runs. Returns the number of cycles taken.
+using OpcodeHandler = auto (*)(CPU&, const DecodedInstruction&) -> uint8_t;
+
+// Static description of an opcode: how to execute it, how long it is and
+// how many cycles it takes (when a branch isn't taken)
+struct OpcodeInfo {
+    OpcodeHandler handler;
+    uint8_t length;
+    uint8_t cycles;
+    // Control may not continue to the next instruction (jumps, calls, HALT, EI...)
+    bool endsBlock = false;
+};
+
+// An instruction with its operand bytes already fetched. For CB-prefixed
+// instructions, opcode holds the byte following the prefix.
+struct DecodedInstruction {
+    OpcodeHandler handler;
+    uint16_t operand;
+    uint8_t opcode;
+    uint8_t length;
+    uint8_t cycles;
+    bool endsBlock;
+    bool prefixed;
+};
+
+}
+
+namespace GameBoy::OpcodeTable {
+
+auto lookup(uint8_t opcode) -> const OpcodeInfo&;
+auto lookup_prefixed(uint8_t opcode) -> const OpcodeInfo&;
+
+// Reads the instruction starting at address and resolves its handler and operand
+auto decode(Memory&, uint16_t address) -> DecodedInstruction;
+
+}
@@ -0,0 +1,149 @@
+#include "instruction/ThreadedInterpreter.h"
+
+#include "CPU.h"
+#include "RegisterFile.h"
+#include "instruction/OpcodeHandlers.h"
+#include "memory/Memory.h"
+
+#if defined(__GNUC__)
+#define GAMEBOY_COMPUTED_GOTO 1
+#define GAMEBOY_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define GAMEBOY_ALWAYS_INLINE inline
+#endif
+
+// Expands X(00) through X(FF), once per opcode
+#define GAMEBOY_OPCODE_ROW(X, high) \
+    X(high##0) X(high##1) X(high##2) X(high##3) X(high##4) X(high##5) X(high##6) X(high##7) \
+    X(high##8) X(high##9) X(high##A) X(high##B) X(high##C) X(high##D) X(high##E) X(high##F)
+#define GAMEBOY_OPCODES(X) \
+    GAMEBOY_OPCODE_ROW(X, 0) GAMEBOY_OPCODE_ROW(X, 1) GAMEBOY_OPCODE_ROW(X, 2) GAMEBOY_OPCODE_ROW(X, 3) \
+    GAMEBOY_OPCODE_ROW(X, 4) GAMEBOY_OPCODE_ROW(X, 5) GAMEBOY_OPCODE_ROW(X, 6) GAMEBOY_OPCODE_ROW(X, 7) \
+    GAMEBOY_OPCODE_ROW(X, 8) GAMEBOY_OPCODE_ROW(X, 9) GAMEBOY_OPCODE_ROW(X, A) GAMEBOY_OPCODE_ROW(X, B) \
+    GAMEBOY_OPCODE_ROW(X, C) GAMEBOY_OPCODE_ROW(X, D) GAMEBOY_OPCODE_ROW(X, E) GAMEBOY_OPCODE_ROW(X, F)
+
+namespace GameBoy::ThreadedInterpreter {
+
+using namespace std;
+
+namespace {
+
+    // Fetches the operands of, and executes, the instruction at PC. Everything about the opcode
+    // is known at compile time, so the handler is called directly and usually inlined.
+    template <uint8_t Opcode>
+    GAMEBOY_ALWAYS_INLINE auto execute(CPU& cpu, Memory& memory, RegisterFile& regs) -> uint8_t
+    {
+        const uint16_t pc = regs.pc;
+        if constexpr (Opcode == 0xCB) {
+            const auto opcode = memory.read8(pc + 1);
+            const auto& info = OpcodeHandlers::PREFIXED_TABLE[opcode];
+            regs.pc = pc + 2;
+            return info.handler(cpu, { info.handler, 0, opcode, info.length, info.cycles, info.endsBlock, true });
+        } else {
+            constexpr auto& info = OpcodeHandlers::TABLE[Opcode];
+            constexpr auto handler = info.handler;
+            uint16_t operand = 0;
+            if constexpr (info.length == 2)
+                operand = memory.read8(pc + 1);
+            else if constexpr (info.length == 3)
+                operand = memory.read16(pc + 1);
+            regs.pc = pc + info.length;
+            return handler(cpu, { handler, operand, Opcode, info.length, info.cycles, info.endsBlock, false });
+        }
+    }
+
+    // Only instructions that end a block can halt, stop or lock the CPU
+    template <uint8_t Opcode>
+    GAMEBOY_ALWAYS_INLINE auto may_stop(const CPU& cpu) -> bool
+    {
+        if constexpr (OpcodeHandlers::TABLE[Opcode].endsBlock)
+            return cpu.state() != CPU::State::Running;
+        else
+            return false;
+    }
+
+}
+
+#ifdef GAMEBOY_COMPUTED_GOTO
+
+auto run(CPU& cpu, uint32_t cycleBudget) -> uint32_t
+{
+    if (cpu.state() != CPU::State::Running)
+        return 0;
+
+    auto& memory = cpu.memory;
+    auto& regs = cpu.registers();
+    uint64_t cycles = 0;
+    uint64_t limit = cycleBudget;
+    cpu.enter_slice(&cycles, &limit);
+
+#define GAMEBOY_LABEL_ADDRESS(opcode) &&op_##opcode,
+    static const void* const LABELS[256] = { GAMEBOY_OPCODES(GAMEBOY_LABEL_ADDRESS) };
+#undef GAMEBOY_LABEL_ADDRESS
+
+    goto* LABELS[memory.read8(regs.pc)];
+
+#define GAMEBOY_THREADED_OPCODE(opcode)                                \
+    op_##opcode : cycles += execute<0x##opcode>(cpu, memory, regs);    \
+    if (cycles >= limit || may_stop<0x##opcode>(cpu))                 \
+        goto done;                                                     \
+    goto* LABELS[memory.read8(regs.pc)];
+
+    GAMEBOY_OPCODES(GAMEBOY_THREADED_OPCODE)
+#undef GAMEBOY_THREADED_OPCODE
+
+done:
+    cpu.flags().materialise();
+    cpu.leave_slice();
+    return uint32_t(cycles);
+}
+
+#else
+
+auto run(CPU& cpu, uint32_t cycleBudget) -> uint32_t
+{
+    return run_portable(cpu, cycleBudget);
+}
+
+#endif
+
+auto run_portable(CPU& cpu, uint32_t cycleBudget) -> uint32_t
+{
+    if (cpu.state() != CPU::State::Running)
+        return 0;
+
+    auto& memory = cpu.memory;
+    auto& regs = cpu.registers();
+    uint64_t cycles = 0;
+    uint64_t limit = cycleBudget;
+    cpu.enter_slice(&cycles, &limit);
+
+    bool stopped = false;
+    do {
+        switch (memory.read8(regs.pc)) {
+#define GAMEBOY_SWITCH_OPCODE(opcode)                               \
+    case 0x##opcode:                                                \
+        cycles += execute<0x##opcode>(cpu, memory, regs);           \
+        stopped = may_stop<0x##opcode>(cpu);                        \
+        break;
+
+            GAMEBOY_OPCODES(GAMEBOY_SWITCH_OPCODE)
+#undef GAMEBOY_SWITCH_OPCODE
+        }
+    } while (!stopped && cycles < limit);
+
+    cpu.flags().materialise();
+    cpu.leave_slice();
+    return uint32_t(cycles);
+}
+
+auto uses_computed_goto() -> bool
+{
+#ifdef GAMEBOY_COMPUTED_GOTO
+    return true;
+#else
+    return false;
+#endif
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace GameBoy {
+
+class CPU;
+
+}
+
+// Interprets straight from memory with one dispatch per opcode, each handler inlined at its
+// own dispatch site. With GCC and Clang every site jumps directly to the next opcode's code
+// through a label table, so the indirect branch is predicted per opcode rather than through
+// one shared switch.
+namespace GameBoy::ThreadedInterpreter {
+
+// Executes instructions from PC until at least cycleBudget cycles have passed or the CPU stops
+// running, always executing at least one. Returns the number of cycles taken.
+auto run(CPU&, uint32_t cycleBudget) -> uint32_t;
+
+// The same core dispatched through a switch; what run() uses on compilers without
+// labels-as-values
+auto run_portable(CPU&, uint32_t cycleBudget) -> uint32_t;
+
+// Whether run() is threaded through computed gotos in this build
+auto uses_computed_goto() -> bool;
+
+}
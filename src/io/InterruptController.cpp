@@ -0,0 +1,106 @@
+#include "io/InterruptController.h"
+
+#include "CPU.h"
+#include "memory/Memory.h"
+#include "state/StateStream.h"
+
+#include <array>
+#include <cassert>
+
+namespace GameBoy {
+
+using namespace std;
+
+constexpr uint16_t INTERRUPT_FLAGS = 0xFF0F;
+constexpr uint16_t INTERRUPT_ENABLE = 0xFFFF;
+
+namespace {
+
+    // The lowest set bit of every 5-bit mask, as a bit index
+    constexpr auto build_trailing_zeros() -> array<uint8_t, 0x20>
+    {
+        array<uint8_t, 0x20> table {};
+        for (uint8_t mask = 1; mask < table.size(); ++mask) {
+            uint8_t bit = 0;
+            while (!(mask & (1 << bit)))
+                ++bit;
+            table[mask] = bit;
+        }
+        return table;
+    }
+
+    constexpr auto TRAILING_ZEROS = build_trailing_zeros();
+
+}
+
+InterruptController::InterruptController(CPU& cpu)
+    : m_cpu(cpu)
+{
+    m_cpu.memory.map_io(INTERRUPT_FLAGS, this);
+    m_cpu.memory.map_io(INTERRUPT_ENABLE, this);
+}
+
+InterruptController::~InterruptController()
+{
+    m_cpu.memory.map_io(INTERRUPT_FLAGS, nullptr);
+    m_cpu.memory.map_io(INTERRUPT_ENABLE, nullptr);
+}
+
+auto InterruptController::request(Interrupt interrupt) -> void
+{
+    m_flags |= uint8_t(interrupt);
+    m_requested |= uint8_t(interrupt);
+    notify();
+}
+
+auto InterruptController::acknowledge() -> uint16_t
+{
+    const auto mask = pending();
+    assert(mask);
+    const auto bit = TRAILING_ZEROS[mask];
+    m_flags &= ~(1 << bit);
+    // Handlers are 8 bytes apart from 0040
+    return 0x40 + 8 * bit;
+}
+
+auto InterruptController::read8(uint16_t address) -> uint8_t
+{
+    if (address == INTERRUPT_FLAGS)
+        return 0xE0 | m_flags;
+    return m_enabled;
+}
+
+auto InterruptController::write8(uint16_t address, uint8_t value) -> void
+{
+    if (address == INTERRUPT_FLAGS)
+        m_flags = value & 0x1F;
+    else
+        m_enabled = value;
+    notify();
+}
+
+auto InterruptController::next_change(uint16_t, uint64_t) -> uint64_t
+{
+    return Scheduler::NEVER;
+}
+
+auto InterruptController::save_state(StateWriter& writer) const -> void
+{
+    writer.write(m_flags);
+    writer.write(m_enabled);
+}
+
+auto InterruptController::load_state(StateReader& reader) -> void
+{
+    reader.read(m_flags);
+    reader.read(m_enabled);
+    m_requested = 0;
+}
+
+auto InterruptController::notify() -> void
+{
+    if (pending())
+        m_cpu.end_slice();
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "memory/IoHandler.h"
+
+#include <stdint.h>
+
+namespace GameBoy {
+
+class CPU;
+class StateReader;
+class StateWriter;
+
+// IF/IE bits, in priority order
+enum class Interrupt : uint8_t {
+    VBlank = 0x01,
+    Stat = 0x02,
+    Timer = 0x04,
+    Serial = 0x08,
+    Joypad = 0x10,
+};
+
+// IF (FF0F) and IE (FFFF). Whether anything needs the CPU's attention is a single mask, so
+// the CPU can check it between instructions without calling out of line. IME lives in the
+// CPU, since only instructions change it.
+class InterruptController : public IoHandler {
+public:
+    InterruptController(CPU&);
+    ~InterruptController() override;
+
+    InterruptController(const InterruptController&) = delete;
+    auto operator=(const InterruptController&) -> InterruptController& = delete;
+
+    // Requested and enabled interrupts; non-zero wakes a halted or stopped CPU
+    auto pending() const -> uint8_t;
+    auto request(Interrupt) -> void;
+    // Every interrupt requested since the last call, whether or not IF already had it
+    auto take_requested() -> uint8_t;
+    // Clears the highest-priority pending interrupt and returns the address of its handler.
+    // Only valid while something is pending.
+    auto acknowledge() -> uint16_t;
+
+    auto read8(uint16_t address) -> uint8_t override;
+    auto write8(uint16_t address, uint8_t value) -> void override;
+    // IF only changes on a request, which always comes from an event or a write
+    auto next_change(uint16_t address, uint64_t cycle) -> uint64_t override;
+
+    // IF and IE
+    auto save_state(StateWriter&) const -> void;
+    auto load_state(StateReader&) -> void;
+
+private:
+    // Ends the CPU's current run if something just became pending
+    auto notify() -> void;
+
+    CPU& m_cpu;
+    uint8_t m_flags = 0;
+    uint8_t m_enabled = 0;
+    uint8_t m_requested = 0;
+};
+
+inline auto InterruptController::pending() const -> uint8_t
+{
+    return m_flags & m_enabled & 0x1F;
+}
+
+inline auto InterruptController::take_requested() -> uint8_t
+{
+    const auto requested = m_requested;
+    m_requested = 0;
+    return requested;
+}
+
+}
@@ -0,0 +1,210 @@
+#include "io/Timer.h"
+
+#include "CPU.h"
+#include "memory/Memory.h"
+#include "state/StateStream.h"
+
+namespace GameBoy {
+
+using namespace std;
+
+constexpr uint16_t DIV = 0xFF04;
+constexpr uint16_t TIMA = 0xFF05;
+constexpr uint16_t TMA = 0xFF06;
+constexpr uint16_t TAC = 0xFF07;
+
+constexpr uint8_t TAC_ENABLE = 0x04;
+// TIMA stays at 00 this long after overflowing before TMA is loaded
+constexpr uint64_t RELOAD_DELAY = 4;
+
+Timer::Timer(CPU& cpu)
+    : m_cpu(cpu)
+    , m_overflowCycle(Scheduler::NEVER)
+    , m_reloadCycle(Scheduler::NEVER)
+{
+    for (auto address = DIV; address <= TAC; ++address)
+        m_cpu.memory.map_io(address, this);
+    m_cpu.scheduler().set_handler(Event::Timer, [this] {
+        catch_up(m_cpu.scheduler().now());
+    });
+}
+
+Timer::~Timer()
+{
+    for (auto address = DIV; address <= TAC; ++address)
+        m_cpu.memory.map_io(address, nullptr);
+    m_cpu.scheduler().cancel(Event::Timer);
+    m_cpu.scheduler().set_handler(Event::Timer, nullptr);
+}
+
+auto Timer::save_state(StateWriter& writer) const -> void
+{
+    writer.write(m_counterBase);
+    writer.write(m_tima);
+    writer.write(m_timaCycle);
+    writer.write(m_tma);
+    writer.write(m_tac);
+    writer.write(m_overflowCycle);
+    writer.write(m_reloadCycle);
+}
+
+auto Timer::load_state(StateReader& reader) -> void
+{
+    reader.read(m_counterBase);
+    reader.read(m_tima);
+    reader.read(m_timaCycle);
+    reader.read(m_tma);
+    reader.read(m_tac);
+    reader.read(m_overflowCycle);
+    reader.read(m_reloadCycle);
+}
+
+auto Timer::read8(uint16_t address) -> uint8_t
+{
+    const auto cycle = m_cpu.cycle();
+    switch (address) {
+    case DIV:
+        return uint8_t((cycle - m_counterBase) >> 8);
+    case TIMA:
+        catch_up(cycle);
+        return tima_at(cycle);
+    case TMA:
+        return m_tma;
+    default:
+        return 0xF8 | m_tac;
+    }
+}
+
+auto Timer::write8(uint16_t address, uint8_t value) -> void
+{
+    const auto cycle = m_cpu.cycle();
+    catch_up(cycle);
+    const bool overflowing = m_overflowCycle <= cycle;
+
+    switch (address) {
+    case DIV: {
+        // Resetting the counter is a falling edge if the selected bit was high
+        const bool edge = signal(cycle);
+        const auto tima = tima_at(cycle);
+        m_counterBase = cycle;
+        if (!overflowing)
+            restart(cycle, tima, edge);
+        break;
+    }
+    case TIMA:
+        // The reload wins on the cycle it happens; before it, the write cancels it
+        if (cycle != m_reloadCycle)
+            restart(cycle, value);
+        break;
+    case TMA:
+        m_tma = value;
+        if (cycle == m_reloadCycle)
+            restart(cycle, value);
+        break;
+    default: {
+        // Disabling the timer or moving to a bit that's low is a falling edge too
+        const bool before = signal(cycle);
+        const auto tima = tima_at(cycle);
+        m_tac = value & 0x07;
+        if (!overflowing)
+            restart(cycle, tima, before && !signal(cycle));
+        break;
+    }
+    }
+}
+
+auto Timer::next_change(uint16_t address, uint64_t cycle) -> uint64_t
+{
+    switch (address) {
+    case DIV:
+        return m_counterBase + ((cycle - m_counterBase) / 256 + 1) * 256;
+    case TIMA:
+        // Reads 00 until the reload
+        if (m_overflowCycle <= cycle)
+            return m_overflowCycle + RELOAD_DELAY;
+        if (!enabled())
+            return Scheduler::NEVER;
+        return m_counterBase + ((cycle - m_counterBase) / period() + 1) * period();
+    default:
+        return Scheduler::NEVER;
+    }
+}
+
+auto Timer::enabled() const -> bool
+{
+    return m_tac & TAC_ENABLE;
+}
+
+auto Timer::period() const -> uint64_t
+{
+    switch (m_tac & 0x03) {
+    case 0:
+        return 1024;
+    case 1:
+        return 16;
+    case 2:
+        return 64;
+    default:
+        return 256;
+    }
+}
+
+auto Timer::signal(uint64_t cycle) const -> bool
+{
+    return enabled() && ((cycle - m_counterBase) & (period() / 2));
+}
+
+auto Timer::edges(uint64_t from, uint64_t to) const -> uint64_t
+{
+    const auto counterPeriod = period();
+    return (to - m_counterBase) / counterPeriod - (from - m_counterBase) / counterPeriod;
+}
+
+auto Timer::catch_up(uint64_t cycle) -> void
+{
+    while (m_overflowCycle != Scheduler::NEVER && cycle >= m_overflowCycle + RELOAD_DELAY) {
+        m_reloadCycle = m_overflowCycle + RELOAD_DELAY;
+        m_tima = m_tma;
+        m_timaCycle = m_reloadCycle;
+        m_cpu.interrupts().request(Interrupt::Timer);
+        schedule_overflow();
+    }
+}
+
+auto Timer::tima_at(uint64_t cycle) const -> uint8_t
+{
+    if (m_overflowCycle <= cycle)
+        return 0x00;
+    if (!enabled())
+        return m_tima;
+    return uint8_t(m_tima + edges(m_timaCycle, cycle));
+}
+
+auto Timer::restart(uint64_t cycle, uint8_t value, bool extraEdge) -> void
+{
+    m_tima = value;
+    m_timaCycle = cycle;
+    if (extraEdge && m_tima++ == 0xFF) {
+        m_overflowCycle = cycle;
+        m_cpu.scheduler().schedule(Event::Timer, cycle + RELOAD_DELAY);
+        return;
+    }
+    schedule_overflow();
+}
+
+auto Timer::schedule_overflow() -> void
+{
+    auto& scheduler = m_cpu.scheduler();
+    if (!enabled()) {
+        m_overflowCycle = Scheduler::NEVER;
+        scheduler.cancel(Event::Timer);
+        return;
+    }
+
+    const auto counterPeriod = period();
+    const auto firstEdge = m_counterBase + ((m_timaCycle - m_counterBase) / counterPeriod + 1) * counterPeriod;
+    m_overflowCycle = firstEdge + (0xFF - m_tima) * counterPeriod;
+    scheduler.schedule(Event::Timer, m_overflowCycle + RELOAD_DELAY);
+}
+
+}
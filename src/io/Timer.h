@@ -0,0 +1,68 @@
+#pragma once
+
+#include "memory/IoHandler.h"
+
+#include <stdint.h>
+
+namespace GameBoy {
+
+class CPU;
+class StateReader;
+class StateWriter;
+
+// DIV, TIMA, TMA and TAC (FF04-FF07). Nothing here counts cycles: DIV is the top of a 16-bit
+// counter that runs from the last DIV write, and TIMA is worked out from how many falling
+// edges of the bit TAC selects that counter has had since TIMA was last known. The only
+// scheduled event is the reload after each overflow, found once per reload.
+class Timer : public IoHandler {
+public:
+    // Maps the registers into the CPU's memory until destroyed
+    Timer(CPU&);
+    ~Timer() override;
+
+    Timer(const Timer&) = delete;
+    auto operator=(const Timer&) -> Timer& = delete;
+
+    auto read8(uint16_t address) -> uint8_t override;
+    auto write8(uint16_t address, uint8_t value) -> void override;
+    auto next_change(uint16_t address, uint64_t cycle) -> uint64_t override;
+
+    // The Timer event is the scheduler's to save
+    auto save_state(StateWriter&) const -> void;
+    auto load_state(StateReader&) -> void;
+
+private:
+    auto enabled() const -> bool;
+    // Cycles between TIMA increments: the period of the selected counter bit
+    auto period() const -> uint64_t;
+    // Whether the selected counter bit, gated by the enable, is high at cycle
+    auto signal(uint64_t cycle) const -> bool;
+    // Falling edges of the selected bit in (from, to]
+    auto edges(uint64_t from, uint64_t to) const -> uint64_t;
+
+    // Applies every reload due by cycle
+    auto catch_up(uint64_t cycle) -> void;
+    auto tima_at(uint64_t cycle) const -> uint8_t;
+    // Takes value as TIMA from cycle on, incrementing it once more for a glitched edge
+    auto restart(uint64_t cycle, uint8_t value, bool extraEdge = false) -> void;
+    // Works out when TIMA next overflows and schedules the reload
+    auto schedule_overflow() -> void;
+
+    CPU& m_cpu;
+
+    // The cycle DIV was last reset on; the internal counter is the cycles since
+    uint64_t m_counterBase = 0;
+    // TIMA as of m_timaCycle
+    uint8_t m_tima = 0;
+    uint64_t m_timaCycle = 0;
+    uint8_t m_tma = 0;
+    uint8_t m_tac = 0;
+
+    // The cycle TIMA next wraps to 00, and stays there until the reload 4 cycles later
+    uint64_t m_overflowCycle;
+    // The cycle of the last reload, during which TIMA writes are ignored and TMA writes go
+    // through to TIMA
+    uint64_t m_reloadCycle;
+};
+
+}
@@ -0,0 +1,94 @@
+#include "jit/CodeArena.h"
+
+#include <cassert>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define GAMEBOY_HAS_MMAP 1
+#endif
+
+namespace GameBoy {
+
+CodeArena::CodeArena(size_t size)
+    : m_size(size)
+{
+#ifdef GAMEBOY_HAS_MMAP
+    auto mapping = mmap(nullptr, size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping != MAP_FAILED)
+        m_base = static_cast<uint8_t*>(mapping);
+    m_pageSize = size_t(sysconf(_SC_PAGESIZE));
+#endif
+    m_cursor = m_base;
+}
+
+CodeArena::~CodeArena()
+{
+#ifdef GAMEBOY_HAS_MMAP
+    if (m_base)
+        munmap(m_base, m_size);
+#endif
+}
+
+auto CodeArena::available() const -> bool
+{
+    return m_base != nullptr;
+}
+
+auto CodeArena::cursor() const -> uint8_t*
+{
+    return m_cursor;
+}
+
+auto CodeArena::remaining() const -> size_t
+{
+    return m_size - (m_cursor - m_base);
+}
+
+auto CodeArena::commit(uint8_t* end) -> void
+{
+    assert(end >= m_cursor && end <= m_base + m_size);
+    m_cursor = end;
+}
+
+auto CodeArena::rewind(uint8_t* mark) -> void
+{
+    assert(mark >= m_base && mark <= m_cursor);
+    m_cursor = mark;
+}
+
+auto CodeArena::protect([[maybe_unused]] uint8_t* start, [[maybe_unused]] size_t size, [[maybe_unused]] bool writable) -> void
+{
+#ifdef GAMEBOY_HAS_MMAP
+    if (!m_base || !size)
+        return;
+    // Whole pages, however few bytes are asked for
+    const auto first = uintptr_t(start) & ~uintptr_t(m_pageSize - 1);
+    const auto end = (uintptr_t(start) + size + m_pageSize - 1) & ~uintptr_t(m_pageSize - 1);
+    [[maybe_unused]] const auto result = mprotect(reinterpret_cast<void*>(first), end - first, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC);
+    assert(result == 0);
+#endif
+}
+
+CodeArena::Writable::Writable(CodeArena& arena)
+    : Writable(arena, arena.m_base, arena.m_size)
+{
+}
+
+CodeArena::Writable::Writable(CodeArena& arena, uint8_t* start, size_t size)
+    : m_arena(arena)
+    , m_start(start)
+    , m_size(size)
+{
+    assert(!size || (start >= m_arena.m_base && start + size <= m_arena.m_base + m_arena.m_size));
+    if (m_arena.m_writers++ == 0)
+        m_arena.protect(m_start, m_size, true);
+}
+
+CodeArena::Writable::~Writable()
+{
+    if (--m_arena.m_writers == 0)
+        m_arena.protect(m_start, m_size, false);
+}
+
+}
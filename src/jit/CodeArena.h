@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace GameBoy {
+
+// A fixed-size region of host memory that can be written and executed, filled front to back.
+// It is never both at once: code can only be emitted or patched while a Writable is alive.
+class CodeArena {
+public:
+    // Makes the arena, or just the pages holding size bytes from start, writable and no
+    // longer executable for as long as it lives. These nest, with the outermost one deciding
+    // which pages: it has to cover whatever the inner ones write.
+    class Writable {
+    public:
+        Writable(CodeArena&);
+        Writable(CodeArena&, uint8_t* start, size_t size);
+        ~Writable();
+
+        Writable(const Writable&) = delete;
+        auto operator=(const Writable&) -> Writable& = delete;
+
+    private:
+        CodeArena& m_arena;
+        uint8_t* m_start;
+        size_t m_size;
+    };
+
+    CodeArena(size_t size);
+    ~CodeArena();
+
+    CodeArena(const CodeArena&) = delete;
+    auto operator=(const CodeArena&) -> CodeArena& = delete;
+
+    // False when the host refused to map executable memory
+    auto available() const -> bool;
+
+    auto cursor() const -> uint8_t*;
+    auto remaining() const -> size_t;
+
+    // Marks everything up to end as used
+    auto commit(uint8_t* end) -> void;
+    // Forgets everything emitted after mark
+    auto rewind(uint8_t* mark) -> void;
+
+private:
+    auto protect(uint8_t* start, size_t size, bool writable) -> void;
+
+    uint8_t* m_base = nullptr;
+    uint8_t* m_cursor = nullptr;
+    size_t m_size;
+    size_t m_pageSize = 4096;
+    uint32_t m_writers = 0;
+};
+
+}
@@ -0,0 +1,400 @@
+#include "jit/Jit.h"
+
+#include "CPU.h"
+#include "RegisterFile.h"
+#include "instruction/BlockCache.h"
+#include "jit/X86Emitter.h"
+#include "memory/Memory.h"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace GameBoy {
+
+using namespace std;
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define GAMEBOY_JIT_SUPPORTED 1
+#endif
+
+// Times a block is interpreted before it is worth translating
+constexpr uint32_t HOT_THRESHOLD = 4;
+
+constexpr size_t ARENA_SIZE = 4 * 1024 * 1024;
+// Comfortably more than the code emitted for the longest block
+constexpr size_t MAX_BLOCK_CODE_SIZE = 8 * 1024;
+
+constexpr uint16_t FIXED_ROM_END = 0x4000;
+constexpr uint16_t SWITCHABLE_ROM_START = 0x4000;
+constexpr uint16_t SWITCHABLE_ROM_END = 0x8000;
+
+constexpr uint8_t CONTEXT_CYCLES = offsetof(JitContext, cycles);
+constexpr uint8_t CONTEXT_CYCLE_LIMIT = offsetof(JitContext, cycleLimit);
+constexpr uint8_t CONTEXT_REGISTERS = offsetof(JitContext, registers);
+constexpr uint8_t CONTEXT_CPU = offsetof(JitContext, cpu);
+
+constexpr uint8_t REGISTER_PC = offsetof(RegisterFile, pc);
+
+// r8 encoding order; (HL) has no register to point at
+constexpr uint8_t R8_OFFSETS[8] = {
+    offsetof(RegisterFile, b),
+    offsetof(RegisterFile, c),
+    offsetof(RegisterFile, d),
+    offsetof(RegisterFile, e),
+    offsetof(RegisterFile, h),
+    offsetof(RegisterFile, l),
+    0,
+    offsetof(RegisterFile, a),
+};
+constexpr uint8_t INDIRECT_HL = 6;
+
+constexpr uint8_t R16_OFFSETS[4] = {
+    offsetof(RegisterFile, bc),
+    offsetof(RegisterFile, de),
+    offsetof(RegisterFile, hl),
+    offsetof(RegisterFile, sp),
+};
+
+struct Jit::CompiledBlock {
+    uint32_t key;
+    const uint8_t* entry;
+    // Read by the generated code after every handler call; cleared when a write lands in the block
+    bool valid = true;
+    // Handlers are called with pointers into this copy, so it must never be resized
+    vector<DecodedInstruction> instructions;
+    vector<pair<uint32_t, uint8_t*>> outgoingLinks;
+};
+
+namespace {
+
+    auto is_static_jump(const DecodedInstruction& instr) -> bool
+    {
+        return !instr.prefixed && (instr.opcode == 0xC3 || instr.opcode == 0x18);
+    }
+
+    // Target of an instruction that may branch to a fixed address, given the PC after it
+    auto static_target(const DecodedInstruction& instr, uint16_t pc, uint16_t& target) -> bool
+    {
+        if (instr.prefixed)
+            return false;
+        const auto opcode = instr.opcode;
+        if (opcode == 0x18 || (opcode & 0xE7) == 0x20) { // JR e, JR cc,e
+            target = pc + int8_t(instr.operand);
+            return true;
+        }
+        if (opcode == 0xC3 || opcode == 0xCD || (opcode & 0xE7) == 0xC2 || (opcode & 0xE7) == 0xC4) { // JP, CALL
+            target = instr.operand;
+            return true;
+        }
+        if ((opcode & 0xC7) == 0xC7) { // RST
+            target = opcode & 0x38;
+            return true;
+        }
+        return false;
+    }
+
+    // Emits register-only instructions directly. Returns false for anything that needs a handler.
+    auto emit_native(X86Emitter& emit, const DecodedInstruction& instr) -> bool
+    {
+        if (instr.prefixed)
+            return false;
+
+        const auto opcode = instr.opcode;
+        if (opcode == 0x00) // NOP
+            return true;
+
+        if (opcode >= 0x40 && opcode < 0x80) { // LD r,r'
+            const auto dst = (opcode >> 3) & 7;
+            const auto src = opcode & 7;
+            if (dst == INDIRECT_HL || src == INDIRECT_HL)
+                return false;
+            if (dst != src) {
+                emit.load_register8(R8_OFFSETS[src]);
+                emit.store_register8(R8_OFFSETS[dst]);
+            }
+            return true;
+        }
+
+        if ((opcode & 0xC7) == 0x06) { // LD r,n
+            const auto dst = (opcode >> 3) & 7;
+            if (dst == INDIRECT_HL)
+                return false;
+            emit.store_register8(R8_OFFSETS[dst], uint8_t(instr.operand));
+            return true;
+        }
+
+        if (opcode < 0x40) {
+            switch (opcode & 0x0F) {
+            case 0x01: // LD rr,nn
+                emit.store_register16(R16_OFFSETS[opcode >> 4], instr.operand);
+                return true;
+            case 0x03: // INC rr
+                emit.increment_register16(R16_OFFSETS[opcode >> 4]);
+                return true;
+            case 0x0B: // DEC rr
+                emit.decrement_register16(R16_OFFSETS[opcode >> 4]);
+                return true;
+            }
+        }
+
+        if (opcode == 0xF9) { // LD SP,HL
+            emit.load_register16(offsetof(RegisterFile, hl));
+            emit.store_register16(offsetof(RegisterFile, sp));
+            return true;
+        }
+
+        return false;
+    }
+
+}
+
+Jit::Jit(CPU& cpu)
+    : m_cpu(cpu)
+    , m_arena(ARENA_SIZE)
+{
+#ifdef GAMEBOY_JIT_SUPPORTED
+    if (!m_arena.available())
+        return;
+
+    CodeArena::Writable writable(m_arena);
+    X86Emitter emit(m_arena.cursor());
+    m_enter = reinterpret_cast<void (*)(JitContext*, const uint8_t*)>(emit.position());
+    emit.emit_enter(CONTEXT_REGISTERS, CONTEXT_CPU);
+    m_exit = emit.position();
+    emit.emit_exit();
+    m_arena.commit(emit.position());
+    m_codeStart = m_arena.cursor();
+
+    m_cpu.block_cache().set_invalidation_listener([this](uint32_t key) {
+        invalidate(key);
+    });
+    m_cpu.memory.set_fixed_bank_watcher([this] { unlink_fixed_bank(); });
+#endif
+}
+
+Jit::~Jit()
+{
+    if (m_enter) {
+        m_cpu.block_cache().set_invalidation_listener(nullptr);
+        m_cpu.memory.set_fixed_bank_watcher(nullptr);
+    }
+}
+
+auto Jit::available() const -> bool
+{
+    return m_enter != nullptr;
+}
+
+auto Jit::execute(uint32_t cycleBudget) -> uint32_t
+{
+    m_retired.clear();
+
+    auto& regs = m_cpu.registers();
+    auto& blockCache = m_cpu.block_cache();
+    const auto key = blockCache.key_for(regs.pc);
+
+    CompiledBlock* compiled = nullptr;
+    const auto found = m_blocks.find(key);
+    if (found != m_blocks.end()) {
+        compiled = found->second.get();
+    } else {
+        const auto& block = blockCache.lookup(regs.pc);
+        if (++m_heat[key] < HOT_THRESHOLD)
+            return m_cpu.interpret_block(block);
+        m_heat.erase(key);
+        compiled = compile(block, key);
+    }
+
+    JitContext context { &m_cpu, &regs, 0, cycleBudget };
+    m_cpu.enter_slice(&context.cycles, &context.cycleLimit);
+    m_enter(&context, compiled->entry);
+    m_cpu.flags().materialise();
+    m_cpu.leave_slice();
+    return uint32_t(context.cycles);
+}
+
+auto Jit::stats() const -> const Stats&
+{
+    return m_stats;
+}
+
+auto Jit::compile(const DecodedBlock& block, uint32_t key) -> CompiledBlock*
+{
+    CodeArena::Writable writable(m_arena);
+    if (m_arena.remaining() < MAX_BLOCK_CODE_SIZE)
+        flush();
+
+    auto compiled = make_unique<CompiledBlock>();
+    compiled->key = key;
+    compiled->instructions = block.instructions;
+
+    X86Emitter emit(m_arena.cursor());
+    compiled->entry = emit.position();
+
+    int32_t pendingCycles = 0;
+    const auto add_pending_cycles = [&] {
+        if (pendingCycles)
+            emit.add_context64(CONTEXT_CYCLES, pendingCycles);
+        pendingCycles = 0;
+    };
+
+    // Leaves the block for target: straight into the target's code while cycles remain,
+    // through the exit otherwise
+    const auto emit_exit_to = [&](uint16_t target) {
+        emit.store_register16(REGISTER_PC, target);
+        if (target >= SWITCHABLE_ROM_START && target < SWITCHABLE_ROM_END) {
+            // The bank may change before we get there
+            X86Emitter::patch(emit.jump(), m_exit);
+            return;
+        }
+        X86Emitter::patch(emit.jump_if_context_above_or_equal(CONTEXT_CYCLES, CONTEXT_CYCLE_LIMIT), m_exit);
+        link(*compiled, emit.jump(), target);
+    };
+
+    uint16_t pc = block.start;
+    bool exited = false;
+    const auto count = compiled->instructions.size();
+    for (size_t i = 0; i < count; ++i) {
+        const auto& instr = compiled->instructions[i];
+        const bool last = i + 1 == count;
+        pc += instr.length;
+
+        uint16_t target = 0;
+        if (is_static_jump(instr)) {
+            pendingCycles += instr.cycles;
+            add_pending_cycles();
+            static_target(instr, pc, target);
+            emit_exit_to(target);
+            exited = true;
+            break;
+        }
+
+        if (emit_native(emit, instr)) {
+            pendingCycles += instr.cycles;
+            continue;
+        }
+
+        add_pending_cycles();
+        emit.store_register16(REGISTER_PC, pc);
+        emit.call_handler(reinterpret_cast<const void*>(instr.handler), &instr);
+        emit.add_context64_from_rax(CONTEXT_CYCLES);
+
+        if (!last) {
+            X86Emitter::patch(emit.jump_if_byte_zero(&compiled->valid), m_exit);
+            continue;
+        }
+
+        if (!instr.endsBlock)
+            break;
+
+        // The handler has already set PC; chain to wherever it went when that is known
+        if (static_target(instr, pc, target)) {
+            if (instr.opcode != 0xCD && (instr.opcode & 0xC7) != 0xC7) {
+                // Conditional: fall through unless PC moved to the target
+                const auto taken = emit.jump_if_register16_equals(REGISTER_PC, target);
+                emit_exit_to(pc);
+                X86Emitter::patch(taken, emit.position());
+            }
+            emit_exit_to(target);
+        } else {
+            X86Emitter::patch(emit.jump(), m_exit);
+        }
+        exited = true;
+    }
+
+    if (!exited) {
+        add_pending_cycles();
+        emit_exit_to(pc);
+    }
+
+    m_arena.commit(emit.position());
+    ++m_stats.compiledBlocks;
+
+    // Now that it exists, route every jump waiting on this block into it
+    auto compiledBlock = compiled.get();
+    m_blocks[key] = move(compiled);
+    for (auto site : m_linksTo[key])
+        X86Emitter::patch(site, compiledBlock->entry);
+    return compiledBlock;
+}
+
+auto Jit::invalidate(uint32_t key) -> void
+{
+    m_heat.erase(key);
+
+    const auto found = m_blocks.find(key);
+    if (found == m_blocks.end())
+        return;
+
+    auto block = move(found->second);
+    m_blocks.erase(found);
+    block->valid = false;
+
+    // Only the pages with jumps into the block: code that writes to itself lands here on every
+    // store, and most blocks have a jump or two into them at most
+    for (auto site : m_linksTo[key]) {
+        CodeArena::Writable writable(m_arena, site, sizeof(int32_t));
+        X86Emitter::patch(site, m_exit);
+    }
+    unlink(*block);
+
+    ++m_stats.invalidatedBlocks;
+    m_retired.push_back(move(block));
+}
+
+auto Jit::flush() -> void
+{
+    for (auto& entry : m_blocks) {
+        entry.second->valid = false;
+        m_retired.push_back(move(entry.second));
+    }
+    m_blocks.clear();
+    m_linksTo.clear();
+    m_arena.rewind(m_codeStart);
+    ++m_stats.flushes;
+}
+
+auto Jit::link(CompiledBlock& from, uint8_t* site, uint16_t target) -> void
+{
+    const auto key = m_cpu.block_cache().key_for(target);
+    from.outgoingLinks.emplace_back(key, site);
+    m_linksTo[key].push_back(site);
+
+    const auto found = m_blocks.find(key);
+    X86Emitter::patch(site, found != m_blocks.end() ? found->second->entry : m_exit);
+}
+
+auto Jit::unlink(CompiledBlock& block) -> void
+{
+    for (const auto& link : block.outgoingLinks) {
+        auto& sites = m_linksTo[link.first];
+        sites.erase(find(sites.begin(), sites.end(), link.second));
+        if (sites.empty())
+            m_linksTo.erase(link.first);
+    }
+}
+
+auto Jit::unlink_fixed_bank() -> void
+{
+    const auto into_fixed_bank = [](const pair<uint32_t, uint8_t*>& link) {
+        return uint16_t(link.first) < FIXED_ROM_END;
+    };
+
+    CodeArena::Writable writable(m_arena);
+    for (auto& entry : m_blocks) {
+        auto& links = entry.second->outgoingLinks;
+        for (const auto& link : links) {
+            if (into_fixed_bank(link))
+                X86Emitter::patch(link.second, m_exit);
+        }
+        links.erase(remove_if(links.begin(), links.end(), into_fixed_bank), links.end());
+    }
+    for (auto it = m_linksTo.begin(); it != m_linksTo.end();) {
+        if (uint16_t(it->first) < FIXED_ROM_END)
+            it = m_linksTo.erase(it);
+        else
+            ++it;
+    }
+}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "instruction/OpcodeTable.h"
+#include "jit/CodeArena.h"
+
+#include <memory>
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace GameBoy {
+
+class CPU;
+struct DecodedBlock;
+struct RegisterFile;
+
+// State shared with generated code, addressed through rbx
+struct JitContext {
+    CPU* cpu;
+    RegisterFile* registers;
+    uint64_t cycles;
+    uint64_t cycleLimit;
+};
+
+// Translates hot blocks from the CPU's block cache into x86-64 code. Register-only loads
+// and unconditional jumps are emitted natively; every other instruction calls its
+// interpreter handler. Blocks whose exits have a known target jump straight into each
+// other while the cycle budget lasts.
+class Jit {
+public:
+    struct Stats {
+        uint64_t compiledBlocks = 0;
+        uint64_t invalidatedBlocks = 0;
+        uint64_t flushes = 0;
+    };
+
+    Jit(CPU&);
+    ~Jit();
+
+    Jit(const Jit&) = delete;
+    auto operator=(const Jit&) -> Jit& = delete;
+
+    // Whether this host can run generated code at all
+    auto available() const -> bool;
+
+    // Runs the block at PC, compiled if it is hot enough, and keeps following chained blocks
+    // until at least cycleBudget cycles have passed. Returns the number of cycles taken.
+    auto execute(uint32_t cycleBudget) -> uint32_t;
+
+    auto stats() const -> const Stats&;
+
+private:
+    struct CompiledBlock;
+
+    auto compile(const DecodedBlock&, uint32_t key) -> CompiledBlock*;
+    auto invalidate(uint32_t key) -> void;
+    auto flush() -> void;
+
+    auto link(CompiledBlock&, uint8_t* site, uint16_t target) -> void;
+    auto unlink(CompiledBlock&) -> void;
+    // Sends every jump into 0000-3FFF through the exit for good, as it was linked to the bank
+    // mapped there at the time
+    auto unlink_fixed_bank() -> void;
+
+    CPU& m_cpu;
+    CodeArena m_arena;
+    uint8_t* m_codeStart = nullptr;
+    const uint8_t* m_exit = nullptr;
+    void (*m_enter)(JitContext*, const uint8_t*) = nullptr;
+
+    std::unordered_map<uint32_t, std::unique_ptr<CompiledBlock>> m_blocks;
+    // How many times each not-yet-compiled block has been interpreted
+    std::unordered_map<uint32_t, uint32_t> m_heat;
+    // Jump sites, by the key of the block they lead to, whether that block is compiled or not
+    std::unordered_map<uint32_t, std::vector<uint8_t*>> m_linksTo;
+    // Invalidated blocks; their code may still be on the host stack until execute() returns
+    std::vector<std::unique_ptr<CompiledBlock>> m_retired;
+    Stats m_stats;
+};
+
+}
@@ -0,0 +1,265 @@
+#include "jit/X86Emitter.h"
+
+#include <cstring>
+
+namespace GameBoy {
+
+// Prefixes and ModRM pieces used below
+constexpr uint8_t REX_B = 0x41;
+constexpr uint8_t REX_W = 0x48;
+constexpr uint8_t OPERAND_SIZE_16 = 0x66;
+constexpr uint8_t MODRM_DISP8_RBX = 0x43;
+
+X86Emitter::X86Emitter(uint8_t* cursor)
+    : m_cursor(cursor)
+{
+}
+
+auto X86Emitter::position() const -> uint8_t*
+{
+    return m_cursor;
+}
+
+auto X86Emitter::load_register8(uint8_t offset) -> void
+{
+    emit8(REX_B);
+    emit8(0x8A);
+    emit_r12_operand(0, offset);
+}
+
+auto X86Emitter::store_register8(uint8_t offset) -> void
+{
+    emit8(REX_B);
+    emit8(0x88);
+    emit_r12_operand(0, offset);
+}
+
+auto X86Emitter::store_register8(uint8_t offset, uint8_t value) -> void
+{
+    emit8(REX_B);
+    emit8(0xC6);
+    emit_r12_operand(0, offset);
+    emit8(value);
+}
+
+auto X86Emitter::load_register16(uint8_t offset) -> void
+{
+    emit8(OPERAND_SIZE_16);
+    emit8(REX_B);
+    emit8(0x8B);
+    emit_r12_operand(0, offset);
+}
+
+auto X86Emitter::store_register16(uint8_t offset) -> void
+{
+    emit8(OPERAND_SIZE_16);
+    emit8(REX_B);
+    emit8(0x89);
+    emit_r12_operand(0, offset);
+}
+
+auto X86Emitter::store_register16(uint8_t offset, uint16_t value) -> void
+{
+    emit8(OPERAND_SIZE_16);
+    emit8(REX_B);
+    emit8(0xC7);
+    emit_r12_operand(0, offset);
+    emit16(value);
+}
+
+auto X86Emitter::increment_register16(uint8_t offset) -> void
+{
+    emit8(OPERAND_SIZE_16);
+    emit8(REX_B);
+    emit8(0xFF);
+    emit_r12_operand(0, offset);
+}
+
+auto X86Emitter::decrement_register16(uint8_t offset) -> void
+{
+    emit8(OPERAND_SIZE_16);
+    emit8(REX_B);
+    emit8(0xFF);
+    emit_r12_operand(1, offset);
+}
+
+auto X86Emitter::add_context64(uint8_t offset, int32_t value) -> void
+{
+    emit8(REX_W);
+    emit8(0x81);
+    emit8(MODRM_DISP8_RBX);
+    emit8(offset);
+    emit32(uint32_t(value));
+}
+
+auto X86Emitter::add_context64_from_rax(uint8_t offset) -> void
+{
+    emit8(REX_W);
+    emit8(0x01);
+    emit8(MODRM_DISP8_RBX);
+    emit8(offset);
+}
+
+auto X86Emitter::call_handler(const void* handler, const void* instruction) -> void
+{
+    // mov rdi, r13
+    emit8(0x4C);
+    emit8(0x89);
+    emit8(0xEF);
+    // mov rsi, imm64
+    emit8(REX_W);
+    emit8(0xBE);
+    emit64(reinterpret_cast<uint64_t>(instruction));
+    // mov rax, imm64
+    emit8(REX_W);
+    emit8(0xB8);
+    emit64(reinterpret_cast<uint64_t>(handler));
+    // call rax
+    emit8(0xFF);
+    emit8(0xD0);
+    // movzx eax, al
+    emit8(0x0F);
+    emit8(0xB6);
+    emit8(0xC0);
+}
+
+auto X86Emitter::jump_if_byte_zero(const void* address) -> uint8_t*
+{
+    // mov rax, imm64
+    emit8(REX_W);
+    emit8(0xB8);
+    emit64(reinterpret_cast<uint64_t>(address));
+    // cmp byte [rax], 0
+    emit8(0x80);
+    emit8(0x38);
+    emit8(0x00);
+    // je rel32
+    emit8(0x0F);
+    emit8(0x84);
+    return emit_rel32();
+}
+
+auto X86Emitter::jump_if_context_above_or_equal(uint8_t offset, uint8_t limitOffset) -> uint8_t*
+{
+    // mov rax, [rbx+offset]
+    emit8(REX_W);
+    emit8(0x8B);
+    emit8(MODRM_DISP8_RBX);
+    emit8(offset);
+    // cmp rax, [rbx+limitOffset]
+    emit8(REX_W);
+    emit8(0x3B);
+    emit8(MODRM_DISP8_RBX);
+    emit8(limitOffset);
+    // jae rel32
+    emit8(0x0F);
+    emit8(0x83);
+    return emit_rel32();
+}
+
+auto X86Emitter::jump_if_register16_equals(uint8_t offset, uint16_t value) -> uint8_t*
+{
+    // movzx eax, word [r12+offset]
+    emit8(REX_B);
+    emit8(0x0F);
+    emit8(0xB7);
+    emit_r12_operand(0, offset);
+    // cmp eax, imm32
+    emit8(0x3D);
+    emit32(value);
+    // je rel32
+    emit8(0x0F);
+    emit8(0x84);
+    return emit_rel32();
+}
+
+auto X86Emitter::jump() -> uint8_t*
+{
+    emit8(0xE9);
+    return emit_rel32();
+}
+
+auto X86Emitter::emit_enter(uint8_t registersOffset, uint8_t cpuOffset) -> void
+{
+    // push rbx; push r12; push r13. Together with the return address this leaves
+    // the stack 16-byte aligned for the calls made by generated code.
+    emit8(0x53);
+    emit8(REX_B);
+    emit8(0x54);
+    emit8(REX_B);
+    emit8(0x55);
+    // mov rbx, rdi
+    emit8(REX_W);
+    emit8(0x89);
+    emit8(0xFB);
+    // mov r12, [rbx+registersOffset]
+    emit8(0x4C);
+    emit8(0x8B);
+    emit8(0x63);
+    emit8(registersOffset);
+    // mov r13, [rbx+cpuOffset]
+    emit8(0x4C);
+    emit8(0x8B);
+    emit8(0x6B);
+    emit8(cpuOffset);
+    // jmp rsi
+    emit8(0xFF);
+    emit8(0xE6);
+}
+
+auto X86Emitter::emit_exit() -> void
+{
+    // pop r13; pop r12; pop rbx; ret
+    emit8(REX_B);
+    emit8(0x5D);
+    emit8(REX_B);
+    emit8(0x5C);
+    emit8(0x5B);
+    emit8(0xC3);
+}
+
+auto X86Emitter::patch(uint8_t* rel32, const uint8_t* target) -> void
+{
+    const auto displacement = int32_t(target - (rel32 + 4));
+    memcpy(rel32, &displacement, sizeof(displacement));
+}
+
+auto X86Emitter::emit8(uint8_t value) -> void
+{
+    *m_cursor++ = value;
+}
+
+auto X86Emitter::emit16(uint16_t value) -> void
+{
+    memcpy(m_cursor, &value, sizeof(value));
+    m_cursor += sizeof(value);
+}
+
+auto X86Emitter::emit32(uint32_t value) -> void
+{
+    memcpy(m_cursor, &value, sizeof(value));
+    m_cursor += sizeof(value);
+}
+
+auto X86Emitter::emit64(uint64_t value) -> void
+{
+    memcpy(m_cursor, &value, sizeof(value));
+    m_cursor += sizeof(value);
+}
+
+auto X86Emitter::emit_r12_operand(uint8_t reg, uint8_t offset) -> void
+{
+    // ModRM with a disp8 and r12 (through REX.B) as base, which always needs a SIB byte
+    emit8(0x44 | reg << 3);
+    emit8(0x24);
+    emit8(offset);
+}
+
+auto X86Emitter::emit_rel32() -> uint8_t*
+{
+    auto site = m_cursor;
+    emit32(0);
+    return site;
+}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace GameBoy {
+
+// Encodes the handful of x86-64 instructions the JIT needs. Generated code keeps
+//   rbx: the JitContext
+//   r12: the guest RegisterFile
+//   r13: the CPU, passed along to opcode handlers
+// Fields of the register file and the context are addressed with 8-bit displacements.
+class X86Emitter {
+public:
+    X86Emitter(uint8_t* cursor);
+
+    auto position() const -> uint8_t*;
+
+    // Guest register file
+    auto load_register8(uint8_t offset) -> void; // mov al, [r12+offset]
+    auto store_register8(uint8_t offset) -> void; // mov [r12+offset], al
+    auto store_register8(uint8_t offset, uint8_t value) -> void; // mov byte [r12+offset], imm8
+    auto load_register16(uint8_t offset) -> void; // mov ax, [r12+offset]
+    auto store_register16(uint8_t offset) -> void; // mov [r12+offset], ax
+    auto store_register16(uint8_t offset, uint16_t value) -> void; // mov word [r12+offset], imm16
+    auto increment_register16(uint8_t offset) -> void; // inc word [r12+offset]
+    auto decrement_register16(uint8_t offset) -> void; // dec word [r12+offset]
+
+    // JitContext
+    auto add_context64(uint8_t offset, int32_t value) -> void; // add qword [rbx+offset], imm32
+    auto add_context64_from_rax(uint8_t offset) -> void; // add [rbx+offset], rax
+
+    // Calls handler(cpu, instruction) and leaves the zero-extended uint8_t result in rax
+    auto call_handler(const void* handler, const void* instruction) -> void;
+
+    // Conditional and unconditional jumps with a rel32 to patch later. Each returns the
+    // address of its rel32 field.
+    auto jump_if_byte_zero(const void* address) -> uint8_t*;
+    auto jump_if_context_above_or_equal(uint8_t offset, uint8_t limitOffset) -> uint8_t*;
+    auto jump_if_register16_equals(uint8_t offset, uint16_t value) -> uint8_t*;
+    auto jump() -> uint8_t*;
+
+    // Entry trampoline: enter(JitContext* context, const uint8_t* code)
+    auto emit_enter(uint8_t registersOffset, uint8_t cpuOffset) -> void;
+    // Restores what the trampoline saved and returns to its caller
+    auto emit_exit() -> void;
+
+    static auto patch(uint8_t* rel32, const uint8_t* target) -> void;
+
+private:
+    auto emit8(uint8_t) -> void;
+    auto emit16(uint16_t) -> void;
+    auto emit32(uint32_t) -> void;
+    auto emit64(uint64_t) -> void;
+    auto emit_r12_operand(uint8_t reg, uint8_t offset) -> void;
+    auto emit_rel32() -> uint8_t*;
+
+    uint8_t* m_cursor;
+};
+
+}
@@ -0,0 +1,28 @@
+#include "memory/AddressReference.h"
+
+#include "memory/Memory.h"
+
+namespace GameBoy {
+
+AddressReference::AddressReference(Memory& memory, uint16_t address)
+    : m_memory(memory)
+    , m_address(address) {};
+
+AddressReference::~AddressReference() = default;
+
+auto AddressReference::clone() -> std::unique_ptr<ByteAddressable>
+{
+    return std::make_unique<AddressReference>(m_memory, m_address);
+}
+
+auto AddressReference::read8() -> uint8_t
+{
+    return m_memory.read8(m_address);
+}
+
+auto AddressReference::write8(uint8_t value) -> void
+{
+    m_memory.write8(m_address, value);
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "memory/ByteAddressable.h"
+
+namespace GameBoy {
+
+class Memory;
+
+// References one address in memory, going through the memory map on every access
+class AddressReference : public ByteAddressable {
+public:
+    AddressReference(Memory&, uint16_t address);
+    ~AddressReference() override;
+
+    auto clone() -> std::unique_ptr<ByteAddressable> override;
+
+    auto read8() -> uint8_t override;
+
+    auto write8(uint8_t value) -> void override;
+
+private:
+    Memory& m_memory;
+    uint16_t m_address;
+};
+
+}
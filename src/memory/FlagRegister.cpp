@@ -1,40 +1,34 @@
 #include "memory/FlagRegister.h"
 
-#include <bitset>
-
 namespace GameBoy {
 
-using namespace std;
-
-FlagRegister::FlagRegister(std::unique_ptr<ByteAddressable>&& flagRef)
-    : m_flagRef(move(flagRef)) {};
+FlagRegister::FlagRegister(uint8_t& f)
+    : m_f(f) {};
 
 auto FlagRegister::set_zero(bool value) -> void
 {
-    set_bit(7, value);
+    set_bit(Flags::ZERO, value);
 }
 
 auto FlagRegister::set_substract(bool value) -> void
 {
-    set_bit(6, value);
+    set_bit(Flags::SUBTRACT, value);
 }
 
 auto FlagRegister::set_half_carry(bool value) -> void
 {
-    set_bit(5, value);
+    set_bit(Flags::HALF_CARRY, value);
 }
 
 auto FlagRegister::set_carry(bool value) -> void
 {
-    set_bit(4, value);
+    set_bit(Flags::CARRY, value);
 }
 
-auto FlagRegister::set_bit(size_t pos, bool value) -> void
+auto FlagRegister::set_bit(uint8_t mask, bool value) -> void
 {
-    bitset<8> flagBits { m_flagRef->read8() };
-    flagBits.set(pos, value);
-    auto newFlagValue = uint8_t(flagBits.to_ulong());
-    m_flagRef->write8(newFlagValue);
+    materialise();
+    m_f = value ? m_f | mask : m_f & ~mask;
 }
 
 }
@@ -1,14 +1,41 @@
 #pragma once
 
-#include "memory/ByteAddressable.h"
+#include "RegisterFile.h"
 
-#include <memory>
+#include <stdint.h>
 
 namespace GameBoy {
 
+// Owns F while the CPU runs. ALU instructions only record what they computed; Z/N/H/C are
+// worked out when something actually looks at them, which most of the time nothing does
+// before the next ALU instruction replaces them. F is brought up to date whenever the CPU
+// stops executing, so outside of it the register file can be read and written as usual.
 class FlagRegister {
 public:
-    FlagRegister(std::unique_ptr<ByteAddressable>&& flagRef);
+    FlagRegister(uint8_t& f);
+
+    FlagRegister(const FlagRegister&) = delete;
+    auto operator=(const FlagRegister&) -> FlagRegister& = delete;
+
+    // 8-bit add or subtract, with or without carry. result is the untruncated 16-bit sum or
+    // difference, so a borrow shows up above the low byte.
+    auto defer_add(uint8_t a, uint8_t b, uint16_t result) -> void;
+    auto defer_subtract(uint8_t a, uint8_t b, uint16_t result) -> void;
+    // AND sets H; XOR and OR clear it
+    auto defer_logic(uint8_t result, bool halfCarry) -> void;
+    // INC and DEC leave C as it was
+    auto defer_increment(uint8_t a, uint8_t result) -> void;
+    auto defer_decrement(uint8_t a, uint8_t result) -> void;
+
+    auto zero() const -> bool;
+    auto carry() const -> bool;
+
+    // The up-to-date value of F
+    auto value() -> uint8_t;
+    // Replaces every flag, dropping anything still pending
+    auto set(uint8_t value) -> void;
+    // Writes any pending flags to F
+    auto materialise() -> void;
 
     auto set_zero(bool) -> void;
     auto set_substract(bool) -> void;
@@ -16,9 +43,124 @@ public:
     auto set_carry(bool) -> void;
 
 private:
-    auto set_bit(size_t pos, bool) -> void;
+    enum class Operation : uint8_t {
+        // F holds the flags
+        None,
+        Add,
+        Subtract,
+        Logic,
+        Increment,
+        Decrement,
+    };
 
-    std::unique_ptr<ByteAddressable> m_flagRef;
+    auto set_bit(uint8_t mask, bool) -> void;
+
+    uint8_t& m_f;
+    Operation m_operation = Operation::None;
+    // The only flag not derived from the result: H after AND, C before INC/DEC
+    bool m_flag = false;
+    // a ^ b; bit 4 of this and the result gives the carry out of the low nibble
+    uint8_t m_operands = 0;
+    uint16_t m_result = 0;
 };
 
+inline auto FlagRegister::defer_add(uint8_t a, uint8_t b, uint16_t result) -> void
+{
+    m_operation = Operation::Add;
+    m_operands = a ^ b;
+    m_result = result;
+}
+
+inline auto FlagRegister::defer_subtract(uint8_t a, uint8_t b, uint16_t result) -> void
+{
+    m_operation = Operation::Subtract;
+    m_operands = a ^ b;
+    m_result = result;
+}
+
+inline auto FlagRegister::defer_logic(uint8_t result, bool halfCarry) -> void
+{
+    m_operation = Operation::Logic;
+    m_flag = halfCarry;
+    m_result = result;
+}
+
+inline auto FlagRegister::defer_increment(uint8_t a, uint8_t result) -> void
+{
+    m_flag = carry();
+    m_operation = Operation::Increment;
+    m_operands = a ^ 1;
+    m_result = result;
+}
+
+inline auto FlagRegister::defer_decrement(uint8_t a, uint8_t result) -> void
+{
+    m_flag = carry();
+    m_operation = Operation::Decrement;
+    m_operands = a ^ 1;
+    m_result = result;
+}
+
+inline auto FlagRegister::zero() const -> bool
+{
+    if (m_operation == Operation::None)
+        return m_f & Flags::ZERO;
+    return uint8_t(m_result) == 0;
+}
+
+inline auto FlagRegister::carry() const -> bool
+{
+    switch (m_operation) {
+    case Operation::None:
+        return m_f & Flags::CARRY;
+    case Operation::Add:
+    case Operation::Subtract:
+        return m_result > 0xFF;
+    case Operation::Logic:
+        return false;
+    default:
+        return m_flag;
+    }
+}
+
+inline auto FlagRegister::value() -> uint8_t
+{
+    materialise();
+    return m_f;
+}
+
+inline auto FlagRegister::set(uint8_t value) -> void
+{
+    m_operation = Operation::None;
+    m_f = value;
+}
+
+inline auto FlagRegister::materialise() -> void
+{
+    if (m_operation == Operation::None)
+        return;
+
+    const uint8_t zero = uint8_t(m_result) ? 0 : Flags::ZERO;
+    const uint8_t halfCarry = ((m_operands ^ m_result) & 0x10) ? Flags::HALF_CARRY : 0;
+    const uint8_t carryFlag = m_flag ? Flags::CARRY : 0;
+    switch (m_operation) {
+    case Operation::Add:
+        m_f = zero | halfCarry | (m_result > 0xFF ? Flags::CARRY : 0);
+        break;
+    case Operation::Subtract:
+        m_f = zero | Flags::SUBTRACT | halfCarry | (m_result > 0xFF ? Flags::CARRY : 0);
+        break;
+    case Operation::Logic:
+        m_f = zero | (m_flag ? Flags::HALF_CARRY : 0);
+        break;
+    case Operation::Increment:
+        m_f = zero | halfCarry | carryFlag;
+        break;
+    default:
+        m_f = zero | Flags::SUBTRACT | halfCarry | carryFlag;
+        break;
+    }
+    m_operation = Operation::None;
+}
+
 }
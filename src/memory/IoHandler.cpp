@@ -0,0 +1,12 @@
+#include "memory/IoHandler.h"
+
+namespace GameBoy {
+
+IoHandler::~IoHandler() = default;
+
+auto IoHandler::next_change(uint16_t, uint64_t cycle) -> uint64_t
+{
+    return cycle;
+}
+
+}
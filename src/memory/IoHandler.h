@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace GameBoy {
+
+// Traps reads and writes to addresses that aren't plain memory: I/O registers, cartridge
+// bank controllers and anything else whose accesses have side effects
+class IoHandler {
+public:
+    virtual ~IoHandler();
+
+    virtual auto read8(uint16_t address) -> uint8_t = 0;
+    virtual auto write8(uint16_t address, uint8_t value) -> void = 0;
+
+    // The first cycle after cycle at which reading address could give something other than it
+    // does at cycle, short of a write. Returning cycle itself, as the default does, means it
+    // could change at any time.
+    virtual auto next_change(uint16_t address, uint64_t cycle) -> uint64_t;
+};
+
+}
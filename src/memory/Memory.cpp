@@ -1,34 +1,321 @@
 #include "memory/Memory.h"
 
+#include "memory/AddressReference.h"
 #include "memory/ByteReference.h"
 #include "memory/CompositeWordReference.h"
 #include "memory/WordReference.h"
+#include "state/StateStream.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 
 namespace GameBoy {
 
 constexpr size_t MEM_SIZE = 0x10000;
 
+constexpr uint8_t ECHO_FIRST_PAGE = 0xE0;
+constexpr uint8_t ECHO_LAST_PAGE = 0xFD;
+constexpr uint16_t ECHO_OFFSET = 0x2000;
+constexpr uint16_t VIDEO_RAM_START = 0x8000;
+constexpr uint8_t VIDEO_RAM_FIRST_PAGE = 0x80;
+constexpr uint8_t VIDEO_RAM_LAST_PAGE = 0x9F;
+constexpr uint16_t OAM_START = 0xFE00;
+constexpr uint16_t OAM_END = 0xFEA0;
+constexpr uint8_t OAM_PAGE = 0xFE;
+constexpr uint8_t HIGH_PAGE = 0xFF;
+constexpr uint8_t LOCKED_BUS_VALUE = 0xFF;
+
 Memory::Memory()
     : m_memory(MEM_SIZE)
-    , m_stackPointer(0xFFFF)
-    , m_programCounter(0)
+    , m_registers {}
+{
+    m_registers.sp = 0xFFFF;
+    m_registers.pc = 0;
+
+    unmap(0x00, ECHO_FIRST_PAGE);
+}
+
+auto Memory::map_ram(uint8_t firstPage, uint8_t count, uint8_t* data) -> void
+{
+    for (uint8_t i = 0; i < count; ++i) {
+        const uint8_t page = firstPage + i;
+        const bool remapped = m_pages[page].data != data + (i << 8) || m_pages[page].handler;
+        m_pages[page].data = data + (i << 8);
+        m_pages[page].handler = nullptr;
+        update_pointers(page);
+        if (remapped)
+            report_remapped(page);
+    }
+}
+
+auto Memory::map_rom(uint8_t firstPage, uint8_t count, const uint8_t* data, IoHandler* writeHandler) -> void
+{
+    assert(writeHandler);
+    for (uint8_t i = 0; i < count; ++i) {
+        const uint8_t page = firstPage + i;
+        // The handler takes every write, so the bytes are only ever read
+        m_pages[page].data = const_cast<uint8_t*>(data) + (i << 8);
+        m_pages[page].handler = writeHandler;
+        update_pointers(page);
+    }
+}
+
+auto Memory::map_handler(uint8_t firstPage, uint8_t count, IoHandler* handler) -> void
+{
+    for (uint8_t i = 0; i < count; ++i) {
+        const uint8_t page = firstPage + i;
+        const bool remapped = m_pages[page].data || m_pages[page].handler != handler;
+        m_pages[page] = { nullptr, nullptr, nullptr, handler };
+        if (remapped)
+            report_remapped(page);
+    }
+}
+
+auto Memory::map_io(uint16_t address, IoHandler* handler) -> void
+{
+    assert(address >> 8 == HIGH_PAGE);
+    m_ioHandlers[address & 0xFF] = handler;
+}
+
+auto Memory::unmap(uint8_t firstPage, uint8_t count) -> void
+{
+    assert(firstPage + count <= ECHO_FIRST_PAGE);
+    map_ram(firstPage, count, &m_memory[firstPage << 8]);
+}
+
+auto Memory::fixed_rom_bank() const -> uint16_t
+{
+    return m_fixedRomBank;
+}
+
+auto Memory::switchable_rom_bank() const -> uint16_t
+{
+    return m_romBank;
+}
+
+auto Memory::set_rom_banks(uint16_t fixed, uint16_t switchable) -> void
+{
+    const bool fixedChanged = fixed != m_fixedRomBank;
+    m_fixedRomBank = fixed;
+    m_romBank = switchable;
+    if (fixedChanged && m_fixedBankWatcher)
+        m_fixedBankWatcher();
+}
+
+auto Memory::set_fixed_bank_watcher(std::function<void()> watcher) -> void
+{
+    m_fixedBankWatcher = move(watcher);
+}
+
+auto Memory::set_write_watcher(std::function<void(uint16_t)> watcher) -> void
+{
+    m_writeWatcher = move(watcher);
+}
+
+auto Memory::set_video_ram_watcher(std::function<void(uint16_t)> watcher) -> void
+{
+    m_videoRamWatcher = move(watcher);
+    for (auto page = VIDEO_RAM_FIRST_PAGE; page <= VIDEO_RAM_LAST_PAGE; ++page)
+        update_pointers(page);
+}
+
+auto Memory::set_oam_watcher(std::function<void(uint16_t, uint16_t)> watcher) -> void
+{
+    m_oamWatcher = move(watcher);
+}
+
+auto Memory::watch_page(uint8_t page) -> void
+{
+    assert(m_writeWatcher);
+    ++m_watchedPages[page];
+    update_pointers(page);
+}
+
+auto Memory::unwatch_page(uint8_t page) -> void
+{
+    assert(m_watchedPages[page] > 0);
+    --m_watchedPages[page];
+    update_pointers(page);
+}
+
+auto Memory::report_changed(uint16_t address, uint16_t count) -> void
+{
+    for (uint32_t current = address; current < uint32_t(address) + count; ++current) {
+        // Each report may drop the last watch on the page
+        if (m_watchedPages[current >> 8])
+            m_writeWatcher(uint16_t(current));
+    }
+}
+
+auto Memory::save_state(StateWriter& writer) const -> void
+{
+    writer.write_bytes(m_memory.data(), m_memory.size());
+    writer.write(m_busLocked);
+    writer.write(m_busLockedUntil);
+}
+
+auto Memory::load_state(StateReader& reader) -> void
+{
+    const auto* bytes = reader.view(MEM_SIZE);
+    if (!bytes)
+        return;
+    for (int page = 0; page < 0x100; ++page) {
+        const auto offset = page << 8;
+        if (m_watchedPages[page] && std::memcmp(&m_memory[offset], bytes + offset, 0x100))
+            report_changed(offset, 0x100);
+    }
+    std::memcpy(m_memory.data(), bytes, MEM_SIZE);
+
+    bool locked;
+    uint64_t until;
+    reader.read(locked);
+    reader.read(until);
+    if (locked)
+        lock_bus(until);
+    else if (m_busLocked)
+        unlock_bus();
+}
+
+auto Memory::copy_to_oam(uint16_t source) -> void
+{
+    assert(!(source & 0xFF));
+    uint8_t page = source >> 8;
+    if (page >= ECHO_FIRST_PAGE)
+        page -= ECHO_OFFSET >> 8;
+
+    const auto size = OAM_END - OAM_START;
+    if (m_pages[page].data) {
+        std::memcpy(&m_memory[OAM_START], m_pages[page].data, size);
+    } else {
+        // Nothing to copy from directly, so ask whoever handles the page
+        const bool locked = m_busLocked;
+        m_busLocked = false;
+        for (uint16_t offset = 0; offset < size; ++offset)
+            m_memory[OAM_START + offset] = read_trapped((page << 8) + offset);
+        m_busLocked = locked;
+    }
+    if (m_oamWatcher)
+        m_oamWatcher(OAM_START, size);
+}
+
+auto Memory::lock_bus(uint64_t until) -> void
+{
+    m_busLocked = true;
+    m_busLockedUntil = until;
+    for (int page = 0; page < HIGH_PAGE; ++page)
+        update_pointers(page);
+}
+
+auto Memory::unlock_bus() -> void
+{
+    m_busLocked = false;
+    for (int page = 0; page < HIGH_PAGE; ++page)
+        update_pointers(page);
+}
+
+auto Memory::report_remapped(uint8_t page) -> void
+{
+    // Code cached from ROM is told apart by bank, but RAM (cartridge RAM banks, or RAM
+    // disabled) is only known by address
+    if (m_watchedPages[page])
+        report_changed(uint16_t(page << 8), 0x100);
+}
+
+auto Memory::read_trapped(uint16_t address) -> uint8_t
+{
+    const uint8_t page = address >> 8;
+    if (m_busLocked && page != HIGH_PAGE)
+        return LOCKED_BUS_VALUE;
+    if (m_pages[page].handler)
+        return m_pages[page].handler->read8(address);
+
+    if (page == HIGH_PAGE) {
+        if (auto* handler = m_ioHandlers[address & 0xFF])
+            return handler->read8(address);
+        return m_memory[address];
+    }
+    if (page == OAM_PAGE)
+        return address < OAM_END ? m_memory[address] : 0x00;
+    // Echo of C000-DDFF
+    return read8(address - ECHO_OFFSET);
+}
+
+auto Memory::video_ram() const -> const uint8_t*
 {
-    m_registers = std::unordered_map<Register, uint8_t> {
-        { Register::A, 0 },
-        { Register::B, 0 },
-        { Register::C, 0 },
-        { Register::D, 0 },
-        { Register::E, 0 },
-        { Register::F, 0 },
-        { Register::H, 0 },
-        { Register::L, 0 }
-    };
+    return &m_memory[VIDEO_RAM_START];
+}
+
+auto Memory::oam() const -> const uint8_t*
+{
+    return &m_memory[OAM_START];
+}
+
+auto Memory::next_change(uint16_t address, uint64_t cycle) -> uint64_t
+{
+    // Pages read straight from host memory only change when written, like plain memory
+    const uint8_t page = address >> 8;
+    if (m_busLocked && page != HIGH_PAGE)
+        return std::max(m_busLockedUntil, cycle);
+    const auto& entry = m_pages[page];
+    if (!entry.data && entry.handler)
+        return entry.handler->next_change(address, cycle);
+    if (page == HIGH_PAGE) {
+        if (auto* handler = m_ioHandlers[address & 0xFF])
+            return handler->next_change(address, cycle);
+    }
+    return UINT64_MAX;
+}
+
+auto Memory::write_trapped(uint16_t address, uint8_t value) -> void
+{
+    const uint8_t page = address >> 8;
+    if (m_busLocked && page != HIGH_PAGE)
+        return;
+    auto& entry = m_pages[page];
+    if (entry.handler) {
+        entry.handler->write8(address, value);
+        return;
+    }
+
+    if (page == HIGH_PAGE) {
+        if (auto* handler = m_ioHandlers[address & 0xFF]) {
+            handler->write8(address, value);
+            return;
+        }
+    } else if (page == OAM_PAGE) {
+        // FEA0-FEFF ignores writes
+        if (address >= OAM_END)
+            return;
+    } else if (!entry.data) {
+        // Echo of C000-DDFF
+        write8(address - ECHO_OFFSET, value);
+        return;
+    }
+
+    if (m_watchedPages[page])
+        m_writeWatcher(address);
+    if (entry.data)
+        entry.data[address & 0xFF] = value;
+    else
+        m_memory[address] = value;
+    if (page == OAM_PAGE && m_oamWatcher)
+        m_oamWatcher(address, 1);
+    else if (m_videoRamWatcher && page >= VIDEO_RAM_FIRST_PAGE && page <= VIDEO_RAM_LAST_PAGE)
+        m_videoRamWatcher(address);
+}
+
+auto Memory::update_pointers(uint8_t page) -> void
+{
+    auto& entry = m_pages[page];
+    const bool videoRam = m_videoRamWatcher && page >= VIDEO_RAM_FIRST_PAGE && page <= VIDEO_RAM_LAST_PAGE;
+    entry.read = m_busLocked ? nullptr : entry.data;
+    entry.write = entry.handler || m_watchedPages[page] || videoRam || m_busLocked ? nullptr : entry.data;
 }
 
 auto Memory::get_ref(uint16_t address) -> std::unique_ptr<ByteAddressable>
 {
-    // For now, just assume everything is a big RAM bank
-    return std::make_unique<ByteReference>(m_memory.at(address));
+    return std::make_unique<AddressReference>(*this, address);
 }
 
 auto Memory::get_word_ref(uint16_t address) -> std::unique_ptr<WordAddressable>
@@ -43,35 +330,12 @@ auto Memory::get_word_ref(uint16_t address) -> std::unique_ptr<WordAddressable>
 
 auto Memory::get_register(Register registerName) -> std::unique_ptr<ByteAddressable>
 {
-    return std::make_unique<ByteReference>(m_registers.at(registerName));
+    return std::make_unique<ByteReference>(m_registers[registerName]);
 }
 
 auto Memory::get_word_register(WordRegister registerName) -> std::unique_ptr<WordAddressable>
 {
-    switch (registerName) {
-    case WordRegister::AF:
-        return std::make_unique<CompositeWordReference>(
-            get_register(Register::A),
-            get_register(Register::F));
-    case WordRegister::BC:
-        return std::make_unique<CompositeWordReference>(
-            get_register(Register::B),
-            get_register(Register::C));
-    case WordRegister::DE:
-        return std::make_unique<CompositeWordReference>(
-            get_register(Register::D),
-            get_register(Register::E));
-    case WordRegister::HL:
-        return std::make_unique<CompositeWordReference>(
-            get_register(Register::H),
-            get_register(Register::L));
-    case WordRegister::SP:
-        return std::make_unique<WordReference>(m_stackPointer);
-    case WordRegister::PC:
-        return std::make_unique<WordReference>(m_programCounter);
-    default:
-        abort();
-    }
+    return std::make_unique<WordReference>(m_registers[registerName]);
 }
 
 auto Memory::operator[](Register registerName) -> NewByteReference
@@ -1,17 +1,23 @@
 #pragma once
 
+#include "RegisterFile.h"
 #include "Registers.h"
 #include "memory/ByteAddressable.h"
+#include "memory/IoHandler.h"
 #include "memory/NewByteReference.h"
 #include "memory/NewWordReference.h"
 #include "memory/WordAddressable.h"
 
+#include <array>
+#include <functional>
 #include <memory>
-#include <unordered_map>
 #include <vector>
 
 namespace GameBoy {
 
+class StateReader;
+class StateWriter;
+
 /*
 Memory Model:
      Interrupt Enable Register
@@ -39,14 +45,93 @@ Memory Model:
      16kB ROM bank #0                 |
     --------------------------- 0000 --
 */
+//
+// Every 256-byte page has an entry in a page table. A page backed by host memory is read with a
+// single load, and written with one too unless writes to it need to be trapped. Anything else
+// goes to the page's IoHandler, or, for the echo region, OAM and FF00-FFFF, to Memory itself.
+// Without a cartridge 0000-DFFF is plain RAM.
 class Memory {
 public:
     Memory();
 
+    Memory(const Memory&) = delete;
+    auto operator=(const Memory&) -> Memory& = delete;
+
+    // Plain value accessors for the execution engine; these never allocate
+    auto read8(uint16_t address) -> uint8_t;
+    auto write8(uint16_t address, uint8_t value) -> void;
+    auto read16(uint16_t address) -> uint16_t;
+    auto write16(uint16_t address, uint16_t value) -> void;
+
+    // The first cycle after cycle at which address could read differently without being
+    // written, as its IoHandler sees it. Plain memory never changes by itself.
+    auto next_change(uint16_t address, uint64_t cycle) -> uint64_t;
+
+    // Points count pages starting at firstPage at data, which must outlive the mapping. Bank
+    // switches remap pages this way rather than copying.
+    auto map_ram(uint8_t firstPage, uint8_t count, uint8_t* data) -> void;
+    // As map_ram, but the pages are read-only and writes go to writeHandler instead, as for
+    // cartridge ROM and its bank controller
+    auto map_rom(uint8_t firstPage, uint8_t count, const uint8_t* data, IoHandler* writeHandler) -> void;
+    // Sends every access to count pages starting at firstPage to handler
+    auto map_handler(uint8_t firstPage, uint8_t count, IoHandler* handler) -> void;
+    // Sends accesses to a single FF00-FFFF register to handler, or back to plain storage if null
+    auto map_io(uint16_t address, IoHandler* handler) -> void;
+    // Returns count pages starting at firstPage to the built-in RAM
+    auto unmap(uint8_t firstPage, uint8_t count) -> void;
+
+    // Banks currently mapped at 0000-3FFF and 4000-7FFF
+    auto fixed_rom_bank() const -> uint16_t;
+    auto switchable_rom_bank() const -> uint16_t;
+    // Called by whoever maps ROM, so cached code can be told apart by bank
+    auto set_rom_banks(uint16_t fixed, uint16_t switchable) -> void;
+    // Told whenever set_rom_banks maps a different bank at 0000-3FFF
+    auto set_fixed_bank_watcher(std::function<void()>) -> void;
+
+    // Writes through write8/write16 that land in a watched 256-byte page are reported to the
+    // watcher before they do. Watches are counted, so every watch_page needs a matching
+    // unwatch_page. A watched page loses its direct write pointer until the last unwatch.
+    auto set_write_watcher(std::function<void(uint16_t address)>) -> void;
+    auto watch_page(uint8_t page) -> void;
+    auto unwatch_page(uint8_t page) -> void;
+    // Tells the watcher of count bytes from address that changed without being written, as
+    // when a snapshot is loaded. Only addresses in watched pages are passed on.
+    auto report_changed(uint16_t address, uint16_t count) -> void;
+
+    // Told the address of every write to VRAM (8000-9FFF) once it has landed, so decoded
+    // tiles can be dropped or the write passed on. VRAM loses its direct write pointers while
+    // it is set.
+    auto set_video_ram_watcher(std::function<void(uint16_t address)>) -> void;
+    // Likewise for OAM (FE00-FE9F), told of count bytes from address: one for a write, all of
+    // OAM after a DMA
+    auto set_oam_watcher(std::function<void(uint16_t address, uint16_t count)>) -> void;
+
+    // OAM DMA's transfer all at once: the 160 bytes from source, a multiple of 100, to OAM.
+    // Sources from E000 up read the echo of C000-DFFF, as the DMA sees it.
+    auto copy_to_oam(uint16_t source) -> void;
+    // While locked, as during OAM DMA, only FF00-FFFF can be reached: everything else reads
+    // FF and ignores writes. until is the cycle it is due to lift, which next_change gives.
+    auto lock_bus(uint64_t until) -> void;
+    auto unlock_bus() -> void;
+    auto bus_locked() const -> bool { return m_busLocked; }
+
     // Returns a pointer to an interface that allows reading and writing
     auto get_ref(uint16_t address) -> std::unique_ptr<ByteAddressable>;
     auto get_word_ref(uint16_t address) -> std::unique_ptr<WordAddressable>;
 
+    // Direct access to the register file, for code that can't afford a reference per access
+    auto registers() -> RegisterFile& { return m_registers; }
+
+    // The built-in VRAM (8000-9FFF) and OAM (FE00-FE9F), for the PPU to read without going
+    // through the page table
+    auto video_ram() const -> const uint8_t*;
+    auto oam() const -> const uint8_t*;
+
+    // The built-in memory and whether the bus is locked. Registers are the CPU's to save, and
+    // the cartridge puts back what it maps. Loading reports whatever changed in watched pages.
+    auto save_state(StateWriter&) const -> void;
+    auto load_state(StateReader&) -> void;
+
     auto get_register(Register registerName) -> std::unique_ptr<ByteAddressable>;
     auto get_word_register(WordRegister registerName) -> std::unique_ptr<WordAddressable>;
 
@@ -58,10 +143,67 @@ public:
     auto deref_word(WordAddressable& addressRef, int16_t offset = 0) -> std::unique_ptr<WordAddressable>;
 
 private:
+    struct Page {
+        // Host memory backing the page, or null if every access is trapped. Never written
+        // through while the page has a handler.
+        uint8_t* data = nullptr;
+        // data, while reads from the page can come straight from it
+        const uint8_t* read = nullptr;
+        // data, while writes to the page can land directly
+        uint8_t* write = nullptr;
+        IoHandler* handler = nullptr;
+    };
+
+    auto read_trapped(uint16_t address) -> uint8_t;
+    auto write_trapped(uint16_t address, uint8_t value) -> void;
+    auto update_pointers(uint8_t page) -> void;
+    // Tells the write watcher a page now reads from somewhere else
+    auto report_remapped(uint8_t page) -> void;
+
     std::vector<uint8_t> m_memory;
-    uint16_t m_stackPointer;
-    uint16_t m_programCounter;
-    std::unordered_map<Register, uint8_t> m_registers;
+    RegisterFile m_registers;
+    uint16_t m_fixedRomBank = 0;
+    uint16_t m_romBank = 1;
+
+    std::array<Page, 0x100> m_pages;
+    std::array<IoHandler*, 0x100> m_ioHandlers {};
+
+    std::array<uint16_t, 0x100> m_watchedPages {};
+    std::function<void()> m_fixedBankWatcher;
+    std::function<void(uint16_t)> m_writeWatcher;
+    std::function<void(uint16_t)> m_videoRamWatcher;
+    std::function<void(uint16_t, uint16_t)> m_oamWatcher;
+
+    bool m_busLocked = false;
+    uint64_t m_busLockedUntil = 0;
 };
 
+inline auto Memory::read8(uint16_t address) -> uint8_t
+{
+    const auto* read = m_pages[address >> 8].read;
+    if (read)
+        return read[address & 0xFF];
+    return read_trapped(address);
+}
+
+inline auto Memory::write8(uint16_t address, uint8_t value) -> void
+{
+    auto* write = m_pages[address >> 8].write;
+    if (write)
+        write[address & 0xFF] = value;
+    else
+        write_trapped(address, value);
+}
+
+inline auto Memory::read16(uint16_t address) -> uint16_t
+{
+    return uint16_t(read8(address)) | uint16_t(read8(address + 1) << 8);
+}
+
+inline auto Memory::write16(uint16_t address, uint16_t value) -> void
+{
+    write8(address, uint8_t(value));
+    write8(address + 1, uint8_t(value >> 8));
+}
+
 }
@@ -0,0 +1,151 @@
+#include "state/SaveState.h"
+
+#include "CPU.h"
+#include "audio/Apu.h"
+#include "cartridge/Cartridge.h"
+#include "io/Timer.h"
+#include "memory/Memory.h"
+#include "state/StateStream.h"
+#include "video/OamDma.h"
+#include "video/Ppu.h"
+
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GAMEBOY_HAS_MMAP 1
+#endif
+
+namespace GameBoy {
+
+using namespace std;
+
+constexpr uint32_t CPU_CHUNK = chunk_tag("CPU ");
+constexpr uint32_t SCHEDULER_CHUNK = chunk_tag("SCHD");
+constexpr uint32_t INTERRUPTS_CHUNK = chunk_tag("INT ");
+constexpr uint32_t MEMORY_CHUNK = chunk_tag("MEM ");
+constexpr uint32_t CARTRIDGE_CHUNK = chunk_tag("CART");
+constexpr uint32_t TIMER_CHUNK = chunk_tag("TIMR");
+constexpr uint32_t PPU_CHUNK = chunk_tag("PPU ");
+constexpr uint32_t DMA_CHUNK = chunk_tag("DMA ");
+constexpr uint32_t APU_CHUNK = chunk_tag("APU ");
+
+namespace {
+
+    // Calls visit with the tag and device of every chunk the machine has, in the order they
+    // load: memory before the cartridge maps into it and the PPU reloads sprites from it
+    template <typename Visit>
+    auto for_each_device(const Machine& machine, Visit&& visit) -> void
+    {
+        visit(CPU_CHUNK, machine.cpu);
+        visit(SCHEDULER_CHUNK, machine.cpu.scheduler());
+        visit(INTERRUPTS_CHUNK, machine.cpu.interrupts());
+        visit(MEMORY_CHUNK, machine.cpu.memory);
+        if (machine.cartridge)
+            visit(CARTRIDGE_CHUNK, *machine.cartridge);
+        if (machine.timer)
+            visit(TIMER_CHUNK, *machine.timer);
+        if (machine.ppu)
+            visit(PPU_CHUNK, *machine.ppu);
+        if (machine.dma)
+            visit(DMA_CHUNK, *machine.dma);
+        if (machine.apu)
+            visit(APU_CHUNK, *machine.apu);
+    }
+
+}
+
+auto save_state(const Machine& machine, vector<uint8_t>& snapshot) -> void
+{
+    StateWriter writer(&snapshot);
+    writer.write_header();
+    for_each_device(machine, [&](uint32_t tag, const auto& device) {
+        writer.begin_chunk(tag);
+        device.save_state(writer);
+        writer.end_chunk();
+    });
+}
+
+auto load_state(const Machine& machine, const uint8_t* snapshot, size_t size) -> bool
+{
+    StateReader reader(snapshot, size);
+    if (!reader.valid())
+        return false;
+
+    // Every chunk must be the size this machine's would be, which leaves nothing that can go
+    // wrong halfway through
+    size_t devices = 0;
+    bool sizesMatch = true;
+    for_each_device(machine, [&](uint32_t tag, const auto& device) {
+        StateWriter counter(nullptr);
+        device.save_state(counter);
+        sizesMatch = sizesMatch && reader.chunk_size(tag) == counter.size();
+        ++devices;
+    });
+    if (!sizesMatch || reader.num_chunks() != devices)
+        return false;
+    if (machine.cartridge && !(reader.open_chunk(CARTRIDGE_CHUNK) && machine.cartridge->state_matches(reader)))
+        return false;
+
+    for_each_device(machine, [&](uint32_t tag, auto& device) {
+        reader.open_chunk(tag);
+        device.load_state(reader);
+    });
+    return !reader.failed();
+}
+
+auto write_state_file(const string& path, const vector<uint8_t>& snapshot) -> bool
+{
+#ifdef GAMEBOY_HAS_MMAP
+    const auto fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    const auto* data = snapshot.data();
+    auto remaining = snapshot.size();
+    while (remaining) {
+        const auto written = write(fd, data, remaining);
+        if (written <= 0)
+            break;
+        data += written;
+        remaining -= size_t(written);
+    }
+    return close(fd) == 0 && !remaining;
+#else
+    ofstream file(path, ios::binary | ios::trunc);
+    file.write(reinterpret_cast<const char*>(snapshot.data()), streamsize(snapshot.size()));
+    return bool(file);
+#endif
+}
+
+auto load_state_file(const Machine& machine, const string& path) -> bool
+{
+#ifdef GAMEBOY_HAS_MMAP
+    const auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    void* mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+        mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    const auto loaded = load_state(machine, static_cast<const uint8_t*>(mapping), info.st_size);
+    munmap(mapping, info.st_size);
+    return loaded;
+#else
+    ifstream file(path, ios::binary);
+    if (!file)
+        return false;
+    const vector<uint8_t> snapshot((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    return load_state(machine, snapshot.data(), snapshot.size());
+#endif
+}
+
+}
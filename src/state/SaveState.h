@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace GameBoy {
+
+class Apu;
+class CPU;
+class Cartridge;
+class OamDma;
+class Ppu;
+class Timer;
+
+// Everything a snapshot covers. The CPU brings its memory, scheduler and interrupts; devices
+// the emulator runs without are left null, and a snapshot only loads into a machine with the
+// same ones.
+struct Machine {
+    CPU& cpu;
+    Cartridge* cartridge = nullptr;
+    Timer* timer = nullptr;
+    Ppu* ppu = nullptr;
+    OamDma* dma = nullptr;
+    Apu* apu = nullptr;
+};
+
+// Replaces snapshot with the machine as it stands between runs. Reusing the same vector keeps
+// its allocation, so snapshots taken every frame cost a copy of the state and nothing more.
+auto save_state(const Machine&, std::vector<uint8_t>& snapshot) -> void;
+// Puts the machine back as the snapshot has it. Fails, touching nothing, unless the snapshot
+// is this version, of this cartridge and has a chunk of the right size for every device.
+auto load_state(const Machine&, const uint8_t* snapshot, size_t size) -> bool;
+
+// Writes snapshot in one go, replacing whatever was at path
+auto write_state_file(const std::string& path, const std::vector<uint8_t>& snapshot) -> bool;
+// Maps the file at path and loads it
+auto load_state_file(const Machine&, const std::string& path) -> bool;
+
+}
@@ -0,0 +1,125 @@
+#include "state/StateStream.h"
+
+#include <cstring>
+
+namespace GameBoy {
+
+using namespace std;
+
+namespace {
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+    };
+
+    struct ChunkHeader {
+        uint32_t tag;
+        uint32_t size;
+    };
+
+}
+
+StateWriter::StateWriter(vector<uint8_t>* snapshot)
+    : m_snapshot(snapshot)
+{
+    if (m_snapshot)
+        m_snapshot->clear();
+}
+
+auto StateWriter::write_header() -> void
+{
+    write(Header { STATE_MAGIC, STATE_VERSION });
+}
+
+auto StateWriter::begin_chunk(uint32_t tag) -> void
+{
+    m_chunkSize = m_size + offsetof(ChunkHeader, size);
+    write(ChunkHeader { tag, 0 });
+}
+
+auto StateWriter::end_chunk() -> void
+{
+    const auto size = uint32_t(m_size - m_chunkSize - sizeof(uint32_t));
+    if (m_snapshot)
+        memcpy(m_snapshot->data() + m_chunkSize, &size, sizeof(size));
+}
+
+auto StateWriter::write_bytes(const void* data, size_t size) -> void
+{
+    if (m_snapshot) {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        m_snapshot->insert(m_snapshot->end(), bytes, bytes + size);
+    }
+    m_size += size;
+}
+
+StateReader::StateReader(const uint8_t* data, size_t size)
+{
+    Header header;
+    if (size < sizeof(header))
+        return;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != STATE_MAGIC || header.version != STATE_VERSION)
+        return;
+
+    const auto* end = data + size;
+    for (auto* position = data + sizeof(header); position != end;) {
+        ChunkHeader chunk;
+        if (size_t(end - position) < sizeof(chunk) || m_numChunks == MAX_CHUNKS)
+            return;
+        memcpy(&chunk, position, sizeof(chunk));
+        position += sizeof(chunk);
+        if (size_t(end - position) < chunk.size || find(chunk.tag))
+            return;
+        m_chunks[m_numChunks++] = { chunk.tag, position, chunk.size };
+        position += chunk.size;
+    }
+    m_valid = true;
+}
+
+auto StateReader::chunk_size(uint32_t tag) const -> size_t
+{
+    const auto* chunk = find(tag);
+    return chunk ? chunk->size : NO_CHUNK;
+}
+
+auto StateReader::open_chunk(uint32_t tag) -> bool
+{
+    const auto* chunk = find(tag);
+    if (!chunk)
+        return false;
+    m_position = chunk->data;
+    m_end = chunk->data + chunk->size;
+    return true;
+}
+
+auto StateReader::read_bytes(void* data, size_t size) -> void
+{
+    if (const auto* bytes = view(size))
+        memcpy(data, bytes, size);
+    else
+        memset(data, 0, size);
+}
+
+auto StateReader::view(size_t size) -> const uint8_t*
+{
+    if (size_t(m_end - m_position) < size) {
+        m_failed = true;
+        return nullptr;
+    }
+    const auto* bytes = m_position;
+    m_position += size;
+    return bytes;
+}
+
+auto StateReader::find(uint32_t tag) const -> const Chunk*
+{
+    for (size_t i = 0; i < m_numChunks; ++i) {
+        if (m_chunks[i].tag == tag)
+            return &m_chunks[i];
+    }
+    return nullptr;
+}
+
+}
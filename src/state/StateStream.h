@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+#include <vector>
+
+namespace GameBoy {
+
+// A snapshot is a header, then one chunk per device: a tag, a size and that many bytes. Each
+// device writes its fields as raw copies in host byte order, so saving and loading are a
+// memcpy apiece and the snapshot is only good for builds like the one that took it. The
+// version goes up whenever any chunk's layout changes; other versions aren't loaded.
+
+// Four characters, as a little-endian word
+constexpr auto chunk_tag(const char (&name)[5]) -> uint32_t
+{
+    return uint32_t(uint8_t(name[0])) | uint32_t(uint8_t(name[1])) << 8 | uint32_t(uint8_t(name[2])) << 16
+        | uint32_t(uint8_t(name[3])) << 24;
+}
+
+constexpr uint32_t STATE_MAGIC = chunk_tag("GBST");
+constexpr uint32_t STATE_VERSION = 1;
+
+class StateWriter {
+public:
+    // Clears snapshot and appends to it. Null only counts the bytes that would be written.
+    explicit StateWriter(std::vector<uint8_t>* snapshot);
+
+    auto write_header() -> void;
+    auto begin_chunk(uint32_t tag) -> void;
+    auto end_chunk() -> void;
+
+    auto write_bytes(const void* data, size_t size) -> void;
+    template <typename T>
+    auto write(const T& value) -> void;
+
+    auto size() const -> size_t { return m_size; }
+
+private:
+    std::vector<uint8_t>* m_snapshot;
+    size_t m_size = 0;
+    // Where the open chunk's size goes
+    size_t m_chunkSize = 0;
+};
+
+class StateReader {
+public:
+    // What chunk_size() gives for a chunk that isn't there
+    static constexpr size_t NO_CHUNK = SIZE_MAX;
+
+    // Checks the header and that the chunks fill the size bytes at data exactly. data must
+    // outlive the reader; nothing is copied until it is read.
+    StateReader(const uint8_t* data, size_t size);
+
+    auto valid() const -> bool { return m_valid; }
+    auto num_chunks() const -> size_t { return m_numChunks; }
+    auto chunk_size(uint32_t tag) const -> size_t;
+    // Reads from the start of the chunk with tag from now on; false if there isn't one
+    auto open_chunk(uint32_t tag) -> bool;
+
+    // Reads past the end of the open chunk give zeros and mark the reader failed
+    auto read_bytes(void* data, size_t size) -> void;
+    template <typename T>
+    auto read(T& value) -> void;
+    // The next size bytes where they lie, or null past the end
+    auto view(size_t size) -> const uint8_t*;
+    auto failed() const -> bool { return m_failed; }
+
+private:
+    struct Chunk {
+        uint32_t tag;
+        const uint8_t* data;
+        size_t size;
+    };
+
+    static constexpr size_t MAX_CHUNKS = 16;
+
+    auto find(uint32_t tag) const -> const Chunk*;
+
+    std::array<Chunk, MAX_CHUNKS> m_chunks {};
+    size_t m_numChunks = 0;
+    bool m_valid = false;
+    // The rest of the open chunk
+    const uint8_t* m_position = nullptr;
+    const uint8_t* m_end = nullptr;
+    bool m_failed = false;
+};
+
+template <typename T>
+auto StateWriter::write(const T& value) -> void
+{
+    static_assert(std::is_trivially_copyable_v<T>, "state is written as raw bytes");
+    write_bytes(&value, sizeof(value));
+}
+
+template <typename T>
+auto StateReader::read(T& value) -> void
+{
+    static_assert(std::is_trivially_copyable_v<T>, "state is read as raw bytes");
+    read_bytes(&value, sizeof(value));
+}
+
+}
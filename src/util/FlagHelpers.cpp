@@ -1,7 +1,11 @@
 #include "util/FlagHelpers.h"
 
+#include "RegisterFile.h"
+
 namespace GameBoy::FlagHelpers {
 
+using namespace std;
+
 namespace Add {
 
     auto should_half_carry(uint8_t a, uint8_t b) -> bool
@@ -21,4 +25,90 @@ namespace Add {
     }
 }
 
+namespace Alu {
+
+    namespace {
+
+        constexpr auto flags(bool zero, bool subtract, bool halfCarry, bool carry) -> uint8_t
+        {
+            return (zero ? Flags::ZERO : 0)
+                | (subtract ? Flags::SUBTRACT : 0)
+                | (halfCarry ? Flags::HALF_CARRY : 0)
+                | (carry ? Flags::CARRY : 0);
+        }
+
+        constexpr auto build_decimal_adjust() -> array<AluResult, 0x800>
+        {
+            array<AluResult, 0x800> table {};
+            for (uint32_t index = 0; index < table.size(); ++index) {
+                const uint8_t a = index;
+                const bool subtract = index & 0x400;
+                const bool halfCarry = index & 0x200;
+                bool carry = index & 0x100;
+                uint8_t correction = 0;
+                if (halfCarry || (!subtract && (a & 0x0F) > 0x09))
+                    correction |= 0x06;
+                if (carry || (!subtract && a > 0x99)) {
+                    correction |= 0x60;
+                    carry = true;
+                }
+                const uint8_t res = subtract ? a - correction : a + correction;
+                table[index] = { res, flags(res == 0, subtract, false, carry) };
+            }
+            return table;
+        }
+
+        constexpr auto build_rotate() -> array<AluResult, 0x1000>
+        {
+            array<AluResult, 0x1000> table {};
+            for (uint32_t index = 0; index < table.size(); ++index) {
+                const uint8_t value = index;
+                const uint8_t carryIn = (index >> 8) & 1;
+                uint8_t res = 0;
+                bool carryOut = false;
+                switch (index >> 9) {
+                case 0: // RLC
+                    res = uint8_t(value << 1) | (value >> 7);
+                    carryOut = value & 0x80;
+                    break;
+                case 1: // RRC
+                    res = (value >> 1) | uint8_t(value << 7);
+                    carryOut = value & 0x01;
+                    break;
+                case 2: // RL
+                    res = uint8_t(value << 1) | carryIn;
+                    carryOut = value & 0x80;
+                    break;
+                case 3: // RR
+                    res = (value >> 1) | uint8_t(carryIn << 7);
+                    carryOut = value & 0x01;
+                    break;
+                case 4: // SLA
+                    res = uint8_t(value << 1);
+                    carryOut = value & 0x80;
+                    break;
+                case 5: // SRA
+                    res = (value >> 1) | (value & 0x80);
+                    carryOut = value & 0x01;
+                    break;
+                case 6: // SWAP
+                    res = uint8_t(value << 4) | (value >> 4);
+                    break;
+                default: // SRL
+                    res = value >> 1;
+                    carryOut = value & 0x01;
+                    break;
+                }
+                table[index] = { res, flags(res == 0, false, false, carryOut) };
+            }
+            return table;
+        }
+
+    }
+
+    constexpr array<AluResult, 0x800> DECIMAL_ADJUST = build_decimal_adjust();
+    constexpr array<AluResult, 0x1000> ROTATE = build_rotate();
+
+}
+
 }
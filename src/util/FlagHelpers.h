@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <stdint.h>
 
 namespace GameBoy::FlagHelpers {
@@ -11,4 +12,32 @@ namespace Add {
 
 }
 
+// An 8-bit ALU result together with the F it leaves behind
+struct AluResult {
+    uint8_t value;
+    uint8_t flags;
+};
+
+// Table-driven results for the ALU operations whose flags are always read or cheaper to look up
+// than to work out: a single indexed load of the result and flags. The tables are built at
+// compile time. ADD, SUB, INC and DEC defer their flags instead.
+namespace Alu {
+
+    // Indexed by N, H and C from F, then A
+    extern const std::array<AluResult, 0x800> DECIMAL_ADJUST;
+    // Indexed by the CB rotate/shift operation field, carry in and value
+    extern const std::array<AluResult, 0x1000> ROTATE;
+
+    inline auto decimal_adjust(uint8_t a, uint8_t flags) -> AluResult
+    {
+        return DECIMAL_ADJUST[(flags & 0x70) << 4 | a];
+    }
+
+    inline auto rotate(uint8_t operation, uint8_t value, bool carry) -> AluResult
+    {
+        return ROTATE[operation << 9 | carry << 8 | value];
+    }
+
+}
+
 }
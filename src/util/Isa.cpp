@@ -0,0 +1,32 @@
+#include "util/Isa.h"
+
+namespace GameBoy {
+
+auto isa_supported(Isa isa) -> bool
+{
+    switch (isa) {
+    case Isa::Scalar:
+        return true;
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    case Isa::Sse2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2");
+    case Isa::Avx2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+auto best_isa() -> Isa
+{
+    if (isa_supported(Isa::Avx2))
+        return Isa::Avx2;
+    if (isa_supported(Isa::Sse2))
+        return Isa::Sse2;
+    return Isa::Scalar;
+}
+
+}
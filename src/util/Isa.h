@@ -0,0 +1,17 @@
+#pragma once
+
+// The instruction sets that the SIMD paths are written for, picked once at startup from what
+// the host supports. Off x86 only Scalar is ever supported.
+namespace GameBoy {
+
+enum class Isa {
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+auto isa_supported(Isa) -> bool;
+// The widest supported
+auto best_isa() -> Isa;
+
+}
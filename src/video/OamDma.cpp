@@ -0,0 +1,73 @@
+#include "video/OamDma.h"
+
+#include "CPU.h"
+#include "memory/Memory.h"
+#include "state/StateStream.h"
+
+namespace GameBoy {
+
+using namespace std;
+
+constexpr uint16_t DMA = 0xFF46;
+
+// The startup delay, then a byte every 4 cycles
+constexpr uint64_t DMA_CYCLES = 4 + 160 * 4;
+
+OamDma::OamDma(CPU& cpu)
+    : m_cpu(cpu)
+{
+    m_cpu.memory.map_io(DMA, this);
+    m_cpu.scheduler().set_handler(Event::Dma, [this] { finish(); });
+}
+
+OamDma::~OamDma()
+{
+    if (m_active)
+        m_cpu.memory.unlock_bus();
+    m_cpu.memory.map_io(DMA, nullptr);
+    m_cpu.scheduler().cancel(Event::Dma);
+    m_cpu.scheduler().set_handler(Event::Dma, nullptr);
+}
+
+auto OamDma::read8(uint16_t) -> uint8_t
+{
+    return m_page;
+}
+
+auto OamDma::write8(uint16_t, uint8_t value) -> void
+{
+    // Starting again during a transfer replaces it
+    m_page = value;
+    m_active = true;
+    const auto end = m_cpu.cycle() + DMA_CYCLES;
+    m_cpu.memory.lock_bus(end);
+    m_cpu.scheduler().schedule(Event::Dma, end);
+    // Only one instruction at a time runs while the bus is locked
+    m_cpu.end_slice();
+}
+
+auto OamDma::next_change(uint16_t, uint64_t) -> uint64_t
+{
+    return Scheduler::NEVER;
+}
+
+auto OamDma::save_state(StateWriter& writer) const -> void
+{
+    writer.write(m_page);
+    writer.write(m_active);
+}
+
+auto OamDma::load_state(StateReader& reader) -> void
+{
+    reader.read(m_page);
+    reader.read(m_active);
+}
+
+auto OamDma::finish() -> void
+{
+    m_active = false;
+    m_cpu.memory.unlock_bus();
+    m_cpu.memory.copy_to_oam(m_page << 8);
+}
+
+}
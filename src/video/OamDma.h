@@ -0,0 +1,47 @@
+#pragma once
+
+#include "memory/IoHandler.h"
+
+#include <stdint.h>
+
+namespace GameBoy {
+
+class CPU;
+class StateReader;
+class StateWriter;
+
+// DMA (FF46). Writing a page number starts a 160-byte transfer from there into OAM, which
+// on the DMG takes 640 cycles, a byte every 4, after 4 to get going. Nothing is done per byte:
+// the bus is locked from the write, and the Dma event copies all 160 bytes and unlocks it as
+// the transfer ends. With the CPU locked out of all but FF00-FFFF meanwhile, nothing it does
+// can tell the copy wasn't made a byte at a time.
+class OamDma : public IoHandler {
+public:
+    // Maps the register into the CPU's memory until destroyed
+    OamDma(CPU&);
+    ~OamDma() override;
+
+    OamDma(const OamDma&) = delete;
+    auto operator=(const OamDma&) -> OamDma& = delete;
+
+    auto active() const -> bool { return m_active; }
+
+    auto read8(uint16_t address) -> uint8_t override;
+    auto write8(uint16_t address, uint8_t value) -> void override;
+    auto next_change(uint16_t address, uint64_t cycle) -> uint64_t override;
+
+    // The bus lock is memory's to save, and the Dma event the scheduler's
+    auto save_state(StateWriter&) const -> void;
+    auto load_state(StateReader&) -> void;
+
+private:
+    // Handles the Dma event
+    auto finish() -> void;
+
+    CPU& m_cpu;
+    // The last value written, which is what reads give
+    uint8_t m_page = 0;
+    bool m_active = false;
+};
+
+}
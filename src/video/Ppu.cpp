@@ -0,0 +1,332 @@
+#include "video/Ppu.h"
+
+#include "CPU.h"
+#include "memory/Memory.h"
+#include "state/StateStream.h"
+
+namespace GameBoy {
+
+using namespace std;
+
+constexpr uint16_t LCDC = 0xFF40;
+constexpr uint16_t STAT = 0xFF41;
+constexpr uint16_t SCY = 0xFF42;
+constexpr uint16_t SCX = 0xFF43;
+constexpr uint16_t LY = 0xFF44;
+constexpr uint16_t LYC = 0xFF45;
+// Left to OAM DMA
+constexpr uint16_t DMA = 0xFF46;
+constexpr uint16_t BGP = 0xFF47;
+constexpr uint16_t OBP0 = 0xFF48;
+constexpr uint16_t OBP1 = 0xFF49;
+constexpr uint16_t WY = 0xFF4A;
+constexpr uint16_t WX = 0xFF4B;
+
+constexpr uint16_t VIDEO_RAM_START = 0x8000;
+constexpr uint16_t OAM_START = 0xFE00;
+
+constexpr uint8_t LCD_ENABLE = 0x80;
+
+// STAT
+constexpr uint8_t COINCIDENCE = 0x04;
+constexpr uint8_t HBLANK_INTERRUPT = 0x08;
+constexpr uint8_t VBLANK_INTERRUPT = 0x10;
+constexpr uint8_t OAM_SCAN_INTERRUPT = 0x20;
+constexpr uint8_t COINCIDENCE_INTERRUPT = 0x40;
+constexpr uint8_t STAT_WRITABLE = 0x78;
+
+constexpr uint64_t OAM_SCAN_CYCLES = 80;
+constexpr uint64_t DRAWING_CYCLES = 172;
+constexpr uint64_t HBLANK_CYCLES = 204;
+constexpr uint64_t LINE_CYCLES = OAM_SCAN_CYCLES + DRAWING_CYCLES + HBLANK_CYCLES;
+constexpr uint8_t NUM_LINES = 154;
+
+Ppu::Ppu(CPU& cpu)
+    : m_cpu(cpu)
+    , m_renderer(cpu.memory.video_ram(), cpu.memory.oam())
+{
+    for (auto address = LCDC; address <= WX; ++address) {
+        if (address != DMA)
+            m_cpu.memory.map_io(address, this);
+    }
+    m_cpu.scheduler().set_handler(Event::Ppu, [this] { advance(); });
+    m_cpu.memory.set_video_ram_watcher([this](uint16_t address) { video_ram_written(address); });
+    m_cpu.memory.set_oam_watcher([this](uint16_t address, uint16_t count) { oam_written(address, count); });
+}
+
+Ppu::~Ppu()
+{
+    for (auto address = LCDC; address <= WX; ++address) {
+        if (address != DMA)
+            m_cpu.memory.map_io(address, nullptr);
+    }
+    m_cpu.scheduler().cancel(Event::Ppu);
+    m_cpu.scheduler().set_handler(Event::Ppu, nullptr);
+    m_cpu.memory.set_video_ram_watcher(nullptr);
+    m_cpu.memory.set_oam_watcher(nullptr);
+}
+
+auto Ppu::set_framebuffer(uint8_t* pixels) -> void
+{
+    m_framebuffer = pixels;
+    if (m_renderThread)
+        m_renderThread->set_framebuffer(pixels);
+}
+
+auto Ppu::set_threaded_rendering(bool enabled) -> void
+{
+    m_threadedRendering = enabled;
+}
+
+auto Ppu::sync_framebuffer() -> void
+{
+    if (m_renderThread)
+        m_renderThread->flush();
+}
+
+auto Ppu::set_frame_watcher(function<void()> watcher) -> void
+{
+    m_frameWatcher = move(watcher);
+}
+
+auto Ppu::set_tile_cache_enabled(bool enabled) -> void
+{
+    m_renderer.set_tile_cache_enabled(enabled);
+}
+
+auto Ppu::read8(uint16_t address) -> uint8_t
+{
+    switch (address) {
+    case LCDC:
+        return m_registers.lcdc;
+    case STAT:
+        return 0x80 | m_stat | (m_ly == m_lyc ? COINCIDENCE : 0) | uint8_t(m_mode);
+    case SCY:
+        return m_registers.scy;
+    case SCX:
+        return m_registers.scx;
+    case LY:
+        return m_ly;
+    case LYC:
+        return m_lyc;
+    case BGP:
+        return m_registers.bgp;
+    case OBP0:
+        return m_registers.obp0;
+    case OBP1:
+        return m_registers.obp1;
+    case WY:
+        return m_registers.wy;
+    default:
+        return m_registers.wx;
+    }
+}
+
+auto Ppu::write8(uint16_t address, uint8_t value) -> void
+{
+    if (m_renderThread)
+        m_renderThread->log_write(address, value);
+
+    switch (address) {
+    case LCDC: {
+        const bool wasEnabled = lcd_enabled();
+        m_registers.lcdc = value;
+        if (!wasEnabled && lcd_enabled())
+            start_lcd();
+        else if (wasEnabled && !lcd_enabled())
+            stop_lcd();
+        break;
+    }
+    case STAT:
+        m_stat = value & STAT_WRITABLE;
+        update_stat_line();
+        break;
+    case SCY:
+        m_registers.scy = value;
+        break;
+    case SCX:
+        m_registers.scx = value;
+        break;
+    case LY:
+        // Read only
+        break;
+    case LYC:
+        m_lyc = value;
+        update_stat_line();
+        break;
+    case BGP:
+        m_registers.bgp = value;
+        break;
+    case OBP0:
+        m_registers.obp0 = value;
+        break;
+    case OBP1:
+        m_registers.obp1 = value;
+        break;
+    case WY:
+        m_registers.wy = value;
+        break;
+    default:
+        m_registers.wx = value;
+        break;
+    }
+}
+
+auto Ppu::next_change(uint16_t, uint64_t) -> uint64_t
+{
+    return Scheduler::NEVER;
+}
+
+auto Ppu::save_state(StateWriter& writer) const -> void
+{
+    if (m_renderThread)
+        m_renderThread->flush();
+    writer.write(m_registers);
+    writer.write(m_stat);
+    writer.write(m_ly);
+    writer.write(m_lyc);
+    writer.write(m_mode);
+    writer.write(m_statLine);
+    writer.write(m_frames);
+    writer.write(m_renderThread ? m_renderThread->window_line() : m_renderer.window_line());
+}
+
+auto Ppu::load_state(StateReader& reader) -> void
+{
+    // Finishes the lines it was given; its copies of VRAM and OAM are out of date
+    m_renderThread.reset();
+    reader.read(m_registers);
+    reader.read(m_stat);
+    reader.read(m_ly);
+    reader.read(m_lyc);
+    reader.read(m_mode);
+    reader.read(m_statLine);
+    reader.read(m_frames);
+    uint8_t windowLine;
+    reader.read(windowLine);
+    m_renderer.set_window_line(windowLine);
+    m_renderer.tiles().invalidate_all();
+    m_renderer.sprites().reload();
+}
+
+auto Ppu::lcd_enabled() const -> bool
+{
+    return m_registers.lcdc & LCD_ENABLE;
+}
+
+auto Ppu::start_lcd() -> void
+{
+    start_frame();
+    m_ly = 0;
+    enter_mode(Mode::OamScan, OAM_SCAN_CYCLES);
+}
+
+auto Ppu::stop_lcd() -> void
+{
+    m_cpu.scheduler().cancel(Event::Ppu);
+    if (m_renderThread)
+        m_renderThread->submit();
+    m_ly = 0;
+    m_mode = Mode::HBlank;
+    update_stat_line();
+}
+
+auto Ppu::start_frame() -> void
+{
+    if (m_threadedRendering && !m_renderThread) {
+        m_renderThread = make_unique<RenderThread>(m_registers, m_cpu.memory.video_ram(), m_cpu.memory.oam(),
+            m_framebuffer);
+    } else if (!m_threadedRendering && m_renderThread) {
+        m_renderThread.reset();
+        // VRAM and OAM went by unseen meanwhile
+        m_renderer.tiles().invalidate_all();
+        m_renderer.sprites().reload();
+    }
+
+    if (m_renderThread)
+        m_renderThread->log_start_frame();
+    else
+        m_renderer.start_frame();
+}
+
+auto Ppu::video_ram_written(uint16_t address) -> void
+{
+    if (m_renderThread)
+        m_renderThread->log_write(address, m_cpu.memory.video_ram()[address - VIDEO_RAM_START]);
+    else
+        m_renderer.tiles().invalidate(address);
+}
+
+auto Ppu::oam_written(uint16_t address, uint16_t count) -> void
+{
+    const auto* oam = m_cpu.memory.oam();
+    if (m_renderThread) {
+        for (auto end = address + count; address < end; ++address)
+            m_renderThread->log_write(address, oam[address - OAM_START]);
+    } else if (count == 1) {
+        m_renderer.sprites().update(address - OAM_START);
+    } else {
+        m_renderer.sprites().reload();
+    }
+}
+
+auto Ppu::advance() -> void
+{
+    switch (m_mode) {
+    case Mode::OamScan:
+        enter_mode(Mode::Drawing, DRAWING_CYCLES);
+        if (m_framebuffer && m_renderThread)
+            m_renderThread->log_line(m_ly);
+        else if (m_framebuffer)
+            m_renderer.render_line(m_registers, m_ly, m_framebuffer + m_ly * SCREEN_WIDTH);
+        break;
+    case Mode::Drawing:
+        enter_mode(Mode::HBlank, HBLANK_CYCLES);
+        break;
+    case Mode::HBlank:
+        ++m_ly;
+        if (m_ly == SCREEN_HEIGHT) {
+            ++m_frames;
+            if (m_renderThread)
+                m_renderThread->submit();
+            if (m_frameWatcher)
+                m_frameWatcher();
+            enter_mode(Mode::VBlank, LINE_CYCLES);
+            m_cpu.interrupts().request(Interrupt::VBlank);
+        } else {
+            enter_mode(Mode::OamScan, OAM_SCAN_CYCLES);
+        }
+        break;
+    case Mode::VBlank:
+        if (m_ly == NUM_LINES - 1) {
+            m_ly = 0;
+            start_frame();
+            enter_mode(Mode::OamScan, OAM_SCAN_CYCLES);
+        } else {
+            ++m_ly;
+            enter_mode(Mode::VBlank, LINE_CYCLES);
+        }
+        break;
+    }
+}
+
+auto Ppu::enter_mode(Mode mode, uint64_t cycles) -> void
+{
+    m_mode = mode;
+    m_cpu.scheduler().schedule(Event::Ppu, m_cpu.cycle() + cycles);
+    update_stat_line();
+}
+
+auto Ppu::update_stat_line() -> void
+{
+    const bool line = lcd_enabled()
+        && (((m_stat & COINCIDENCE_INTERRUPT) && m_ly == m_lyc)
+            || ((m_stat & HBLANK_INTERRUPT) && m_mode == Mode::HBlank)
+            || ((m_stat & VBLANK_INTERRUPT) && m_mode == Mode::VBlank)
+            || ((m_stat & OAM_SCAN_INTERRUPT) && m_mode == Mode::OamScan));
+    if (line && !m_statLine)
+        m_cpu.interrupts().request(Interrupt::Stat);
+    m_statLine = line;
+}
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "memory/IoHandler.h"
+#include "video/RenderThread.h"
+#include "video/Renderer.h"
+
+#include <functional>
+#include <memory>
+#include <stdint.h>
+
+namespace GameBoy {
+
+class CPU;
+class StateReader;
+class StateWriter;
+
+// LCDC, STAT, SCY, SCX, LY, LYC, BGP, OBP0, OBP1, WY and WX (FF40-FF4B, less DMA). Each line is
+// 80 cycles of OAM scan, 172 of drawing and 204 of HBlank, and the last ten of the 154 lines
+// are VBlank; the scheduler's Ppu event moves it from one mode to the next. A line is drawn
+// all at once as drawing starts, with the registers as they stand then, either inline or by
+// logging it for a RenderThread.
+class Ppu : public IoHandler {
+public:
+    enum class Mode : uint8_t {
+        HBlank = 0,
+        VBlank = 1,
+        OamScan = 2,
+        Drawing = 3
+    };
+
+    // Maps the registers into the CPU's memory until destroyed. The LCD starts off.
+    Ppu(CPU&);
+    ~Ppu() override;
+
+    Ppu(const Ppu&) = delete;
+    auto operator=(const Ppu&) -> Ppu& = delete;
+
+    // Where frames are drawn, SCREEN_WIDTH * SCREEN_HEIGHT shades a row at a time; nothing is
+    // drawn while null
+    auto set_framebuffer(uint8_t* pixels) -> void;
+    // Draws on a RenderThread from the next frame on, so that it overlaps emulation. Each
+    // frame is handed over as VBlank starts; until sync_framebuffer() the framebuffer
+    // belongs to the thread.
+    auto set_threaded_rendering(bool) -> void;
+    // Waits until every line so far is in the framebuffer; inline they already are
+    auto sync_framebuffer() -> void;
+    // Called as each frame is finished, as VBlank starts; the framebuffer can be swapped
+    // for another then, after sync_framebuffer()
+    auto set_frame_watcher(std::function<void()>) -> void;
+
+    // Tile decoding is cached by default, and the cache dropped tile by tile as VRAM is written
+    auto set_tile_cache_enabled(bool) -> void;
+    auto tile_cache_stats() const -> const TileCache::Stats& { return m_renderer.tiles().stats(); }
+
+    auto mode() const -> Mode { return m_mode; }
+    // How many times VBlank has started
+    auto frame_count() const -> uint64_t { return m_frames; }
+
+    auto read8(uint16_t address) -> uint8_t override;
+    auto write8(uint16_t address, uint8_t value) -> void override;
+    // LY and STAT only change on the Ppu event
+    auto next_change(uint16_t address, uint64_t cycle) -> uint64_t override;
+
+    // Registers, mode and how far into the frame drawing is, after waiting for the render
+    // thread to get there. Loading goes back to drawing inline until the next frame, with
+    // decoded tiles and sprites dropped since VRAM and OAM changed under them.
+    auto save_state(StateWriter&) const -> void;
+    auto load_state(StateReader&) -> void;
+
+private:
+    auto lcd_enabled() const -> bool;
+    auto start_lcd() -> void;
+    auto stop_lcd() -> void;
+    // Starts drawing a frame, first switching to or from the render thread if asked to
+    auto start_frame() -> void;
+    // Drawing inline needs the tile cache and sprite table kept in step with VRAM and OAM;
+    // the render thread needs the writes logged
+    auto video_ram_written(uint16_t address) -> void;
+    auto oam_written(uint16_t address, uint16_t count) -> void;
+    // Handles the Ppu event: moves on to the next mode, or the next line
+    auto advance() -> void;
+    auto enter_mode(Mode, uint64_t cycles) -> void;
+    // Raises the STAT interrupt when any of its enabled conditions has just become true
+    auto update_stat_line() -> void;
+
+    CPU& m_cpu;
+    Renderer m_renderer;
+    uint8_t* m_framebuffer = nullptr;
+    std::unique_ptr<RenderThread> m_renderThread;
+    bool m_threadedRendering = false;
+    std::function<void()> m_frameWatcher;
+
+    LcdRegisters m_registers;
+    // Only the interrupt enables, bits 3-6; the rest is worked out on reads
+    uint8_t m_stat = 0;
+    uint8_t m_ly = 0;
+    uint8_t m_lyc = 0;
+    Mode m_mode = Mode::HBlank;
+    bool m_statLine = false;
+    uint64_t m_frames = 0;
+};
+
+}
@@ -0,0 +1,166 @@
+#include "video/RenderThread.h"
+
+#include <cstring>
+
+namespace GameBoy {
+
+using namespace std;
+
+constexpr uint16_t VIDEO_RAM_START = 0x8000;
+constexpr uint16_t OAM_START = 0xFE00;
+constexpr uint16_t LCDC = 0xFF40;
+constexpr uint16_t SCY = 0xFF42;
+constexpr uint16_t SCX = 0xFF43;
+constexpr uint16_t BGP = 0xFF47;
+constexpr uint16_t OBP0 = 0xFF48;
+constexpr uint16_t OBP1 = 0xFF49;
+constexpr uint16_t WY = 0xFF4A;
+constexpr uint16_t WX = 0xFF4B;
+
+RenderThread::RenderThread(const LcdRegisters& registers, const uint8_t* vram, const uint8_t* oam,
+    uint8_t* framebuffer)
+    : m_registers(registers)
+    , m_renderer(m_vram.data(), m_oam.data())
+    , m_framebuffer(framebuffer)
+{
+    memcpy(m_vram.data(), vram, m_vram.size());
+    memcpy(m_oam.data(), oam, m_oam.size());
+    // The renderer saw nothing of the copies going in
+    m_renderer.tiles().invalidate_all();
+    m_renderer.sprites().reload();
+    m_thread = thread([this] { run(); });
+}
+
+RenderThread::~RenderThread()
+{
+    flush();
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_changed.notify_all();
+    m_thread.join();
+}
+
+auto RenderThread::log_write(uint16_t address, uint8_t value) -> void
+{
+    m_log.push_back({ Command::Write, address, value });
+}
+
+auto RenderThread::log_start_frame() -> void
+{
+    m_log.push_back({ Command::StartFrame, 0, 0 });
+}
+
+auto RenderThread::log_line(uint8_t ly) -> void
+{
+    m_log.push_back({ Command::DrawLine, 0, ly });
+}
+
+auto RenderThread::set_framebuffer(uint8_t* framebuffer) -> void
+{
+    // Once idle, the thread won't look at it until the next submit
+    flush();
+    m_framebuffer = framebuffer;
+}
+
+auto RenderThread::submit() -> void
+{
+    if (m_log.empty())
+        return;
+    {
+        unique_lock<mutex> lock(m_mutex);
+        m_changed.wait(lock, [this] { return !m_busy; });
+        // The old work comes back cleared, so its capacity carries on in the log
+        swap(m_work, m_log);
+        m_busy = true;
+    }
+    m_changed.notify_all();
+}
+
+auto RenderThread::flush() -> void
+{
+    submit();
+    unique_lock<mutex> lock(m_mutex);
+    m_changed.wait(lock, [this] { return !m_busy; });
+}
+
+auto RenderThread::run() -> void
+{
+    unique_lock<mutex> lock(m_mutex);
+    for (;;) {
+        m_changed.wait(lock, [this] { return m_busy || m_stopping; });
+        if (!m_busy)
+            return;
+
+        lock.unlock();
+        replay(m_work);
+        m_work.clear();
+        lock.lock();
+        m_busy = false;
+        m_changed.notify_all();
+    }
+}
+
+auto RenderThread::replay(const vector<Entry>& log) -> void
+{
+    for (const auto& entry : log) {
+        switch (entry.command) {
+        case Command::Write:
+            apply(entry.address, entry.value);
+            break;
+        case Command::StartFrame:
+            m_renderer.start_frame();
+            break;
+        case Command::DrawLine:
+            m_renderer.render_line(m_registers, entry.value, m_framebuffer + entry.value * SCREEN_WIDTH);
+            break;
+        }
+    }
+}
+
+auto RenderThread::apply(uint16_t address, uint8_t value) -> void
+{
+    if (address >= OAM_START && address < OAM_START + m_oam.size()) {
+        m_oam[address - OAM_START] = value;
+        m_renderer.sprites().update(address - OAM_START);
+        return;
+    }
+    if (address >= VIDEO_RAM_START && address < VIDEO_RAM_START + m_vram.size()) {
+        m_vram[address - VIDEO_RAM_START] = value;
+        m_renderer.tiles().invalidate(address);
+        return;
+    }
+
+    switch (address) {
+    case LCDC:
+        m_registers.lcdc = value;
+        break;
+    case SCY:
+        m_registers.scy = value;
+        break;
+    case SCX:
+        m_registers.scx = value;
+        break;
+    case BGP:
+        m_registers.bgp = value;
+        break;
+    case OBP0:
+        m_registers.obp0 = value;
+        break;
+    case OBP1:
+        m_registers.obp1 = value;
+        break;
+    case WY:
+        m_registers.wy = value;
+        break;
+    case WX:
+        m_registers.wx = value;
+        break;
+    default:
+        // STAT, LY and LYC don't change what is drawn
+        break;
+    }
+}
+
+}
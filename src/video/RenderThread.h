@@ -0,0 +1,89 @@
+#pragma once
+
+#include "video/Renderer.h"
+
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace GameBoy {
+
+// Draws lines on a thread of its own, from a log of everything that decides how they look.
+// The emulating thread logs each write to a PPU register, VRAM or OAM, and each line where
+// it would have drawn it, in the order they happen; submit() hands the log over, and
+// the thread replays it against its own copies of the registers, VRAM and OAM. Since the
+// copies see the same writes in the same order as the lines, the result is what drawing
+// inline would have given.
+//
+// Entries carry no cycle. The PPU draws each line whole as it enters mode 3, so a write made
+// while a line is being drawn counts from the next one, inline and here alike; where a write
+// falls among the lines in the log is all that decides what it affects. A renderer that changes registers partway
+// through a line would need each write's cycle logged again.
+class RenderThread {
+public:
+    // Starts from copies of the registers, vram (8000-9FFF) and oam (FE00-FE9F) as they are
+    // now, drawing into framebuffer
+    RenderThread(const LcdRegisters&, const uint8_t* vram, const uint8_t* oam, uint8_t* framebuffer);
+    // Finishes whatever was submitted
+    ~RenderThread();
+
+    RenderThread(const RenderThread&) = delete;
+    auto operator=(const RenderThread&) -> RenderThread& = delete;
+
+    // address is FF40-FF4B, 8000-9FFF or FE00-FE9F
+    auto log_write(uint16_t address, uint8_t value) -> void;
+    auto log_start_frame() -> void;
+    auto log_line(uint8_t ly) -> void;
+
+    // Takes effect from the next line drawn
+    auto set_framebuffer(uint8_t*) -> void;
+
+    // Passes on everything logged so far, once the last log submitted has been drawn
+    auto submit() -> void;
+    // Submits, then waits for it all to be drawn
+    auto flush() -> void;
+    // The renderer's, as of the last line drawn; only settled after flush()
+    auto window_line() const -> uint8_t { return m_renderer.window_line(); }
+
+private:
+    enum class Command : uint8_t {
+        Write,
+        StartFrame,
+        DrawLine
+    };
+
+    struct Entry {
+        Command command;
+        uint16_t address;
+        // The value written, or the line to draw
+        uint8_t value;
+    };
+
+    auto run() -> void;
+    auto replay(const std::vector<Entry>&) -> void;
+    auto apply(uint16_t address, uint8_t value) -> void;
+
+    // Only touched by the emulating thread
+    std::vector<Entry> m_log;
+
+    // Only touched by the render thread, but for the constructor
+    LcdRegisters m_registers;
+    std::array<uint8_t, 0x2000> m_vram;
+    std::array<uint8_t, 0xA0> m_oam;
+    Renderer m_renderer;
+    uint8_t* m_framebuffer;
+
+    // Guarded by m_mutex
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::vector<Entry> m_work;
+    bool m_busy = false;
+    bool m_stopping = false;
+
+    std::thread m_thread;
+};
+
+}
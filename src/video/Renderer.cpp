@@ -0,0 +1,156 @@
+#include "video/Renderer.h"
+
+#include "video/TileDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace GameBoy {
+
+using namespace std;
+
+// LCDC
+constexpr uint8_t BACKGROUND_ENABLE = 0x01;
+constexpr uint8_t SPRITE_ENABLE = 0x02;
+constexpr uint8_t TALL_SPRITES = 0x04;
+constexpr uint8_t BACKGROUND_MAP = 0x08;
+constexpr uint8_t UNSIGNED_TILE_DATA = 0x10;
+constexpr uint8_t WINDOW_ENABLE = 0x20;
+constexpr uint8_t WINDOW_MAP = 0x40;
+
+// Sprite attributes
+constexpr uint8_t BEHIND_BACKGROUND = 0x80;
+constexpr uint8_t FLIP_Y = 0x40;
+constexpr uint8_t FLIP_X = 0x20;
+constexpr uint8_t SECOND_PALETTE = 0x10;
+
+// Offsets into VRAM
+constexpr uint16_t LOW_TILE_MAP = 0x1800;
+constexpr uint16_t HIGH_TILE_MAP = 0x1C00;
+constexpr uint16_t SIGNED_TILE_BASE = 0x1000;
+
+constexpr int TILE_BYTES = 16;
+// A line scrolled part way into a tile touches one more than fits on screen
+constexpr int MAX_TILES_PER_LINE = SCREEN_WIDTH / 8 + 1;
+
+Renderer::Renderer(const uint8_t* vram, const uint8_t* oam)
+    : m_vram(vram)
+    , m_oam(oam)
+    , m_tiles(vram)
+    , m_sprites(oam)
+{
+}
+
+auto Renderer::set_tile_cache_enabled(bool enabled) -> void
+{
+    if (enabled && !m_useTileCache)
+        m_tiles.invalidate_all();
+    m_useTileCache = enabled;
+}
+
+auto Renderer::start_frame() -> void
+{
+    m_windowLine = 0;
+}
+
+auto Renderer::render_line(const LcdRegisters& regs, uint8_t ly, uint8_t* pixels) -> void
+{
+    uint8_t indices[SCREEN_WIDTH];
+    if (regs.lcdc & BACKGROUND_ENABLE) {
+        const auto backgroundMap = (regs.lcdc & BACKGROUND_MAP) ? HIGH_TILE_MAP : LOW_TILE_MAP;
+        draw_tiles(regs, backgroundMap, uint8_t(ly + regs.scy), regs.scx, 0, SCREEN_WIDTH, indices);
+
+        // The window covers the background from WX-7 rightwards once LY has reached WY. Its own
+        // line counter only moves on lines where it was drawn.
+        if ((regs.lcdc & WINDOW_ENABLE) && ly >= regs.wy && regs.wx < SCREEN_WIDTH + 7) {
+            const auto windowMap = (regs.lcdc & WINDOW_MAP) ? HIGH_TILE_MAP : LOW_TILE_MAP;
+            const int x = max(regs.wx - 7, 0);
+            draw_tiles(regs, windowMap, m_windowLine, uint8_t(x - (regs.wx - 7)), x, SCREEN_WIDTH - x, indices);
+            ++m_windowLine;
+        }
+    } else {
+        // On the DMG this blanks the window too
+        memset(indices, 0, sizeof(indices));
+    }
+
+    for (int x = 0; x < SCREEN_WIDTH; ++x)
+        pixels[x] = (regs.bgp >> (2 * indices[x])) & 0x03;
+
+    if (regs.lcdc & SPRITE_ENABLE)
+        draw_sprites(regs, ly, indices, pixels);
+}
+
+auto Renderer::draw_tiles(const LcdRegisters& regs, uint16_t mapBase, uint8_t y, uint8_t scrollX, int x,
+    int count, uint8_t* indices) -> void
+{
+    const int fineX = scrollX & 0x07;
+    const int tiles = (fineX + count + 7) / 8;
+    const auto* map = m_vram + mapBase + (y / 8) * 32;
+    const int row = y & 0x07;
+    // Signed tile numbers count from 9000, tile 256
+    const auto tile_number = [&](uint8_t tile) -> uint16_t {
+        return (regs.lcdc & UNSIGNED_TILE_DATA) ? tile : (SIGNED_TILE_BASE / TILE_BYTES) + int8_t(tile);
+    };
+
+    uint8_t decoded[8 * MAX_TILES_PER_LINE];
+    if (m_useTileCache) {
+        for (int i = 0; i < tiles; ++i)
+            memcpy(decoded + 8 * i, m_tiles.row(tile_number(map[((scrollX >> 3) + i) & 31]), row), 8);
+    } else {
+        // Gather the row of every tile first, so they can all be decoded at once
+        uint8_t planes[2 * MAX_TILES_PER_LINE];
+        for (int i = 0; i < tiles; ++i) {
+            const int offset = tile_number(map[((scrollX >> 3) + i) & 31]) * TILE_BYTES + 2 * row;
+            planes[2 * i] = m_vram[offset];
+            planes[2 * i + 1] = m_vram[offset + 1];
+        }
+        TileDecoder::decode_rows(planes, tiles, decoded);
+    }
+    memcpy(indices + x, decoded + fineX, count);
+}
+
+auto Renderer::draw_sprites(const LcdRegisters& regs, uint8_t ly, const uint8_t* backgroundIndices,
+    uint8_t* pixels) -> void
+{
+    const int height = (regs.lcdc & TALL_SPRITES) ? 16 : 8;
+
+    // A pixel belongs to the highest priority sprite that isn't transparent there, even when
+    // that sprite is then hidden behind the background
+    const auto& line = m_sprites.line(ly, height == 16);
+    bool claimed[SCREEN_WIDTH] = {};
+    for (int i = 0; i < line.count; ++i) {
+        const auto* sprite = m_oam + 4 * line.sprites[i];
+        const auto attributes = sprite[3];
+        int row = ly - (sprite[0] - 16);
+        if (attributes & FLIP_Y)
+            row = height - 1 - row;
+        // Tall sprites run on into the next tile
+        const uint8_t tile = height == 16 ? sprite[2] & 0xFE : sprite[2];
+        uint8_t buffer[8];
+        const auto* decoded = tile_row(tile + row / 8, row % 8, buffer);
+
+        const auto palette = (attributes & SECOND_PALETTE) ? regs.obp1 : regs.obp0;
+        const int left = sprite[1] - 8;
+        for (int column = 0; column < 8; ++column) {
+            const int x = left + column;
+            if (x < 0 || x >= SCREEN_WIDTH || claimed[x])
+                continue;
+            const auto index = decoded[(attributes & FLIP_X) ? 7 - column : column];
+            if (!index)
+                continue;
+            claimed[x] = true;
+            if (!(attributes & BEHIND_BACKGROUND) || !backgroundIndices[x])
+                pixels[x] = (palette >> (2 * index)) & 0x03;
+        }
+    }
+}
+
+auto Renderer::tile_row(uint16_t tile, int row, uint8_t* decoded) -> const uint8_t*
+{
+    if (m_useTileCache)
+        return m_tiles.row(tile, row);
+    TileDecoder::decode_rows(m_vram + tile * TILE_BYTES + 2 * row, 1, decoded);
+    return decoded;
+}
+
+}
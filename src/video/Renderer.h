@@ -0,0 +1,67 @@
+#pragma once
+
+#include "video/SpriteTable.h"
+#include "video/TileCache.h"
+
+#include <stdint.h>
+
+namespace GameBoy {
+
+constexpr int SCREEN_WIDTH = 160;
+constexpr int SCREEN_HEIGHT = 144;
+
+// The PPU registers that decide what a line looks like
+struct LcdRegisters {
+    uint8_t lcdc = 0;
+    uint8_t scy = 0;
+    uint8_t scx = 0;
+    uint8_t bgp = 0;
+    uint8_t obp0 = 0;
+    uint8_t obp1 = 0;
+    uint8_t wy = 0;
+    uint8_t wx = 0;
+};
+
+// Draws the background, window and sprites one scanline at a time, as shades from 0 (lightest)
+// to 3. Tiles come decoded from a TileCache, or, with the cache off, are decoded through
+// TileDecoder a line's worth at once. Each line's sprites come sorted from a SpriteTable.
+class Renderer {
+public:
+    // vram is 8000-9FFF and oam FE00-FE9F; both must outlive the renderer
+    Renderer(const uint8_t* vram, const uint8_t* oam);
+
+    // Starts the window from its first line again
+    auto start_frame() -> void;
+    // How many lines of the window have been drawn this frame
+    auto window_line() const -> uint8_t { return m_windowLine; }
+    auto set_window_line(uint8_t line) -> void { m_windowLine = line; }
+    // Draws line ly into the SCREEN_WIDTH shades at pixels
+    auto render_line(const LcdRegisters&, uint8_t ly, uint8_t* pixels) -> void;
+
+    auto tiles() -> TileCache& { return m_tiles; }
+    auto tiles() const -> const TileCache& { return m_tiles; }
+    auto sprites() -> SpriteTable& { return m_sprites; }
+    auto tile_cache_enabled() const -> bool { return m_useTileCache; }
+    // Off decodes every tile row as it is drawn, leaving the cache alone. Turning it back on
+    // invalidates the whole cache, as VRAM may have changed unseen.
+    auto set_tile_cache_enabled(bool) -> void;
+
+private:
+    // Fills count palette indices from x with the tile map at mapBase, scrolled to (scrollX, y)
+    auto draw_tiles(const LcdRegisters&, uint16_t mapBase, uint8_t y, uint8_t scrollX, int x, int count,
+        uint8_t* indices) -> void;
+    auto draw_sprites(const LcdRegisters&, uint8_t ly, const uint8_t* backgroundIndices, uint8_t* pixels)
+        -> void;
+    // The palette indices of a row of tile (numbered as from 8000), left to right
+    auto tile_row(uint16_t tile, int row, uint8_t* decoded) -> const uint8_t*;
+
+    const uint8_t* m_vram;
+    const uint8_t* m_oam;
+    TileCache m_tiles;
+    SpriteTable m_sprites;
+    bool m_useTileCache = true;
+    // Lines of the window drawn so far this frame
+    uint8_t m_windowLine = 0;
+};
+
+}
@@ -0,0 +1,126 @@
+#include "video/SpriteTable.h"
+
+#include <algorithm>
+
+namespace GameBoy {
+
+using namespace std;
+
+// OAM Y is the line below the sprite's top, plus 16
+constexpr int Y_OFFSET = 16;
+constexpr int SHORT_HEIGHT = 8;
+constexpr int TALL_HEIGHT = 16;
+
+namespace {
+
+    // Index of the lowest set bit of a non-zero mask
+    inline auto lowest_bit(uint64_t mask) -> int
+    {
+#if defined(__GNUC__)
+        return __builtin_ctzll(mask);
+#else
+        int bit = 0;
+        for (; !(mask & 1); mask >>= 1)
+            ++bit;
+        return bit;
+#endif
+    }
+
+}
+
+SpriteTable::SpriteTable(const uint8_t* oam)
+    : m_oam(oam)
+{
+    reload();
+}
+
+auto SpriteTable::update(uint8_t offset) -> void
+{
+    const uint8_t sprite = offset / 4;
+    switch (offset % 4) {
+    case 0:
+        if (m_oam[offset] != m_y[sprite]) {
+            cover(sprite, m_y[sprite], false);
+            m_y[sprite] = m_oam[offset];
+            cover(sprite, m_y[sprite], true);
+        }
+        break;
+    case 1:
+        // Only the order along the line depends on X
+        if (m_oam[offset] != m_x[sprite]) {
+            m_x[sprite] = m_oam[offset];
+            mark_lines(m_y[sprite]);
+        }
+        break;
+    default:
+        // The tile and attributes are read as the line is drawn
+        break;
+    }
+}
+
+auto SpriteTable::reload() -> void
+{
+    for (auto& covering : m_covering)
+        covering.fill(0);
+    for (uint8_t sprite = 0; sprite < NUM_SPRITES; ++sprite) {
+        m_y[sprite] = m_oam[4 * sprite];
+        m_x[sprite] = m_oam[4 * sprite + 1];
+        cover(sprite, m_y[sprite], true);
+    }
+    for (auto& sorted : m_sorted)
+        sorted.fill(false);
+}
+
+auto SpriteTable::line(uint8_t ly, bool tall) -> const Line&
+{
+    if (!m_sorted[tall][ly])
+        sort_line(ly, tall);
+    return m_lines[tall][ly];
+}
+
+auto SpriteTable::cover(uint8_t sprite, uint8_t y, bool covered) -> void
+{
+    const int top = y - Y_OFFSET;
+    const uint64_t bit = uint64_t(1) << sprite;
+    for (int tall = 0; tall < 2; ++tall) {
+        const int bottom = min(top + (tall ? TALL_HEIGHT : SHORT_HEIGHT), NUM_LINES);
+        for (int ly = max(top, 0); ly < bottom; ++ly) {
+            if (covered)
+                m_covering[tall][ly] |= bit;
+            else
+                m_covering[tall][ly] &= ~bit;
+            m_sorted[tall][ly] = false;
+        }
+    }
+}
+
+auto SpriteTable::mark_lines(uint8_t y) -> void
+{
+    // A tall sprite covers everything a short one would
+    const int top = y - Y_OFFSET;
+    const int bottom = min(top + TALL_HEIGHT, NUM_LINES);
+    for (int ly = max(top, 0); ly < bottom; ++ly) {
+        m_sorted[0][ly] = false;
+        m_sorted[1][ly] = false;
+    }
+}
+
+auto SpriteTable::sort_line(uint8_t ly, bool tall) -> void
+{
+    auto& line = m_lines[tall][ly];
+    line.count = 0;
+    // Lowest bit first is OAM order, which settles which ten are drawn
+    for (auto mask = m_covering[tall][ly]; mask && line.count < MAX_PER_LINE; mask &= mask - 1)
+        line.sprites[line.count++] = uint8_t(lowest_bit(mask));
+    // Then lowest X first; the sort is stable, so OAM order breaks ties
+    for (int i = 1; i < line.count; ++i) {
+        const auto sprite = line.sprites[i];
+        int j = i;
+        for (; j > 0 && m_x[line.sprites[j - 1]] > m_x[sprite]; --j)
+            line.sprites[j] = line.sprites[j - 1];
+        line.sprites[j] = sprite;
+    }
+    m_sorted[tall][ly] = true;
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <stdint.h>
+
+namespace GameBoy {
+
+// Which sprites each visible line draws, kept up to date from OAM writes so a line never has
+// to look through all 40 entries. Every line has a bitmask of the sprites whose Y covers it,
+// for both sprite heights; a write to a Y or X byte moves only its own sprite's bits and marks
+// the lines it touched for re-sorting. A line's list is then picked and ordered as the DMG
+// does: the first ten in OAM order, lowest X first and OAM order between equal X.
+class SpriteTable {
+public:
+    static constexpr int MAX_PER_LINE = 10;
+
+    struct Line {
+        uint8_t count = 0;
+        // OAM indices, highest priority first
+        uint8_t sprites[MAX_PER_LINE];
+    };
+
+    // oam is FE00-FE9F and must outlive the table
+    SpriteTable(const uint8_t* oam);
+
+    // The OAM byte at offset has just been written
+    auto update(uint8_t offset) -> void;
+    // All of OAM may have changed, as after a DMA
+    auto reload() -> void;
+
+    // The sprites on line ly, for 8x16 sprites if tall
+    auto line(uint8_t ly, bool tall) -> const Line&;
+
+private:
+    static constexpr int NUM_SPRITES = 40;
+    // Lines that are drawn, the same as NUM_LINES
+    static constexpr int NUM_LINES = 144;
+
+    // Sets or clears the sprite's bit on the lines it covers, and marks them to be sorted again
+    auto cover(uint8_t sprite, uint8_t y, bool covered) -> void;
+    auto mark_lines(uint8_t y) -> void;
+    auto sort_line(uint8_t ly, bool tall) -> void;
+
+    const uint8_t* m_oam;
+    // Y and X as last seen, so a write knows where the sprite was
+    std::array<uint8_t, NUM_SPRITES> m_y {};
+    std::array<uint8_t, NUM_SPRITES> m_x {};
+    // Indexed by height: 0 for 8x8, 1 for 8x16
+    std::array<uint64_t, NUM_LINES> m_covering[2] {};
+    std::array<Line, NUM_LINES> m_lines[2];
+    std::array<bool, NUM_LINES> m_sorted[2] {};
+};
+
+}
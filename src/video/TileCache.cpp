@@ -0,0 +1,27 @@
+#include "video/TileCache.h"
+
+namespace GameBoy {
+
+using namespace std;
+
+constexpr uint16_t TILE_DATA_START = 0x8000;
+constexpr uint16_t TILE_DATA_END = 0x9800;
+
+TileCache::TileCache(const uint8_t* vram)
+    : m_vram(vram)
+{
+    invalidate_all();
+}
+
+auto TileCache::invalidate(uint16_t address) -> void
+{
+    if (address < TILE_DATA_END)
+        m_dirty[(address - TILE_DATA_START) / 16] = true;
+}
+
+auto TileCache::invalidate_all() -> void
+{
+    m_dirty.fill(true);
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "video/TileDecoder.h"
+
+#include <array>
+#include <stdint.h>
+
+namespace GameBoy {
+
+// The 384 tiles of 8000-97FF decoded to 8x8 palette indices. A tile is decoded the first time
+// it is drawn after its 16 bytes were written, and read straight from here until the next
+// write.
+class TileCache {
+public:
+    static constexpr uint16_t NUM_TILES = 384;
+
+    struct Stats {
+        // Tile rows drawn from an already decoded tile, and tiles decoded
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    // vram is 8000-9FFF and must outlive the cache
+    TileCache(const uint8_t* vram);
+
+    // The 8 palette indices of one row of a tile, numbered as from 8000
+    auto row(uint16_t tile, uint8_t row) -> const uint8_t*;
+    // The VRAM byte at address has changed; writes to the tile maps are ignored
+    auto invalidate(uint16_t address) -> void;
+    auto invalidate_all() -> void;
+
+    auto stats() const -> const Stats& { return m_stats; }
+
+private:
+    const uint8_t* m_vram;
+    std::array<uint8_t, NUM_TILES * 64> m_pixels {};
+    std::array<bool, NUM_TILES> m_dirty {};
+    Stats m_stats;
+};
+
+inline auto TileCache::row(uint16_t tile, uint8_t row) -> const uint8_t*
+{
+    if (m_dirty[tile]) {
+        ++m_stats.misses;
+        TileDecoder::decode_rows(m_vram + tile * 16, 8, &m_pixels[tile * 64]);
+        m_dirty[tile] = false;
+    } else {
+        ++m_stats.hits;
+    }
+    return &m_pixels[tile * 64 + row * 8];
+}
+
+}
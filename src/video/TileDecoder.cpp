@@ -0,0 +1,150 @@
+#include "video/TileDecoder.h"
+
+#include <cassert>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define GAMEBOY_TILE_SIMD 1
+#include <immintrin.h>
+#endif
+
+namespace GameBoy::TileDecoder {
+
+using namespace std;
+
+namespace {
+
+    // The reference: one pixel at a time, shifting each bit out of both planes
+    auto decode_scalar(const uint8_t* planes, size_t rows, uint8_t* pixels) -> void
+    {
+        for (size_t row = 0; row < rows; ++row) {
+            const uint8_t low = planes[2 * row];
+            const uint8_t high = planes[2 * row + 1];
+            for (int x = 0; x < 8; ++x) {
+                const int bit = 7 - x;
+                pixels[8 * row + x] = ((low >> bit) & 1) | (((high >> bit) & 1) << 1);
+            }
+        }
+    }
+
+#ifdef GAMEBOY_TILE_SIMD
+
+    // Both versions copy each plane byte across the eight pixels of its row, keep each pixel's
+    // own bit with an AND against 80 40 20 10 08 04 02 01, turn that into 00/FF with a compare,
+    // and combine the planes as 1s and 2s.
+
+    __attribute__((target("sse2"))) inline auto expand_sse2(__m128i plane, __m128i bits, __m128i value) -> __m128i
+    {
+        return _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(plane, bits), bits), value);
+    }
+
+    __attribute__((target("avx2"))) inline auto expand_avx2(__m256i plane, __m256i bits, __m256i value) -> __m256i
+    {
+        return _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(plane, bits), bits), value);
+    }
+
+    __attribute__((target("sse2"))) auto decode_sse2(const uint8_t* planes, size_t rows, uint8_t* pixels) -> void
+    {
+        const auto bits = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+        const auto ones = _mm_set1_epi8(1);
+        const auto twos = _mm_set1_epi8(2);
+        const auto lowBytes = _mm_set1_epi16(0x00FF);
+
+        // Eight rows at a time, from sixteen interleaved plane bytes
+        size_t row = 0;
+        for (; row + 8 <= rows; row += 8) {
+            const auto interleaved = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + 2 * row));
+            // l0..l7 and h0..h7 in the low halves
+            const auto lows = _mm_packus_epi16(_mm_and_si128(interleaved, lowBytes), _mm_setzero_si128());
+            const auto highs = _mm_packus_epi16(_mm_srli_epi16(interleaved, 8), _mm_setzero_si128());
+            // Each byte twice, four times, then eight times: two rows per register
+            const auto lows2 = _mm_unpacklo_epi8(lows, lows);
+            const auto highs2 = _mm_unpacklo_epi8(highs, highs);
+            const auto lows4 = _mm_unpacklo_epi16(lows2, lows2);
+            const auto lowsHigh4 = _mm_unpackhi_epi16(lows2, lows2);
+            const auto highs4 = _mm_unpacklo_epi16(highs2, highs2);
+            const auto highsHigh4 = _mm_unpackhi_epi16(highs2, highs2);
+            const __m128i lowRows[4] = {
+                _mm_unpacklo_epi32(lows4, lows4),
+                _mm_unpackhi_epi32(lows4, lows4),
+                _mm_unpacklo_epi32(lowsHigh4, lowsHigh4),
+                _mm_unpackhi_epi32(lowsHigh4, lowsHigh4),
+            };
+            const __m128i highRows[4] = {
+                _mm_unpacklo_epi32(highs4, highs4),
+                _mm_unpackhi_epi32(highs4, highs4),
+                _mm_unpacklo_epi32(highsHigh4, highsHigh4),
+                _mm_unpackhi_epi32(highsHigh4, highsHigh4),
+            };
+            for (int pair = 0; pair < 4; ++pair) {
+                const auto result = _mm_or_si128(expand_sse2(lowRows[pair], bits, ones), expand_sse2(highRows[pair], bits, twos));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 8 * row + 16 * pair), result);
+            }
+        }
+        decode_scalar(planes + 2 * row, rows - row, pixels + 8 * row);
+    }
+
+    __attribute__((target("avx2"))) auto decode_avx2(const uint8_t* planes, size_t rows, uint8_t* pixels) -> void
+    {
+        const auto bits = _mm256_set1_epi64x(0x0102040810204080);
+        const auto ones = _mm256_set1_epi8(1);
+        const auto twos = _mm256_set1_epi8(2);
+        // From four rows' plane bytes in each lane, row r's low plane across pixels 8r-8r+7:
+        // rows 0 and 1 in the first lane, 2 and 3 in the second
+        const auto lowIndices = _mm256_setr_epi8(
+            0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2,
+            4, 4, 4, 4, 4, 4, 4, 4, 6, 6, 6, 6, 6, 6, 6, 6);
+        const auto highIndices = _mm256_add_epi8(lowIndices, ones);
+
+        // Four rows at a time, from eight interleaved plane bytes copied into both lanes
+        size_t row = 0;
+        for (; row + 4 <= rows; row += 4) {
+            int64_t interleaved;
+            memcpy(&interleaved, planes + 2 * row, sizeof(interleaved));
+            const auto source = _mm256_set1_epi64x(interleaved);
+            const auto lows = _mm256_shuffle_epi8(source, lowIndices);
+            const auto highs = _mm256_shuffle_epi8(source, highIndices);
+            const auto result = _mm256_or_si256(expand_avx2(lows, bits, ones), expand_avx2(highs, bits, twos));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + 8 * row), result);
+        }
+        decode_scalar(planes + 2 * row, rows - row, pixels + 8 * row);
+    }
+
+#endif
+
+    using Decoder = auto (*)(const uint8_t*, size_t, uint8_t*) -> void;
+
+    auto decoder_for(Isa isa) -> Decoder
+    {
+        switch (isa) {
+#ifdef GAMEBOY_TILE_SIMD
+        case Isa::Sse2:
+            return decode_sse2;
+        case Isa::Avx2:
+            return decode_avx2;
+#endif
+        default:
+            return decode_scalar;
+        }
+    }
+
+}
+
+auto decode_rows(const uint8_t* planes, size_t rows, uint8_t* pixels) -> void
+{
+    static const auto decoder = decoder_for(best_isa());
+    decoder(planes, rows, pixels);
+}
+
+auto decode_rows(Isa isa, const uint8_t* planes, size_t rows, uint8_t* pixels) -> void
+{
+    assert(supported(isa));
+    decoder_for(isa)(planes, rows, pixels);
+}
+
+auto supported(Isa isa) -> bool
+{
+    return isa_supported(isa);
+}
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "util/Isa.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Expands 2bpp planar tile data into one palette index (0-3) per byte. Each row of a tile is
+// two bytes, the low bitplane first, with bit 7 the leftmost pixel; a pixel's index is its bit
+// from the high plane above its bit from the low one. On x86 the bitplanes are interleaved 16
+// or 32 pixels at a time with SSE2 or AVX2, picked once at startup.
+namespace GameBoy::TileDecoder {
+
+using GameBoy::Isa;
+
+// Decodes rows consecutive rows, 2 * rows bytes of planes, into 8 * rows pixels
+auto decode_rows(const uint8_t* planes, size_t rows, uint8_t* pixels) -> void;
+// The same through a particular implementation, which must be supported
+auto decode_rows(Isa, const uint8_t* planes, size_t rows, uint8_t* pixels) -> void;
+
+auto supported(Isa) -> bool;
+// What decode_rows without an Isa uses
+using GameBoy::best_isa;
+
+}
@@ -0,0 +1,435 @@
+#include "gtest/gtest.h"
+
+#include "CPU.h"
+#include "audio/Apu.h"
+#include "audio/BlepBuffer.h"
+#include "audio/Resampler.h"
+#include "audio/WavWriter.h"
+#include "memory/Memory.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace GameBoy;
+using namespace std;
+
+namespace {
+
+constexpr uint16_t NR10 = 0xFF10;
+constexpr uint16_t NR11 = 0xFF11;
+constexpr uint16_t NR12 = 0xFF12;
+constexpr uint16_t NR13 = 0xFF13;
+constexpr uint16_t NR14 = 0xFF14;
+constexpr uint16_t NR30 = 0xFF1A;
+constexpr uint16_t NR32 = 0xFF1C;
+constexpr uint16_t NR33 = 0xFF1D;
+constexpr uint16_t NR34 = 0xFF1E;
+constexpr uint16_t NR42 = 0xFF21;
+constexpr uint16_t NR43 = 0xFF22;
+constexpr uint16_t NR44 = 0xFF23;
+constexpr uint16_t NR50 = 0xFF24;
+constexpr uint16_t NR51 = 0xFF25;
+constexpr uint16_t NR52 = 0xFF26;
+constexpr uint16_t WAVE_RAM = 0xFF30;
+
+constexpr uint32_t FRAME_SEQUENCER_CYCLES = 8192;
+// 128 cycles a sample
+constexpr uint32_t SAMPLE_RATE = 32768;
+// A channel at full volume with the master volume all the way up
+constexpr int16_t LOUDEST = 15 * 8 * 64;
+// Output is band-limited, so only levels held for a while come out exactly; an edge spreads
+// over the 16 samples either side of it at this rate, some 10 samples late
+constexpr int EDGE_SAMPLES = 16;
+
+class ApuTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        mem = make_unique<Memory>();
+        cpu = make_unique<CPU>(*mem);
+        apu = make_unique<Apu>(*cpu);
+
+        // HALT with nothing to wake it, so time passes as quickly as it can
+        mem->write8(0xC000, 0x76);
+        mem->registers().pc = 0xC000;
+        mem->write8(NR50, 0x77);
+    }
+
+    // The left samples of the next cycles
+    auto left_samples(uint32_t cycles) -> vector<int16_t>
+    {
+        cpu->run_for(cycles);
+        vector<int16_t> samples(2 * cycles / 64);
+        samples.resize(2 * apu->read_samples(samples.data(), samples.size() / 2));
+        vector<int16_t> left;
+        for (size_t i = 0; i < samples.size(); i += 2)
+            left.push_back(samples[i]);
+        return left;
+    }
+
+    // Where the samples rise through threshold
+    static auto rising(const vector<int16_t>& samples, int threshold) -> vector<size_t>
+    {
+        vector<size_t> indices;
+        for (size_t i = 1; i < samples.size(); ++i) {
+            if (samples[i - 1] < threshold && samples[i] >= threshold)
+                indices.push_back(i);
+        }
+        return indices;
+    }
+
+    static auto above(const vector<int16_t>& samples, int threshold) -> int
+    {
+        return int(count_if(samples.begin(), samples.end(), [&](int16_t sample) { return sample >= threshold; }));
+    }
+
+    // The value held longest
+    static auto level(const vector<int16_t>& samples) -> int16_t
+    {
+        int16_t best = 0;
+        int longest = 0;
+        for (size_t i = 0; i < samples.size();) {
+            size_t end = i;
+            while (end < samples.size() && samples[end] == samples[i])
+                ++end;
+            if (int(end - i) > longest) {
+                longest = int(end - i);
+                best = samples[i];
+            }
+            i = end;
+        }
+        return best;
+    }
+
+    unique_ptr<Memory> mem;
+    unique_ptr<CPU> cpu;
+    unique_ptr<Apu> apu;
+};
+
+}
+
+TEST_F(ApuTest, RegistersReadBackWithUnusedBitsSet) {
+    mem->write8(NR11, 0x80);
+    EXPECT_EQ(mem->read8(NR11), 0xBF);
+    mem->write8(NR13, 0x12);
+    EXPECT_EQ(mem->read8(NR13), 0xFF);
+    EXPECT_EQ(mem->read8(0xFF27), 0xFF);
+    EXPECT_EQ(mem->read8(NR50), 0x77);
+    EXPECT_EQ(mem->read8(NR52), 0xF0);
+
+    // Powering off clears the registers and ignores writes, but not to wave RAM
+    mem->write8(NR52, 0x00);
+    EXPECT_EQ(mem->read8(NR52), 0x70);
+    EXPECT_EQ(mem->read8(NR50), 0x00);
+    mem->write8(NR50, 0x77);
+    EXPECT_EQ(mem->read8(NR50), 0x00);
+    mem->write8(WAVE_RAM, 0x5A);
+    EXPECT_EQ(mem->read8(WAVE_RAM), 0x5A);
+}
+
+TEST_F(ApuTest, LengthCounterStopsTheChannel) {
+    mem->write8(NR12, 0xF0);
+    mem->write8(NR11, 0x3F); // One step left
+    mem->write8(NR14, 0xC0); // Trigger, with the length enabled
+    EXPECT_EQ(mem->read8(NR52) & 0x01, 0x01);
+
+    cpu->run_for(FRAME_SEQUENCER_CYCLES - 100);
+    EXPECT_EQ(mem->read8(NR52) & 0x01, 0x01);
+    cpu->run_for(200);
+    EXPECT_EQ(mem->read8(NR52) & 0x01, 0x00);
+}
+
+TEST_F(ApuTest, SquareWaveAtThePitchSet) {
+    apu->set_sample_rate(SAMPLE_RATE);
+    mem->write8(NR51, 0x11);
+    mem->write8(NR12, 0xF0);
+    mem->write8(NR11, 0x80); // Half duty
+    // Frequency 1024: 4096 cycles a step, so 128 samples high then 128 low
+    mem->write8(NR13, 0x00);
+    mem->write8(NR14, 0x84);
+
+    const auto samples = left_samples(8 * 32768);
+    ASSERT_EQ(samples.size(), 8 * 256);
+    // Steps 0 and 5-7 are high: the trigger, then once a period a step later
+    const auto rises = rising(samples, LOUDEST / 2);
+    ASSERT_EQ(rises.size(), 9);
+    EXPECT_EQ(rises[1] - rises[0], 160);
+    // High for half of each period
+    for (size_t i = 2; i < rises.size(); ++i) {
+        EXPECT_EQ(rises[i] - rises[i - 1], 256);
+        const vector<int16_t> period(samples.begin() + rises[i - 1], samples.begin() + rises[i]);
+        EXPECT_EQ(above(period, LOUDEST / 2), 128);
+    }
+    // Flat away from the edges
+    EXPECT_NEAR(samples[rises[1] + 64], LOUDEST, 1);
+    EXPECT_NEAR(samples[rises[1] - 64], 0, 1);
+}
+
+TEST_F(ApuTest, PitchesAboveTheSampleRateDoNotAlias) {
+    apu->set_sample_rate(SAMPLE_RATE);
+    mem->write8(NR51, 0x11);
+    mem->write8(NR12, 0xF0);
+    mem->write8(NR11, 0x80);
+    // Frequency 2047: 4 cycles a step, a 131 kHz square that averages out at half
+    mem->write8(NR13, 0xFF);
+    mem->write8(NR14, 0x87);
+
+    const auto samples = left_samples(32768);
+    for (size_t i = 2 * EDGE_SAMPLES; i < samples.size(); ++i)
+        ASSERT_NEAR(samples[i], LOUDEST / 2, LOUDEST / 100) << i;
+}
+
+TEST_F(ApuTest, EnvelopeFadesOut) {
+    apu->set_sample_rate(SAMPLE_RATE);
+    mem->write8(NR51, 0x11);
+    mem->write8(NR12, 0xF1); // From 15 down, a step every 8 frame sequencer steps
+    mem->write8(NR11, 0xC0);
+    mem->write8(NR14, 0x87);
+
+    constexpr uint32_t ENVELOPE_CYCLES = 8 * FRAME_SEQUENCER_CYCLES;
+    auto samples = left_samples(ENVELOPE_CYCLES - 200);
+    EXPECT_EQ(level(samples), LOUDEST);
+    // Across the first envelope step, then up to just short of the second
+    left_samples(400 + 2 * EDGE_SAMPLES * 128);
+    samples = left_samples(ENVELOPE_CYCLES - 400 - 2 * EDGE_SAMPLES * 128);
+    EXPECT_EQ(level(samples), 14 * 8 * 64);
+
+    // 15 steps in all take it to nothing
+    left_samples(13 * ENVELOPE_CYCLES + 400 + 2 * EDGE_SAMPLES * 128);
+    samples = left_samples(ENVELOPE_CYCLES);
+    EXPECT_EQ(*max_element(samples.begin(), samples.end()), 0);
+    EXPECT_EQ(*min_element(samples.begin(), samples.end()), 0);
+    // Still playing, just silent
+    EXPECT_EQ(mem->read8(NR52) & 0x01, 0x01);
+}
+
+TEST_F(ApuTest, SweepOverflowStopsTheChannel) {
+    mem->write8(NR12, 0xF0);
+    mem->write8(NR10, 0x11); // Up by half every sweep step
+    mem->write8(NR13, 0xFF);
+    mem->write8(NR14, 0x87);
+    // 2047 would go straight over
+    EXPECT_EQ(mem->read8(NR52) & 0x01, 0x00);
+
+    mem->write8(NR13, 0x00);
+    mem->write8(NR14, 0x84);
+    EXPECT_EQ(mem->read8(NR52) & 0x01, 0x01);
+    // The first sweep step, on the third frame sequencer step, takes it to 1536, which
+    // would overflow on the next
+    cpu->run_for(3 * FRAME_SEQUENCER_CYCLES - 100);
+    EXPECT_EQ(mem->read8(NR52) & 0x01, 0x01);
+    cpu->run_for(200);
+    EXPECT_EQ(mem->read8(NR52) & 0x01, 0x00);
+}
+
+TEST_F(ApuTest, WaveChannelPlaysWaveRam) {
+    apu->set_sample_rate(SAMPLE_RATE);
+    mem->write8(NR51, 0x44);
+    // Only the first of the 32 samples is loud
+    mem->write8(WAVE_RAM, 0xF0);
+    mem->write8(NR30, 0x80);
+    mem->write8(NR32, 0x20); // Full volume
+    // Frequency 0: 4096 cycles a sample, so 32 output samples each
+    mem->write8(NR33, 0x00);
+    mem->write8(NR34, 0x80);
+
+    const auto samples = left_samples(2 * 32 * 4096);
+    const auto rises = rising(samples, LOUDEST / 2);
+    ASSERT_EQ(rises.size(), 2);
+    EXPECT_EQ(rises[1] - rises[0], 1024);
+    EXPECT_EQ(above(samples, LOUDEST / 2), 2 * 32);
+    EXPECT_NEAR(samples[rises[0] + 16], LOUDEST, 1);
+    EXPECT_NEAR(samples[rises[0] + 64], 0, 1);
+
+    // Half volume
+    mem->write8(NR32, 0x40);
+    const auto quieter = left_samples(32 * 4096);
+    EXPECT_NEAR(quieter[rises[0] + 16], 7 * 8 * 64, 1);
+}
+
+TEST_F(ApuTest, NoiseIsNoisy) {
+    apu->set_sample_rate(SAMPLE_RATE);
+    mem->write8(NR51, 0x88);
+    mem->write8(NR42, 0xF0);
+    mem->write8(NR43, 0x31); // 16 << 3 cycles a shift
+    mem->write8(NR44, 0x80);
+
+    const auto samples = left_samples(32768);
+    EXPECT_GT(above(samples, LOUDEST / 2), 50);
+    EXPECT_GT(rising(samples, LOUDEST / 2).size(), 20);
+    // A little over at most, where the band-limited edges ring
+    EXPECT_LT(*max_element(samples.begin(), samples.end()), LOUDEST * 12 / 10);
+    EXPECT_GT(*min_element(samples.begin(), samples.end()), -LOUDEST / 5);
+}
+
+TEST_F(ApuTest, SamplesComeInBatches) {
+    apu->set_sample_rate(48000);
+    cpu->run_for(Apu::CYCLES_PER_SECOND / 10);
+
+    vector<int16_t> samples(2 * 10000);
+    EXPECT_EQ(apu->read_samples(samples.data(), 10000), 4800);
+    EXPECT_EQ(apu->read_samples(samples.data(), 10000), 0);
+    // Only as many as asked for, the rest kept
+    cpu->run_for(Apu::CYCLES_PER_SECOND / 10);
+    EXPECT_EQ(apu->read_samples(samples.data(), 1000), 1000);
+    EXPECT_EQ(apu->read_samples(samples.data(), 10000), 3800);
+}
+
+TEST(ApuReadTest, ReadingInPiecesLosesNothing) {
+    // The same square wave, read all at once or a few frames at a time
+    const auto play = [](size_t framesPerRead) {
+        Memory mem;
+        CPU cpu(mem);
+        Apu apu(cpu);
+        mem.write8(0xC000, 0x76);
+        mem.registers().pc = 0xC000;
+        mem.write8(NR50, 0x77);
+        mem.write8(NR51, 0x11);
+        mem.write8(NR12, 0xF0);
+        mem.write8(NR11, 0x80);
+        mem.write8(NR14, 0x84);
+        apu.set_sample_rate(SAMPLE_RATE);
+
+        vector<int16_t> samples;
+        vector<int16_t> piece(2 * framesPerRead);
+        for (int i = 0; i < 4; ++i) {
+            cpu.run_for(Apu::CYCLES_PER_SECOND / 8);
+            while (const auto frames = apu.read_samples(piece.data(), framesPerRead))
+                samples.insert(samples.end(), piece.begin(), piece.begin() + 2 * frames);
+        }
+        return samples;
+    };
+
+    const auto whole = play(SAMPLE_RATE);
+    EXPECT_EQ(whole.size(), 2 * SAMPLE_RATE / 2);
+    EXPECT_EQ(play(7), whole);
+}
+
+TEST_F(ApuTest, AdjustingTheRateCarriesOn) {
+    apu->set_sample_rate(48000);
+    cpu->run_for(Apu::CYCLES_PER_SECOND / 10);
+    apu->adjust_sample_rate(48240);
+    cpu->run_for(Apu::CYCLES_PER_SECOND / 10);
+
+    // Nothing made so far is dropped, and the rest comes a little faster
+    vector<int16_t> samples(2 * 20000);
+    const auto frames = apu->read_samples(samples.data(), 20000);
+    EXPECT_NEAR(int(frames), 4800 + 4824, 1);
+    EXPECT_EQ(apu->sample_rate(), 48000);
+}
+
+TEST(BlepBufferTest, StepsSettleAtTheirLevel) {
+    BlepBuffer steps;
+    steps.reset(1000);
+    steps.add_step(1000 + 100 * BlepBuffer::CYCLES_PER_SAMPLE + 5, 3000, -500);
+    steps.add_step(1000 + 200 * BlepBuffer::CYCLES_PER_SAMPLE, -1000, 500);
+    EXPECT_EQ(steps.available(1000 + 300 * BlepBuffer::CYCLES_PER_SAMPLE + 31), 300);
+
+    vector<float> left(300);
+    vector<float> right(300);
+    steps.read(100, left.data(), right.data());
+    steps.read(200, left.data() + 100, right.data() + 100);
+    // Silent until the first step, then each level exactly, once its kernel has gone by
+    for (int i = 0; i < 100; ++i)
+        EXPECT_EQ(left[i], 0);
+    for (size_t i = 100 + BlepBuffer::KERNEL_SIZE; i < 200; ++i) {
+        EXPECT_EQ(left[i], 3000);
+        EXPECT_EQ(right[i], -500);
+    }
+    for (size_t i = 200 + BlepBuffer::KERNEL_SIZE; i < 300; ++i) {
+        EXPECT_EQ(left[i], 2000);
+        EXPECT_EQ(right[i], 0);
+    }
+    // Rising through the middle, halfway through the kernel
+    EXPECT_LT(left[100 + BlepBuffer::KERNEL_SIZE / 2 - 1], 1500);
+    EXPECT_GT(left[100 + BlepBuffer::KERNEL_SIZE / 2 + 1], 1500);
+}
+
+TEST(ResamplerTest, EveryIsaMatchesScalar) {
+    constexpr uint32_t INPUT_RATE = 131072;
+    // Square waves with band-limited edges, as from a BlepBuffer, one a side
+    vector<float> left(INPUT_RATE / 4);
+    vector<float> right(left.size());
+    BlepBuffer steps;
+    steps.reset(0);
+    for (uint64_t cycle = 1000, i = 0; cycle < left.size() * BlepBuffer::CYCLES_PER_SAMPLE; cycle += 777, ++i)
+        steps.add_step(cycle, (i & 1) ? -20000 : 20000, (i % 3) ? 3000 : -6000);
+    steps.read(left.size(), left.data(), right.data());
+
+    for (uint32_t outputRate : { 44100, 48000 }) {
+        vector<int16_t> reference;
+        Resampler(INPUT_RATE, outputRate, Isa::Scalar).process(left.data(), right.data(), left.size(), reference);
+        ASSERT_GT(reference.size(), 2 * outputRate / 4 - 10);
+
+        for (auto isa : { Isa::Scalar, Isa::Sse2, Isa::Avx2 }) {
+            if (!isa_supported(isa))
+                continue;
+            // In uneven pieces, which should make no difference
+            Resampler resampler(INPUT_RATE, outputRate, isa);
+            vector<int16_t> output;
+            for (size_t start = 0, piece = 1; start < left.size(); start += piece, piece = piece * 3 % 1001 + 1) {
+                const auto count = min(piece, left.size() - start);
+                resampler.process(left.data() + start, right.data() + start, count, output);
+            }
+            ASSERT_EQ(output.size(), reference.size());
+            for (size_t i = 0; i < output.size(); ++i)
+                ASSERT_NEAR(output[i], reference[i], 1) << "isa " << int(isa) << ", sample " << i;
+        }
+    }
+}
+
+TEST(ResamplerTest, PassesWhatTheOutputRateCarriesAndNothingElse) {
+    constexpr uint32_t INPUT_RATE = 131072;
+    constexpr uint32_t OUTPUT_RATE = 48000;
+    const auto amplitude = [&](double frequency) {
+        vector<float> tone(INPUT_RATE / 8);
+        for (size_t i = 0; i < tone.size(); ++i)
+            tone[i] = float(10000 * sin(2 * 3.14159265358979323846 * frequency * i / INPUT_RATE));
+        Resampler resampler(INPUT_RATE, OUTPUT_RATE);
+        vector<int16_t> output;
+        resampler.process(tone.data(), tone.data(), tone.size(), output);
+        // Past where the filter is still filling
+        int peak = 0;
+        for (size_t i = 2 * Resampler::NUM_TAPS; i < output.size(); i += 2)
+            peak = max(peak, abs(int(output[i])));
+        return peak;
+    };
+
+    EXPECT_NEAR(amplitude(1000), 10000, 20);
+    // Off any whole fraction of the output rate, so that the samples come near the peaks
+    EXPECT_NEAR(amplitude(15111), 10000, 100);
+    // Would fold back to 13 kHz
+    EXPECT_LT(amplitude(35000), 100);
+}
+
+TEST(WavWriterTest, FillsInTheHeader) {
+    const auto path = testing::TempDir() + "apu_test.wav";
+    {
+        auto writer = WavWriter::create(path, 48000);
+        ASSERT_TRUE(writer);
+        const int16_t samples[] = { 1, -1, 0x1234, -0x1234 };
+        writer->write(samples, 2);
+        EXPECT_EQ(writer->frames_written(), 2);
+    }
+
+    auto* file = fopen(path.c_str(), "rb");
+    ASSERT_TRUE(file);
+    vector<uint8_t> bytes(100);
+    bytes.resize(fread(bytes.data(), 1, bytes.size(), file));
+    fclose(file);
+    remove(path.c_str());
+
+    ASSERT_EQ(bytes.size(), 44 + 8);
+    EXPECT_EQ(string(bytes.begin(), bytes.begin() + 4), "RIFF");
+    EXPECT_EQ(bytes[4], 36 + 8);
+    EXPECT_EQ(string(bytes.begin() + 8, bytes.begin() + 16), "WAVEfmt ");
+    EXPECT_EQ(bytes[24] | bytes[25] << 8, 48000 & 0xFFFF);
+    EXPECT_EQ(string(bytes.begin() + 36, bytes.begin() + 40), "data");
+    EXPECT_EQ(bytes[40], 8);
+    EXPECT_EQ(bytes[48], 0x34);
+    EXPECT_EQ(bytes[49], 0x12);
+}
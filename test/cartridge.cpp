@@ -0,0 +1,184 @@
+#include "gtest/gtest.h"
+
+#include "cartridge/Cartridge.h"
+#include "cartridge/RomImage.h"
+#include "memory/Memory.h"
+
+#include <cstdio>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+using namespace GameBoy;
+using namespace std;
+
+namespace {
+
+// A ROM whose every bank starts with its own number
+auto make_rom(uint8_t type, size_t banks, uint8_t ramSize = 0x00) -> unique_ptr<RomImage>
+{
+    vector<uint8_t> bytes(banks * 0x4000);
+    for (size_t bank = 0; bank < banks; ++bank) {
+        bytes[bank * 0x4000] = uint8_t(bank);
+        bytes[bank * 0x4000 + 1] = uint8_t(bank >> 8);
+    }
+    const char title[] = "TESTCART";
+    copy(begin(title), end(title), bytes.begin() + 0x134);
+    bytes[0x147] = type;
+    bytes[0x149] = ramSize;
+    return RomImage::from_bytes(move(bytes));
+}
+
+}
+
+TEST(CartridgeTest, HeaderDescribesTheCartridge) {
+    const auto rom = make_rom(0x13, 8, 0x03);
+    const auto header = Cartridge::parse_header(*rom);
+    ASSERT_TRUE(header);
+    EXPECT_EQ(header->title, "TESTCART");
+    EXPECT_EQ(header->controller, BankController::Mbc3);
+    EXPECT_FALSE(header->hasClock);
+    EXPECT_EQ(header->romBanks, 8);
+    EXPECT_EQ(header->ramSize, 0x8000u);
+}
+
+TEST(CartridgeTest, UnusableImagesAreRejected) {
+    Memory mem;
+    EXPECT_FALSE(Cartridge::parse_header(*RomImage::from_bytes(vector<uint8_t>(0x4000))));
+    EXPECT_FALSE(Cartridge::parse_header(*RomImage::from_bytes(vector<uint8_t>(0x8001))));
+    // MBC2 isn't supported
+    EXPECT_FALSE(Cartridge::insert(mem, make_rom(0x05, 2)));
+}
+
+TEST(CartridgeTest, Mbc1SwitchesBanksWithoutCopying) {
+    Memory mem;
+    auto cartridge = Cartridge::insert(mem, make_rom(0x01, 0x40));
+    ASSERT_TRUE(cartridge);
+    EXPECT_EQ(mem.read8(0x0000), 0);
+    EXPECT_EQ(mem.read8(0x4000), 1);
+
+    mem.write8(0x2000, 0x05);
+    EXPECT_EQ(mem.read8(0x4000), 5);
+    EXPECT_EQ(mem.switchable_rom_bank(), 5);
+    // Bank 0 can't be selected into the switchable window
+    mem.write8(0x2000, 0x00);
+    EXPECT_EQ(mem.read8(0x4000), 1);
+
+    mem.write8(0x4000, 0x01);
+    EXPECT_EQ(mem.read8(0x4000), 0x21);
+    EXPECT_EQ(mem.read8(0x0000), 0);
+    // Advanced mode banks the fixed window too
+    mem.write8(0x6000, 0x01);
+    EXPECT_EQ(mem.read8(0x0000), 0x20);
+    EXPECT_EQ(mem.fixed_rom_bank(), 0x20);
+}
+
+TEST(CartridgeTest, RamIsOnlyMappedWhileEnabled) {
+    Memory mem;
+    auto cartridge = Cartridge::insert(mem, make_rom(0x03, 4, 0x02));
+    ASSERT_TRUE(cartridge);
+
+    mem.write8(0xA000, 0x12);
+    EXPECT_EQ(mem.read8(0xA000), 0xFF);
+
+    mem.write8(0x0000, 0x0A);
+    mem.write8(0xA000, 0x12);
+    EXPECT_EQ(mem.read8(0xA000), 0x12);
+    EXPECT_EQ(cartridge->ram()[0], 0x12);
+
+    mem.write8(0x0000, 0x00);
+    EXPECT_EQ(mem.read8(0xA000), 0xFF);
+}
+
+TEST(CartridgeTest, SmallRamMirrorsAcrossTheWindow) {
+    Memory mem;
+    auto cartridge = Cartridge::insert(mem, make_rom(0x03, 4, 0x01));
+    ASSERT_TRUE(cartridge);
+    EXPECT_EQ(cartridge->ram().size(), 0x800u);
+
+    mem.write8(0x0000, 0x0A);
+    mem.write8(0xA000, 0x12);
+    EXPECT_EQ(mem.read8(0xA800), 0x12);
+    EXPECT_EQ(mem.read8(0xB800), 0x12);
+
+    mem.write8(0xBFFF, 0x34);
+    EXPECT_EQ(mem.read8(0xA7FF), 0x34);
+    EXPECT_EQ(cartridge->ram()[0x7FF], 0x34);
+}
+
+TEST(CartridgeTest, Mbc3BanksRamAndLatchesTheClock) {
+    Memory mem;
+    auto cartridge = Cartridge::insert(mem, make_rom(0x10, 0x80, 0x03));
+    ASSERT_TRUE(cartridge);
+    mem.write8(0x0000, 0x0A);
+
+    mem.write8(0x2000, 0x7F);
+    EXPECT_EQ(mem.read8(0x4000), 0x7F);
+
+    mem.write8(0x4000, 0x02);
+    mem.write8(0xA000, 0x22);
+    mem.write8(0x4000, 0x00);
+    EXPECT_EQ(mem.read8(0xA000), 0x00);
+    mem.write8(0x4000, 0x02);
+    EXPECT_EQ(mem.read8(0xA000), 0x22);
+
+    // Seconds only become readable once latched
+    mem.write8(0x4000, 0x08);
+    mem.write8(0xA000, 42);
+    EXPECT_EQ(mem.read8(0xA000), 0);
+    mem.write8(0x6000, 0x00);
+    mem.write8(0x6000, 0x01);
+    EXPECT_EQ(mem.read8(0xA000), 42);
+}
+
+TEST(CartridgeTest, Mbc5SelectsBanksPastTheFirst256) {
+    Memory mem;
+    auto cartridge = Cartridge::insert(mem, make_rom(0x19, 0x200));
+    ASSERT_TRUE(cartridge);
+
+    mem.write8(0x2000, 0x00);
+    EXPECT_EQ(mem.read8(0x4000), 0);
+    mem.write8(0x2000, 0x34);
+    mem.write8(0x3000, 0x01);
+    EXPECT_EQ(mem.read16(0x4000), 0x134);
+    EXPECT_EQ(cartridge->rom_bank(), 0x134);
+}
+
+TEST(CartridgeTest, BanksPastTheEndWrapAround) {
+    Memory mem;
+    auto cartridge = Cartridge::insert(mem, make_rom(0x19, 4));
+    ASSERT_TRUE(cartridge);
+
+    mem.write8(0x2000, 0x06);
+    EXPECT_EQ(mem.read8(0x4000), 2);
+}
+
+TEST(CartridgeTest, RemovingTheCartridgeRestoresRam) {
+    Memory mem;
+    {
+        auto cartridge = Cartridge::insert(mem, make_rom(0x00, 2));
+        ASSERT_TRUE(cartridge);
+        mem.write8(0x4001, 0x55);
+        EXPECT_EQ(mem.read8(0x4001), 0x00);
+    }
+    mem.write8(0x4001, 0x55);
+    EXPECT_EQ(mem.read8(0x4001), 0x55);
+    EXPECT_EQ(mem.switchable_rom_bank(), 1);
+}
+
+TEST(RomImageTest, FilesAreMappedReadOnly) {
+    const auto path = testing::TempDir() + "rom_image_test.gb";
+    auto* file = fopen(path.c_str(), "wb");
+    ASSERT_TRUE(file);
+    const uint8_t bytes[] = { 0x31, 0xFE, 0xFF };
+    fwrite(bytes, 1, sizeof(bytes), file);
+    fclose(file);
+
+    const auto image = RomImage::map_file(path);
+    remove(path.c_str());
+    ASSERT_TRUE(image);
+    ASSERT_EQ(image->size(), sizeof(bytes));
+    EXPECT_EQ(image->data()[1], 0xFE);
+
+    EXPECT_FALSE(RomImage::map_file(path));
+}
@@ -0,0 +1,888 @@
+#include "gtest/gtest.h"
+
+#include "CPU.h"
+#include "RegisterFile.h"
+#include "cartridge/Cartridge.h"
+#include "cartridge/RomImage.h"
+#include "instruction/IdleLoopDetector.h"
+#include "instruction/OpcodeTable.h"
+#include "instruction/ThreadedInterpreter.h"
+#include "io/Timer.h"
+#include "jit/Jit.h"
+#include "memory/Memory.h"
+
+#include <initializer_list>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+using namespace GameBoy;
+using namespace std;
+
+class CPUTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        mem = make_unique<Memory>();
+        cpu = make_unique<CPU>(*mem);
+        regs().pc = PROGRAM_START;
+        regs().sp = 0xDFFE;
+    }
+
+    auto regs() -> RegisterFile& { return cpu->registers(); }
+
+    // Writes the given bytes at PC
+    auto load(initializer_list<uint8_t> program) -> void
+    {
+        auto address = regs().pc;
+        for (auto byte : program)
+            mem->write8(address++, byte);
+    }
+
+    auto run(int numInstructions) -> int
+    {
+        auto cycles = 0;
+        for (auto i = 0; i < numInstructions; ++i)
+            cycles += cpu->step();
+        return cycles;
+    }
+
+    static constexpr uint16_t PROGRAM_START = 0xC000;
+
+    unique_ptr<Memory> mem;
+    unique_ptr<CPU> cpu;
+};
+
+TEST_F(CPUTest, LoadImmediateAndRegister) {
+    load({
+        0x06, 0x42, // LD B,$42
+        0x48, // LD C,B
+        0x21, 0x00, 0xD0, // LD HL,$D000
+        0x71, // LD (HL),C
+    });
+
+    EXPECT_EQ(run(4), 8 + 4 + 12 + 8);
+    EXPECT_EQ(regs().bc, 0x4242);
+    EXPECT_EQ(regs().hl, 0xD000);
+    EXPECT_EQ(mem->read8(0xD000), 0x42);
+    EXPECT_EQ(regs().pc, PROGRAM_START + 7);
+}
+
+TEST_F(CPUTest, LoadIndirectWithIncrementAndDecrement) {
+    regs().hl = 0xD000;
+    regs().a = 0x99;
+    load({
+        0x22, // LD (HL+),A
+        0x32, // LD (HL-),A
+        0x3A, // LD A,(HL-)
+    });
+    mem->write8(0xD000, 0x11);
+
+    run(2);
+    EXPECT_EQ(mem->read8(0xD000), 0x99);
+    EXPECT_EQ(mem->read8(0xD001), 0x99);
+    EXPECT_EQ(regs().hl, 0xD000);
+
+    run(1);
+    EXPECT_EQ(regs().a, 0x99);
+    EXPECT_EQ(regs().hl, 0xCFFF);
+}
+
+TEST_F(CPUTest, PushPopRoundTrip) {
+    regs().bc = 0x1234;
+    regs().af = 0xABFF;
+    load({
+        0xC5, // PUSH BC
+        0xF5, // PUSH AF
+        0xD1, // POP DE
+        0xF1, // POP AF
+    });
+    mem->write16(0xDFFA, 0);
+
+    run(2);
+    EXPECT_EQ(regs().sp, 0xDFFA);
+    EXPECT_EQ(mem->read16(0xDFFC), 0x1234);
+
+    run(1);
+    EXPECT_EQ(regs().de, 0xABFF);
+
+    run(1);
+    // The low nibble of F always reads back as zero
+    EXPECT_EQ(regs().af, 0x12 << 8 | 0x30);
+    EXPECT_EQ(regs().sp, 0xDFFE);
+}
+
+TEST_F(CPUTest, AddSetsFlags) {
+    regs().a = 0x3A;
+    regs().b = 0xC6;
+    load({
+        0x80, // ADD A,B
+        0xC6, 0x0F, // ADD A,$0F
+    });
+
+    run(1);
+    EXPECT_EQ(regs().a, 0x00);
+    EXPECT_EQ(regs().f, Flags::ZERO | Flags::HALF_CARRY | Flags::CARRY);
+
+    run(1);
+    EXPECT_EQ(regs().a, 0x0F);
+    EXPECT_EQ(regs().f, 0);
+}
+
+TEST_F(CPUTest, SubtractAndCompareSetFlags) {
+    regs().a = 0x3E;
+    regs().e = 0x3E;
+    load({
+        0xBB, // CP E
+        0xD6, 0x40, // SUB $40
+    });
+
+    run(1);
+    EXPECT_EQ(regs().a, 0x3E);
+    EXPECT_EQ(regs().f, Flags::ZERO | Flags::SUBTRACT);
+
+    run(1);
+    EXPECT_EQ(regs().a, 0xFE);
+    EXPECT_EQ(regs().f, Flags::SUBTRACT | Flags::CARRY);
+}
+
+TEST_F(CPUTest, IncDecPreserveCarry) {
+    regs().f = Flags::CARRY;
+    regs().l = 0x0F;
+    regs().d = 0x01;
+    load({
+        0x2C, // INC L
+        0x15, // DEC D
+    });
+
+    run(1);
+    EXPECT_EQ(regs().l, 0x10);
+    EXPECT_EQ(regs().f, Flags::HALF_CARRY | Flags::CARRY);
+
+    run(1);
+    EXPECT_EQ(regs().d, 0x00);
+    EXPECT_EQ(regs().f, Flags::ZERO | Flags::SUBTRACT | Flags::CARRY);
+}
+
+TEST_F(CPUTest, DeferredFlagsMatchTheirDefinitions) {
+    const auto expected_flags = [](uint8_t operation, uint8_t a, uint8_t b, bool carryIn) -> uint8_t {
+        const int c = (operation == 1 || operation == 3) && carryIn;
+        int result;
+        bool halfCarry, carry;
+        switch (operation) {
+        case 0: // ADD
+        case 1: // ADC
+            result = a + b + c;
+            halfCarry = (a & 0x0F) + (b & 0x0F) + c > 0x0F;
+            carry = result > 0xFF;
+            break;
+        case 4: // AND
+            result = a & b;
+            halfCarry = true;
+            carry = false;
+            break;
+        case 5: // XOR
+        case 6: // OR
+            result = operation == 5 ? a ^ b : a | b;
+            halfCarry = carry = false;
+            break;
+        default: // SUB, SBC, CP
+            result = a - b - c;
+            halfCarry = (a & 0x0F) - (b & 0x0F) - c < 0;
+            carry = result < 0;
+            break;
+        }
+        const bool subtract = operation == 2 || operation == 3 || operation == 7;
+        return (uint8_t(result) == 0 ? Flags::ZERO : 0) | (subtract ? Flags::SUBTRACT : 0)
+            | (halfCarry ? Flags::HALF_CARRY : 0) | (carry ? Flags::CARRY : 0);
+    };
+
+    for (uint8_t operation = 0; operation < 8; ++operation) {
+        for (auto a = 0; a < 0x100; a += 3) {
+            for (auto b = 0; b < 0x100; ++b) {
+                const bool carryIn = (a ^ b) & 1;
+                regs().pc = PROGRAM_START;
+                regs().a = a;
+                regs().f = carryIn ? Flags::CARRY : 0;
+                load({ uint8_t(0xC6 | operation << 3), uint8_t(b) }); // ALU A,n
+                run(1);
+                ASSERT_EQ(regs().f, expected_flags(operation, a, b, carryIn))
+                    << "operation " << int(operation) << " a=" << a << " b=" << b;
+            }
+        }
+    }
+}
+
+TEST_F(CPUTest, DeferredFlagsAreVisibleToLaterInstructions) {
+    load({
+        0x3E, 0x0F, // LD A,$0F
+        0xC6, 0xF1, // ADD A,$F1 ; Z, H and C
+        0x3C, // INC A ; H and C kept from the ADD
+        0xF5, // PUSH AF
+        0xC1, // POP BC
+        0xCE, 0x00, // ADC A,0 ; carry in from the ADD
+        0x76, // HALT
+    });
+
+    cpu->run_for(1000);
+    EXPECT_EQ(cpu->state(), CPU::State::Halted);
+    EXPECT_EQ(regs().b, 0x01);
+    EXPECT_EQ(regs().c, Flags::CARRY);
+    EXPECT_EQ(regs().a, 0x02);
+    EXPECT_EQ(regs().f, 0);
+}
+
+TEST_F(CPUTest, DecimalAdjustAfterAdd) {
+    regs().a = 0x45;
+    regs().b = 0x38;
+    load({
+        0x80, // ADD A,B
+        0x27, // DAA
+    });
+
+    run(2);
+    EXPECT_EQ(regs().a, 0x83);
+    EXPECT_FALSE(regs().f & Flags::CARRY);
+}
+
+TEST_F(CPUTest, ConditionalRelativeJumpLoops) {
+    load({
+        0x06, 0x03, // LD B,3
+        0x05, // loop: DEC B
+        0x20, 0xFD, // JR NZ,loop
+        0x00, // NOP
+    });
+
+    auto cycles = run(1 + 3 * 2);
+    EXPECT_EQ(regs().b, 0);
+    EXPECT_EQ(regs().pc, PROGRAM_START + 5);
+    // the last JR NZ falls through and takes fewer cycles
+    EXPECT_EQ(cycles, 8 + 3 * 4 + 2 * 12 + 8);
+}
+
+TEST_F(CPUTest, CallAndReturn) {
+    load({
+        0xCD, 0x00, 0xC1, // CALL $C100
+        0x00, // NOP
+    });
+    mem->write8(0xC100, 0xC9); // RET
+
+    EXPECT_EQ(run(1), 24);
+    EXPECT_EQ(regs().pc, 0xC100);
+    EXPECT_EQ(mem->read16(regs().sp), PROGRAM_START + 3);
+
+    EXPECT_EQ(run(1), 16);
+    EXPECT_EQ(regs().pc, PROGRAM_START + 3);
+    EXPECT_EQ(regs().sp, 0xDFFE);
+}
+
+TEST_F(CPUTest, PrefixedInstructions) {
+    regs().hl = 0xD000;
+    mem->write8(0xD000, 0x01);
+    load({
+        0xCB, 0x7C, // BIT 7,H
+        0xCB, 0x06, // RLC (HL)
+        0xCB, 0xFE, // SET 7,(HL)
+        0xCB, 0x37, // SWAP A
+    });
+    regs().a = 0x12;
+
+    EXPECT_EQ(run(1), 8);
+    EXPECT_EQ(regs().f, Flags::HALF_CARRY);
+
+    EXPECT_EQ(run(1), 16);
+    EXPECT_EQ(mem->read8(0xD000), 0x02);
+
+    run(2);
+    EXPECT_EQ(mem->read8(0xD000), 0x82);
+    EXPECT_EQ(regs().a, 0x21);
+    EXPECT_EQ(regs().pc, PROGRAM_START + 8);
+}
+
+TEST_F(CPUTest, HaltAndIllegalOpcodesStopExecution) {
+    load({ 0x76, 0x00 }); // HALT
+    run(1);
+    EXPECT_EQ(cpu->state(), CPU::State::Halted);
+    run(1);
+    EXPECT_EQ(regs().pc, PROGRAM_START + 1);
+
+    cpu->set_state(CPU::State::Running);
+    regs().pc = PROGRAM_START;
+    load({ 0xD3 });
+    run(1);
+    EXPECT_EQ(cpu->state(), CPU::State::Locked);
+}
+
+TEST(OpcodeTableTest, EveryOpcodeHasAHandler) {
+    for (auto opcode = 0; opcode < 0x100; ++opcode) {
+        EXPECT_NE(OpcodeTable::lookup(opcode).handler, nullptr);
+        EXPECT_NE(OpcodeTable::lookup_prefixed(opcode).handler, nullptr);
+    }
+}
+
+TEST(OpcodeTableTest, RegisterGroupsGetAHandlerPerOpcode) {
+    // LD r,r' and ALU A,r, less HALT in the middle of the loads
+    set<OpcodeHandler> handlers;
+    for (auto opcode = 0x40; opcode < 0xC0; ++opcode)
+        handlers.insert(OpcodeTable::lookup(opcode).handler);
+    handlers.erase(OpcodeTable::lookup(0x76).handler);
+    EXPECT_EQ(handlers.size(), 127);
+}
+
+TEST_F(CPUTest, EveryRegisterToRegisterLoad) {
+    uint8_t* const fields[8] = { &regs().b, &regs().c, &regs().d, &regs().e, &regs().h, &regs().l, nullptr, &regs().a };
+    for (uint8_t dst = 0; dst < 8; ++dst) {
+        for (uint8_t src = 0; src < 8; ++src) {
+            if (!fields[dst] || !fields[src])
+                continue;
+            for (uint8_t i = 0; i < 8; ++i) {
+                if (fields[i])
+                    *fields[i] = 0x10 + i;
+            }
+            regs().pc = PROGRAM_START;
+            load({ uint8_t(0x40 | dst << 3 | src) });
+
+            EXPECT_EQ(run(1), 4);
+            EXPECT_EQ(*fields[dst], 0x10 + src) << "LD " << int(dst) << "," << int(src);
+        }
+    }
+}
+
+TEST_F(CPUTest, EveryBitOperation) {
+    regs().hl = 0xD000;
+    uint8_t* const fields[8] = { &regs().b, &regs().c, &regs().d, &regs().e, &regs().h, &regs().l, nullptr, &regs().a };
+    for (uint8_t r = 0; r < 8; ++r) {
+        for (uint8_t bit = 0; bit < 8; ++bit) {
+            if (r == 4 || r == 5)
+                continue; // would move HL
+            const auto value = [&] { return fields[r] ? *fields[r] : mem->read8(regs().hl); };
+            regs().pc = PROGRAM_START;
+            load({
+                0xCB, uint8_t(0xC0 | bit << 3 | r), // SET bit,r
+                0xCB, uint8_t(0x40 | bit << 3 | r), // BIT bit,r
+                0xCB, uint8_t(0x80 | bit << 3 | r), // RES bit,r
+                0xCB, uint8_t(0x40 | bit << 3 | r), // BIT bit,r
+            });
+
+            run(2);
+            EXPECT_EQ(value() & (1 << bit), 1 << bit);
+            EXPECT_FALSE(regs().f & Flags::ZERO);
+            run(2);
+            EXPECT_EQ(value() & (1 << bit), 0);
+            EXPECT_TRUE(regs().f & Flags::ZERO);
+        }
+    }
+}
+
+TEST_F(CPUTest, RunBlockStopsAtControlFlow) {
+    load({
+        0x06, 0x03, // LD B,3
+        0x05, // loop: DEC B
+        0x20, 0xFD, // JR NZ,loop
+        0x00, // NOP
+    });
+
+    EXPECT_EQ(cpu->run_block(), 8 + 4 + 12);
+    EXPECT_EQ(regs().pc, PROGRAM_START + 2);
+
+    cpu->run_block();
+    EXPECT_EQ(cpu->run_block(), 4 + 8);
+    EXPECT_EQ(regs().b, 0);
+    EXPECT_EQ(regs().pc, PROGRAM_START + 5);
+
+    const auto& stats = cpu->block_cache().stats();
+    EXPECT_EQ(stats.misses, 2);
+    EXPECT_EQ(stats.hits, 1);
+}
+
+TEST_F(CPUTest, WritesInvalidateCachedBlocks) {
+    load({
+        0x3E, 0x01, // LD A,1
+        0xC3, 0x00, 0xC0, // JP $C000
+    });
+
+    cpu->run_block();
+    EXPECT_EQ(regs().a, 1);
+
+    // Patch the immediate operand; the block has to be decoded again
+    mem->write8(PROGRAM_START + 1, 0x02);
+    cpu->run_block();
+    EXPECT_EQ(regs().a, 2);
+
+    const auto& stats = cpu->block_cache().stats();
+    EXPECT_EQ(stats.invalidations, 1);
+    EXPECT_EQ(stats.misses, 2);
+}
+
+TEST_F(CPUTest, SelfModifyingBlockStopsEarly) {
+    regs().hl = PROGRAM_START + 4;
+    load({
+        0x36, 0x3C, // LD (HL),$3C ; overwrite the NOP below with INC A
+        0x00, // NOP
+        0x00, // NOP
+        0x00, // NOP <- patched
+        0x76, // HALT
+    });
+    regs().a = 0;
+
+    cpu->run_block();
+    EXPECT_EQ(regs().pc, PROGRAM_START + 2);
+
+    cpu->run_block();
+    EXPECT_EQ(regs().a, 1);
+    EXPECT_EQ(cpu->state(), CPU::State::Halted);
+}
+
+// Runs whole programs under every execution mode; each must end in the same state
+class ExecutionModeTest : public ::testing::TestWithParam<ExecutionMode> {
+protected:
+    void SetUp() override
+    {
+        mem = make_unique<Memory>();
+        cpu = make_unique<CPU>(*mem);
+        cpu->set_execution_mode(GetParam());
+        regs().pc = PROGRAM_START;
+        regs().sp = 0xDFFE;
+    }
+
+    auto regs() -> RegisterFile& { return cpu->registers(); }
+
+    auto load(uint16_t address, initializer_list<uint8_t> program) -> void
+    {
+        for (auto byte : program)
+            mem->write8(address++, byte);
+    }
+
+    auto run_until_halt() -> void
+    {
+        for (auto i = 0; i < 10000 && cpu->state() == CPU::State::Running; ++i)
+            cpu->run_for(1000);
+        ASSERT_EQ(cpu->state(), CPU::State::Halted);
+    }
+
+    static constexpr uint16_t PROGRAM_START = 0xC000;
+
+    unique_ptr<Memory> mem;
+    unique_ptr<CPU> cpu;
+};
+
+TEST_P(ExecutionModeTest, NestedLoops) {
+    load(PROGRAM_START, {
+        0xAF, // XOR A
+        0x16, 0x10, // LD D,$10
+        0x1E, 0x20, // outer: LD E,$20
+        0x3C, // inner: INC A
+        0x1D, // DEC E
+        0x20, 0xFC, // JR NZ,inner
+        0x15, // DEC D
+        0x20, 0xF7, // JR NZ,outer
+        0x47, // LD B,A
+        0x76, // HALT
+    });
+
+    run_until_halt();
+    EXPECT_EQ(regs().a, uint8_t(0x10 * 0x20));
+    EXPECT_EQ(regs().b, regs().a);
+    EXPECT_EQ(regs().de, 0x0000);
+}
+
+TEST_P(ExecutionModeTest, CallsAndMemoryWrites) {
+    load(PROGRAM_START, {
+        0x21, 0x00, 0xD0, // LD HL,$D000
+        0x06, 0x40, // LD B,$40
+        0xCD, 0x00, 0xC1, // loop: CALL fill
+        0x05, // DEC B
+        0xC2, 0x05, 0xC0, // JP NZ,loop
+        0x76, // HALT
+    });
+    load(0xC100, {
+        0x78, // fill: LD A,B
+        0x22, // LD (HL+),A
+        0xCB, 0x37, // SWAP A
+        0x22, // LD (HL+),A
+        0xC9, // RET
+    });
+
+    run_until_halt();
+    EXPECT_EQ(regs().hl, 0xD080);
+    EXPECT_EQ(mem->read8(0xD000), 0x40);
+    EXPECT_EQ(mem->read8(0xD001), 0x04);
+    EXPECT_EQ(mem->read8(0xD07E), 0x01);
+    EXPECT_EQ(mem->read8(0xD07F), 0x10);
+    EXPECT_EQ(regs().sp, 0xDFFE);
+}
+
+TEST_P(ExecutionModeTest, SelfModifyingLoop) {
+    // Each pass bumps the immediate of the LD A,n that starts the loop
+    load(PROGRAM_START, {
+        0x0E, 0x20, // LD C,$20
+        0x21, 0x06, 0xC0, // LD HL,patch+1
+        0x3E, 0x00, // patch: LD A,$00
+        0x34, // INC (HL)
+        0x0D, // DEC C
+        0x20, 0xFA, // JR NZ,patch
+        0x76, // HALT
+    });
+
+    run_until_halt();
+    EXPECT_EQ(regs().a, 0x1F);
+    EXPECT_EQ(mem->read8(0xC006), 0x20);
+}
+
+TEST_P(ExecutionModeTest, MatchesStepByStepExecution) {
+    // A mix of ALU, rotate, stack and prefixed instructions run many times over
+    const initializer_list<uint8_t> program = {
+        0x31, 0xFE, 0xDF, // LD SP,$DFFE
+        0x01, 0x34, 0x12, // LD BC,$1234
+        0x11, 0x99, 0x00, // LD DE,$0099
+        0x26, 0x00, // LD H,0
+        0x2E, 0xC8, // loop: LD L,$C8
+        0x78, // LD A,B
+        0x89, // ADC A,C
+        0x27, // DAA
+        0x47, // LD B,A
+        0x17, // RLA
+        0x4F, // LD C,A
+        0xCB, 0x19, // RR C
+        0xA8, // XOR B
+        0xC5, // PUSH BC
+        0xE1, // POP HL
+        0x19, // ADD HL,DE
+        0xCB, 0x44, // BIT 0,H
+        0x9A, // SBC A,D
+        0xE6, 0x7F, // AND $7F
+        0x1D, // DEC E
+        0xC2, 0x0D, 0xC0, // JP NZ,loop
+        0x76, // HALT
+    };
+    load(PROGRAM_START, program);
+    run_until_halt();
+
+    Memory referenceMemory;
+    CPU reference(referenceMemory);
+    auto address = PROGRAM_START;
+    for (auto byte : program)
+        referenceMemory.write8(address++, byte);
+    referenceMemory.registers().pc = PROGRAM_START;
+    while (reference.state() == CPU::State::Running)
+        reference.step();
+
+    EXPECT_EQ(regs().af, referenceMemory.registers().af);
+    EXPECT_EQ(regs().bc, referenceMemory.registers().bc);
+    EXPECT_EQ(regs().de, referenceMemory.registers().de);
+    EXPECT_EQ(regs().hl, referenceMemory.registers().hl);
+    EXPECT_EQ(regs().sp, referenceMemory.registers().sp);
+    EXPECT_EQ(regs().pc, referenceMemory.registers().pc);
+}
+
+// Waits for TIMA to reach $10, then reads DIV and halts
+TEST_P(ExecutionModeTest, SkippingIdleLoopsKeepsTime) {
+    const auto run_program = [&](bool skipIdleLoops) {
+        auto memory = make_unique<Memory>();
+        CPU cpu(*memory);
+        Timer timer(cpu);
+        cpu.set_execution_mode(GetParam());
+        cpu.set_idle_loop_skipping(skipIdleLoops);
+        const initializer_list<uint8_t> program = {
+            0x3E, 0x07, // LD A,$07
+            0xE0, 0x07, // LDH (TAC),A
+            0xF0, 0x05, // loop: LDH A,(TIMA)
+            0xFE, 0x10, // CP $10
+            0x38, 0xFA, // JR C,loop
+            0xF0, 0x04, // LDH A,(DIV)
+            0x76, // HALT
+        };
+        auto address = PROGRAM_START;
+        for (auto byte : program)
+            memory->write8(address++, byte);
+        memory->registers().pc = PROGRAM_START;
+
+        cpu.run_for(10000);
+        EXPECT_EQ(cpu.state(), CPU::State::Halted);
+        return make_pair(memory->registers().a, cpu.stats());
+    };
+
+    const auto [referenceDiv, reference] = run_program(false);
+    const auto [div, stats] = run_program(true);
+    EXPECT_EQ(reference.idleLoopCyclesSkipped, 0);
+    EXPECT_GT(stats.idleLoopCyclesSkipped, 0);
+    EXPECT_EQ(div, referenceDiv);
+    // The loop was left on the same cycle
+    EXPECT_EQ(stats.haltCyclesSkipped, reference.haltCyclesSkipped);
+}
+
+TEST_P(ExecutionModeTest, SkipsPollingUntilTheEvent) {
+    load(PROGRAM_START, {
+        0xF0, 0x0F, // loop: LDH A,(IF)
+        0xE6, 0x08, // AND $08
+        0x28, 0xFA, // JR Z,loop
+        0x76, // HALT
+    });
+    mem->write8(0xFF0F, 0x00);
+    auto& scheduler = cpu->scheduler();
+    scheduler.set_handler(Event::Serial, [&] { cpu->interrupts().request(Interrupt::Serial); });
+    scheduler.schedule(Event::Serial, 50'000);
+    cpu->set_idle_loop_skipping(true);
+
+    cpu->run_for(49'000);
+    EXPECT_EQ(regs().a, 0);
+    EXPECT_GT(cpu->stats().idleLoopCyclesSkipped, 40'000);
+
+    cpu->run_for(2'000);
+    EXPECT_EQ(regs().a, 0x08);
+    EXPECT_EQ(regs().pc, PROGRAM_START + 7);
+}
+
+TEST_P(ExecutionModeTest, BatchedRunsStopForTheirReason) {
+    load(PROGRAM_START, {
+        0x3C, // loop: INC A
+        0x3C, // INC A
+        0x3C, // INC A
+        0x18, 0xFB, // JR loop
+    });
+    regs().a = 0;
+
+    auto result = cpu->run_until_pc(PROGRAM_START + 2);
+    EXPECT_EQ(result.reason, CPU::StopReason::ReachedPc);
+    EXPECT_EQ(result.cycles, 8u);
+    EXPECT_EQ(regs().a, 2);
+    // Already there
+    EXPECT_EQ(cpu->run_until_pc(PROGRAM_START + 2).cycles, 0u);
+
+    // Halfway through an instruction is never reached
+    result = cpu->run_until_pc(PROGRAM_START + 4, 1000);
+    EXPECT_EQ(result.reason, CPU::StopReason::CyclesElapsed);
+    EXPECT_GE(result.cycles, 1000u);
+
+    result = cpu->run_cycles(10'000);
+    EXPECT_EQ(result.reason, CPU::StopReason::CyclesElapsed);
+    EXPECT_GE(result.cycles, 10'000u);
+    EXPECT_LT(result.cycles, 10'012u);
+
+    auto& scheduler = cpu->scheduler();
+    const auto start = scheduler.now();
+    scheduler.schedule_in(Event::Timer, 1'000);
+    scheduler.schedule_in(Event::Serial, 5'000);
+    result = cpu->run_until_event(event_bit(Event::Serial));
+    EXPECT_EQ(result.reason, CPU::StopReason::Event);
+    // Within a pass of the loop, however far the engine overran the deadline
+    EXPECT_GE(scheduler.now(), start + 5'000);
+    EXPECT_LT(scheduler.now(), start + 5'024);
+
+    // The PPU would request VBlank at the end of each frame's visible lines
+    scheduler.set_handler(Event::Ppu, [&] { cpu->interrupts().request(Interrupt::VBlank); });
+    scheduler.schedule_in(Event::Ppu, 30'000);
+    result = cpu->run_frame();
+    EXPECT_EQ(result.reason, CPU::StopReason::FrameEnded);
+    EXPECT_GE(result.cycles, 30'000u);
+    EXPECT_LT(result.cycles, 30'024u);
+    // Without one, a frame's worth of cycles
+    result = cpu->run_frame();
+    EXPECT_EQ(result.reason, CPU::StopReason::CyclesElapsed);
+    EXPECT_GE(result.cycles, CPU::CYCLES_PER_FRAME);
+
+    load(regs().pc, { 0xD3 }); // Illegal
+    result = cpu->run_cycles(1'000);
+    EXPECT_EQ(result.reason, CPU::StopReason::Locked);
+    EXPECT_EQ(cpu->state(), CPU::State::Locked);
+}
+
+TEST(IdleLoopDetectorTest, FindsPollingLoops) {
+    Memory mem;
+    const initializer_list<uint8_t> program = {
+        0xF0, 0x44, // loop: LDH A,(LY)
+        0xFE, 0x90, // CP $90
+        0x20, 0xFA, // JR NZ,loop
+        0xCB, 0x46, // wait: BIT 0,(HL)
+        0xCA, 0x06, 0xC0, // JP Z,wait
+        0xF0, 0x80, // spin: LDH A,($80)
+        0x3C, // INC A
+        0x18, 0xFB, // JR spin
+    };
+    auto address = 0xC000;
+    for (auto byte : program)
+        mem.write8(address++, byte);
+    mem.registers().hl = 0xFF41;
+
+    const auto loop = IdleLoopDetector::find(mem, 0xC000);
+    ASSERT_TRUE(loop);
+    EXPECT_EQ(loop->instructions, 3);
+    ASSERT_EQ(loop->numReads, 1);
+    EXPECT_EQ(loop->reads[0], 0xFF44);
+    // From partway round too
+    EXPECT_TRUE(IdleLoopDetector::find(mem, 0xC004));
+
+    const auto bitLoop = IdleLoopDetector::find(mem, 0xC006);
+    ASSERT_TRUE(bitLoop);
+    EXPECT_EQ(bitLoop->reads[0], 0xFF41);
+
+    EXPECT_FALSE(IdleLoopDetector::find(mem, 0xC00B));
+}
+
+TEST_P(ExecutionModeTest, CodeInCartridgeRamFollowsItsBank) {
+    // MBC5 with four 8 KiB RAM banks
+    vector<uint8_t> rom(0x8000);
+    rom[0x147] = 0x1B;
+    rom[0x149] = 0x03;
+    Memory mem;
+    auto cartridge = Cartridge::insert(mem, RomImage::from_bytes(move(rom)));
+    ASSERT_TRUE(cartridge);
+    CPU cpu(mem);
+    cpu.set_execution_mode(GetParam());
+
+    const auto load = [&](uint16_t address, initializer_list<uint8_t> code) {
+        for (auto byte : code)
+            mem.write8(address++, byte);
+    };
+    mem.write8(0x0000, 0x0A); // Enable RAM
+    mem.write8(0x4000, 0x01);
+    load(0xA000, { 0x0C, 0xC9 }); // INC C; RET
+    mem.write8(0x4000, 0x00);
+    load(0xA000, { 0x04, 0xC9 }); // INC B; RET
+    load(0xC000, {
+        0xCD, 0x00, 0xA0, // loop: CALL $A000
+        0x18, 0xFB, // JR loop
+    });
+    auto& regs = mem.registers();
+    regs.pc = 0xC000;
+    regs.sp = 0xDFFE;
+    cpu.run_cycles(10'000);
+    ASSERT_GT(regs.b, 0);
+    ASSERT_EQ(regs.c, 0);
+
+    mem.write8(0x4000, 0x01);
+    regs.b = 0;
+    cpu.run_cycles(10'000);
+    EXPECT_EQ(regs.b, 0);
+    EXPECT_GT(regs.c, 0);
+
+    // And back again
+    mem.write8(0x4000, 0x00);
+    regs.b = 0;
+    regs.c = 0;
+    cpu.run_cycles(10'000);
+    EXPECT_GT(regs.b, 0);
+    EXPECT_EQ(regs.c, 0);
+}
+
+TEST(JitTest, CompilesHotBlocks) {
+    Memory mem;
+    CPU cpu(mem);
+    cpu.set_execution_mode(ExecutionMode::Jit);
+    if (!cpu.jit())
+        GTEST_SKIP() << "no JIT on this host";
+
+    const initializer_list<uint8_t> program = {
+        0x06, 0x00, // LD B,0
+        0x05, // loop: DEC B
+        0x20, 0xFD, // JR NZ,loop
+        0x76, // HALT
+    };
+    auto address = 0xC000;
+    for (auto byte : program)
+        mem.write8(address++, byte);
+    mem.registers().pc = 0xC000;
+
+    cpu.run_for(8 + 256 * 16);
+    EXPECT_EQ(cpu.state(), CPU::State::Halted);
+    EXPECT_GE(cpu.jit()->stats().compiledBlocks, 1);
+}
+
+TEST(JitTest, CallsIntoTheFixedBankFollowItsSwitches) {
+    // MBC1 with 64 banks, where the advanced mode maps bank 20 at 0000-3FFF
+    vector<uint8_t> rom(0x40 * 0x4000);
+    rom[0x147] = 0x01;
+    rom[0x0100] = 0x04; // INC B
+    rom[0x0101] = 0xC9; // RET
+    rom[0x20 * 0x4000 + 0x0100] = 0x0C; // INC C
+    rom[0x20 * 0x4000 + 0x0101] = 0xC9; // RET
+    Memory mem;
+    auto cartridge = Cartridge::insert(mem, RomImage::from_bytes(move(rom)));
+    ASSERT_TRUE(cartridge);
+    CPU cpu(mem);
+    cpu.set_execution_mode(ExecutionMode::Jit);
+    if (!cpu.jit())
+        GTEST_SKIP() << "no JIT on this host";
+
+    const initializer_list<uint8_t> program = {
+        0xCD, 0x00, 0x01, // loop: CALL $0100
+        0x18, 0xFB, // JR loop
+    };
+    auto address = 0xC000;
+    for (auto byte : program)
+        mem.write8(address++, byte);
+    auto& regs = mem.registers();
+    regs.pc = 0xC000;
+    regs.sp = 0xDFFE;
+    cpu.run_cycles(10'000);
+    ASSERT_GT(regs.b, 0);
+    ASSERT_GE(cpu.jit()->stats().compiledBlocks, 2);
+
+    mem.write8(0x4000, 0x01);
+    mem.write8(0x6000, 0x01);
+    regs.b = 0;
+    regs.c = 0;
+    cpu.run_cycles(10'000);
+    EXPECT_EQ(regs.b, 0);
+    EXPECT_GT(regs.c, 0);
+}
+
+TEST(ThreadedInterpreterTest, BothDispatchesMatchStepByStepExecution) {
+    const initializer_list<uint8_t> program = {
+        0x01, 0x00, 0x08, // LD BC,$0800
+        0x21, 0x00, 0xD0, // LD HL,$D000
+        0x78, // loop: LD A,B
+        0xA9, // XOR C
+        0xCB, 0x07, // RLC A
+        0x22, // LD (HL+),A
+        0x0C, // INC C
+        0x20, 0xF8, // JR NZ,loop
+        0x05, // DEC B
+        0x20, 0xF5, // JR NZ,loop
+        0x76, // HALT
+    };
+    const auto run_program = [&](auto run) {
+        auto mem = make_unique<Memory>();
+        CPU cpu(*mem);
+        auto address = 0xC000;
+        for (auto byte : program)
+            mem->write8(address++, byte);
+        mem->registers().pc = 0xC000;
+        uint64_t cycles = 0;
+        while (cpu.state() == CPU::State::Running)
+            cycles += run(cpu);
+        return make_pair(move(mem), cycles);
+    };
+
+    const auto reference = run_program([](CPU& cpu) { return cpu.step(); });
+    const auto threaded = run_program([](CPU& cpu) { return ThreadedInterpreter::run(cpu, 1000); });
+    const auto portable = run_program([](CPU& cpu) { return ThreadedInterpreter::run_portable(cpu, 1000); });
+
+    for (const auto* result : { &threaded, &portable }) {
+        EXPECT_EQ(result->second, reference.second);
+        EXPECT_EQ(result->first->registers().af, reference.first->registers().af);
+        EXPECT_EQ(result->first->registers().bc, reference.first->registers().bc);
+        EXPECT_EQ(result->first->registers().hl, reference.first->registers().hl);
+        EXPECT_EQ(result->first->registers().pc, reference.first->registers().pc);
+        for (uint16_t address = 0xD000; address < 0xD100; ++address)
+            ASSERT_EQ(result->first->read8(address), reference.first->read8(address));
+    }
+}
+
+TEST(ThreadedInterpreterTest, StopsOnceTheBudgetIsSpent) {
+    Memory mem;
+    CPU cpu(mem);
+    mem.registers().pc = 0xC000; // Zeroed memory runs as a sled of NOPs
+
+    EXPECT_EQ(ThreadedInterpreter::run(cpu, 0), 4);
+    EXPECT_EQ(ThreadedInterpreter::run(cpu, 10), 12);
+    EXPECT_EQ(ThreadedInterpreter::run_portable(cpu, 10), 12);
+    EXPECT_EQ(mem.registers().pc, 0xC007);
+}
+
+INSTANTIATE_TEST_SUITE_P(AllModes, ExecutionModeTest,
+    ::testing::Values(ExecutionMode::Interpreter, ExecutionMode::Jit),
+    [](const ::testing::TestParamInfo<ExecutionMode>& info) {
+        return info.param == ExecutionMode::Jit ? "Jit" : "Interpreter";
+    });
@@ -0,0 +1,165 @@
+#include "gtest/gtest.h"
+
+#include "frontend/RateControl.h"
+#include "frontend/SampleRing.h"
+#include "frontend/TripleBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+using namespace GameBoy;
+using namespace std;
+
+TEST(SampleRingTest, WrapsAroundInPlace) {
+    SampleRing ring(10);
+    ASSERT_EQ(ring.capacity(), 16);
+
+    vector<int16_t> samples(2 * 16);
+    for (size_t i = 0; i < samples.size(); ++i)
+        samples[i] = int16_t(i);
+    EXPECT_EQ(ring.write(samples.data(), 12), 12);
+    vector<int16_t> out(2 * 16);
+    EXPECT_EQ(ring.read(out.data(), 8), 8);
+    EXPECT_EQ(out[15], 15);
+
+    // Only four frames to the end, though there is room for twelve
+    auto region = ring.write_region();
+    EXPECT_EQ(region.frames, 4);
+    EXPECT_EQ(ring.write(samples.data(), 16), 12);
+    EXPECT_EQ(ring.queued_frames(), 16);
+    EXPECT_EQ(ring.write_region().frames, 0);
+
+    region = ring.read_region();
+    EXPECT_EQ(region.frames, 8);
+    EXPECT_EQ(region.samples[0], 16);
+    ring.commit_read(8);
+    // The second write's frames 4-11, from the start of the ring
+    EXPECT_EQ(ring.read(out.data(), 16), 8);
+    EXPECT_EQ(out[0], 8);
+    EXPECT_EQ(out[15], 23);
+    EXPECT_EQ(ring.queued_frames(), 0);
+}
+
+TEST(SampleRingTest, PassesEveryFrameInOrderBetweenThreads) {
+    constexpr size_t NUM_FRAMES = 1'000'000;
+    SampleRing ring(1000);
+
+    thread producer([&] {
+        size_t frame = 0;
+        for (size_t chunk = 1; frame < NUM_FRAMES; chunk = chunk * 7 % 997 + 1) {
+            const auto region = ring.write_region();
+            const auto count = min({ region.frames, chunk, NUM_FRAMES - frame });
+            for (size_t i = 0; i < count; ++i, ++frame) {
+                region.samples[2 * i] = int16_t(frame);
+                region.samples[2 * i + 1] = int16_t(~frame);
+            }
+            ring.commit_write(count);
+            if (!count)
+                this_thread::yield();
+        }
+    });
+
+    size_t frame = 0;
+    bool inOrder = true;
+    vector<int16_t> samples(2 * 333);
+    while (frame < NUM_FRAMES) {
+        const auto count = ring.read(samples.data(), 333);
+        for (size_t i = 0; i < count; ++i, ++frame)
+            inOrder &= samples[2 * i] == int16_t(frame) && samples[2 * i + 1] == int16_t(~frame);
+        if (!count)
+            this_thread::yield();
+    }
+    producer.join();
+    EXPECT_TRUE(inOrder);
+    EXPECT_EQ(ring.queued_frames(), 0);
+}
+
+TEST(TripleBufferTest, ConsumerGetsTheNewestFrame) {
+    TripleBuffer frames(4);
+    EXPECT_FALSE(frames.acquire());
+    EXPECT_EQ(frames.front()[0], 0);
+
+    memset(frames.back(), 1, 4);
+    auto* back = frames.publish();
+    memset(back, 2, 4);
+    back = frames.publish();
+    memset(back, 3, 4);
+    // 1 was never shown
+    EXPECT_TRUE(frames.acquire());
+    EXPECT_EQ(frames.front()[0], 2);
+    EXPECT_FALSE(frames.acquire());
+    EXPECT_EQ(frames.front()[0], 2);
+
+    frames.publish();
+    EXPECT_TRUE(frames.acquire());
+    EXPECT_EQ(frames.front()[3], 3);
+}
+
+TEST(TripleBufferTest, FramesArriveWholeBetweenThreads) {
+    constexpr uint32_t NUM_FRAMES = 100'000;
+    constexpr size_t WORDS = 1024;
+    TripleBuffer frames(WORDS * sizeof(uint32_t));
+
+    thread producer([&] {
+        auto* back = frames.back();
+        for (uint32_t frame = 1; frame <= NUM_FRAMES; ++frame) {
+            for (size_t word = 0; word < WORDS; ++word)
+                memcpy(back + word * sizeof(uint32_t), &frame, sizeof(frame));
+            back = frames.publish();
+        }
+    });
+
+    uint32_t last = 0;
+    bool whole = true;
+    bool increasing = true;
+    while (last < NUM_FRAMES) {
+        if (!frames.acquire()) {
+            this_thread::yield();
+            continue;
+        }
+        uint32_t words[WORDS];
+        memcpy(words, frames.front(), sizeof(words));
+        whole &= all_of(words, words + WORDS, [&](uint32_t word) { return word == words[0]; });
+        increasing &= words[0] > last;
+        last = words[0];
+    }
+    producer.join();
+    EXPECT_TRUE(whole);
+    EXPECT_TRUE(increasing);
+}
+
+TEST(RateControlTest, StaysWithinItsDeviation) {
+    RateControl control(48000, 3200);
+    EXPECT_EQ(control.update(3200), 48000);
+    for (int i = 0; i < 100; ++i)
+        control.update(0);
+    EXPECT_EQ(control.rate(), 48240);
+    for (int i = 0; i < 100; ++i)
+        control.update(16384);
+    EXPECT_EQ(control.rate(), 47760);
+}
+
+TEST(RateControlTest, KeepsTheQueueNearTheTargetAsClocksDrift) {
+    constexpr size_t TARGET = 3200;
+    // A tenth of a second of sound a frame, played by a host whose clock runs 0.3% fast or slow
+    for (double drift : { 1.003, 0.997 }) {
+        RateControl control(48000, TARGET);
+        double queued = TARGET;
+        double lowest = queued;
+        double highest = queued;
+        for (int frame = 0; frame < 60 * 600; ++frame) {
+            queued += control.rate() / 60.0;
+            queued = max(0.0, queued - 48000 * drift / 60);
+            control.update(size_t(queued));
+            if (frame > 60 * 60) {
+                lowest = min(lowest, queued);
+                highest = max(highest, queued);
+            }
+        }
+        EXPECT_GT(lowest, TARGET / 4) << drift;
+        EXPECT_LT(highest, 2 * TARGET) << drift;
+    }
+}
@@ -1,8 +1,10 @@
 #include "gtest/gtest.h"
 
 #include "CPU.h"
+#include "RegisterFile.h"
 #include "Registers.h"
 #include "memory/Memory.h"
+#include "instruction/AddByteInstruction.h"
 #include "instruction/LoadByteInstruction.h"
 #include "instruction/PushInstruction.h"
 #include "instruction/PopInstruction.h"
@@ -45,6 +47,15 @@ TEST_F(InstructionTest, BaseInstructionCanMoveProgramCounter) {
     EXPECT_EQ(beforeExecutePC + 0x42, afterExecutePC);
 }
 
+TEST_F(InstructionTest, BaseInstructionAdvancesTheClockByItsCycles) {
+    MockInstruction instr;
+    instr.with_cycles(8);
+
+    instr.execute(*cpu);
+
+    EXPECT_EQ(cpu->scheduler().now(), 8u);
+}
+
 TEST_F(InstructionTest, LoadByte) {
     {
         auto refA = mem->get_register(Register::A);
@@ -64,6 +75,23 @@ TEST_F(InstructionTest, LoadByte) {
     EXPECT_EQ(refB->read8(), 0x12);
 }
 
+TEST_F(InstructionTest, AddByteLeavesFlagsInF) {
+    const auto add = [&](uint8_t a, uint8_t b) {
+        mem->get_register(Register::A)->write8(a);
+        mem->get_register(Register::B)->write8(b);
+        mem->registers().f = Flags::SUBTRACT;
+        AddByteInstruction instr(mem->get_register(Register::B), mem->get_register(Register::A));
+        instr.execute(*cpu);
+        return mem->registers().f;
+    };
+
+    EXPECT_EQ(add(0xFF, 0x01), Flags::ZERO | Flags::HALF_CARRY | Flags::CARRY);
+    EXPECT_EQ(mem->registers().a, 0x00);
+    // No carry out of either nibble clears N, H and C
+    EXPECT_EQ(add(0x12, 0x34), 0);
+    EXPECT_EQ(mem->registers().a, 0x46);
+}
+
 TEST_F(InstructionTest, Then) {
     auto refA = mem->get_register(Register::A);
     auto& refToA = *refA;
@@ -0,0 +1,187 @@
+#include "gtest/gtest.h"
+
+#include "CPU.h"
+#include "io/InterruptController.h"
+#include "io/Timer.h"
+#include "memory/Memory.h"
+
+#include <initializer_list>
+#include <memory>
+#include <stdint.h>
+
+using namespace GameBoy;
+using namespace std;
+
+namespace {
+
+constexpr uint16_t IF = 0xFF0F;
+constexpr uint16_t IE = 0xFFFF;
+constexpr uint16_t PROGRAM_START = 0xC000;
+constexpr uint16_t STACK_TOP = 0xDFFE;
+
+class InterruptTest : public ::testing::TestWithParam<ExecutionMode> {
+protected:
+    void SetUp() override
+    {
+        mem = make_unique<Memory>();
+        cpu = make_unique<CPU>(*mem);
+        cpu->set_execution_mode(GetParam());
+        regs().pc = PROGRAM_START;
+        regs().sp = STACK_TOP;
+    }
+
+    auto regs() -> RegisterFile& { return cpu->registers(); }
+
+    auto load(uint16_t address, initializer_list<uint8_t> program) -> void
+    {
+        for (auto byte : program)
+            mem->write8(address++, byte);
+    }
+
+    unique_ptr<Memory> mem;
+    unique_ptr<CPU> cpu;
+};
+
+}
+
+TEST_P(InterruptTest, DispatchesHighestPriorityFirst) {
+    cpu->set_interrupts_enabled(true);
+    mem->write8(IE, 0x1F);
+    mem->write8(IF, 0x14); // Timer and joypad
+
+    EXPECT_EQ(cpu->step(), 20);
+    EXPECT_EQ(regs().pc, 0x0050);
+    EXPECT_EQ(regs().sp, STACK_TOP - 2);
+    EXPECT_EQ(mem->read16(STACK_TOP - 2), PROGRAM_START);
+    EXPECT_FALSE(cpu->interrupts_enabled());
+    EXPECT_EQ(mem->read8(IF), 0xF0); // The unused bits read back set
+}
+
+TEST_P(InterruptTest, IgnoredWhileDisabled) {
+    mem->write8(IE, 0x01);
+    cpu->interrupts().request(Interrupt::VBlank);
+
+    EXPECT_EQ(cpu->step(), 4);
+    EXPECT_EQ(regs().pc, PROGRAM_START + 1);
+    EXPECT_EQ(cpu->interrupts().pending(), 0x01);
+}
+
+TEST_P(InterruptTest, EnableTakesEffectAfterTheNextInstruction) {
+    load(PROGRAM_START, { 0xFB, 0x00, 0x00 }); // EI; NOP; NOP
+    mem->write8(IE, 0x04);
+    mem->write8(IF, 0x04);
+
+    cpu->step();
+    EXPECT_FALSE(cpu->interrupts_enabled());
+    cpu->step();
+    EXPECT_EQ(regs().pc, PROGRAM_START + 2);
+
+    EXPECT_EQ(cpu->step(), 20);
+    EXPECT_EQ(regs().pc, 0x0050);
+    EXPECT_EQ(mem->read16(STACK_TOP - 2), PROGRAM_START + 2);
+}
+
+TEST_P(InterruptTest, DisableCancelsAPendingEnable) {
+    load(PROGRAM_START, { 0xFB, 0xF3, 0x00 }); // EI; DI; NOP
+    mem->write8(IE, 0x04);
+    mem->write8(IF, 0x04);
+
+    for (auto i = 0; i < 3; ++i)
+        cpu->step();
+    EXPECT_EQ(regs().pc, PROGRAM_START + 3);
+    EXPECT_FALSE(cpu->interrupts_enabled());
+}
+
+TEST_P(InterruptTest, HaltWakesWithoutDispatchWhileDisabled) {
+    load(PROGRAM_START, { 0x76, 0x3C }); // HALT; INC A
+    mem->write8(IE, 0x04);
+
+    cpu->step();
+    EXPECT_EQ(cpu->state(), CPU::State::Halted);
+    cpu->step();
+    EXPECT_EQ(regs().pc, PROGRAM_START + 1);
+
+    cpu->interrupts().request(Interrupt::Timer);
+    cpu->step();
+    EXPECT_EQ(cpu->state(), CPU::State::Running);
+    EXPECT_EQ(regs().a, 1);
+    EXPECT_EQ(mem->read8(IF) & 0x04, 0x04);
+}
+
+TEST_P(InterruptTest, HaltDoesNotStopWithSomethingPending) {
+    load(PROGRAM_START, { 0x76 }); // HALT
+    mem->write8(IE, 0x04);
+    mem->write8(IF, 0x04);
+
+    cpu->step();
+    EXPECT_EQ(cpu->state(), CPU::State::Running);
+}
+
+TEST_P(InterruptTest, WritingIeEndsTheRunningSlice) {
+    load(PROGRAM_START, {
+        0x3E, 0x04, // LD A,$04
+        0xE0, 0xFF, // LDH (IE),A
+        0x18, 0xFE, // JR self
+    });
+    load(0x0050, { 0x3E, 0x42, 0x76 }); // LD A,$42; HALT
+    cpu->set_interrupts_enabled(true);
+    mem->write8(IF, 0x04);
+
+    // All in one call: the handler has to run before the budget is spent on the loop
+    cpu->run_for(100'000);
+    EXPECT_EQ(regs().a, 0x42);
+    EXPECT_EQ(cpu->state(), CPU::State::Halted);
+    EXPECT_EQ(mem->read16(STACK_TOP - 2), PROGRAM_START + 4);
+}
+
+TEST_P(InterruptTest, TimerInterruptsALoop) {
+    Timer timer(*cpu);
+    load(PROGRAM_START, { 0x18, 0xFE }); // JR self
+    load(0x0050, {
+        0xAF, // XOR A
+        0xE0, 0x07, // LDH (TAC),A
+        0x3E, 0x42, // LD A,$42
+        0x76, // HALT
+    });
+    cpu->set_interrupts_enabled(true);
+    mem->write8(IE, 0x04);
+    mem->write8(0xFF05, 0xF0); // TIMA
+    mem->write8(0xFF07, 0x05); // Every 16 cycles
+
+    cpu->run_for(100'000);
+    EXPECT_EQ(regs().a, 0x42);
+    EXPECT_EQ(cpu->state(), CPU::State::Halted);
+    EXPECT_EQ(mem->read16(STACK_TOP - 2), PROGRAM_START);
+    EXPECT_EQ(mem->read8(IF) & 0x04, 0);
+}
+
+TEST_P(InterruptTest, HaltSkipsStraightToTheTarget) {
+    load(PROGRAM_START, { 0x76 }); // HALT
+
+    EXPECT_EQ(cpu->run_for(70224), 70224);
+    EXPECT_EQ(cpu->stats().haltFastForwards, 1);
+    EXPECT_EQ(cpu->stats().haltCyclesSkipped, 70224 - 4);
+}
+
+TEST_P(InterruptTest, HaltSkipsToTheNextEvent) {
+    load(PROGRAM_START, { 0x76, 0x3C, 0x76 }); // HALT; INC A; HALT
+    load(0x0058, { 0xD9 }); // RETI
+    auto& scheduler = cpu->scheduler();
+    scheduler.set_handler(Event::Serial, [&] { cpu->interrupts().request(Interrupt::Serial); });
+    scheduler.schedule(Event::Serial, 1000);
+    cpu->set_interrupts_enabled(true);
+    mem->write8(IE, 0x08);
+
+    cpu->run_for(5000);
+    EXPECT_EQ(regs().a, 1);
+    EXPECT_EQ(cpu->state(), CPU::State::Halted);
+    EXPECT_EQ(cpu->stats().haltFastForwards, 2);
+    // Up to the event, then from the second HALT after the dispatch, RETI and INC A
+    EXPECT_EQ(cpu->stats().haltCyclesSkipped, (1000 - 4) + (5000 - 1000 - 20 - 16 - 4 - 4));
+}
+
+INSTANTIATE_TEST_SUITE_P(AllModes, InterruptTest,
+    ::testing::Values(ExecutionMode::Interpreter, ExecutionMode::Jit),
+    [](const ::testing::TestParamInfo<ExecutionMode>& info) {
+        return info.param == ExecutionMode::Jit ? "Jit" : "Interpreter";
+    });
@@ -4,11 +4,14 @@
 #include "memory/NewByteReference.h"
 #include "memory/NewWordReference.h"
 #include "memory/CompositeWordReference.h"
+#include "memory/IoHandler.h"
 #include "memory/Memory.h"
 #include "memory/WordReference.h"
+#include "RegisterFile.h"
 #include "Registers.h"
 
 #include <memory>
+#include <vector>
 
 using namespace GameBoy;
 using namespace std;
@@ -159,13 +162,45 @@ TEST(MemoryTest, WordRegistersAreComposedOfSubValues) {
     auto refB = mem.get_register(Register::B);
     auto refC = mem.get_register(Register::C);
 
-    refB->write8(0x34);
-    refC->write8(0x12);
+    refB->write8(0x12);
+    refC->write8(0x34);
 
     auto refBC = mem.get_word_register(WordRegister::BC);
     EXPECT_EQ(refBC->read16(), 0x1234);
 }
 
+TEST(MemoryTest, RegisterFileIsSharedWithReferences) {
+    Memory mem;
+    auto& regs = mem.registers();
+
+    regs.hl = 0xC123;
+    EXPECT_EQ(mem.get_register(Register::H)->read8(), 0xC1);
+    EXPECT_EQ(mem.get_register(Register::L)->read8(), 0x23);
+
+    mem.get_word_register(WordRegister::SP)->write16(0xFFFE);
+    EXPECT_EQ(regs.sp, 0xFFFE);
+}
+
+TEST(RegisterFileTest, PairsAreComposedOfHalves) {
+    RegisterFile regs {};
+
+    regs.a = 0x12;
+    regs.f = 0xB0;
+    EXPECT_EQ(regs.af, 0x12B0);
+
+    regs.de = 0xBEEF;
+    EXPECT_EQ(regs.d, 0xBE);
+    EXPECT_EQ(regs.e, 0xEF);
+
+    regs.pc = 0x0150;
+    EXPECT_EQ(regs.pc_high, 0x01);
+    EXPECT_EQ(regs.pc_low, 0x50);
+
+    regs[Register::B] = 0x34;
+    regs[WordRegister::BC] += 1;
+    EXPECT_EQ(regs.bc, 0x3401);
+}
+
 TEST(MemoryTest, DerefPointsToAddressReadFromMemoryLocation) {
     Memory mem;
 
@@ -225,3 +260,124 @@ TEST(MemoryTest, NewReferenceDerefsEasily) {
     EXPECT_EQ(v1, 0xABCD);
     EXPECT_EQ(v1, v2);
 }
+
+namespace {
+
+// Records every trapped access, and reads back whatever was last written
+class RecordingHandler : public IoHandler {
+public:
+    auto read8(uint16_t address) -> uint8_t override
+    {
+        lastRead = address;
+        return value;
+    }
+
+    auto write8(uint16_t address, uint8_t newValue) -> void override
+    {
+        lastWrite = address;
+        value = newValue;
+    }
+
+    uint16_t lastRead = 0;
+    uint16_t lastWrite = 0;
+    uint8_t value = 0;
+};
+
+}
+
+TEST(MemoryTest, EchoRegionMirrorsInternalRam) {
+    Memory mem;
+
+    mem.write8(0xC123, 0x42);
+    EXPECT_EQ(mem.read8(0xE123), 0x42);
+
+    mem.write8(0xFDFF, 0x24);
+    EXPECT_EQ(mem.read8(0xDDFF), 0x24);
+}
+
+TEST(MemoryTest, UnusableRegionAfterOamIgnoresWrites) {
+    Memory mem;
+
+    mem.write8(0xFE9F, 0x12);
+    mem.write8(0xFEA0, 0x34);
+    EXPECT_EQ(mem.read8(0xFE9F), 0x12);
+    EXPECT_EQ(mem.read8(0xFEA0), 0x00);
+}
+
+TEST(MemoryTest, IoRegistersGoToTheirHandlers) {
+    Memory mem;
+    RecordingHandler handler;
+    mem.map_io(0xFF44, &handler);
+
+    mem.write8(0xFF44, 0x90);
+    EXPECT_EQ(handler.lastWrite, 0xFF44);
+    EXPECT_EQ(mem.read8(0xFF44), 0x90);
+    EXPECT_EQ(handler.lastRead, 0xFF44);
+
+    // Unmapped registers and high RAM are plain storage
+    mem.write8(0xFF45, 0x12);
+    mem.write8(0xFF80, 0x34);
+    EXPECT_EQ(mem.read8(0xFF45), 0x12);
+    EXPECT_EQ(mem.read8(0xFF80), 0x34);
+
+    mem.map_io(0xFF44, nullptr);
+    mem.write8(0xFF44, 0x56);
+    EXPECT_EQ(mem.read8(0xFF44), 0x56);
+    EXPECT_EQ(handler.value, 0x90);
+}
+
+TEST(MemoryTest, BankSwitchesRemapPagesWithoutCopying) {
+    Memory mem;
+    RecordingHandler controller;
+    std::vector<uint8_t> rom(0x8000);
+    rom[0x4000] = 0x11;
+    rom[0x6000] = 0x22;
+
+    mem.map_rom(0x40, 0x20, &rom[0x4000], &controller);
+    EXPECT_EQ(mem.read8(0x4000), 0x11);
+
+    // Writes to ROM go to the controller rather than the bytes
+    mem.write8(0x4000, 0x02);
+    EXPECT_EQ(controller.lastWrite, 0x4000);
+    EXPECT_EQ(rom[0x4000], 0x11);
+
+    mem.map_rom(0x40, 0x20, &rom[0x6000], &controller);
+    EXPECT_EQ(mem.read8(0x4000), 0x22);
+    rom[0x6001] = 0x33;
+    EXPECT_EQ(mem.read8(0x4001), 0x33);
+}
+
+TEST(MemoryTest, HandlerPagesTrapEveryAccess) {
+    Memory mem;
+    RecordingHandler handler;
+    mem.map_handler(0xA0, 0x20, &handler);
+
+    mem.write8(0xB234, 0x56);
+    EXPECT_EQ(handler.lastWrite, 0xB234);
+    EXPECT_EQ(mem.read8(0xA000), 0x56);
+    EXPECT_EQ(handler.lastRead, 0xA000);
+    EXPECT_EQ(mem.get_ref(0xA001)->read8(), 0x56);
+    EXPECT_EQ(handler.lastRead, 0xA001);
+}
+
+TEST(MemoryTest, WatchedPagesReportWritesUntilUnwatched) {
+    Memory mem;
+    std::vector<uint16_t> reported;
+    mem.set_write_watcher([&](uint16_t address) { reported.push_back(address); });
+
+    mem.watch_page(0xC1);
+    mem.watch_page(0xC1);
+    mem.write8(0xC000, 1);
+    mem.write8(0xC101, 2);
+    // The echo region reports the address it mirrors
+    mem.write8(0xE102, 3);
+    mem.unwatch_page(0xC1);
+    mem.write16(0xC1FF, 0x0405);
+    mem.unwatch_page(0xC1);
+    mem.write8(0xC103, 6);
+
+    EXPECT_EQ(reported, (std::vector<uint16_t> { 0xC101, 0xC102, 0xC1FF }));
+    EXPECT_EQ(mem.read8(0xC102), 3);
+    EXPECT_EQ(mem.read16(0xC1FF), 0x0405);
+    EXPECT_EQ(mem.read8(0xC103), 6);
+}
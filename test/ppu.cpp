@@ -0,0 +1,414 @@
+#include "gtest/gtest.h"
+
+#include "CPU.h"
+#include "memory/Memory.h"
+#include "video/OamDma.h"
+#include "video/Ppu.h"
+#include "video/SpriteTable.h"
+#include "video/TileDecoder.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <stdint.h>
+#include <vector>
+
+using namespace GameBoy;
+using namespace std;
+
+namespace {
+
+constexpr uint16_t LCDC = 0xFF40;
+constexpr uint16_t STAT = 0xFF41;
+constexpr uint16_t SCX = 0xFF43;
+constexpr uint16_t LY = 0xFF44;
+constexpr uint16_t LYC = 0xFF45;
+constexpr uint16_t BGP = 0xFF47;
+constexpr uint16_t OBP0 = 0xFF48;
+constexpr uint16_t WY = 0xFF4A;
+constexpr uint16_t WX = 0xFF4B;
+constexpr uint16_t DMA = 0xFF46;
+constexpr uint16_t IF = 0xFF0F;
+
+constexpr uint32_t LINE_CYCLES = 456;
+constexpr uint32_t FRAME_CYCLES = 154 * LINE_CYCLES;
+constexpr size_t NUM_TILES = 384;
+
+// LCD, background and sprites on, tiles from 8000, maps at 9800
+constexpr uint8_t LCDC_ON = 0x93;
+
+class PpuTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        mem = make_unique<Memory>();
+        cpu = make_unique<CPU>(*mem);
+        ppu = make_unique<Ppu>(*cpu);
+        ppu->set_framebuffer(framebuffer.data());
+
+        // JR self, so the CPU keeps busy without wandering through memory
+        mem->write8(0xC000, 0x18);
+        mem->write8(0xC001, 0xFE);
+        mem->registers().pc = 0xC000;
+        mem->write8(BGP, 0xE4);
+        mem->write8(OBP0, 0xE4);
+    }
+
+    // Fills the tile with one palette index
+    auto set_tile(uint8_t tile, uint8_t index) -> void
+    {
+        for (uint16_t row = 0; row < 8; ++row) {
+            mem->write8(0x8000 + tile * 16 + 2 * row, (index & 1) ? 0xFF : 0x00);
+            mem->write8(0x8000 + tile * 16 + 2 * row + 1, (index & 2) ? 0xFF : 0x00);
+        }
+    }
+
+    auto set_sprite(int sprite, uint8_t y, uint8_t x, uint8_t tile, uint8_t attributes = 0) -> void
+    {
+        mem->write8(0xFE00 + 4 * sprite, y);
+        mem->write8(0xFE00 + 4 * sprite + 1, x);
+        mem->write8(0xFE00 + 4 * sprite + 2, tile);
+        mem->write8(0xFE00 + 4 * sprite + 3, attributes);
+    }
+
+    // Moves the loop to HRAM, the only place the CPU can run from during OAM DMA
+    auto wait_in_high_ram() -> void
+    {
+        mem->write8(0xFF80, 0x18);
+        mem->write8(0xFF81, 0xFE);
+        mem->registers().pc = 0xFF80;
+    }
+
+    auto pixel(int x, int y) -> uint8_t { return framebuffer[y * SCREEN_WIDTH + x]; }
+
+    vector<uint8_t> framebuffer = vector<uint8_t>(SCREEN_WIDTH * SCREEN_HEIGHT, 0xFF);
+    unique_ptr<Memory> mem;
+    unique_ptr<CPU> cpu;
+    unique_ptr<Ppu> ppu;
+};
+
+// Runs a program that keeps scrolling, moving the window and writing VRAM and OAM as it
+// goes, and returns each frame as VBlank starts. Drawing switches to the render thread as
+// the first frame starts if threaded, and back again for the last few frames.
+auto record_frames(bool threaded, int count) -> vector<vector<uint8_t>>
+{
+    Memory mem;
+    CPU cpu(mem);
+    Ppu ppu(cpu);
+    vector<uint8_t> framebuffer(SCREEN_WIDTH * SCREEN_HEIGHT);
+    ppu.set_framebuffer(framebuffer.data());
+    ppu.set_threaded_rendering(threaded);
+
+    mt19937 random(19);
+    for (uint32_t address = 0x8000; address < 0xA000; ++address)
+        mem.write8(address, uint8_t(random()));
+    for (uint32_t address = 0xFE00; address < 0xFEA0; ++address)
+        mem.write8(address, uint8_t(random()));
+    uint16_t address = 0xC000;
+    for (uint8_t byte : {
+             0x21, 0x00, 0x80, // LD HL,$8000
+             0x01, 0x00, 0xFE, // LD BC,$FE00
+             0x3C, // loop: INC A
+             0xE0, 0x43, // LDH (SCX),A
+             0x22, // LD (HL+),A
+             0xCB, 0xAC, // RES 5,H, to stay in VRAM
+             0x02, // LD (BC),A
+             0x0C, // INC C
+             0xE0, 0x4A, // LDH (WY),A
+             0x18, 0xF4, // JR loop
+         })
+        mem.write8(address++, byte);
+    mem.registers().pc = 0xC000;
+    mem.write8(BGP, 0xE4);
+    mem.write8(OBP0, 0xD2);
+    mem.write8(WX, 50);
+    // Window, tall sprites and everything else on
+    mem.write8(LCDC, 0xF7);
+
+    vector<vector<uint8_t>> frames;
+    while (int(frames.size()) < count) {
+        const auto frame = ppu.frame_count();
+        while (ppu.frame_count() == frame)
+            cpu.run_for(LINE_CYCLES);
+        ppu.sync_framebuffer();
+        frames.push_back(framebuffer);
+        if (int(frames.size()) == count - 3)
+            ppu.set_threaded_rendering(false);
+    }
+    return frames;
+}
+
+}
+
+TEST(TileDecoderTest, EveryIsaMatchesScalarAcrossAllTiles) {
+    mt19937 random(16);
+    vector<uint8_t> tiles(NUM_TILES * 16);
+    for (auto& byte : tiles)
+        byte = uint8_t(random());
+
+    vector<uint8_t> reference(NUM_TILES * 64);
+    TileDecoder::decode_rows(TileDecoder::Isa::Scalar, tiles.data(), NUM_TILES * 8, reference.data());
+    // Spot check the reference itself: bit 7 is the leftmost pixel, the high plane is bit 1
+    EXPECT_EQ(reference[0], ((tiles[0] >> 7) & 1) | ((tiles[1] >> 7) << 1));
+    EXPECT_EQ(reference[7], (tiles[0] & 1) | ((tiles[1] & 1) << 1));
+
+    for (auto isa : { TileDecoder::Isa::Sse2, TileDecoder::Isa::Avx2 }) {
+        if (!TileDecoder::supported(isa))
+            continue;
+        vector<uint8_t> pixels(NUM_TILES * 64);
+        TileDecoder::decode_rows(isa, tiles.data(), NUM_TILES * 8, pixels.data());
+        EXPECT_EQ(pixels, reference) << "isa " << int(isa);
+
+        // Counts that leave rows over for the scalar tail
+        for (size_t rows : { 1, 3, 7, 11 }) {
+            vector<uint8_t> partial(rows * 8);
+            TileDecoder::decode_rows(isa, tiles.data() + 2, rows, partial.data());
+            EXPECT_TRUE(equal(partial.begin(), partial.end(), reference.begin() + 8)) << rows << " rows";
+        }
+    }
+}
+
+TEST(SpriteTableTest, MatchesAFullScanAfterEveryWrite) {
+    mt19937 random(18);
+    vector<uint8_t> oam(160);
+    SpriteTable table(oam.data());
+
+    for (int write = 0; write < 2000; ++write) {
+        // Keep Y and X to a narrow range so lines crowd and X ties
+        const uint8_t offset = random() % oam.size();
+        oam[offset] = uint8_t(random() % 40 + (offset % 4 == 0 ? 10 : 0));
+        table.update(offset);
+        if (write % 50)
+            continue;
+
+        for (bool tall : { false, true }) {
+            const int height = tall ? 16 : 8;
+            for (uint8_t ly = 0; ly < SCREEN_HEIGHT; ++ly) {
+                vector<uint8_t> expected;
+                for (uint8_t sprite = 0; sprite < 40 && expected.size() < 10; ++sprite) {
+                    if (ly >= oam[4 * sprite] - 16 && ly < oam[4 * sprite] - 16 + height)
+                        expected.push_back(sprite);
+                }
+                stable_sort(expected.begin(), expected.end(),
+                    [&](uint8_t a, uint8_t b) { return oam[4 * a + 1] < oam[4 * b + 1]; });
+
+                const auto& line = table.line(ly, tall);
+                EXPECT_EQ(vector<uint8_t>(line.sprites, line.sprites + line.count), expected)
+                    << "line " << int(ly) << (tall ? " tall" : "");
+            }
+        }
+    }
+}
+
+TEST(RenderThreadTest, FramesMatchDrawingInline) {
+    const auto drawnInline = record_frames(false, 12);
+    const auto threaded = record_frames(true, 12);
+    ASSERT_EQ(threaded.size(), drawnInline.size());
+    for (size_t frame = 0; frame < drawnInline.size(); ++frame)
+        EXPECT_EQ(threaded[frame], drawnInline[frame]) << "frame " << frame;
+    // The program does change the picture
+    EXPECT_NE(drawnInline[0], drawnInline[1]);
+}
+
+TEST_F(PpuTest, CountsLinesAndRaisesVBlank) {
+    mem->write8(LCDC, LCDC_ON);
+    EXPECT_EQ(ppu->mode(), Ppu::Mode::OamScan);
+
+    cpu->run_for(10 * LINE_CYCLES + 100);
+    EXPECT_EQ(mem->read8(LY), 10);
+    EXPECT_EQ(ppu->mode(), Ppu::Mode::Drawing);
+    EXPECT_EQ(mem->read8(STAT) & 0x03, 3);
+    EXPECT_EQ(mem->read8(IF) & 0x01, 0);
+
+    cpu->run_for(134 * LINE_CYCLES);
+    EXPECT_EQ(mem->read8(LY), 144);
+    EXPECT_EQ(ppu->mode(), Ppu::Mode::VBlank);
+    EXPECT_EQ(mem->read8(IF) & 0x01, 0x01);
+    EXPECT_EQ(ppu->frame_count(), 1);
+
+    cpu->run_for(10 * LINE_CYCLES);
+    EXPECT_EQ(mem->read8(LY), 0);
+
+    mem->write8(LCDC, 0x00);
+    EXPECT_EQ(mem->read8(LY), 0);
+    EXPECT_EQ(mem->read8(STAT) & 0x03, 0);
+}
+
+TEST_F(PpuTest, RaisesStatOnCoincidence) {
+    mem->write8(LYC, 5);
+    mem->write8(STAT, 0x40);
+    mem->write8(LCDC, LCDC_ON);
+
+    // Short of line 5 by more than the JR that may run over
+    cpu->run_for(5 * LINE_CYCLES - 20);
+    EXPECT_EQ(mem->read8(IF) & 0x02, 0);
+    cpu->run_for(40);
+    EXPECT_EQ(mem->read8(IF) & 0x02, 0x02);
+    EXPECT_EQ(mem->read8(STAT) & 0x04, 0x04);
+}
+
+TEST_F(PpuTest, DrawsScrolledBackground) {
+    set_tile(1, 3);
+    set_tile(2, 1);
+    // Alternate tiles 1 and 2 along the first row of the map, and tile 2 below
+    for (uint16_t column = 0; column < 32; ++column) {
+        mem->write8(0x9800 + column, column % 2 ? 2 : 1);
+        mem->write8(0x9820 + column, 2);
+    }
+    mem->write8(SCX, 3);
+    mem->write8(LCDC, LCDC_ON);
+    cpu->run_for(FRAME_CYCLES);
+
+    EXPECT_EQ(pixel(0, 0), 3);
+    EXPECT_EQ(pixel(4, 0), 3);
+    EXPECT_EQ(pixel(5, 0), 1);
+    EXPECT_EQ(pixel(13, 0), 3);
+    EXPECT_EQ(pixel(0, 8), 1);
+    // The rest of the map is tile 0, which is blank
+    EXPECT_EQ(pixel(100, 20), 0);
+}
+
+TEST_F(PpuTest, DrawsTheWindowOverTheBackground) {
+    set_tile(1, 2);
+    // Window map at 9C00 is all tile 1
+    for (uint16_t offset = 0; offset < 0x400; ++offset)
+        mem->write8(0x9C00 + offset, 1);
+    mem->write8(WY, 16);
+    mem->write8(WX, 7 + 80);
+    mem->write8(LCDC, LCDC_ON | 0x60);
+    cpu->run_for(FRAME_CYCLES);
+
+    EXPECT_EQ(pixel(79, 16), 0);
+    EXPECT_EQ(pixel(80, 16), 2);
+    EXPECT_EQ(pixel(80, 15), 0);
+    EXPECT_EQ(pixel(159, 143), 2);
+}
+
+TEST_F(PpuTest, SpritePriorityFollowsTheDmg) {
+    set_tile(1, 1);
+    set_tile(2, 2);
+    set_tile(3, 3);
+    // Background tile 3 under x 64-71 of the first row
+    mem->write8(0x9808, 3);
+
+    // Overlapping at x 8-15: the lower X wins whatever the OAM order
+    set_sprite(0, 16, 12, 1);
+    set_sprite(1, 16, 8, 2);
+    // Same X: the first in OAM wins
+    set_sprite(2, 16, 32, 1);
+    set_sprite(3, 16, 32, 2);
+    // Behind the background, and in front of a lower priority sprite it hides there anyway
+    set_sprite(4, 16, 72, 1, 0x80);
+    set_sprite(5, 16, 73, 2);
+    mem->write8(LCDC, LCDC_ON);
+    cpu->run_for(FRAME_CYCLES);
+
+    EXPECT_EQ(pixel(0, 0), 2);
+    EXPECT_EQ(pixel(7, 0), 2);
+    EXPECT_EQ(pixel(8, 0), 1);
+    EXPECT_EQ(pixel(24, 0), 1);
+    EXPECT_EQ(pixel(64, 0), 3);
+    EXPECT_EQ(pixel(71, 0), 3);
+    EXPECT_EQ(pixel(72, 0), 2);
+    EXPECT_EQ(pixel(0, 8), 0);
+}
+
+TEST_F(PpuTest, OnlyTenSpritesPerLine) {
+    set_tile(1, 3);
+    for (int sprite = 0; sprite < 12; ++sprite)
+        set_sprite(sprite, 16, uint8_t(8 + 10 * sprite), 1);
+    mem->write8(LCDC, LCDC_ON);
+    cpu->run_for(FRAME_CYCLES);
+
+    EXPECT_EQ(pixel(90, 0), 3);
+    EXPECT_EQ(pixel(100, 0), 0);
+    EXPECT_EQ(pixel(110, 0), 0);
+}
+
+TEST_F(PpuTest, TileCacheDecodesOnceUntilWritten) {
+    set_tile(1, 3);
+    // The whole background map is tile 1
+    for (uint16_t offset = 0; offset < 0x400; ++offset)
+        mem->write8(0x9800 + offset, 1);
+    mem->write8(LCDC, LCDC_ON);
+    cpu->run_for(FRAME_CYCLES);
+
+    // One miss for tile 1, then hits for the 20 tiles of every line after
+    const auto stats = ppu->tile_cache_stats();
+    EXPECT_EQ(stats.misses, 1);
+    EXPECT_EQ(stats.hits, 144 * 20 - 1);
+    EXPECT_EQ(pixel(50, 50), 3);
+
+    // A write to its data has it decoded afresh
+    set_tile(1, 2);
+    cpu->run_for(FRAME_CYCLES);
+    EXPECT_EQ(ppu->tile_cache_stats().misses, 2);
+    EXPECT_EQ(pixel(50, 50), 2);
+}
+
+TEST_F(PpuTest, CachedFramesMatchUncached) {
+    mt19937 random(17);
+    for (uint32_t address = 0x8000; address < 0xA000; ++address)
+        mem->write8(address, uint8_t(random()));
+    for (uint32_t address = 0xFE00; address < 0xFEA0; ++address)
+        mem->write8(address, uint8_t(random()));
+    mem->write8(WY, 40);
+    mem->write8(WX, 50);
+
+    // Signed tile data and tall sprites, then unsigned, both with the window on
+    for (uint8_t lcdc : { 0xE7, 0xF3 }) {
+        mem->write8(LCDC, lcdc);
+        ppu->set_tile_cache_enabled(false);
+        cpu->run_for(FRAME_CYCLES);
+        const auto uncached = framebuffer;
+
+        ppu->set_tile_cache_enabled(true);
+        cpu->run_for(FRAME_CYCLES);
+        EXPECT_EQ(framebuffer, uncached) << "LCDC " << int(lcdc);
+        mem->write8(LCDC, 0x00);
+    }
+}
+
+TEST_F(PpuTest, OamDmaCopiesAsTheTransferEnds) {
+    OamDma dma(*cpu);
+    for (uint16_t offset = 0; offset < 0xA0; ++offset)
+        mem->write8(0xC100 + offset, uint8_t(offset + 1));
+    wait_in_high_ram();
+
+    mem->write8(DMA, 0xC1);
+    EXPECT_TRUE(dma.active());
+    EXPECT_EQ(mem->read8(DMA), 0xC1);
+    // Everything but FF00-FFFF is locked out
+    EXPECT_EQ(mem->read8(0xC100), 0xFF);
+    EXPECT_EQ(mem->read8(0xFE00), 0xFF);
+    EXPECT_EQ(mem->read8(0xFF80), 0x18);
+    mem->write8(0xC000, 0x42);
+
+    cpu->run_for(620);
+    EXPECT_TRUE(dma.active());
+    EXPECT_EQ(mem->oam()[0], 0);
+
+    cpu->run_for(40);
+    EXPECT_FALSE(dma.active());
+    EXPECT_EQ(mem->read8(0xC000), 0x18);
+    for (uint16_t offset = 0; offset < 0xA0; ++offset)
+        ASSERT_EQ(mem->read8(0xFE00 + offset), uint8_t(offset + 1)) << offset;
+}
+
+TEST_F(PpuTest, OamDmaMovesSprites) {
+    OamDma dma(*cpu);
+    wait_in_high_ram();
+    set_tile(1, 3);
+    set_sprite(0, 16, 8, 1);
+    // The same sprite at the next row of tiles
+    mem->write8(0xC100, 24);
+    mem->write8(0xC101, 8);
+    mem->write8(0xC102, 1);
+
+    mem->write8(DMA, 0xC1);
+    cpu->run_for(700);
+    mem->write8(LCDC, LCDC_ON);
+    cpu->run_for(FRAME_CYCLES);
+    EXPECT_EQ(pixel(0, 0), 0);
+    EXPECT_EQ(pixel(0, 8), 3);
+}
@@ -0,0 +1,185 @@
+#include "gtest/gtest.h"
+
+#include "CPU.h"
+#include "audio/Apu.h"
+#include "cartridge/Cartridge.h"
+#include "cartridge/RomImage.h"
+#include "io/Timer.h"
+#include "memory/Memory.h"
+#include "state/SaveState.h"
+#include "video/OamDma.h"
+#include "video/Ppu.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+using namespace GameBoy;
+using namespace std;
+
+namespace {
+
+// Every device there is, around an MBC1 cartridge with 8 KiB of RAM
+struct TestMachine {
+    TestMachine(const char* title = "SNAPSHOT", bool withApu = true)
+    {
+        vector<uint8_t> rom(0x8000);
+        copy(title, title + strlen(title), rom.begin() + 0x134);
+        rom[0x147] = 0x03;
+        rom[0x149] = 0x02;
+        cartridge = Cartridge::insert(memory, RomImage::from_bytes(move(rom)));
+        if (withApu)
+            apu = make_unique<Apu>(cpu);
+        ppu.set_framebuffer(framebuffer.data());
+    }
+
+    auto machine() -> Machine { return { cpu, cartridge.get(), &timer, &ppu, &dma, apu.get() }; }
+
+    auto load(uint16_t address, initializer_list<uint8_t> program) -> void
+    {
+        for (auto byte : program)
+            memory.write8(address++, byte);
+    }
+
+    // Everything a program could see, and then some
+    auto observe() -> vector<uint8_t>
+    {
+        vector<uint8_t> seen(framebuffer);
+        const auto& regs = memory.registers();
+        for (auto word : { regs.af, regs.bc, regs.de, regs.hl, regs.sp, regs.pc }) {
+            seen.push_back(uint8_t(word));
+            seen.push_back(uint8_t(word >> 8));
+        }
+        seen.insert(seen.end(), cartridge->ram().begin(), cartridge->ram().end());
+        for (uint32_t address = 0xC000; address < 0x10000; ++address) {
+            // Reading DMA doesn't start one
+            if (address < 0xE000 || address >= 0xFE00)
+                seen.push_back(memory.read8(uint16_t(address)));
+        }
+        const auto now = cpu.scheduler().now();
+        for (auto shift = 0; shift < 64; shift += 8)
+            seen.push_back(uint8_t(now >> shift));
+        seen.push_back(uint8_t(ppu.frame_count()));
+        return seen;
+    }
+
+    Memory memory;
+    unique_ptr<Cartridge> cartridge;
+    CPU cpu { memory };
+    Timer timer { cpu };
+    Ppu ppu { cpu };
+    OamDma dma { cpu };
+    unique_ptr<Apu> apu;
+    vector<uint8_t> framebuffer = vector<uint8_t>(SCREEN_WIDTH * SCREEN_HEIGHT);
+};
+
+}
+
+TEST(SaveStateTest, LoadingReplaysTheSameRun) {
+    TestMachine gb;
+    // From HRAM, so it carries on through OAM DMA
+    gb.load(0xFF90, {
+        0x21, 0x00, 0xA0, // LD HL,$A000
+        0x3E, 0x0A, // LD A,$0A
+        0xEA, 0x00, 0x00, // LD ($0000),A: enable cartridge RAM
+        0xF0, 0x04, // loop: LDH A,(DIV)
+        0x22, // LD (HL+),A
+        0xF0, 0x05, // LDH A,(TIMA)
+        0xEA, 0x00, 0xC1, // LD ($C100),A
+        0xF0, 0x44, // LDH A,(LY)
+        0x86, // ADD A,(HL)
+        0x77, // LD (HL),A
+        0x7C, // LD A,H
+        0xE6, 0x1F, // AND $1F
+        0xF6, 0xA0, // OR $A0
+        0x67, // LD H,A
+        0x18, 0xEC, // JR loop
+    });
+    for (uint16_t address = 0x8000; address < 0x9C00; ++address)
+        gb.memory.write8(address, uint8_t(address * 13));
+    for (uint16_t address = 0xC000; address < 0xC0A0; ++address)
+        gb.memory.write8(address, uint8_t(address * 7));
+    gb.load(0xFF06, { 0x80, 0x05 }); // TMA, TAC: every 16 cycles
+    gb.load(0xFF10, { 0x15, 0x80, 0xF3, 0x00, 0x87 }); // Square 1, sweeping and fading
+    gb.load(0xFF21, { 0xF1, 0x22, 0x80 }); // Noise
+    gb.load(0xFF24, { 0x77, 0xFF });
+    gb.load(0xFF40, { 0x93 }); // LCD on
+    gb.apu->set_sample_rate(48000);
+    gb.memory.registers().pc = 0xFF90;
+    gb.cpu.run_cycles(100'000);
+
+    // Mid-transfer, with the bus locked
+    gb.memory.write8(0xFF46, 0xC0);
+    vector<uint8_t> snapshot;
+    save_state(gb.machine(), snapshot);
+    gb.cpu.run_cycles(300'000);
+    const auto expected = gb.observe();
+
+    ASSERT_TRUE(load_state(gb.machine(), snapshot.data(), snapshot.size()));
+    gb.cpu.run_cycles(300'000);
+    EXPECT_EQ(gb.observe(), expected);
+
+    // And by way of a file
+    const auto path = testing::TempDir() + "save_state_test.state";
+    ASSERT_TRUE(write_state_file(path, snapshot));
+    ASSERT_TRUE(load_state_file(gb.machine(), path));
+    gb.cpu.run_cycles(300'000);
+    EXPECT_EQ(gb.observe(), expected);
+    remove(path.c_str());
+
+    // Sound carries on from where it was
+    vector<int16_t> samples(2 * 48000);
+    EXPECT_GT(gb.apu->read_samples(samples.data(), 48000), 0u);
+}
+
+TEST(SaveStateTest, LoadingDropsCodeCachedSince) {
+    for (auto mode : { ExecutionMode::Interpreter, ExecutionMode::Jit }) {
+        TestMachine gb;
+        gb.cpu.set_execution_mode(mode);
+        gb.load(0xC000, {
+            0x3C, // loop: INC A
+            0x18, 0xFD, // JR loop
+        });
+        auto& regs = gb.memory.registers();
+        regs.pc = 0xC000;
+        regs.a = 0;
+        gb.cpu.run_cycles(10'000);
+
+        vector<uint8_t> snapshot;
+        save_state(gb.machine(), snapshot);
+        gb.cpu.run_cycles(10'000);
+        const auto expected = regs.a;
+
+        gb.memory.write8(0xC000, 0x3D); // DEC A
+        gb.cpu.run_cycles(10'000);
+        ASSERT_TRUE(load_state(gb.machine(), snapshot.data(), snapshot.size()));
+        gb.cpu.run_cycles(10'000);
+        EXPECT_EQ(regs.a, expected);
+    }
+}
+
+TEST(SaveStateTest, SnapshotsThatDoNotFitAreRejected) {
+    TestMachine gb;
+    gb.memory.registers().pc = 0xC000;
+    vector<uint8_t> snapshot;
+    save_state(gb.machine(), snapshot);
+    gb.memory.registers().pc = 0xC123;
+
+    EXPECT_FALSE(load_state(gb.machine(), snapshot.data(), snapshot.size() - 1));
+    auto newer = snapshot;
+    ++newer[4];
+    EXPECT_FALSE(load_state(gb.machine(), newer.data(), newer.size()));
+
+    TestMachine silent("SNAPSHOT", false);
+    EXPECT_FALSE(load_state(silent.machine(), snapshot.data(), snapshot.size()));
+    TestMachine other("ANOTHER");
+    EXPECT_FALSE(load_state(other.machine(), snapshot.data(), snapshot.size()));
+    EXPECT_EQ(gb.memory.registers().pc, 0xC123);
+
+    EXPECT_TRUE(load_state(gb.machine(), snapshot.data(), snapshot.size()));
+    EXPECT_EQ(gb.memory.registers().pc, 0xC000);
+}
@@ -0,0 +1,91 @@
+#include "gtest/gtest.h"
+
+#include "CPU.h"
+#include "Scheduler.h"
+#include "memory/Memory.h"
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+using namespace GameBoy;
+using namespace std;
+
+TEST(SchedulerTest, EventsFireInDeadlineOrder) {
+    Scheduler scheduler;
+    vector<pair<Event, uint64_t>> fired;
+    for (auto event : { Event::Timer, Event::Ppu, Event::Dma, Event::Serial })
+        scheduler.set_handler(event, [&, event] { fired.push_back({ event, scheduler.now() }); });
+
+    scheduler.schedule(Event::Timer, 30);
+    scheduler.schedule(Event::Ppu, 10);
+    scheduler.schedule(Event::Dma, 20);
+    scheduler.schedule(Event::Serial, 10);
+    EXPECT_EQ(scheduler.next_deadline(), 10u);
+
+    scheduler.advance(25);
+    // Ties go in declaration order
+    EXPECT_EQ(fired, (vector<pair<Event, uint64_t>> { { Event::Ppu, 10 }, { Event::Serial, 10 }, { Event::Dma, 20 } }));
+    EXPECT_EQ(scheduler.now(), 25u);
+    EXPECT_EQ(scheduler.next_deadline(), 30u);
+    EXPECT_FALSE(scheduler.is_scheduled(Event::Ppu));
+}
+
+TEST(SchedulerTest, ReschedulingAndCancellingMoveDeadlines) {
+    Scheduler scheduler;
+    scheduler.schedule(Event::Timer, 100);
+    scheduler.schedule(Event::Ppu, 200);
+    scheduler.schedule(Event::Apu, 300);
+
+    scheduler.schedule(Event::Apu, 50);
+    EXPECT_EQ(scheduler.next_deadline(), 50u);
+    scheduler.schedule(Event::Apu, 400);
+    EXPECT_EQ(scheduler.next_deadline(), 100u);
+
+    scheduler.cancel(Event::Timer);
+    scheduler.cancel(Event::Dma);
+    EXPECT_EQ(scheduler.next_deadline(), 200u);
+    EXPECT_EQ(scheduler.deadline(Event::Timer), Scheduler::NEVER);
+    EXPECT_EQ(scheduler.deadline(Event::Apu), 400u);
+
+    scheduler.cancel(Event::Ppu);
+    scheduler.cancel(Event::Apu);
+    EXPECT_EQ(scheduler.next_deadline(), Scheduler::NEVER);
+}
+
+TEST(SchedulerTest, PeriodicEventsKeepExactTimeWhenFiredLate) {
+    Scheduler scheduler;
+    vector<uint64_t> fired;
+    scheduler.set_handler(Event::Timer, [&] {
+        fired.push_back(scheduler.now());
+        scheduler.schedule_in(Event::Timer, 16);
+    });
+    scheduler.schedule(Event::Timer, 16);
+
+    // Steps that don't line up with the period
+    for (auto i = 0; i < 10; ++i)
+        scheduler.advance(7);
+    scheduler.advance(42);
+
+    EXPECT_EQ(fired, (vector<uint64_t> { 16, 32, 48, 64, 80, 96, 112 }));
+    EXPECT_EQ(scheduler.next_deadline(), 128u);
+}
+
+TEST(SchedulerTest, CpuStopsAtEachDeadline) {
+    Memory mem;
+    CPU cpu(mem);
+    // NOPs everywhere; each takes 4 cycles
+    mem.registers().pc = 0xC000;
+
+    auto& scheduler = cpu.scheduler();
+    vector<pair<uint64_t, uint16_t>> fired;
+    scheduler.set_handler(Event::Timer, [&] {
+        fired.push_back({ scheduler.now(), mem.registers().pc });
+        scheduler.schedule_in(Event::Timer, 10);
+    });
+    scheduler.schedule(Event::Timer, 10);
+
+    EXPECT_EQ(cpu.run_until(40), 40u);
+    // The CPU gets at most one instruction past each deadline before it fires
+    EXPECT_EQ(fired, (vector<pair<uint64_t, uint16_t>> { { 10, 0xC003 }, { 20, 0xC005 }, { 30, 0xC008 }, { 40, 0xC00A } }));
+}
@@ -0,0 +1,274 @@
+#include "gtest/gtest.h"
+
+#include "CPU.h"
+#include "io/Timer.h"
+#include "memory/Memory.h"
+
+#include <initializer_list>
+#include <random>
+#include <stdint.h>
+#include <utility>
+
+using namespace GameBoy;
+using namespace std;
+
+namespace {
+
+constexpr uint16_t DIV = 0xFF04;
+constexpr uint16_t TIMA = 0xFF05;
+constexpr uint16_t TMA = 0xFF06;
+constexpr uint16_t TAC = 0xFF07;
+constexpr uint16_t IF = 0xFF0F;
+
+// The timer as the hardware runs it: one counter increment per cycle, TIMA bumped on every
+// falling edge of the selected bit
+struct ReferenceTimer {
+    auto signal() const -> bool
+    {
+        static const uint16_t BITS[] = { 1 << 9, 1 << 3, 1 << 5, 1 << 7 };
+        return (tac & 0x04) && (counter & BITS[tac & 0x03]);
+    }
+
+    auto increment() -> void
+    {
+        if (++tima == 0)
+            reloadIn = 4;
+    }
+
+    auto tick() -> void
+    {
+        reloaded = false;
+        const bool before = signal();
+        ++counter;
+        if (reloadIn > 0 && --reloadIn == 0) {
+            tima = tma;
+            reloaded = true;
+            ++interrupts;
+        }
+        if (before && !signal())
+            increment();
+    }
+
+    auto write(uint16_t address, uint8_t value) -> void
+    {
+        const bool before = signal();
+        switch (address) {
+        case DIV:
+            counter = 0;
+            break;
+        case TIMA:
+            if (!reloaded) {
+                tima = value;
+                reloadIn = 0;
+            }
+            return;
+        case TMA:
+            tma = value;
+            if (reloaded)
+                tima = value;
+            return;
+        default:
+            tac = value & 0x07;
+            break;
+        }
+        if (before && !signal())
+            increment();
+    }
+
+    uint16_t counter = 0;
+    uint8_t tima = 0;
+    uint8_t tma = 0;
+    uint8_t tac = 0;
+    int reloadIn = 0;
+    bool reloaded = false;
+    int interrupts = 0;
+};
+
+class TimerTest : public ::testing::Test {
+protected:
+    TimerTest()
+        : cpu(mem)
+        , timer(cpu)
+    {
+    }
+
+    Memory mem;
+    CPU cpu;
+    Timer timer;
+};
+
+}
+
+TEST_F(TimerTest, DivCountsFromTheLastWrite) {
+    cpu.tick(0x1234);
+    EXPECT_EQ(mem.read8(DIV), 0x12);
+
+    mem.write8(DIV, 0x99);
+    EXPECT_EQ(mem.read8(DIV), 0x00);
+    cpu.tick(0xFF);
+    EXPECT_EQ(mem.read8(DIV), 0x00);
+    cpu.tick(1);
+    EXPECT_EQ(mem.read8(DIV), 0x01);
+}
+
+TEST_F(TimerTest, OverflowReloadsFourCyclesLater) {
+    mem.write8(TMA, 0xF0);
+    mem.write8(TIMA, 0xFE);
+    mem.write8(TAC, 0x05);
+    EXPECT_EQ(mem.read8(TAC), 0xFD);
+
+    cpu.tick(16);
+    EXPECT_EQ(mem.read8(TIMA), 0xFF);
+    cpu.tick(16);
+    EXPECT_EQ(mem.read8(TIMA), 0x00);
+    cpu.tick(3);
+    EXPECT_EQ(mem.read8(TIMA), 0x00);
+    EXPECT_EQ(mem.read8(IF) & 0x04, 0);
+    // Fired by the scheduler, not by the read
+    cpu.tick(1);
+    EXPECT_EQ(mem.read8(IF) & 0x04, 0x04);
+    EXPECT_EQ(mem.read8(TIMA), 0xF0);
+}
+
+TEST_F(TimerTest, WritingTimaDuringTheOverflowCancelsTheReload) {
+    mem.write8(TIMA, 0xFF);
+    mem.write8(TAC, 0x05);
+    cpu.tick(18);
+    mem.write8(TIMA, 0x42);
+    cpu.tick(16);
+    EXPECT_EQ(mem.read8(TIMA), 0x43);
+    EXPECT_EQ(mem.read8(IF) & 0x04, 0);
+}
+
+TEST_F(TimerTest, WritingTmaOnTheReloadCycleReachesTima) {
+    mem.write8(TIMA, 0xFF);
+    mem.write8(TAC, 0x05);
+    cpu.tick(20);
+    mem.write8(TMA, 0x80);
+    EXPECT_EQ(mem.read8(TIMA), 0x80);
+}
+
+TEST_F(TimerTest, ResettingDivWhileTheSelectedBitIsHighIncrementsTima) {
+    mem.write8(TAC, 0x05);
+    cpu.tick(8);
+    mem.write8(DIV, 0);
+    EXPECT_EQ(mem.read8(TIMA), 0x01);
+    // The counter restarted, so the next edge is a whole period away
+    cpu.tick(15);
+    EXPECT_EQ(mem.read8(TIMA), 0x01);
+    cpu.tick(1);
+    EXPECT_EQ(mem.read8(TIMA), 0x02);
+}
+
+TEST_F(TimerTest, ChangingTacCanIncrementTima) {
+    mem.write8(TAC, 0x05);
+    cpu.tick(8);
+    // Bit 9 is low, so moving to it is a falling edge
+    mem.write8(TAC, 0x04);
+    EXPECT_EQ(mem.read8(TIMA), 0x01);
+    cpu.tick(0x200);
+    // So is turning the timer off while the selected bit is high
+    mem.write8(TAC, 0x00);
+    EXPECT_EQ(mem.read8(TIMA), 0x02);
+}
+
+TEST_F(TimerTest, MatchesACycleByCycleTimer) {
+    ReferenceTimer reference;
+    mt19937 random(12);
+    static const uint16_t REGISTERS[] = { DIV, TIMA, TMA, TAC };
+
+    // The ways a program stores A to a timer register, and how far into each the write lands
+    struct Store {
+        uint8_t code[3];
+        uint32_t offset;
+        uint32_t cycles;
+    };
+    static const Store STORES[] = {
+        { { 0xE0, 0x00, 0x00 }, 8, 12 }, // LDH (n),A
+        { { 0xE2, 0x00, 0x00 }, 4, 8 }, // LDH (C),A
+        { { 0x77, 0x00, 0x00 }, 4, 8 }, // LD (HL),A
+        { { 0xEA, 0x00, 0xFF }, 12, 16 }, // LD (nn),A
+    };
+    auto& regs = mem.registers();
+
+    for (auto i = 0; i < 20000; ++i) {
+        const auto cycles = random() % 300;
+        for (uint32_t cycle = 0; cycle < cycles; ++cycle)
+            reference.tick();
+        cpu.tick(cycles);
+
+        ASSERT_EQ(mem.read8(DIV), reference.counter >> 8) << "step " << i;
+        ASSERT_EQ(mem.read8(TIMA), reference.tima) << "step " << i;
+        // IF only records that at least one overflow happened
+        ASSERT_EQ(bool(mem.read8(IF) & 0x04), reference.interrupts > 0) << "step " << i;
+        reference.interrupts = 0;
+        mem.write8(IF, 0);
+
+        const auto address = REGISTERS[random() % 4];
+        const auto& store = STORES[random() % 4];
+        for (uint32_t cycle = 0; cycle < store.offset; ++cycle)
+            reference.tick();
+        // An edge while TIMA sits at 00 waiting for its reload isn't modelled
+        if (reference.reloadIn > 0 && (address == DIV || address == TAC)) {
+            cpu.tick(store.offset);
+            continue;
+        }
+
+        // Mostly the fast rates, so overflows are common
+        const auto value = address == TAC ? uint8_t(0x04 | (random() % 8 ? 1 + random() % 3 : random() % 8)) : uint8_t(random());
+        reference.write(address, value);
+        for (uint32_t cycle = store.offset; cycle < store.cycles; ++cycle)
+            reference.tick();
+
+        mem.write8(0xC000, store.code[0]);
+        mem.write8(0xC001, store.code[1] | uint8_t(address));
+        mem.write8(0xC002, store.code[2]);
+        regs.pc = 0xC000;
+        regs.a = value;
+        regs.c = uint8_t(address);
+        regs.hl = address;
+        ASSERT_EQ(cpu.step(), store.cycles) << "step " << i;
+    }
+}
+
+TEST_F(TimerTest, ReadsDuringExecutionSeeTheCurrentCycle) {
+    // 64 NOPs take 256 cycles, then LDH A,(DIV)
+    mem.write8(0xC040, 0xF0);
+    mem.write8(0xC041, 0x04);
+    mem.registers().pc = 0xC000;
+
+    cpu.run_until(256 + 12);
+    EXPECT_EQ(mem.registers().a, 0x01);
+}
+
+TEST(TimerInterruptTest, TimaWritesCutTheRunningSliceShort) {
+    // Returns what DIV read in the timer interrupt handler
+    const auto handler_sees = [](ExecutionMode mode, bool stepping) -> uint8_t {
+        Memory mem;
+        CPU cpu(mem);
+        Timer timer(cpu);
+        cpu.set_execution_mode(mode);
+        for (auto [address, value] : initializer_list<pair<uint16_t, uint8_t>> {
+                 { 0x0050, 0xF0 }, { 0x0051, 0x04 }, // LDH A,(DIV)
+                 { 0x0052, 0x47 }, // LD B,A
+                 { 0x0053, 0x18 }, { 0x0054, 0xFE }, // JR -2
+                 { 0xC000, 0x3E }, { 0xC001, 0xFF }, // LD A,$FF
+                 { 0xC002, 0xE0 }, { 0xC003, 0x05 }, // LDH (TIMA),A
+                 { 0xC004, 0x18 }, { 0xC005, 0xFE }, // JR -2
+                 { TAC, 0x05 }, { 0xFFFF, 0x04 } })
+            mem.write8(address, value);
+        mem.registers().pc = 0xC000;
+        cpu.set_interrupts_enabled(true);
+        if (stepping) {
+            while (mem.registers().pc != 0x0053)
+                cpu.step();
+        } else {
+            cpu.run_until(10000);
+        }
+        EXPECT_EQ(mem.registers().pc, 0x0053);
+        return mem.registers().b;
+    };
+
+    for (auto mode : { ExecutionMode::Interpreter, ExecutionMode::Jit })
+        EXPECT_EQ(handler_sees(mode, false), handler_sees(mode, true));
+}
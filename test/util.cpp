@@ -29,3 +29,25 @@ TEST(FlagHelpersTest, AddCarry) {
     EXPECT_EQ(should_carry(0xFE, 0x01), false);
     EXPECT_EQ(should_carry(0b0111'0111, 0b0001'0001), false);
 }
+
+TEST(FlagHelpersTest, DecimalAdjustAndRotateTables) {
+    using namespace GameBoy::FlagHelpers;
+
+    // $45 + $38 = $7D, adjusted to 83
+    EXPECT_EQ(Alu::decimal_adjust(0x7D, 0x00).value, 0x83);
+    // $83 - $38 = $4B with H set, adjusted to 45
+    EXPECT_EQ(Alu::decimal_adjust(0x4B, 0x60).value, 0x45);
+    EXPECT_EQ(Alu::decimal_adjust(0x4B, 0x60).flags, 0x40);
+    // $99 + $01 = $9A, adjusted to 00 with a carry
+    EXPECT_EQ(Alu::decimal_adjust(0x9A, 0x00).value, 0x00);
+    EXPECT_EQ(Alu::decimal_adjust(0x9A, 0x00).flags, 0x90);
+
+    EXPECT_EQ(Alu::rotate(0, 0x85, false).value, 0x0B); // RLC
+    EXPECT_EQ(Alu::rotate(0, 0x85, false).flags, 0x10);
+    EXPECT_EQ(Alu::rotate(3, 0x01, false).value, 0x00); // RR
+    EXPECT_EQ(Alu::rotate(3, 0x01, false).flags, 0x90);
+    EXPECT_EQ(Alu::rotate(2, 0x80, true).value, 0x01); // RL
+    EXPECT_EQ(Alu::rotate(5, 0x8A, false).value, 0xC5); // SRA
+    EXPECT_EQ(Alu::rotate(6, 0xF1, true).value, 0x1F); // SWAP
+    EXPECT_EQ(Alu::rotate(6, 0xF1, true).flags, 0x00);
+}